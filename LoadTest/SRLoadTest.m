@@ -0,0 +1,924 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the license found in the
+// LICENSE-examples file in the root directory of this source tree.
+//
+
+// Opens a growing number of connections to the load test server and reports throughput,
+// latency, memory, CPU and thread usage for every connection count.
+//
+// Options (all optional):
+//   -url ws://127.0.0.1:9002/        Server to connect to.
+//   -connections 100,1000,5000,10000 Connection counts to measure, in order.
+//   -rate 1                          Messages per second sent by every connection.
+//   -size 64                         Message size in bytes, at least 8.
+//   -duration 10                     Seconds to measure at every connection count.
+//   -delegateQueue main              Where delegate callbacks go: `main`, `shared` (one serial queue) or `socket` (queue per socket).
+//   -contentionThreads 0             If set, instead measures `sendData:error:` called concurrently on one socket
+//                                    from 1, 2, 4... up to this many threads.
+//   -contentionMessages 100000       Messages sent by every thread in the contention benchmark.
+//   -decodeMessages 0                If set, instead measures main thread time per JSON message of `-size` bytes,
+//                                    decoded on the main queue versus by a `messageDecoder`.
+//   -http2 NO                        Whether connections are multiplexed over HTTP/2, see `allowsHTTP2`.
+//   -loopbackMessages 0              If set, instead measures throughput of `-size` byte messages echoed by an in-process server
+//                                    over an `SRLoopbackTransport`, without the kernel TCP stack or the network run loop.
+//   -loopbackChunkSize 0             Largest read on either end of the loopback transport, to split frames across reads.
+//   -loopbackPrepared NO             With `-loopbackMessages`, also measures sending one `SRPreparedMessage` repeatedly,
+//                                    to compare against `sendData:error:`.
+
+#import <Foundation/Foundation.h>
+
+#import <SocketRocket/SocketRocket.h>
+
+#import <CommonCrypto/CommonDigest.h>
+#import <mach/mach.h>
+#import <mach/mach_time.h>
+#import <os/lock.h>
+#import <stdatomic.h>
+#import <sys/resource.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Interval between sending ticks and between run loop/delegate queue latency probes.
+static const NSTimeInterval SRLoadTestTickInterval = 0.01;
+
+// Maximum time to wait for all connections to open or close.
+static const NSTimeInterval SRLoadTestConnectTimeout = 120.0;
+
+static uint64_t SRLoadTestNow(void)
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+///--------------------------------------
+#pragma mark - Latency Samples
+///--------------------------------------
+
+@interface SRLatencySamples : NSObject
+
+- (void)addNanoseconds:(uint64_t)nanoseconds;
+- (void)reset;
+
+@property (nonatomic, assign, readonly) NSUInteger count;
+- (double)millisecondsAtPercentile:(double)percentile;
+
+@end
+
+@implementation SRLatencySamples
+{
+    os_unfair_lock _lock;
+    NSMutableData *_samples;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (!self) return self;
+
+    _lock = OS_UNFAIR_LOCK_INIT;
+    _samples = [NSMutableData data];
+
+    return self;
+}
+
+- (void)addNanoseconds:(uint64_t)nanoseconds
+{
+    os_unfair_lock_lock(&_lock);
+    [_samples appendBytes:&nanoseconds length:sizeof(nanoseconds)];
+    os_unfair_lock_unlock(&_lock);
+}
+
+- (void)reset
+{
+    os_unfair_lock_lock(&_lock);
+    _samples.length = 0;
+    os_unfair_lock_unlock(&_lock);
+}
+
+- (NSUInteger)count
+{
+    os_unfair_lock_lock(&_lock);
+    NSUInteger count = _samples.length / sizeof(uint64_t);
+    os_unfair_lock_unlock(&_lock);
+    return count;
+}
+
+static int SRCompareUInt64(const void *a, const void *b)
+{
+    uint64_t lhs = *(const uint64_t *)a;
+    uint64_t rhs = *(const uint64_t *)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+- (double)millisecondsAtPercentile:(double)percentile
+{
+    os_unfair_lock_lock(&_lock);
+    NSMutableData *samples = [_samples mutableCopy];
+    os_unfair_lock_unlock(&_lock);
+
+    NSUInteger count = samples.length / sizeof(uint64_t);
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t *values = samples.mutableBytes;
+    qsort(values, count, sizeof(uint64_t), SRCompareUInt64);
+    NSUInteger index = MIN(count - 1, (NSUInteger)(percentile / 100.0 * count));
+    return values[index] / (double)NSEC_PER_MSEC;
+}
+
+@end
+
+///--------------------------------------
+#pragma mark - Client
+///--------------------------------------
+
+@interface SRLoadTestClient : NSObject <SRWebSocketDelegate>
+
+@property (nonatomic, strong, readonly) SRWebSocket *webSocket;
+@property (nonatomic, assign) double sendCredit;
+
+- (instancetype)initWithURL:(NSURL *)url
+              delegateQueue:(nullable dispatch_queue_t)delegateQueue
+                  latencies:(SRLatencySamples *)latencies
+                   counters:(_Atomic(uint64_t) *)counters;
+
+@end
+
+typedef NS_ENUM(NSUInteger, SRLoadTestCounter) {
+    SRLoadTestCounterOpened = 0,
+    SRLoadTestCounterClosed,
+    SRLoadTestCounterFailed,
+    SRLoadTestCounterSent,
+    SRLoadTestCounterReceived,
+    SRLoadTestCounterCount,
+};
+
+@implementation SRLoadTestClient
+{
+    SRLatencySamples *_latencies;
+    _Atomic(uint64_t) *_counters;
+}
+
+- (instancetype)initWithURL:(NSURL *)url
+              delegateQueue:(nullable dispatch_queue_t)delegateQueue
+                  latencies:(SRLatencySamples *)latencies
+                   counters:(_Atomic(uint64_t) *)counters
+{
+    self = [super init];
+    if (!self) return self;
+
+    _latencies = latencies;
+    _counters = counters;
+    _webSocket = [[SRWebSocket alloc] initWithURL:url];
+    _webSocket.delegate = self;
+    if (delegateQueue) {
+        _webSocket.delegateDispatchQueue = delegateQueue;
+    }
+
+    return self;
+}
+
+- (void)webSocketDidOpen:(SRWebSocket *)webSocket
+{
+    atomic_fetch_add(&_counters[SRLoadTestCounterOpened], 1);
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didReceiveMessageWithData:(NSData *)data
+{
+    uint64_t sentTime = 0;
+    if (data.length >= sizeof(sentTime)) {
+        [data getBytes:&sentTime length:sizeof(sentTime)];
+        [_latencies addNanoseconds:SRLoadTestNow() - sentTime];
+    }
+    atomic_fetch_add(&_counters[SRLoadTestCounterReceived], 1);
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didFailWithError:(NSError *)error
+{
+    atomic_fetch_add(&_counters[SRLoadTestCounterFailed], 1);
+    atomic_fetch_add(&_counters[SRLoadTestCounterClosed], 1);
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didCloseWithCode:(NSInteger)code reason:(nullable NSString *)reason wasClean:(BOOL)wasClean
+{
+    atomic_fetch_add(&_counters[SRLoadTestCounterClosed], 1);
+}
+
+@end
+
+///--------------------------------------
+#pragma mark - Decode Client
+///--------------------------------------
+
+// Receives JSON messages on the main queue, and records how long the main thread was busy handling them.
+@interface SRDecodeBenchmarkClient : NSObject <SRWebSocketDelegate, SRWebSocketMessageDecoder>
+
+@property (nonatomic, strong, readonly) SRWebSocket *webSocket;
+@property (nonatomic, assign, readonly) uint64_t mainThreadNanoseconds;
+
+- (instancetype)initWithURL:(NSURL *)url usesMessageDecoder:(BOOL)usesMessageDecoder counters:(_Atomic(uint64_t) *)counters;
+
+@end
+
+@implementation SRDecodeBenchmarkClient
+{
+    _Atomic(uint64_t) *_counters;
+    _Atomic(uint64_t) _mainThreadNanoseconds;
+}
+
+- (instancetype)initWithURL:(NSURL *)url usesMessageDecoder:(BOOL)usesMessageDecoder counters:(_Atomic(uint64_t) *)counters
+{
+    self = [super init];
+    if (!self) return self;
+
+    _counters = counters;
+    atomic_init(&_mainThreadNanoseconds, 0);
+    _webSocket = [[SRWebSocket alloc] initWithURL:url];
+    _webSocket.delegate = self;
+    if (usesMessageDecoder) {
+        _webSocket.messageDecoder = self;
+    }
+
+    return self;
+}
+
+- (uint64_t)mainThreadNanoseconds
+{
+    return atomic_load(&_mainThreadNanoseconds);
+}
+
+- (nullable id)webSocket:(SRWebSocket *)webSocket decodeMessage:(id)message error:(NSError **)error
+{
+    return [NSJSONSerialization JSONObjectWithData:message options:0 error:error];
+}
+
+- (void)webSocketDidOpen:(SRWebSocket *)webSocket
+{
+    atomic_fetch_add(&_counters[SRLoadTestCounterOpened], 1);
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didReceiveMessageWithData:(NSData *)data
+{
+    uint64_t start = SRLoadTestNow();
+    id object = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+    [self _didHandleObject:object start:start];
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didReceiveDecodedMessage:(id)message
+{
+    [self _didHandleObject:message start:SRLoadTestNow()];
+}
+
+- (void)_didHandleObject:(nullable id)object start:(uint64_t)start
+{
+    if ([object isKindOfClass:[NSArray class]] && [object count] > 0) {
+        atomic_fetch_add(&_counters[SRLoadTestCounterReceived], 1);
+    } else {
+        atomic_fetch_add(&_counters[SRLoadTestCounterFailed], 1);
+    }
+    atomic_fetch_add(&_mainThreadNanoseconds, SRLoadTestNow() - start);
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didFailWithError:(NSError *)error
+{
+    atomic_fetch_add(&_counters[SRLoadTestCounterFailed], 1);
+    atomic_fetch_add(&_counters[SRLoadTestCounterClosed], 1);
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didCloseWithCode:(NSInteger)code reason:(nullable NSString *)reason wasClean:(BOOL)wasClean
+{
+    atomic_fetch_add(&_counters[SRLoadTestCounterClosed], 1);
+}
+
+@end
+
+///--------------------------------------
+#pragma mark - Loopback Echo Server
+///--------------------------------------
+
+// Minimal WebSocket server on the other end of a loopback transport: accepts the handshake and echoes every frame back unmasked.
+@interface SRLoopbackEchoServer : NSObject <SRTransportDelegate>
+
+- (instancetype)initWithTransport:(SRLoopbackTransport *)transport;
+
+@end
+
+@implementation SRLoopbackEchoServer
+{
+    SRLoopbackTransport *_transport;
+    NSMutableData *_input;
+    NSMutableData *_output;
+    NSUInteger _outputOffset;
+    BOOL _handshakeFinished;
+}
+
+- (instancetype)initWithTransport:(SRLoopbackTransport *)transport
+{
+    self = [super init];
+    if (!self) return self;
+
+    _input = [NSMutableData data];
+    _output = [NSMutableData data];
+    _transport = transport;
+    _transport.delegate = self;
+    [_transport openTransport];
+
+    return self;
+}
+
+// All events are reported on the loopback queue, one at a time.
+- (void)transport:(id<SRTransport>)transport handleEvent:(SRTransportEvent)event
+{
+    switch (event) {
+        case SRTransportEventHasBytesAvailable: {
+            uint8_t buffer[16 * 1024];
+            while (_transport.hasBytesAvailable) {
+                NSInteger length = [_transport read:buffer maxLength:sizeof(buffer)];
+                if (length <= 0) {
+                    break;
+                }
+                [_input appendBytes:buffer length:(NSUInteger)length];
+            }
+            if (!_handshakeFinished) {
+                [self _readHandshake];
+            }
+            if (_handshakeFinished) {
+                [self _echoFrames];
+            }
+            [self _flush];
+            break;
+        }
+        case SRTransportEventHasSpaceAvailable:
+            [self _flush];
+            break;
+        case SRTransportEventEndEncountered:
+        case SRTransportEventErrorOccurred:
+            [_transport close];
+            break;
+        case SRTransportEventOpenCompleted:
+            break;
+    }
+}
+
+- (void)_readHandshake
+{
+    NSData *terminator = [@"\r\n\r\n" dataUsingEncoding:NSASCIIStringEncoding];
+    NSRange terminatorRange = [_input rangeOfData:terminator options:0 range:NSMakeRange(0, _input.length)];
+    if (terminatorRange.location == NSNotFound) {
+        return;
+    }
+
+    NSString *request = [[NSString alloc] initWithBytes:_input.bytes length:terminatorRange.location encoding:NSUTF8StringEncoding];
+    NSString *key = @"";
+    for (NSString *line in [request componentsSeparatedByString:@"\r\n"]) {
+        NSRange separator = [line rangeOfString:@":"];
+        if (separator.location != NSNotFound &&
+            [[line substringToIndex:separator.location] caseInsensitiveCompare:@"Sec-WebSocket-Key"] == NSOrderedSame) {
+            key = [[line substringFromIndex:NSMaxRange(separator)] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        }
+    }
+
+    NSData *acceptSource = [[key stringByAppendingString:@"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"] dataUsingEncoding:NSUTF8StringEncoding];
+    uint8_t digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(acceptSource.bytes, (CC_LONG)acceptSource.length, digest);
+    NSString *accept = [[NSData dataWithBytes:digest length:sizeof(digest)] base64EncodedStringWithOptions:0];
+    NSString *response = [NSString stringWithFormat:@"HTTP/1.1 101 Switching Protocols\r\n"
+                                                    "Upgrade: websocket\r\n"
+                                                    "Connection: Upgrade\r\n"
+                                                    "Sec-WebSocket-Accept: %@\r\n\r\n", accept];
+    [_output appendData:[response dataUsingEncoding:NSUTF8StringEncoding]];
+
+    [_input replaceBytesInRange:NSMakeRange(0, NSMaxRange(terminatorRange)) withBytes:NULL length:0];
+    _handshakeFinished = YES;
+}
+
+- (void)_echoFrames
+{
+    const uint8_t *bytes = _input.bytes;
+    NSUInteger length = _input.length;
+    NSUInteger offset = 0;
+    while (length - offset >= 2) {
+        const uint8_t *frame = bytes + offset;
+        BOOL masked = !!(frame[1] & 0x80);
+        uint64_t payloadLength = frame[1] & 0x7F;
+        NSUInteger headerLength = 2;
+        NSUInteger extendedLengthSize = (payloadLength == 126 ? 2 : (payloadLength == 127 ? 8 : 0));
+        if (length - offset < headerLength + extendedLengthSize) {
+            break;
+        }
+        if (extendedLengthSize) {
+            payloadLength = 0;
+            for (NSUInteger i = 0; i < extendedLengthSize; i++) {
+                payloadLength = (payloadLength << 8) | frame[headerLength + i];
+            }
+            headerLength += extendedLengthSize;
+        }
+        const uint8_t *maskKey = frame + headerLength;
+        if (masked) {
+            headerLength += 4;
+        }
+        if (length - offset < headerLength + payloadLength) {
+            break;
+        }
+
+        // Same header without the mask bit and key.
+        uint8_t header[10];
+        NSUInteger responseHeaderLength = headerLength - (masked ? 4 : 0);
+        memcpy(header, frame, responseHeaderLength);
+        header[1] &= 0x7F;
+        [_output appendBytes:header length:responseHeaderLength];
+
+        NSUInteger payloadOffset = _output.length;
+        [_output appendBytes:frame + headerLength length:(NSUInteger)payloadLength];
+        if (masked) {
+            uint8_t *payload = (uint8_t *)_output.mutableBytes + payloadOffset;
+            for (NSUInteger i = 0; i < payloadLength; i++) {
+                payload[i] ^= maskKey[i % 4];
+            }
+        }
+        offset += headerLength + (NSUInteger)payloadLength;
+    }
+    [_input replaceBytesInRange:NSMakeRange(0, offset) withBytes:NULL length:0];
+}
+
+- (void)_flush
+{
+    while (_outputOffset < _output.length) {
+        NSInteger length = [_transport write:(const uint8_t *)_output.bytes + _outputOffset maxLength:_output.length - _outputOffset];
+        if (length <= 0) {
+            break;
+        }
+        _outputOffset += (NSUInteger)length;
+    }
+    if (_outputOffset == _output.length) {
+        _output.length = 0;
+        _outputOffset = 0;
+    }
+}
+
+@end
+
+///--------------------------------------
+#pragma mark - Process Statistics
+///--------------------------------------
+
+static double SRResidentMemoryMegabytes(void)
+{
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size / (1024.0 * 1024.0);
+}
+
+static NSUInteger SRThreadCount(void)
+{
+    thread_act_array_t threads;
+    mach_msg_type_number_t count = 0;
+    if (task_threads(mach_task_self(), &threads, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    for (mach_msg_type_number_t i = 0; i < count; i++) {
+        mach_port_deallocate(mach_task_self(), threads[i]);
+    }
+    vm_deallocate(mach_task_self(), (vm_address_t)threads, count * sizeof(thread_act_t));
+    return count;
+}
+
+static uint64_t SRCPUTimeNanoseconds(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return ((uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * NSEC_PER_SEC +
+            (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * NSEC_PER_USEC);
+}
+
+static void SRRaiseFileDescriptorLimit(void)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = MIN(limit.rlim_max, (rlim_t)OPEN_MAX);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+///--------------------------------------
+#pragma mark - Load Test
+///--------------------------------------
+
+@interface SRLoadTest : NSObject
+
+@property (nonatomic, copy) NSURL *url;
+@property (nonatomic, copy) NSArray<NSNumber *> *connectionCounts;
+@property (nonatomic, assign) double messagesPerSecond;
+@property (nonatomic, assign) NSUInteger messageSize;
+@property (nonatomic, assign) NSTimeInterval duration;
+@property (nonatomic, copy) NSString *delegateQueueMode;
+@property (nonatomic, assign) BOOL allowsHTTP2;
+
+- (void)run;
+- (void)runSendContentionWithMaximumThreadCount:(NSUInteger)maximumThreadCount messageCount:(NSUInteger)messageCount;
+- (void)runDecodeWithMessageCount:(NSUInteger)messageCount;
+- (void)runLoopbackWithMessageCount:(NSUInteger)messageCount chunkSize:(NSUInteger)chunkSize prepared:(BOOL)prepared;
+
+@end
+
+@implementation SRLoadTest
+{
+    _Atomic(uint64_t) _counters[SRLoadTestCounterCount];
+    SRLatencySamples *_messageLatencies;
+    SRLatencySamples *_runLoopLatencies;
+    SRLatencySamples *_delegateQueueLatencies;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (!self) return self;
+
+    _messageLatencies = [[SRLatencySamples alloc] init];
+    _runLoopLatencies = [[SRLatencySamples alloc] init];
+    _delegateQueueLatencies = [[SRLatencySamples alloc] init];
+
+    return self;
+}
+
+- (uint64_t)_counter:(SRLoadTestCounter)counter
+{
+    return atomic_load(&_counters[counter]);
+}
+
+- (void)_resetCounters
+{
+    for (NSUInteger i = 0; i < SRLoadTestCounterCount; i++) {
+        atomic_store(&_counters[i], 0);
+    }
+}
+
+- (BOOL)_waitForCounter:(SRLoadTestCounter)counter toReach:(uint64_t)value
+{
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:SRLoadTestConnectTimeout];
+    while ([self _counter:counter] + (counter == SRLoadTestCounterOpened ? [self _counter:SRLoadTestCounterFailed] : 0) < value) {
+        if (deadline.timeIntervalSinceNow < 0) {
+            return NO;
+        }
+        usleep(10 * USEC_PER_SEC / MSEC_PER_SEC);
+    }
+    return YES;
+}
+
+- (void)run
+{
+    SRRaiseFileDescriptorLimit();
+
+    printf("%8s %9s %9s %9s %8s %7s %10s %10s %8s %8s %11s %12s %7s\n",
+           "conns", "open_ms", "rss_mb", "kb/conn", "threads", "cpu%", "sent/s", "recv/s",
+           "p50_ms", "p99_ms", "runloop_p99", "delegate_p99", "errors");
+
+    for (NSNumber *connectionCount in self.connectionCounts) {
+        [self _runWithConnectionCount:connectionCount.unsignedIntegerValue];
+    }
+}
+
+- (void)runSendContentionWithMaximumThreadCount:(NSUInteger)maximumThreadCount messageCount:(NSUInteger)messageCount
+{
+    [self _resetCounters];
+
+    dispatch_queue_t delegateQueue = dispatch_queue_create("com.facebook.socketrocket.loadtest.delegate", DISPATCH_QUEUE_SERIAL);
+    SRLoadTestClient *client = [[SRLoadTestClient alloc] initWithURL:self.url
+                                                       delegateQueue:delegateQueue
+                                                           latencies:_messageLatencies
+                                                            counters:_counters];
+    client.webSocket.allowsHTTP2 = self.allowsHTTP2;
+    [client.webSocket open];
+    if (![self _waitForCounter:SRLoadTestCounterOpened toReach:1] || [self _counter:SRLoadTestCounterFailed] > 0) {
+        fprintf(stderr, "Unable to connect to %s\n", self.url.absoluteString.UTF8String);
+        return;
+    }
+
+    printf("%8s %12s %10s %12s\n", "threads", "sends", "ns/send", "sends/s");
+
+    NSData *payload = [NSMutableData dataWithLength:MAX(self.messageSize, sizeof(uint64_t))];
+    for (NSUInteger threadCount = 1; threadCount <= maximumThreadCount; threadCount *= 2) {
+        _Atomic(uint64_t) failedSends = 0;
+        _Atomic(uint64_t) *failedSendsPointer = &failedSends;
+        uint64_t receivedBefore = [self _counter:SRLoadTestCounterReceived];
+        uint64_t start = SRLoadTestNow();
+        dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t thread) {
+            for (NSUInteger i = 0; i < messageCount; i++) {
+                if (![client.webSocket sendData:payload error:nil]) {
+                    atomic_fetch_add(failedSendsPointer, 1);
+                }
+            }
+        });
+        uint64_t elapsed = SRLoadTestNow() - start;
+        uint64_t sends = threadCount * messageCount;
+
+        printf("%8lu %12llu %10.1f %12.0f\n",
+               (unsigned long)threadCount,
+               sends,
+               elapsed / (double)sends * threadCount,
+               sends / (elapsed / (double)NSEC_PER_SEC));
+        fflush(stdout);
+        if (atomic_load(&failedSends) > 0) {
+            fprintf(stderr, "%llu sends failed\n", atomic_load(&failedSends));
+        }
+
+        // Let the socket drain everything that was queued, so runs don't affect each other.
+        [self _waitForCounter:SRLoadTestCounterReceived toReach:receivedBefore + sends - atomic_load(&failedSends)];
+    }
+
+    [client.webSocket close];
+}
+
+- (void)runDecodeWithMessageCount:(NSUInteger)messageCount
+{
+    // A JSON array of numbers of about `messageSize` bytes.
+    NSMutableArray<NSNumber *> *numbers = [NSMutableArray array];
+    for (NSUInteger i = 0; i < MAX(self.messageSize / 6, 1); i++) {
+        [numbers addObject:@(10000 + i % 90000)];
+    }
+    NSData *payload = [NSJSONSerialization dataWithJSONObject:numbers options:0 error:nil];
+
+    printf("%10s %10s %14s %12s %7s\n", "decoder", "messages", "main_ns/msg", "msgs/s", "errors");
+
+    for (NSNumber *usesMessageDecoder in @[ @NO, @YES ]) {
+        [self _resetCounters];
+        SRDecodeBenchmarkClient *client = [[SRDecodeBenchmarkClient alloc] initWithURL:self.url
+                                                                     usesMessageDecoder:usesMessageDecoder.boolValue
+                                                                               counters:_counters];
+        [client.webSocket open];
+        if (![self _waitForCounter:SRLoadTestCounterOpened toReach:1] || [self _counter:SRLoadTestCounterFailed] > 0) {
+            fprintf(stderr, "Unable to connect to %s\n", self.url.absoluteString.UTF8String);
+            return;
+        }
+
+        uint64_t start = SRLoadTestNow();
+        for (NSUInteger i = 0; i < messageCount; i++) {
+            [client.webSocket sendData:payload error:nil];
+        }
+        [self _waitForCounter:SRLoadTestCounterReceived toReach:messageCount - [self _counter:SRLoadTestCounterFailed]];
+        uint64_t elapsed = SRLoadTestNow() - start;
+
+        printf("%10s %10llu %14.0f %12.0f %7llu\n",
+               (usesMessageDecoder.boolValue ? "yes" : "no"),
+               [self _counter:SRLoadTestCounterReceived],
+               client.mainThreadNanoseconds / (double)MAX(messageCount, 1),
+               messageCount / (elapsed / (double)NSEC_PER_SEC),
+               [self _counter:SRLoadTestCounterFailed]);
+        fflush(stdout);
+
+        [client.webSocket close];
+        [self _waitForCounter:SRLoadTestCounterClosed toReach:1];
+    }
+}
+
+- (void)runLoopbackWithMessageCount:(NSUInteger)messageCount chunkSize:(NSUInteger)chunkSize prepared:(BOOL)prepared
+{
+    [self _resetCounters];
+    [_messageLatencies reset];
+
+    SRLoopbackTransport *clientTransport = nil;
+    SRLoopbackTransport *serverTransport = nil;
+    [SRLoopbackTransport getClientTransport:&clientTransport serverTransport:&serverTransport];
+    clientTransport.chunkSize = chunkSize;
+    serverTransport.chunkSize = chunkSize;
+    SRLoopbackEchoServer *server NS_VALID_UNTIL_END_OF_SCOPE = [[SRLoopbackEchoServer alloc] initWithTransport:(SRLoopbackTransport *_Nonnull)serverTransport];
+
+    dispatch_queue_t delegateQueue = dispatch_queue_create("com.facebook.socketrocket.loadtest.delegate", DISPATCH_QUEUE_SERIAL);
+    SRLoadTestClient *client = [[SRLoadTestClient alloc] initWithURL:self.url
+                                                       delegateQueue:delegateQueue
+                                                           latencies:_messageLatencies
+                                                            counters:_counters];
+    [client.webSocket openWithTransport:(SRLoopbackTransport *_Nonnull)clientTransport];
+    if (![self _waitForCounter:SRLoadTestCounterOpened toReach:1] || [self _counter:SRLoadTestCounterFailed] > 0) {
+        fprintf(stderr, "Unable to open a socket over the loopback transport\n");
+        return;
+    }
+
+    printf("%9s %10s %8s %12s %10s %7s %7s\n", "send", "messages", "size", "msgs/s", "mb/s", "cpu%", "errors");
+
+    NSMutableData *payload = [NSMutableData dataWithLength:MAX(self.messageSize, sizeof(uint64_t))];
+    SRPreparedMessage *preparedMessage = [[SRPreparedMessage alloc] initWithData:payload];
+    for (NSUInteger pass = 0; pass < (prepared ? 2 : 1); pass++) {
+        BOOL sendsPreparedMessage = (pass == 1);
+        uint64_t receivedBefore = [self _counter:SRLoadTestCounterReceived];
+        uint64_t cpuBefore = SRCPUTimeNanoseconds();
+        uint64_t start = SRLoadTestNow();
+        for (NSUInteger i = 0; i < messageCount; i++) {
+            if (sendsPreparedMessage) {
+                [client.webSocket sendPreparedMessage:preparedMessage error:nil];
+            } else {
+                [client.webSocket sendData:payload error:nil];
+            }
+        }
+        [self _waitForCounter:SRLoadTestCounterReceived toReach:receivedBefore + messageCount - [self _counter:SRLoadTestCounterFailed]];
+        uint64_t elapsed = SRLoadTestNow() - start;
+        double elapsedSeconds = elapsed / (double)NSEC_PER_SEC;
+
+        printf("%9s %10llu %8lu %12.0f %10.1f %7.1f %7llu\n",
+               (sendsPreparedMessage ? "prepared" : "data"),
+               [self _counter:SRLoadTestCounterReceived] - receivedBefore,
+               (unsigned long)payload.length,
+               messageCount / elapsedSeconds,
+               messageCount * payload.length / elapsedSeconds / (1024.0 * 1024.0),
+               (SRCPUTimeNanoseconds() - cpuBefore) / (double)elapsed * 100.0,
+               [self _counter:SRLoadTestCounterFailed]);
+        fflush(stdout);
+    }
+
+    [client.webSocket close];
+    [self _waitForCounter:SRLoadTestCounterClosed toReach:1];
+}
+
+- (void)_runWithConnectionCount:(NSUInteger)connectionCount
+{
+    [self _resetCounters];
+    [_messageLatencies reset];
+    [_runLoopLatencies reset];
+    [_delegateQueueLatencies reset];
+
+    dispatch_queue_t sharedDelegateQueue = nil;
+    if ([self.delegateQueueMode isEqualToString:@"shared"]) {
+        sharedDelegateQueue = dispatch_queue_create("com.facebook.socketrocket.loadtest.delegate", DISPATCH_QUEUE_SERIAL);
+    } else if (![self.delegateQueueMode isEqualToString:@"socket"]) {
+        sharedDelegateQueue = dispatch_get_main_queue();
+    }
+
+    double baselineRSS = SRResidentMemoryMegabytes();
+
+    // Open
+    uint64_t openStart = SRLoadTestNow();
+    NSMutableArray<SRLoadTestClient *> *clients = [NSMutableArray arrayWithCapacity:connectionCount];
+    for (NSUInteger i = 0; i < connectionCount; i++) {
+        dispatch_queue_t delegateQueue = sharedDelegateQueue ?: dispatch_queue_create("com.facebook.socketrocket.loadtest.socket", DISPATCH_QUEUE_SERIAL);
+        SRLoadTestClient *client = [[SRLoadTestClient alloc] initWithURL:self.url
+                                                           delegateQueue:delegateQueue
+                                                               latencies:_messageLatencies
+                                                                counters:_counters];
+        [clients addObject:client];
+        client.webSocket.allowsHTTP2 = self.allowsHTTP2;
+        [client.webSocket open];
+    }
+    BOOL opened = [self _waitForCounter:SRLoadTestCounterOpened toReach:connectionCount];
+    double openMilliseconds = (SRLoadTestNow() - openStart) / (double)NSEC_PER_MSEC;
+    double openRSS = SRResidentMemoryMegabytes();
+    if (!opened) {
+        fprintf(stderr, "Timed out opening %lu connections (%llu opened)\n", (unsigned long)connectionCount, [self _counter:SRLoadTestCounterOpened]);
+    }
+
+    // Measure
+    dispatch_queue_t tickQueue = dispatch_queue_create("com.facebook.socketrocket.loadtest.tick", DISPATCH_QUEUE_SERIAL);
+    dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, tickQueue);
+    dispatch_source_set_timer(timer, DISPATCH_TIME_NOW, (uint64_t)(SRLoadTestTickInterval * NSEC_PER_SEC), NSEC_PER_MSEC);
+
+    NSUInteger messageSize = MAX(self.messageSize, sizeof(uint64_t));
+    double creditPerTick = self.messagesPerSecond * SRLoadTestTickInterval;
+    CFRunLoopRef networkRunLoop = [[NSRunLoop SR_networkRunLoop] getCFRunLoop];
+    dispatch_queue_t probedDelegateQueue = sharedDelegateQueue ?: dispatch_get_main_queue();
+
+    __weak typeof(self) wself = self;
+    dispatch_source_set_event_handler(timer, ^{
+        __strong typeof(wself) sself = wself;
+        if (!sself) {
+            return;
+        }
+
+        NSMutableData *payload = [NSMutableData dataWithLength:messageSize];
+        for (SRLoadTestClient *client in clients) {
+            if (client.webSocket.readyState != SR_OPEN) {
+                continue;
+            }
+            client.sendCredit += creditPerTick;
+            while (client.sendCredit >= 1) {
+                client.sendCredit -= 1;
+                uint64_t now = SRLoadTestNow();
+                [payload replaceBytesInRange:NSMakeRange(0, sizeof(now)) withBytes:&now];
+                if ([client.webSocket sendData:payload error:nil]) {
+                    atomic_fetch_add(&sself->_counters[SRLoadTestCounterSent], 1);
+                }
+            }
+        }
+
+        uint64_t probeStart = SRLoadTestNow();
+        SRLatencySamples *runLoopLatencies = sself->_runLoopLatencies;
+        CFRunLoopPerformBlock(networkRunLoop, kCFRunLoopDefaultMode, ^{
+            [runLoopLatencies addNanoseconds:SRLoadTestNow() - probeStart];
+        });
+        CFRunLoopWakeUp(networkRunLoop);
+
+        SRLatencySamples *delegateQueueLatencies = sself->_delegateQueueLatencies;
+        dispatch_async(probedDelegateQueue, ^{
+            [delegateQueueLatencies addNanoseconds:SRLoadTestNow() - probeStart];
+        });
+    });
+
+    uint64_t sentBefore = [self _counter:SRLoadTestCounterSent];
+    uint64_t receivedBefore = [self _counter:SRLoadTestCounterReceived];
+    uint64_t cpuBefore = SRCPUTimeNanoseconds();
+    uint64_t measureStart = SRLoadTestNow();
+    dispatch_resume(timer);
+
+    [NSThread sleepForTimeInterval:self.duration];
+
+    dispatch_source_cancel(timer);
+    double elapsedSeconds = (SRLoadTestNow() - measureStart) / (double)NSEC_PER_SEC;
+    double cpuPercent = (SRCPUTimeNanoseconds() - cpuBefore) / (elapsedSeconds * NSEC_PER_SEC) * 100.0;
+    uint64_t sent = [self _counter:SRLoadTestCounterSent] - sentBefore;
+    uint64_t received = [self _counter:SRLoadTestCounterReceived] - receivedBefore;
+    NSUInteger threadCount = SRThreadCount();
+    double steadyRSS = SRResidentMemoryMegabytes();
+
+    printf("%8lu %9.0f %9.1f %9.1f %8lu %7.1f %10.0f %10.0f %8.2f %8.2f %11.2f %12.2f %7llu\n",
+           (unsigned long)connectionCount,
+           openMilliseconds,
+           steadyRSS,
+           (openRSS - baselineRSS) * 1024.0 / MAX(connectionCount, 1u),
+           (unsigned long)threadCount,
+           cpuPercent,
+           sent / elapsedSeconds,
+           received / elapsedSeconds,
+           [_messageLatencies millisecondsAtPercentile:50],
+           [_messageLatencies millisecondsAtPercentile:99],
+           [_runLoopLatencies millisecondsAtPercentile:99],
+           [_delegateQueueLatencies millisecondsAtPercentile:99],
+           [self _counter:SRLoadTestCounterFailed]);
+    fflush(stdout);
+
+    // Close
+    uint64_t alreadyClosed = [self _counter:SRLoadTestCounterClosed];
+    for (SRLoadTestClient *client in clients) {
+        [client.webSocket close];
+    }
+    if (![self _waitForCounter:SRLoadTestCounterClosed toReach:MAX(alreadyClosed, connectionCount)]) {
+        fprintf(stderr, "Timed out closing %lu connections\n", (unsigned long)connectionCount);
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
+
+int main(int argc, const char *argv[])
+{
+    @autoreleasepool {
+        NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+        [defaults registerDefaults:@{ @"url" : @"ws://127.0.0.1:9002/",
+                                      @"connections" : @"100,1000,5000,10000",
+                                      @"rate" : @1,
+                                      @"size" : @64,
+                                      @"duration" : @10,
+                                      @"delegateQueue" : @"main",
+                                      @"contentionThreads" : @0,
+                                      @"contentionMessages" : @100000,
+                                      @"decodeMessages" : @0,
+                                      @"http2" : @NO,
+                                      @"loopbackMessages" : @0,
+                                      @"loopbackChunkSize" : @0,
+                                      @"loopbackPrepared" : @NO }];
+
+        NSMutableArray<NSNumber *> *connectionCounts = [NSMutableArray array];
+        for (NSString *count in [[defaults stringForKey:@"connections"] componentsSeparatedByString:@","]) {
+            [connectionCounts addObject:@(count.integerValue)];
+        }
+
+        SRLoadTest *loadTest = [[SRLoadTest alloc] init];
+        loadTest.url = [NSURL URLWithString:[defaults stringForKey:@"url"]];
+        loadTest.connectionCounts = connectionCounts;
+        loadTest.messagesPerSecond = [defaults doubleForKey:@"rate"];
+        loadTest.messageSize = (NSUInteger)[defaults integerForKey:@"size"];
+        loadTest.duration = [defaults doubleForKey:@"duration"];
+        loadTest.delegateQueueMode = [defaults stringForKey:@"delegateQueue"];
+        loadTest.allowsHTTP2 = [defaults boolForKey:@"http2"];
+
+        // Delegate callbacks may target the main queue, so the load test itself runs off the main thread.
+        NSUInteger contentionThreads = (NSUInteger)[defaults integerForKey:@"contentionThreads"];
+        NSUInteger contentionMessages = (NSUInteger)[defaults integerForKey:@"contentionMessages"];
+        NSUInteger decodeMessages = (NSUInteger)[defaults integerForKey:@"decodeMessages"];
+        NSUInteger loopbackMessages = (NSUInteger)[defaults integerForKey:@"loopbackMessages"];
+        NSUInteger loopbackChunkSize = (NSUInteger)[defaults integerForKey:@"loopbackChunkSize"];
+        BOOL loopbackPrepared = [defaults boolForKey:@"loopbackPrepared"];
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+            if (contentionThreads > 0) {
+                [loadTest runSendContentionWithMaximumThreadCount:contentionThreads messageCount:contentionMessages];
+            } else if (decodeMessages > 0) {
+                [loadTest runDecodeWithMessageCount:decodeMessages];
+            } else if (loopbackMessages > 0) {
+                [loadTest runLoopbackWithMessageCount:loopbackMessages chunkSize:loopbackChunkSize prepared:loopbackPrepared];
+            } else {
+                [loadTest run];
+            }
+            exit(EXIT_SUCCESS);
+        });
+        dispatch_main();
+    }
+    return 0;
+}
@@ -0,0 +1,788 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the license found in the
+// LICENSE-examples file in the root directory of this source tree.
+//
+
+// Single-threaded WebSocket echo server for load testing, built on the SocketRocket framing core.
+// Every text or binary message is echoed back unchanged, pings are answered with pongs.
+// Clients can also connect with HTTP/2 prior knowledge and open any number of WebSockets on one connection
+// with extended CONNECT (RFC 8441).
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "SRFrame.h"
+#include "SRHPACK.h"
+#include "SRHTTP2.h"
+#include "SRHandshake.h"
+
+// Handshake requests larger than this are rejected.
+static const size_t SRLoadTestServerMaxHandshakeLength = 8192;
+
+// Messages larger than this close the connection.
+static const size_t SRLoadTestServerMaxMessageLength = 16 * 1024 * 1024;
+
+typedef struct {
+    uint8_t *bytes;
+    size_t length;
+    size_t capacity;
+} SRBuffer;
+
+// WebSocket echo state of an HTTP/1.1 connection or an HTTP/2 stream.
+typedef struct {
+    SRCoreIO output;
+    bool closing;
+    SRFrameDecoder decoder;
+    SROpCode messageOpcode;
+    SRBuffer message;
+    SRBuffer control;
+} SRSession;
+
+typedef struct SRStream {
+    uint32_t streamID;
+    SRSession session;
+    SRBuffer pending; // Frames waiting for send window.
+    int64_t sendWindow;
+    bool endStreamReceived;
+    bool endStreamSent;
+    struct SRStream *next;
+} SRStream;
+
+typedef struct {
+    int fd;
+    bool open;
+    bool closing;
+    SRBuffer input;
+    SRBuffer output;
+    size_t outputOffset;
+    SRSession session;
+
+    // HTTP/2
+    bool http2;
+    SRStream *streams;
+    int64_t sendWindow;
+    uint32_t initialSendWindow;
+    uint32_t maxFrameSize;
+    uint32_t headerBlockStreamID;
+    uint8_t headerBlockFlags;
+    SRBuffer headerBlock;
+} SRConnection;
+
+static SRConnection **SRConnections;
+static size_t SRConnectionsCapacity;
+static size_t SRConnectionCount;
+static uint64_t SRMessageCount;
+
+///--------------------------------------
+// Buffers
+///--------------------------------------
+
+static bool SRBufferAppend(SRBuffer *buffer, const uint8_t *bytes, size_t length)
+{
+    if (buffer->length + length > buffer->capacity) {
+        size_t capacity = (buffer->capacity ? buffer->capacity : 1024);
+        while (capacity < buffer->length + length) {
+            capacity *= 2;
+        }
+        uint8_t *newBytes = realloc(buffer->bytes, capacity);
+        if (!newBytes) {
+            return false;
+        }
+        buffer->bytes = newBytes;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+    return true;
+}
+
+static void SRBufferConsume(SRBuffer *buffer, size_t length)
+{
+    memmove(buffer->bytes, buffer->bytes + length, buffer->length - length);
+    buffer->length -= length;
+}
+
+static void SRBufferFree(SRBuffer *buffer)
+{
+    free(buffer->bytes);
+    *buffer = (SRBuffer){0};
+}
+
+static bool SRBufferWrite(void *context, const uint8_t *bytes, size_t length)
+{
+    return SRBufferAppend(context, bytes, length);
+}
+
+///--------------------------------------
+// Connections
+///--------------------------------------
+
+///--------------------------------------
+// Sessions
+///--------------------------------------
+
+static void SRSessionFrameHeader(void *context, const SRFrameHeader *header)
+{
+    SRSession *session = context;
+    if (SROpCodeIsControl(header->opcode)) {
+        session->control.length = 0;
+    } else if (header->opcode != SROpCodeContinuationFrame) {
+        session->messageOpcode = header->opcode;
+        session->message.length = 0;
+    }
+}
+
+static void SRSessionFramePayload(void *context, const SRFrameHeader *header, const uint8_t *bytes, size_t length)
+{
+    SRSession *session = context;
+    SRBuffer *buffer = (SROpCodeIsControl(header->opcode) ? &session->control : &session->message);
+    if (buffer->length + length > SRLoadTestServerMaxMessageLength || !SRBufferAppend(buffer, bytes, length)) {
+        session->closing = true;
+    }
+}
+
+static void SRSessionFrameEnd(void *context, const SRFrameHeader *header)
+{
+    SRSession *session = context;
+    bool sent = true;
+    switch (header->opcode) {
+        case SROpCodePing:
+            sent = SRFrameWrite(&session->output, NULL, SROpCodePong, true, session->control.bytes, session->control.length);
+            break;
+        case SROpCodePong:
+            break;
+        case SROpCodeConnectionClose:
+            sent = SRFrameWrite(&session->output, NULL, SROpCodeConnectionClose, true, session->control.bytes, (session->control.length >= 2 ? 2 : 0));
+            session->closing = true;
+            break;
+        default:
+            if (header->fin) {
+                sent = SRFrameWrite(&session->output, NULL, session->messageOpcode, true, session->message.bytes, session->message.length);
+                SRMessageCount++;
+            }
+            break;
+    }
+    if (!sent) {
+        session->closing = true;
+    }
+}
+
+static void SRSessionInit(SRSession *session, SRBuffer *output)
+{
+    session->output = (SRCoreIO){ .write = SRBufferWrite, .context = output };
+    SRFrameDecoderInit(&session->decoder, (SRFrameDecoderCallbacks){
+        .frameHeader = SRSessionFrameHeader,
+        .framePayload = SRSessionFramePayload,
+        .frameEnd = SRSessionFrameEnd,
+        .context = session,
+    });
+}
+
+static void SRSessionFree(SRSession *session)
+{
+    SRBufferFree(&session->message);
+    SRBufferFree(&session->control);
+}
+
+///--------------------------------------
+// Connections
+///--------------------------------------
+
+static void SRConnectionClose(SRConnection *connection)
+{
+    close(connection->fd);
+    SRConnections[connection->fd] = NULL;
+    while (connection->streams) {
+        SRStream *stream = connection->streams;
+        connection->streams = stream->next;
+        SRSessionFree(&stream->session);
+        SRBufferFree(&stream->pending);
+        free(stream);
+    }
+    SRBufferFree(&connection->input);
+    SRBufferFree(&connection->output);
+    SRBufferFree(&connection->headerBlock);
+    SRSessionFree(&connection->session);
+    free(connection);
+    SRConnectionCount--;
+}
+
+static bool SRConnectionHandleHandshake(SRConnection *connection)
+{
+    const char *request = (const char *)connection->input.bytes;
+    size_t requestLength = 0;
+    for (size_t i = 3; i < connection->input.length; i++) {
+        if (memcmp(request + i - 3, "\r\n\r\n", 4) == 0) {
+            requestLength = i + 1;
+            break;
+        }
+    }
+    if (requestLength == 0) {
+        return (connection->input.length <= SRLoadTestServerMaxHandshakeLength);
+    }
+
+    static const char keyHeader[] = "\r\nSec-WebSocket-Key:";
+    const char *key = NULL;
+    for (size_t i = 0; i + sizeof(keyHeader) - 1 < requestLength; i++) {
+        if (strncasecmp(request + i, keyHeader, sizeof(keyHeader) - 1) == 0) {
+            key = request + i + sizeof(keyHeader) - 1;
+            break;
+        }
+    }
+    if (!key) {
+        return false;
+    }
+    while (*key == ' ') {
+        key++;
+    }
+    size_t keyLength = 0;
+    while (key[keyLength] != '\r' && key[keyLength] != ' ') {
+        keyLength++;
+    }
+
+    char acceptKey[SRHandshakeAcceptKeyLength + 1];
+    if (!SRHandshakeAcceptKeyCreate(&SRCoreCryptoPortable, key, keyLength, acceptKey)) {
+        return false;
+    }
+
+    char response[256];
+    int responseLength = snprintf(response, sizeof(response),
+                                  "HTTP/1.1 101 Switching Protocols\r\n"
+                                  "Upgrade: websocket\r\n"
+                                  "Connection: Upgrade\r\n"
+                                  "Sec-WebSocket-Accept: %s\r\n\r\n", acceptKey);
+    if (!SRBufferAppend(&connection->output, (const uint8_t *)response, (size_t)responseLength)) {
+        return false;
+    }
+
+    SRBufferConsume(&connection->input, requestLength);
+    connection->open = true;
+    return true;
+}
+
+///--------------------------------------
+// HTTP/2
+///--------------------------------------
+
+static SRCoreIO SRConnectionOutput(SRConnection *connection)
+{
+    return (SRCoreIO){ .write = SRBufferWrite, .context = &connection->output };
+}
+
+static SRStream *SRConnectionFindStream(SRConnection *connection, uint32_t streamID)
+{
+    for (SRStream *stream = connection->streams; stream; stream = stream->next) {
+        if (stream->streamID == streamID) {
+            return stream;
+        }
+    }
+    return NULL;
+}
+
+static void SRConnectionRemoveStream(SRConnection *connection, SRStream *stream)
+{
+    for (SRStream **link = &connection->streams; *link; link = &(*link)->next) {
+        if (*link == stream) {
+            *link = stream->next;
+            break;
+        }
+    }
+    SRSessionFree(&stream->session);
+    SRBufferFree(&stream->pending);
+    free(stream);
+}
+
+// Sends as much of the stream's pending output as the send windows allow, then ends the stream once the WebSocket closed.
+static bool SRStreamFlush(SRConnection *connection, SRStream *stream)
+{
+    SRCoreIO io = SRConnectionOutput(connection);
+    size_t offset = 0;
+    while (offset < stream->pending.length) {
+        int64_t window = (stream->sendWindow < connection->sendWindow ? stream->sendWindow : connection->sendWindow);
+        if (window <= 0) {
+            break;
+        }
+        size_t length = stream->pending.length - offset;
+        if ((int64_t)length > window) {
+            length = (size_t)window;
+        }
+        if (length > connection->maxFrameSize) {
+            length = connection->maxFrameSize;
+        }
+        if (!SRHTTP2FrameWrite(&io, SRHTTP2FrameTypeData, 0, stream->streamID, stream->pending.bytes + offset, length)) {
+            return false;
+        }
+        offset += length;
+        stream->sendWindow -= (int64_t)length;
+        connection->sendWindow -= (int64_t)length;
+    }
+    SRBufferConsume(&stream->pending, offset);
+
+    if (stream->session.closing && stream->pending.length == 0 && !stream->endStreamSent) {
+        if (!SRHTTP2FrameWrite(&io, SRHTTP2FrameTypeData, SRHTTP2FlagEndStream, stream->streamID, NULL, 0)) {
+            return false;
+        }
+        stream->endStreamSent = true;
+    }
+    if (stream->endStreamSent && stream->endStreamReceived) {
+        SRConnectionRemoveStream(connection, stream);
+    }
+    return true;
+}
+
+static bool SRConnectionFlushStreams(SRConnection *connection)
+{
+    SRStream *stream = connection->streams;
+    while (stream) {
+        SRStream *next = stream->next;
+        if (!SRStreamFlush(connection, stream)) {
+            return false;
+        }
+        stream = next;
+    }
+    return true;
+}
+
+typedef struct {
+    bool connect;
+    bool websocket;
+} SRConnectRequest;
+
+static void SRConnectRequestHeader(void *context, const uint8_t *name, size_t nameLength, const uint8_t *value, size_t valueLength)
+{
+    SRConnectRequest *request = context;
+    if (nameLength == 7 && memcmp(name, ":method", 7) == 0) {
+        request->connect = (valueLength == 7 && memcmp(value, "CONNECT", 7) == 0);
+    } else if (nameLength == 9 && memcmp(name, ":protocol", 9) == 0) {
+        request->websocket = (valueLength == 9 && memcmp(value, "websocket", 9) == 0);
+    }
+}
+
+static bool SRConnectionHandleHeaderBlock(SRConnection *connection)
+{
+    static uint8_t scratch[16 * 1024];
+    SRConnectRequest request = {0};
+    SRHPACKDecoderCallbacks callbacks = { .header = SRConnectRequestHeader, .context = &request };
+    if (SRHPACKDecode(connection->headerBlock.bytes, connection->headerBlock.length, scratch, sizeof(scratch), callbacks) != SRFrameResultOK) {
+        return false;
+    }
+    connection->headerBlock.length = 0;
+
+    uint32_t streamID = connection->headerBlockStreamID;
+    SRStream *stream = SRConnectionFindStream(connection, streamID);
+    if (stream) {
+        // Trailers.
+        stream->endStreamReceived = stream->endStreamReceived || (connection->headerBlockFlags & SRHTTP2FlagEndStream);
+        return SRStreamFlush(connection, stream);
+    }
+
+    // Both responses are a single byte, as `:status` 200 and 400 are in the static table.
+    SRCoreIO io = SRConnectionOutput(connection);
+    SRBuffer response = {0};
+    SRCoreIO responseIO = { .write = SRBufferWrite, .context = &response };
+    bool accepted = (request.connect && request.websocket && !(connection->headerBlockFlags & SRHTTP2FlagEndStream));
+    bool written = (SRHPACKEncodeHeader(&responseIO, ":status", 7, (accepted ? "200" : "400"), 3) &&
+                    SRHTTP2FrameWrite(&io,
+                                      SRHTTP2FrameTypeHeaders,
+                                      SRHTTP2FlagEndHeaders | (accepted ? 0 : SRHTTP2FlagEndStream),
+                                      streamID,
+                                      response.bytes,
+                                      response.length));
+    SRBufferFree(&response);
+    if (!written || !accepted) {
+        return written;
+    }
+
+    stream = calloc(1, sizeof(SRStream));
+    if (!stream) {
+        return false;
+    }
+    stream->streamID = streamID;
+    stream->sendWindow = connection->initialSendWindow;
+    SRSessionInit(&stream->session, &stream->pending);
+    stream->next = connection->streams;
+    connection->streams = stream;
+    return true;
+}
+
+static bool SRConnectionHandleSettings(SRConnection *connection, const SRHTTP2FrameHeader *header, const uint8_t *payload)
+{
+    if (header->flags & SRHTTP2FlagAck) {
+        return true;
+    }
+    SRHTTP2Setting setting;
+    for (size_t i = 0; SRHTTP2SettingRead(payload, header->length, i, &setting); i++) {
+        if (setting.identifier == SRHTTP2SettingInitialWindowSize) {
+            int64_t delta = (int64_t)setting.value - (int64_t)connection->initialSendWindow;
+            for (SRStream *stream = connection->streams; stream; stream = stream->next) {
+                stream->sendWindow += delta;
+            }
+            connection->initialSendWindow = setting.value;
+        } else if (setting.identifier == SRHTTP2SettingMaxFrameSize) {
+            connection->maxFrameSize = setting.value;
+        }
+    }
+    SRCoreIO io = SRConnectionOutput(connection);
+    return SRHTTP2WriteSettings(&io, NULL, 0, true) && SRConnectionFlushStreams(connection);
+}
+
+static bool SRConnectionHandleData(SRConnection *connection, const SRHTTP2FrameHeader *header, uint8_t *payload)
+{
+    SRCoreIO io = SRConnectionOutput(connection);
+    SRStream *stream = SRConnectionFindStream(connection, header->streamID);
+    // Data is consumed right away, so every byte is acknowledged as it arrives.
+    if (header->length > 0) {
+        if (!SRHTTP2WriteWindowUpdate(&io, 0, header->length) ||
+            (stream && !SRHTTP2WriteWindowUpdate(&io, header->streamID, header->length))) {
+            return false;
+        }
+    }
+    if (!stream) {
+        return true;
+    }
+
+    const uint8_t *data = NULL;
+    size_t dataLength = 0;
+    if (SRHTTP2FramePayloadStrip(header, payload, &data, &dataLength) != SRFrameResultOK) {
+        return false;
+    }
+    if (!stream->session.closing &&
+        SRFrameDecoderConsume(&stream->session.decoder, payload + (data - payload), dataLength) != SRFrameResultOK) {
+        stream->session.closing = true;
+    }
+    stream->endStreamReceived = stream->endStreamReceived || (header->flags & SRHTTP2FlagEndStream);
+    return SRStreamFlush(connection, stream);
+}
+
+static bool SRConnectionHandleFrame(SRConnection *connection, const SRHTTP2FrameHeader *header, uint8_t *payload)
+{
+    SRCoreIO io = SRConnectionOutput(connection);
+    if (connection->headerBlock.length > 0 && header->type != SRHTTP2FrameTypeContinuation) {
+        return false;
+    }
+
+    switch (header->type) {
+        case SRHTTP2FrameTypeSettings:
+            return SRConnectionHandleSettings(connection, header, payload);
+        case SRHTTP2FrameTypePing:
+            return ((header->flags & SRHTTP2FlagAck) ||
+                    SRHTTP2FrameWrite(&io, SRHTTP2FrameTypePing, SRHTTP2FlagAck, 0, payload, header->length));
+        case SRHTTP2FrameTypeWindowUpdate: {
+            if (header->length != 4) {
+                return false;
+            }
+            uint32_t increment = SRHTTP2ReadUInt31(payload);
+            if (header->streamID == 0) {
+                connection->sendWindow += increment;
+                return SRConnectionFlushStreams(connection);
+            }
+            SRStream *stream = SRConnectionFindStream(connection, header->streamID);
+            if (stream) {
+                stream->sendWindow += increment;
+                return SRStreamFlush(connection, stream);
+            }
+            return true;
+        }
+        case SRHTTP2FrameTypeHeaders: {
+            const uint8_t *fragment = NULL;
+            size_t fragmentLength = 0;
+            if (SRHTTP2FramePayloadStrip(header, payload, &fragment, &fragmentLength) != SRFrameResultOK ||
+                !SRBufferAppend(&connection->headerBlock, fragment, fragmentLength)) {
+                return false;
+            }
+            connection->headerBlockStreamID = header->streamID;
+            connection->headerBlockFlags = header->flags;
+            return (!(header->flags & SRHTTP2FlagEndHeaders) || SRConnectionHandleHeaderBlock(connection));
+        }
+        case SRHTTP2FrameTypeContinuation:
+            if (header->streamID != connection->headerBlockStreamID ||
+                !SRBufferAppend(&connection->headerBlock, payload, header->length) ||
+                connection->headerBlock.length > SRLoadTestServerMaxHandshakeLength) {
+                return false;
+            }
+            return (!(header->flags & SRHTTP2FlagEndHeaders) || SRConnectionHandleHeaderBlock(connection));
+        case SRHTTP2FrameTypeData:
+            return SRConnectionHandleData(connection, header, payload);
+        case SRHTTP2FrameTypeRSTStream: {
+            SRStream *stream = SRConnectionFindStream(connection, header->streamID);
+            if (stream) {
+                SRConnectionRemoveStream(connection, stream);
+            }
+            return true;
+        }
+        case SRHTTP2FrameTypeGoAway:
+            connection->closing = true;
+            return true;
+        default:
+            return true;
+    }
+}
+
+static bool SRConnectionStartHTTP2(SRConnection *connection)
+{
+    connection->http2 = true;
+    connection->open = true;
+    connection->sendWindow = SRHTTP2DefaultInitialWindowSize;
+    connection->initialSendWindow = SRHTTP2DefaultInitialWindowSize;
+    connection->maxFrameSize = SRHTTP2DefaultMaxFrameSize;
+    SRBufferConsume(&connection->input, SRHTTP2ConnectionPrefaceLength);
+
+    // Streams are consumed as fast as they arrive, so windows are only limited by how much the client allows.
+    const SRHTTP2Setting settings[] = {
+        { SRHTTP2SettingHeaderTableSize, 0 },
+        { SRHTTP2SettingInitialWindowSize, SRHTTP2MaxWindowSize },
+        { SRHTTP2SettingEnableConnectProtocol, 1 },
+    };
+    SRCoreIO io = SRConnectionOutput(connection);
+    return (SRHTTP2WriteSettings(&io, settings, sizeof(settings) / sizeof(settings[0]), false) &&
+            SRHTTP2WriteWindowUpdate(&io, 0, SRHTTP2MaxWindowSize - SRHTTP2DefaultInitialWindowSize));
+}
+
+static bool SRConnectionHandleHTTP2(SRConnection *connection)
+{
+    size_t offset = 0;
+    while (!connection->closing) {
+        SRHTTP2FrameHeader header;
+        if (SRHTTP2FrameHeaderParse(connection->input.bytes + offset, connection->input.length - offset, &header) != SRFrameResultOK) {
+            break;
+        }
+        if (header.length > SRHTTP2DefaultMaxFrameSize) {
+            return false;
+        }
+        if (connection->input.length - offset < SRHTTP2FrameHeaderLength + header.length) {
+            break;
+        }
+        if (!SRConnectionHandleFrame(connection, &header, connection->input.bytes + offset + SRHTTP2FrameHeaderLength)) {
+            return false;
+        }
+        offset += SRHTTP2FrameHeaderLength + header.length;
+    }
+    SRBufferConsume(&connection->input, offset);
+    return true;
+}
+
+///--------------------------------------
+// I/O
+///--------------------------------------
+
+static bool SRConnectionFlush(SRConnection *connection)
+{
+    while (connection->outputOffset < connection->output.length) {
+        ssize_t written = send(connection->fd,
+                               connection->output.bytes + connection->outputOffset,
+                               connection->output.length - connection->outputOffset,
+                               0);
+        if (written < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+        }
+        connection->outputOffset += (size_t)written;
+    }
+    connection->output.length = 0;
+    connection->outputOffset = 0;
+    return true;
+}
+
+static bool SRConnectionRead(SRConnection *connection)
+{
+    uint8_t buffer[64 * 1024];
+    while (true) {
+        ssize_t readLength = recv(connection->fd, buffer, sizeof(buffer), 0);
+        if (readLength == 0) {
+            return false;
+        }
+        if (readLength < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+        }
+
+        if (connection->http2) {
+            if (!SRBufferAppend(&connection->input, buffer, (size_t)readLength) || !SRConnectionHandleHTTP2(connection)) {
+                return false;
+            }
+        } else if (connection->open) {
+            if (SRFrameDecoderConsume(&connection->session.decoder, buffer, (size_t)readLength) != SRFrameResultOK) {
+                return false;
+            }
+        } else {
+            if (!SRBufferAppend(&connection->input, buffer, (size_t)readLength)) {
+                return false;
+            }
+            // HTTP/2 with prior knowledge starts with the connection preface instead of an upgrade request.
+            size_t prefaceLength = (connection->input.length < SRHTTP2ConnectionPrefaceLength ? connection->input.length : SRHTTP2ConnectionPrefaceLength);
+            if (memcmp(connection->input.bytes, SRHTTP2ConnectionPreface, prefaceLength) == 0) {
+                if (prefaceLength == SRHTTP2ConnectionPrefaceLength &&
+                    (!SRConnectionStartHTTP2(connection) || !SRConnectionHandleHTTP2(connection))) {
+                    return false;
+                }
+                continue;
+            }
+            if (!SRConnectionHandleHandshake(connection)) {
+                return false;
+            }
+            // Frames that arrived together with the handshake.
+            if (connection->open && connection->input.length > 0) {
+                if (SRFrameDecoderConsume(&connection->session.decoder, connection->input.bytes, connection->input.length) != SRFrameResultOK) {
+                    return false;
+                }
+                connection->input.length = 0;
+            }
+        }
+        if (connection->closing || connection->session.closing) {
+            return true;
+        }
+    }
+}
+
+static void SRAcceptConnections(int listenFD)
+{
+    while (true) {
+        int fd = accept(listenFD, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        if ((size_t)fd >= SRConnectionsCapacity) {
+            close(fd);
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        SRConnection *connection = calloc(1, sizeof(SRConnection));
+        if (!connection) {
+            close(fd);
+            continue;
+        }
+        connection->fd = fd;
+        SRSessionInit(&connection->session, &connection->output);
+        SRConnections[fd] = connection;
+        SRConnectionCount++;
+    }
+}
+
+///--------------------------------------
+// Main
+///--------------------------------------
+
+static void SRRaiseFileDescriptorLimit(void)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+#ifdef __APPLE__
+        if (limit.rlim_cur > OPEN_MAX) {
+            limit.rlim_cur = OPEN_MAX;
+        }
+#endif
+        setrlimit(RLIMIT_NOFILE, &limit);
+        getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    SRConnectionsCapacity = (size_t)limit.rlim_cur;
+    if (SRConnectionsCapacity > 1024 * 1024) {
+        SRConnectionsCapacity = 1024 * 1024;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int port = 9002;
+    int option;
+    while ((option = getopt(argc, argv, "p:h")) != -1) {
+        switch (option) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-p port]\n", argv[0]);
+                return (option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    SRRaiseFileDescriptorLimit();
+    SRConnections = calloc(SRConnectionsCapacity, sizeof(SRConnection *));
+    struct pollfd *pollFDs = calloc(SRConnectionsCapacity + 1, sizeof(struct pollfd));
+    if (!SRConnections || !pollFDs) {
+        fprintf(stderr, "Failed to allocate connection table\n");
+        return EXIT_FAILURE;
+    }
+
+    int listenFD = socket(AF_INET, SOCK_STREAM, 0);
+    int reuseAddress = 1;
+    setsockopt(listenFD, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons((uint16_t)port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(listenFD, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listenFD, SOMAXCONN) != 0) {
+        perror("Failed to listen");
+        return EXIT_FAILURE;
+    }
+    fcntl(listenFD, F_SETFL, fcntl(listenFD, F_GETFL) | O_NONBLOCK);
+
+    printf("Listening on ws://127.0.0.1:%d/ with HTTP/1.1 or HTTP/2 (max %zu connections)\n", port, SRConnectionsCapacity - 1);
+    fflush(stdout);
+
+    time_t lastReportTime = time(NULL);
+    uint64_t lastReportMessageCount = 0;
+    while (true) {
+        time_t now = time(NULL);
+        if (now - lastReportTime >= 5) {
+            printf("%zu connections, %.0f messages/s\n", SRConnectionCount, (double)(SRMessageCount - lastReportMessageCount) / (double)(now - lastReportTime));
+            fflush(stdout);
+            lastReportTime = now;
+            lastReportMessageCount = SRMessageCount;
+        }
+
+        nfds_t pollCount = 0;
+        pollFDs[pollCount++] = (struct pollfd){ .fd = listenFD, .events = POLLIN };
+        for (size_t fd = 0; fd < SRConnectionsCapacity; fd++) {
+            SRConnection *connection = SRConnections[fd];
+            if (connection) {
+                short events = POLLIN | (connection->output.length > connection->outputOffset ? POLLOUT : 0);
+                pollFDs[pollCount++] = (struct pollfd){ .fd = (int)fd, .events = events };
+            }
+        }
+
+        if (poll(pollFDs, pollCount, 1000) < 0 && errno != EINTR) {
+            perror("poll");
+            return EXIT_FAILURE;
+        }
+
+        for (nfds_t i = 1; i < pollCount; i++) {
+            if (!pollFDs[i].revents) {
+                continue;
+            }
+            SRConnection *connection = SRConnections[pollFDs[i].fd];
+            bool alive = true;
+            if (pollFDs[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                alive = SRConnectionRead(connection);
+            }
+            alive = alive && SRConnectionFlush(connection);
+            bool closing = (connection->closing || connection->session.closing);
+            if (!alive || (closing && connection->output.length == 0)) {
+                SRConnectionClose(connection);
+            }
+        }
+
+        if (pollFDs[0].revents & POLLIN) {
+            SRAcceptConnections(listenFD);
+        }
+    }
+}
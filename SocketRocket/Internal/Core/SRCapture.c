@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#include "SRCapture.h"
+
+#include <string.h>
+
+static void SRCaptureWriteLittleEndian(uint8_t *buffer, uint64_t value, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        buffer[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t SRCaptureReadLittleEndian(const uint8_t *buffer, size_t length)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < length; i++) {
+        value |= (uint64_t)buffer[i] << (8 * i);
+    }
+    return value;
+}
+
+bool SRCaptureWriteFileHeader(const SRCoreIO *io)
+{
+    return io->write(io->context, (const uint8_t *)SRCaptureFileMagic, SRCaptureFileMagicLength);
+}
+
+bool SRCaptureWriteRecord(const SRCoreIO *io, const SRCaptureRecord *record, const uint8_t *bytes)
+{
+    uint8_t header[SRCaptureRecordHeaderLength] = {0};
+    SRCaptureWriteLittleEndian(header, record->timestamp, sizeof(uint64_t));
+    SRCaptureWriteLittleEndian(header + 8, record->length, sizeof(uint32_t));
+    header[12] = record->direction;
+
+    if (!io->write(io->context, header, sizeof(header))) {
+        return false;
+    }
+    return (record->length == 0 || io->write(io->context, bytes, record->length));
+}
+
+bool SRCaptureFileHeaderIsValid(const uint8_t *bytes, size_t length)
+{
+    return (length >= SRCaptureFileMagicLength && memcmp(bytes, SRCaptureFileMagic, SRCaptureFileMagicLength) == 0);
+}
+
+SRFrameResult SRCaptureRecordParse(const uint8_t *bytes, size_t length, SRCaptureRecord *record)
+{
+    if (length < SRCaptureRecordHeaderLength) {
+        return SRFrameResultNeedMoreData;
+    }
+
+    record->timestamp = SRCaptureReadLittleEndian(bytes, sizeof(uint64_t));
+    record->length = (uint32_t)SRCaptureReadLittleEndian(bytes + 8, sizeof(uint32_t));
+    record->direction = bytes[12];
+
+    if (record->direction > SRCaptureDirectionOutbound || bytes[13] || bytes[14] || bytes[15]) {
+        return SRFrameResultProtocolError;
+    }
+    if (length - SRCaptureRecordHeaderLength < record->length) {
+        return SRFrameResultNeedMoreData;
+    }
+    return SRFrameResultOK;
+}
@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SRFrame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ Wire capture format: raw bytes a socket read from or wrote to the network, with timestamps.
+
+ A capture starts with the 8 byte `SRCaptureFileMagic`, followed by records, each of which is
+ a 16 byte little-endian header (timestamp: uint64 nanoseconds since the capture started, length: uint32,
+ direction: uint8, 3 reserved zero bytes) followed by `length` bytes of data.
+ */
+#define SRCaptureFileMagic "SRWSCAP1"
+
+enum {
+    SRCaptureFileMagicLength = 8,
+    SRCaptureRecordHeaderLength = 16,
+};
+
+typedef uint8_t SRCaptureDirection;
+enum {
+    SRCaptureDirectionInbound = 0,
+    SRCaptureDirectionOutbound = 1,
+};
+
+typedef struct {
+    uint64_t timestamp; // Nanoseconds since the capture started.
+    uint32_t length;
+    SRCaptureDirection direction;
+} SRCaptureRecord;
+
+extern bool SRCaptureWriteFileHeader(const SRCoreIO *io);
+
+extern bool SRCaptureWriteRecord(const SRCoreIO *io, const SRCaptureRecord *record, const uint8_t *bytes);
+
+/**
+ Returns whether `bytes` start with `SRCaptureFileMagic`.
+ */
+extern bool SRCaptureFileHeaderIsValid(const uint8_t *bytes, size_t length);
+
+/**
+ Parses a record header from the beginning of `bytes`.
+
+ @return `SRFrameResultNeedMoreData` if `bytes` don't contain the whole header and data of the record,
+ `SRFrameResultProtocolError` if the header is malformed.
+ */
+extern SRFrameResult SRCaptureRecordParse(const uint8_t *bytes, size_t length, SRCaptureRecord *record);
+
+#ifdef __cplusplus
+}
+#endif
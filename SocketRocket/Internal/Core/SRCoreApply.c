@@ -0,0 +1,23 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#include "SRCoreApply.h"
+
+static void SRCoreApplySerialApply(void *context, size_t count, void *workContext, void (*work)(void *workContext, size_t index))
+{
+    (void)context;
+    for (size_t index = 0; index < count; index++) {
+        work(workContext, index);
+    }
+}
+
+const SRCoreApply SRCoreApplySerial = {
+    .apply = SRCoreApplySerialApply,
+    .context = NULL,
+};
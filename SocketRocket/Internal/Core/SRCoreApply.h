@@ -0,0 +1,46 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Large payloads are processed in chunks of this size, small enough to stay in a core's L2 cache.
+#define SRCoreApplyChunkSize ((size_t)256 * 1024)
+
+/**
+ Runs independent pieces of work of the core, possibly concurrently. Platforms plug in their own implementations,
+ like a thread pool, `SRCoreApplySerial` is available where nothing better exists.
+ */
+typedef struct {
+    // Calls `work` for every index below `count` and returns once all calls returned.
+    void (*apply)(void *context, size_t count, void *workContext, void (*work)(void *workContext, size_t index));
+    void *context;
+} SRCoreApply;
+
+/**
+ Runs all work on the calling thread, in order.
+ */
+extern const SRCoreApply SRCoreApplySerial;
+
+/**
+ Returns the number of `SRCoreApplyChunkSize` chunks `length` bytes are split into.
+ */
+static inline size_t SRCoreApplyChunkCount(size_t length)
+{
+    return (length + SRCoreApplyChunkSize - 1) / SRCoreApplyChunkSize;
+}
+
+#ifdef __cplusplus
+}
+#endif
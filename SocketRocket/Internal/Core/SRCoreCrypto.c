@@ -0,0 +1,148 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#include "SRCoreCrypto.h"
+
+#include <string.h>
+
+#if defined(__APPLE__)
+#include <stdlib.h>
+#elif defined(__linux__)
+#include <errno.h>
+#include <sys/random.h>
+#else
+#include <stdio.h>
+#endif
+
+///--------------------------------------
+// SHA-1
+///--------------------------------------
+
+static inline uint32_t SRSHA1RotateLeft(uint32_t value, unsigned int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void SRSHA1ProcessBlock(uint32_t state[5], const uint8_t block[64])
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) | ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = SRSHA1RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = SRSHA1RotateLeft(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = SRSHA1RotateLeft(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void SRCoreSHA1(const uint8_t *bytes, size_t length, uint8_t digest[SRSHA1DigestLength])
+{
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+    size_t offset = 0;
+    for (; offset + 64 <= length; offset += 64) {
+        SRSHA1ProcessBlock(state, bytes + offset);
+    }
+
+    // Padding: 0x80, zeros, then the message length in bits as a 64-bit big-endian integer.
+    uint8_t block[128] = {0};
+    size_t remaining = length - offset;
+    memcpy(block, bytes + offset, remaining);
+    block[remaining] = 0x80;
+    size_t paddedLength = (remaining + 1 + 8 <= 64 ? 64 : 128);
+    uint64_t bitLength = (uint64_t)length * 8;
+    for (int i = 0; i < 8; i++) {
+        block[paddedLength - 1 - i] = (uint8_t)(bitLength >> (i * 8));
+    }
+    for (size_t blockOffset = 0; blockOffset < paddedLength; blockOffset += 64) {
+        SRSHA1ProcessBlock(state, block + blockOffset);
+    }
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (uint8_t)(state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)state[i];
+    }
+}
+
+///--------------------------------------
+// Portable Crypto
+///--------------------------------------
+
+static void SRCoreCryptoPortableSHA1(void *context, const uint8_t *bytes, size_t length, uint8_t digest[SRSHA1DigestLength])
+{
+    (void)context;
+    SRCoreSHA1(bytes, length, digest);
+}
+
+static bool SRCoreCryptoPortableRandomBytes(void *context, uint8_t *bytes, size_t length)
+{
+    (void)context;
+#if defined(__APPLE__)
+    arc4random_buf(bytes, length);
+    return true;
+#elif defined(__linux__)
+    size_t offset = 0;
+    while (offset < length) {
+        ssize_t result = getrandom(bytes + offset, length - offset, 0);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += (size_t)result;
+    }
+    return true;
+#else
+    FILE *file = fopen("/dev/urandom", "rb");
+    if (!file) {
+        return false;
+    }
+    size_t readLength = fread(bytes, 1, length, file);
+    fclose(file);
+    return (readLength == length);
+#endif
+}
+
+const SRCoreCrypto SRCoreCryptoPortable = {
+    .sha1 = SRCoreCryptoPortableSHA1,
+    .randomBytes = SRCoreCryptoPortableRandomBytes,
+    .context = NULL,
+};
@@ -0,0 +1,42 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SRSHA1DigestLength 20
+
+/**
+ Crypto primitives used by the core. Platforms plug in their own implementations,
+ `SRCoreCryptoPortable` is available where nothing better exists.
+ */
+typedef struct {
+    void (*sha1)(void *context, const uint8_t *bytes, size_t length, uint8_t digest[SRSHA1DigestLength]);
+    // Fills `bytes` with cryptographically secure random bytes or returns `false`.
+    bool (*randomBytes)(void *context, uint8_t *bytes, size_t length);
+    void *context;
+} SRCoreCrypto;
+
+/**
+ Built-in SHA-1 and the random source of the operating system.
+ */
+extern const SRCoreCrypto SRCoreCryptoPortable;
+
+extern void SRCoreSHA1(const uint8_t *bytes, size_t length, uint8_t digest[SRSHA1DigestLength]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,283 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#include "SRFrame.h"
+
+#include <string.h>
+
+#include "SRMasking.h"
+
+static const uint8_t SRFinMask          = 0x80;
+static const uint8_t SROpCodeMask       = 0x0F;
+static const uint8_t SRRsvMask          = 0x70;
+static const uint8_t SRMaskMask         = 0x80;
+static const uint8_t SRPayloadLenMask   = 0x7F;
+
+// Payload of masked frames is copied into a buffer of this size before it is masked and written.
+static const size_t SRFrameWriteChunkSize = 4096;
+
+static inline size_t SRMinSize(size_t a, uint64_t b)
+{
+    return (b < a ? (size_t)b : a);
+}
+
+///--------------------------------------
+// Header
+///--------------------------------------
+
+SRFrameResult SRFrameHeaderParse(const uint8_t *bytes, size_t length, SRFrameHeader *header)
+{
+    if (length < 2) {
+        header->headerLength = 2;
+        return SRFrameResultNeedMoreData;
+    }
+
+    header->fin = !!(bytes[0] & SRFinMask);
+    header->rsv = (bytes[0] & SRRsvMask) >> 4;
+    header->opcode = bytes[0] & SROpCodeMask;
+    header->masked = !!(bytes[1] & SRMaskMask);
+
+    uint8_t payloadLengthField = bytes[1] & SRPayloadLenMask;
+    size_t extendedLengthSize = (payloadLengthField == 126 ? sizeof(uint16_t) : (payloadLengthField == 127 ? sizeof(uint64_t) : 0));
+    header->headerLength = 2 + extendedLengthSize + (header->masked ? sizeof(header->maskKey) : 0);
+    if (length < header->headerLength) {
+        return SRFrameResultNeedMoreData;
+    }
+
+    const uint8_t *cursor = bytes + 2;
+    if (extendedLengthSize == 0) {
+        header->payloadLength = payloadLengthField;
+    } else {
+        uint64_t payloadLength = 0;
+        for (size_t i = 0; i < extendedLengthSize; i++) {
+            payloadLength = (payloadLength << 8) | cursor[i];
+        }
+        // The most significant bit of a 64-bit length MUST be 0.
+        if (payloadLength >> 63) {
+            return SRFrameResultProtocolError;
+        }
+        header->payloadLength = payloadLength;
+        cursor += extendedLengthSize;
+    }
+
+    if (header->masked) {
+        memcpy(header->maskKey, cursor, sizeof(header->maskKey));
+    } else {
+        memset(header->maskKey, 0, sizeof(header->maskKey));
+    }
+    return SRFrameResultOK;
+}
+
+size_t SRFrameHeaderLength(uint64_t payloadLength, bool masked)
+{
+    size_t length = 2;
+    if (payloadLength >= 126) {
+        length += (payloadLength <= UINT16_MAX ? sizeof(uint16_t) : sizeof(uint64_t));
+    }
+    if (masked) {
+        length += sizeof(uint32_t);
+    }
+    return length;
+}
+
+size_t SRFrameHeaderWrite(uint8_t *buffer, SROpCode opcode, bool fin, uint64_t payloadLength, const uint8_t *maskKey)
+{
+    buffer[0] = (fin ? SRFinMask : 0) | (opcode & SROpCodeMask);
+    buffer[1] = (maskKey ? SRMaskMask : 0);
+
+    size_t length = 2;
+    if (payloadLength < 126) {
+        buffer[1] |= (uint8_t)payloadLength;
+    } else {
+        size_t extendedLengthSize = 0;
+        if (payloadLength <= UINT16_MAX) {
+            buffer[1] |= 126;
+            extendedLengthSize = sizeof(uint16_t);
+        } else {
+            buffer[1] |= 127;
+            extendedLengthSize = sizeof(uint64_t);
+        }
+        for (size_t i = 0; i < extendedLengthSize; i++) {
+            buffer[length + i] = (uint8_t)(payloadLength >> (8 * (extendedLengthSize - 1 - i)));
+        }
+        length += extendedLengthSize;
+    }
+
+    if (maskKey) {
+        memcpy(buffer + length, maskKey, sizeof(uint32_t));
+        length += sizeof(uint32_t);
+    }
+    return length;
+}
+
+bool SRCloseCodeIsValid(uint16_t closeCode)
+{
+    if (closeCode < 1000) {
+        return false;
+    }
+
+    if (closeCode >= 1000 && closeCode <= 1011) {
+        if (closeCode == 1004 ||
+            closeCode == 1005 ||
+            closeCode == 1006) {
+            return false;
+        }
+        return true;
+    }
+
+    if (closeCode >= 3000 && closeCode <= 3999) {
+        return true;
+    }
+
+    if (closeCode >= 4000 && closeCode <= 4999) {
+        return true;
+    }
+
+    return false;
+}
+
+///--------------------------------------
+// Writing
+///--------------------------------------
+
+bool SRFrameWrite(const SRCoreIO *io, const SRCoreCrypto *crypto, SROpCode opcode, bool fin, const uint8_t *payload, size_t payloadLength)
+{
+    uint8_t maskKey[sizeof(uint32_t)];
+    if (crypto && !crypto->randomBytes(crypto->context, maskKey, sizeof(maskKey))) {
+        return false;
+    }
+
+    uint8_t header[SRFrameHeaderMaxLength];
+    size_t headerLength = SRFrameHeaderWrite(header, opcode, fin, payloadLength, (crypto ? maskKey : NULL));
+    if (!io->write(io->context, header, headerLength)) {
+        return false;
+    }
+
+    if (!crypto) {
+        return (payloadLength == 0 || io->write(io->context, payload, payloadLength));
+    }
+
+    uint8_t chunk[SRFrameWriteChunkSize];
+    for (size_t offset = 0; offset < payloadLength; offset += sizeof(chunk)) {
+        size_t chunkLength = SRMinSize(sizeof(chunk), payloadLength - offset);
+        memcpy(chunk, payload + offset, chunkLength);
+        SRMaskBytes(chunk, chunkLength, maskKey, offset);
+        if (!io->write(io->context, chunk, chunkLength)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+///--------------------------------------
+// Decoding
+///--------------------------------------
+
+SRFrameHeaderValidity SRFrameHeaderValidate(const SRFrameHeader *header, bool readingFragmentedMessage)
+{
+    if (header->rsv != 0) {
+        return SRFrameHeaderInvalidReservedBits;
+    }
+
+    switch (header->opcode) {
+        case SROpCodeConnectionClose:
+        case SROpCodePing:
+        case SROpCodePong:
+            if (!header->fin) {
+                return SRFrameHeaderInvalidFragmentedControlFrame;
+            }
+            if (header->payloadLength > SRControlFrameMaxPayloadLength) {
+                return SRFrameHeaderInvalidControlFramePayloadLength;
+            }
+            return SRFrameHeaderValid;
+        case SROpCodeContinuationFrame:
+            return (readingFragmentedMessage ? SRFrameHeaderValid : SRFrameHeaderInvalidUnexpectedContinuationFrame);
+        case SROpCodeTextFrame:
+        case SROpCodeBinaryFrame:
+            return (readingFragmentedMessage ? SRFrameHeaderInvalidUnexpectedDataFrame : SRFrameHeaderValid);
+        default:
+            return SRFrameHeaderInvalidReservedOpcode;
+    }
+}
+
+void SRFrameDecoderInit(SRFrameDecoder *decoder, SRFrameDecoderCallbacks callbacks)
+{
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->callbacks = callbacks;
+}
+
+static bool SRFrameDecoderHeaderIsValid(SRFrameDecoder *decoder, const SRFrameHeader *header)
+{
+    if (SRFrameHeaderValidate(header, decoder->readingFragmentedMessage) != SRFrameHeaderValid) {
+        return false;
+    }
+    if (!SROpCodeIsControl(header->opcode)) {
+        decoder->readingFragmentedMessage = !header->fin;
+    }
+    return true;
+}
+
+static void SRFrameDecoderFinishFrame(SRFrameDecoder *decoder)
+{
+    decoder->readingPayload = false;
+    if (decoder->callbacks.frameEnd) {
+        decoder->callbacks.frameEnd(decoder->callbacks.context, &decoder->header);
+    }
+}
+
+SRFrameResult SRFrameDecoderConsume(SRFrameDecoder *decoder, uint8_t *bytes, size_t length)
+{
+    size_t offset = 0;
+    while (offset < length) {
+        if (!decoder->readingPayload) {
+            size_t requiredLength = (decoder->headerBytesLength < 2 ? 2 : decoder->header.headerLength);
+            size_t copyLength = SRMinSize(requiredLength - decoder->headerBytesLength, length - offset);
+            memcpy(decoder->headerBytes + decoder->headerBytesLength, bytes + offset, copyLength);
+            decoder->headerBytesLength += copyLength;
+            offset += copyLength;
+
+            SRFrameResult result = SRFrameHeaderParse(decoder->headerBytes, decoder->headerBytesLength, &decoder->header);
+            if (result == SRFrameResultNeedMoreData) {
+                continue;
+            }
+            if (result != SRFrameResultOK) {
+                return result;
+            }
+            if (!SRFrameDecoderHeaderIsValid(decoder, &decoder->header)) {
+                return SRFrameResultProtocolError;
+            }
+
+            decoder->headerBytesLength = 0;
+            decoder->payloadOffset = 0;
+            decoder->readingPayload = true;
+            if (decoder->callbacks.frameHeader) {
+                decoder->callbacks.frameHeader(decoder->callbacks.context, &decoder->header);
+            }
+            if (decoder->header.payloadLength == 0) {
+                SRFrameDecoderFinishFrame(decoder);
+            }
+            continue;
+        }
+
+        size_t payloadLength = SRMinSize(length - offset, decoder->header.payloadLength - decoder->payloadOffset);
+        if (decoder->header.masked) {
+            SRMaskBytes(bytes + offset, payloadLength, decoder->header.maskKey, (size_t)decoder->payloadOffset);
+        }
+        if (decoder->callbacks.framePayload) {
+            decoder->callbacks.framePayload(decoder->callbacks.context, &decoder->header, bytes + offset, payloadLength);
+        }
+        decoder->payloadOffset += payloadLength;
+        offset += payloadLength;
+
+        if (decoder->payloadOffset == decoder->header.payloadLength) {
+            SRFrameDecoderFinishFrame(decoder);
+        }
+    }
+    return SRFrameResultOK;
+}
@@ -0,0 +1,163 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SRCoreCrypto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t SROpCode;
+enum {
+    SROpCodeContinuationFrame = 0x0,
+    SROpCodeTextFrame = 0x1,
+    SROpCodeBinaryFrame = 0x2,
+    // 3-7 reserved.
+    SROpCodeConnectionClose = 0x8,
+    SROpCodePing = 0x9,
+    SROpCodePong = 0xA,
+    // B-F reserved.
+};
+
+static inline bool SROpCodeIsControl(SROpCode opcode)
+{
+    return (opcode == SROpCodePing || opcode == SROpCodePong || opcode == SROpCodeConnectionClose);
+}
+
+// 2 bytes of fixed header, up to 8 bytes of extended payload length and 4 bytes of mask key.
+#define SRFrameHeaderMaxLength 14
+
+// Control frames can't be fragmented and can carry at most 125 bytes of payload.
+#define SRControlFrameMaxPayloadLength 125
+
+typedef struct {
+    bool fin;
+    uint8_t rsv; // RSV1-3 bits, shifted into the lowest 3 bits.
+    SROpCode opcode;
+    bool masked;
+    uint8_t maskKey[4];
+    uint64_t payloadLength;
+    size_t headerLength;
+} SRFrameHeader;
+
+typedef enum {
+    SRFrameResultOK = 0,
+    SRFrameResultNeedMoreData,
+    SRFrameResultProtocolError,
+} SRFrameResult;
+
+/**
+ Parses a frame header from the beginning of `bytes`.
+
+ Returns `SRFrameResultNeedMoreData` if `bytes` don't contain the whole header, in which case `fin`, `rsv`, `opcode`
+ and `masked` are already populated, if at least 2 bytes were available, and `headerLength` is set to the total number of bytes
+ required to parse the header.
+ */
+extern SRFrameResult SRFrameHeaderParse(const uint8_t *bytes, size_t length, SRFrameHeader *header);
+
+/**
+ Returns the length of a header for a frame with a given payload length.
+ */
+extern size_t SRFrameHeaderLength(uint64_t payloadLength, bool masked);
+
+/**
+ Writes a frame header into `buffer`, which must be at least `SRFrameHeaderMaxLength` bytes long.
+
+ @param maskKey 4 byte mask key or `NULL` for an unmasked frame.
+
+ @return Number of bytes written.
+ */
+extern size_t SRFrameHeaderWrite(uint8_t *buffer, SROpCode opcode, bool fin, uint64_t payloadLength, const uint8_t *maskKey);
+
+/**
+ Returns whether a close code received from the peer is allowed by RFC 6455.
+ */
+extern bool SRCloseCodeIsValid(uint16_t closeCode);
+
+typedef enum {
+    SRFrameHeaderValid = 0,
+    SRFrameHeaderInvalidReservedBits,
+    SRFrameHeaderInvalidReservedOpcode,
+    SRFrameHeaderInvalidFragmentedControlFrame,
+    SRFrameHeaderInvalidControlFramePayloadLength,
+    SRFrameHeaderInvalidUnexpectedContinuationFrame,
+    SRFrameHeaderInvalidUnexpectedDataFrame,
+} SRFrameHeaderValidity;
+
+/**
+ Checks a frame header received from the peer against RFC 6455, with no extensions negotiated.
+ Masking is not checked, since it depends on whether the frame was received by a client or a server.
+
+ @param readingFragmentedMessage Whether a data frame without FIN was received, so continuation frames are expected.
+ */
+extern SRFrameHeaderValidity SRFrameHeaderValidate(const SRFrameHeader *header, bool readingFragmentedMessage);
+
+///--------------------------------------
+// I/O
+///--------------------------------------
+
+typedef struct {
+    // Writes all `length` bytes or returns `false` if the transport failed.
+    bool (*write)(void *context, const uint8_t *bytes, size_t length);
+    void *context;
+} SRCoreIO;
+
+/**
+ Writes a single frame through `io`. If `crypto` is not `NULL`, the frame is masked with a random mask key,
+ as required for frames sent by a client.
+ */
+extern bool SRFrameWrite(const SRCoreIO *io, const SRCoreCrypto *crypto, SROpCode opcode, bool fin, const uint8_t *payload, size_t payloadLength);
+
+typedef struct {
+    // Called once the header of every frame is parsed.
+    void (*frameHeader)(void *context, const SRFrameHeader *header);
+    // Called with unmasked payload bytes of the current frame, possibly split over multiple calls.
+    void (*framePayload)(void *context, const SRFrameHeader *header, const uint8_t *bytes, size_t length);
+    // Called once all payload of the current frame was delivered.
+    void (*frameEnd)(void *context, const SRFrameHeader *header);
+    void *context;
+} SRFrameDecoderCallbacks;
+
+/**
+ Incremental frame decoder, that can be fed bytes in chunks of any size as they arrive from a transport.
+ Payload is delivered without any buffering or copying, except for unmasking which happens in place.
+ */
+typedef struct {
+    SRFrameDecoderCallbacks callbacks;
+    SRFrameHeader header;
+    uint8_t headerBytes[SRFrameHeaderMaxLength];
+    size_t headerBytesLength;
+    uint64_t payloadOffset;
+    bool readingPayload;
+    bool readingFragmentedMessage; // A data frame without FIN was received, so continuation frames are expected.
+} SRFrameDecoder;
+
+extern void SRFrameDecoderInit(SRFrameDecoder *decoder, SRFrameDecoderCallbacks callbacks);
+
+/**
+ Consumes `length` bytes, invoking callbacks for every frame event. Masked payload is unmasked in place.
+
+ The stream is malformed, and no callbacks are invoked for the offending frame, if a frame has any RSV bits set
+ (no extensions are supported), uses a reserved opcode, is a fragmented control frame or a control frame
+ with more than 125 bytes of payload, is a continuation frame outside of a fragmented message or a new data frame
+ inside of one, or has a 64-bit payload length with the most significant bit set.
+
+ @return `SRFrameResultOK` if all bytes were consumed, `SRFrameResultProtocolError` if the stream is malformed.
+ */
+extern SRFrameResult SRFrameDecoderConsume(SRFrameDecoder *decoder, uint8_t *bytes, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,368 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#include "SRHPACK.h"
+
+#include <string.h>
+
+///--------------------------------------
+// Static Table
+///--------------------------------------
+
+typedef struct {
+    const char *name;
+    const char *value;
+} SRHPACKStaticEntry;
+
+// RFC 7541, Appendix A. Index 1 is the first entry.
+static const SRHPACKStaticEntry SRHPACKStaticTable[] = {
+    { ":authority", "" },
+    { ":method", "GET" },
+    { ":method", "POST" },
+    { ":path", "/" },
+    { ":path", "/index.html" },
+    { ":scheme", "http" },
+    { ":scheme", "https" },
+    { ":status", "200" },
+    { ":status", "204" },
+    { ":status", "206" },
+    { ":status", "304" },
+    { ":status", "400" },
+    { ":status", "404" },
+    { ":status", "500" },
+    { "accept-charset", "" },
+    { "accept-encoding", "gzip, deflate" },
+    { "accept-language", "" },
+    { "accept-ranges", "" },
+    { "accept", "" },
+    { "access-control-allow-origin", "" },
+    { "age", "" },
+    { "allow", "" },
+    { "authorization", "" },
+    { "cache-control", "" },
+    { "content-disposition", "" },
+    { "content-encoding", "" },
+    { "content-language", "" },
+    { "content-length", "" },
+    { "content-location", "" },
+    { "content-range", "" },
+    { "content-type", "" },
+    { "cookie", "" },
+    { "date", "" },
+    { "etag", "" },
+    { "expect", "" },
+    { "expires", "" },
+    { "from", "" },
+    { "host", "" },
+    { "if-match", "" },
+    { "if-modified-since", "" },
+    { "if-none-match", "" },
+    { "if-range", "" },
+    { "if-unmodified-since", "" },
+    { "last-modified", "" },
+    { "link", "" },
+    { "location", "" },
+    { "max-forwards", "" },
+    { "proxy-authenticate", "" },
+    { "proxy-authorization", "" },
+    { "range", "" },
+    { "referer", "" },
+    { "refresh", "" },
+    { "retry-after", "" },
+    { "server", "" },
+    { "set-cookie", "" },
+    { "strict-transport-security", "" },
+    { "transfer-encoding", "" },
+    { "user-agent", "" },
+    { "vary", "" },
+    { "via", "" },
+    { "www-authenticate", "" },
+};
+
+enum {
+    SRHPACKStaticTableLength = sizeof(SRHPACKStaticTable) / sizeof(SRHPACKStaticTable[0]),
+};
+
+///--------------------------------------
+// Huffman
+///--------------------------------------
+
+// The HPACK Huffman code (RFC 7541, Appendix B) is canonical, so it is fully described by the symbols
+// ordered by (code length, code) and the number of codes of every length.
+static const uint8_t SRHPACKHuffmanSymbols[256] = {
+    0x30, 0x31, 0x32, 0x61, 0x63, 0x65, 0x69, 0x6F, 0x73, 0x74, 0x20, 0x25, 0x2D, 0x2E, 0x2F, 0x33,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3D, 0x41, 0x5F, 0x62, 0x64, 0x66, 0x67, 0x68, 0x6C, 0x6D,
+    0x6E, 0x70, 0x72, 0x75, 0x3A, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C,
+    0x4D, 0x4E, 0x4F, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x59, 0x6A, 0x6B, 0x71, 0x76,
+    0x77, 0x78, 0x79, 0x7A, 0x26, 0x2A, 0x2C, 0x3B, 0x58, 0x5A, 0x21, 0x22, 0x28, 0x29, 0x3F, 0x27,
+    0x2B, 0x7C, 0x23, 0x3E, 0x00, 0x24, 0x40, 0x5B, 0x5D, 0x7E, 0x5E, 0x7D, 0x3C, 0x60, 0x7B, 0x5C,
+    0xC3, 0xD0, 0x80, 0x82, 0x83, 0xA2, 0xB8, 0xC2, 0xE0, 0xE2, 0x99, 0xA1, 0xA7, 0xAC, 0xB0, 0xB1,
+    0xB3, 0xD1, 0xD8, 0xD9, 0xE3, 0xE5, 0xE6, 0x81, 0x84, 0x85, 0x86, 0x88, 0x92, 0x9A, 0x9C, 0xA0,
+    0xA3, 0xA4, 0xA9, 0xAA, 0xAD, 0xB2, 0xB5, 0xB9, 0xBA, 0xBB, 0xBD, 0xBE, 0xC4, 0xC6, 0xE4, 0xE8,
+    0xE9, 0x01, 0x87, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8F, 0x93, 0x95, 0x96, 0x97, 0x98, 0x9B, 0x9D,
+    0x9E, 0xA5, 0xA6, 0xA8, 0xAE, 0xAF, 0xB4, 0xB6, 0xB7, 0xBC, 0xBF, 0xC5, 0xE7, 0xEF, 0x09, 0x8E,
+    0x90, 0x91, 0x94, 0x9F, 0xAB, 0xCE, 0xD7, 0xE1, 0xEC, 0xED, 0xC7, 0xCF, 0xEA, 0xEB, 0xC0, 0xC1,
+    0xC8, 0xC9, 0xCA, 0xCD, 0xD2, 0xD5, 0xDA, 0xDB, 0xEE, 0xF0, 0xF2, 0xF3, 0xFF, 0xCB, 0xCC, 0xD3,
+    0xD4, 0xD6, 0xDD, 0xDE, 0xDF, 0xF1, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE,
+    0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x0B, 0x0C, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14,
+    0x15, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x7F, 0xDC, 0xF9, 0x0A, 0x0D, 0x16,
+};
+
+enum {
+    SRHPACKHuffmanMaxCodeLength = 30,
+};
+
+static const uint16_t SRHPACKHuffmanLengthCounts[SRHPACKHuffmanMaxCodeLength + 1] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+    0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 3,
+};
+
+ptrdiff_t SRHPACKHuffmanDecode(const uint8_t *bytes, size_t length, uint8_t *output, size_t capacity)
+{
+    size_t outputLength = 0;
+    uint32_t code = 0;      // Bits of the current symbol read so far.
+    uint32_t firstCode = 0; // First canonical code of the current length.
+    size_t firstIndex = 0;  // Index in `SRHPACKHuffmanSymbols` of `firstCode`.
+    unsigned int codeLength = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            code = (code << 1) | ((bytes[i] >> bit) & 1);
+            codeLength++;
+            if (codeLength > SRHPACKHuffmanMaxCodeLength) {
+                return -1;
+            }
+
+            uint16_t count = SRHPACKHuffmanLengthCounts[codeLength];
+            if (code - firstCode < count) {
+                if (outputLength == capacity) {
+                    return -1;
+                }
+                output[outputLength++] = SRHPACKHuffmanSymbols[firstIndex + (code - firstCode)];
+                code = 0;
+                firstCode = 0;
+                firstIndex = 0;
+                codeLength = 0;
+                continue;
+            }
+            firstIndex += count;
+            firstCode = (firstCode + count) << 1;
+        }
+    }
+
+    // Padding must be shorter than 8 bits and consist of the most significant bits of EOS, which are all ones.
+    if (codeLength > 7 || code != ((1u << codeLength) - 1)) {
+        return -1;
+    }
+    return (ptrdiff_t)outputLength;
+}
+
+///--------------------------------------
+// Primitives
+///--------------------------------------
+
+static bool SRHPACKDecodeInteger(const uint8_t *bytes, size_t length, size_t *offset, unsigned int prefixBits, uint32_t *value)
+{
+    if (*offset >= length) {
+        return false;
+    }
+    uint32_t prefixMask = (1u << prefixBits) - 1;
+    uint32_t result = bytes[(*offset)++] & prefixMask;
+    if (result < prefixMask) {
+        *value = result;
+        return true;
+    }
+
+    for (unsigned int shift = 0; ; shift += 7) {
+        // Anything that doesn't fit in 32 bits is far beyond any sane header size.
+        if (*offset >= length || shift > 28) {
+            return false;
+        }
+        uint8_t byte = bytes[(*offset)++];
+        uint64_t next = result + ((uint64_t)(byte & 0x7F) << shift);
+        if (next > UINT32_MAX) {
+            return false;
+        }
+        result = (uint32_t)next;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    *value = result;
+    return true;
+}
+
+static bool SRHPACKWriteInteger(const SRCoreIO *io, uint8_t firstByte, unsigned int prefixBits, size_t value)
+{
+    uint8_t buffer[1 + 10];
+    size_t length = 0;
+    size_t prefixMask = ((size_t)1 << prefixBits) - 1;
+    if (value < prefixMask) {
+        buffer[length++] = firstByte | (uint8_t)value;
+    } else {
+        buffer[length++] = firstByte | (uint8_t)prefixMask;
+        value -= prefixMask;
+        while (value >= 0x80) {
+            buffer[length++] = (uint8_t)(value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        buffer[length++] = (uint8_t)value;
+    }
+    return io->write(io->context, buffer, length);
+}
+
+// Decodes a string literal. `*scratchOffset` is advanced past any Huffman-decoded output.
+static bool SRHPACKDecodeString(const uint8_t *bytes,
+                                size_t length,
+                                size_t *offset,
+                                uint8_t *scratch,
+                                size_t scratchCapacity,
+                                size_t *scratchOffset,
+                                const uint8_t **string,
+                                size_t *stringLength)
+{
+    if (*offset >= length) {
+        return false;
+    }
+    bool huffman = !!(bytes[*offset] & 0x80);
+    uint32_t encodedLength = 0;
+    if (!SRHPACKDecodeInteger(bytes, length, offset, 7, &encodedLength) || encodedLength > length - *offset) {
+        return false;
+    }
+
+    const uint8_t *encoded = bytes + *offset;
+    *offset += encodedLength;
+    if (!huffman) {
+        *string = encoded;
+        *stringLength = encodedLength;
+        return true;
+    }
+
+    ptrdiff_t decodedLength = SRHPACKHuffmanDecode(encoded, encodedLength, scratch + *scratchOffset, scratchCapacity - *scratchOffset);
+    if (decodedLength < 0) {
+        return false;
+    }
+    *string = scratch + *scratchOffset;
+    *stringLength = (size_t)decodedLength;
+    *scratchOffset += (size_t)decodedLength;
+    return true;
+}
+
+static bool SRHPACKStaticEntryAtIndex(uint32_t index, const uint8_t **name, size_t *nameLength, const uint8_t **value, size_t *valueLength)
+{
+    // Index 0 is invalid, anything past the static table would be in the dynamic table, which is always empty.
+    if (index == 0 || index > SRHPACKStaticTableLength) {
+        return false;
+    }
+    const SRHPACKStaticEntry *entry = &SRHPACKStaticTable[index - 1];
+    *name = (const uint8_t *)entry->name;
+    *nameLength = strlen(entry->name);
+    *value = (const uint8_t *)entry->value;
+    *valueLength = strlen(entry->value);
+    return true;
+}
+
+///--------------------------------------
+// Decoding
+///--------------------------------------
+
+SRFrameResult SRHPACKDecode(const uint8_t *bytes,
+                            size_t length,
+                            uint8_t *scratch,
+                            size_t scratchCapacity,
+                            SRHPACKDecoderCallbacks callbacks)
+{
+    size_t offset = 0;
+    while (offset < length) {
+        uint8_t byte = bytes[offset];
+
+        // Dynamic table size update, which can't grow the table past the advertised size of 0.
+        if ((byte & 0xE0) == 0x20) {
+            uint32_t size = 0;
+            if (!SRHPACKDecodeInteger(bytes, length, &offset, 5, &size) || size != 0) {
+                return SRFrameResultProtocolError;
+            }
+            continue;
+        }
+
+        const uint8_t *name = NULL;
+        const uint8_t *value = NULL;
+        size_t nameLength = 0;
+        size_t valueLength = 0;
+
+        // Indexed header field.
+        if (byte & 0x80) {
+            uint32_t index = 0;
+            if (!SRHPACKDecodeInteger(bytes, length, &offset, 7, &index) ||
+                !SRHPACKStaticEntryAtIndex(index, &name, &nameLength, &value, &valueLength)) {
+                return SRFrameResultProtocolError;
+            }
+            callbacks.header(callbacks.context, name, nameLength, value, valueLength);
+            continue;
+        }
+
+        // Literal with incremental indexing (6-bit prefix), without indexing or never indexed (4-bit prefix).
+        // With a table size of 0, adding to the dynamic table evicts the entry right away, so all three are decoded alike.
+        unsigned int prefixBits = ((byte & 0xC0) == 0x40 ? 6 : 4);
+        uint32_t nameIndex = 0;
+        if (!SRHPACKDecodeInteger(bytes, length, &offset, prefixBits, &nameIndex)) {
+            return SRFrameResultProtocolError;
+        }
+
+        size_t scratchOffset = 0;
+        if (nameIndex != 0) {
+            const uint8_t *unusedValue = NULL;
+            size_t unusedValueLength = 0;
+            if (!SRHPACKStaticEntryAtIndex(nameIndex, &name, &nameLength, &unusedValue, &unusedValueLength)) {
+                return SRFrameResultProtocolError;
+            }
+        } else if (!SRHPACKDecodeString(bytes, length, &offset, scratch, scratchCapacity, &scratchOffset, &name, &nameLength)) {
+            return SRFrameResultProtocolError;
+        }
+        if (!SRHPACKDecodeString(bytes, length, &offset, scratch, scratchCapacity, &scratchOffset, &value, &valueLength)) {
+            return SRFrameResultProtocolError;
+        }
+        callbacks.header(callbacks.context, name, nameLength, value, valueLength);
+    }
+    return SRFrameResultOK;
+}
+
+///--------------------------------------
+// Encoding
+///--------------------------------------
+
+bool SRHPACKEncodeHeader(const SRCoreIO *io, const char *name, size_t nameLength, const char *value, size_t valueLength)
+{
+    size_t nameIndex = 0;
+    for (size_t i = 0; i < SRHPACKStaticTableLength; i++) {
+        const SRHPACKStaticEntry *entry = &SRHPACKStaticTable[i];
+        if (strlen(entry->name) != nameLength || memcmp(entry->name, name, nameLength) != 0) {
+            continue;
+        }
+        if (strlen(entry->value) == valueLength && memcmp(entry->value, value, valueLength) == 0) {
+            return SRHPACKWriteInteger(io, 0x80, 7, i + 1);
+        }
+        if (nameIndex == 0) {
+            nameIndex = i + 1;
+        }
+    }
+
+    // Literal header field without indexing.
+    if (!SRHPACKWriteInteger(io, 0x00, 4, nameIndex)) {
+        return false;
+    }
+    if (nameIndex == 0) {
+        if (!SRHPACKWriteInteger(io, 0x00, 7, nameLength) ||
+            (nameLength > 0 && !io->write(io->context, (const uint8_t *)name, nameLength))) {
+            return false;
+        }
+    }
+    return (SRHPACKWriteInteger(io, 0x00, 7, valueLength) &&
+            (valueLength == 0 || io->write(io->context, (const uint8_t *)value, valueLength)));
+}
@@ -0,0 +1,64 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SRFrame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ HPACK (RFC 7541) header compression, as needed to open WebSockets over HTTP/2.
+
+ Both sides advertise a dynamic table size of 0 (`SETTINGS_HEADER_TABLE_SIZE`), so no state is kept between header blocks:
+ the encoder never indexes, and the decoder only resolves references into the static table.
+ */
+
+typedef struct {
+    void (*header)(void *context, const uint8_t *name, size_t nameLength, const uint8_t *value, size_t valueLength);
+    void *context;
+} SRHPACKDecoderCallbacks;
+
+/**
+ Decodes a complete header block and calls `callbacks.header` for every header field.
+
+ @param scratch         Buffer that Huffman-encoded strings are decoded into. Names and values passed to the callback
+                        point either into `bytes`, the static table or `scratch`, and are only valid during the callback.
+ @param scratchCapacity Capacity of `scratch`, which limits the decoded size of a single header field.
+
+ @return `SRFrameResultProtocolError` if the block is malformed, references the dynamic table or doesn't fit in `scratch`.
+ */
+extern SRFrameResult SRHPACKDecode(const uint8_t *bytes,
+                                   size_t length,
+                                   uint8_t *scratch,
+                                   size_t scratchCapacity,
+                                   SRHPACKDecoderCallbacks callbacks);
+
+/**
+ Encodes a header field into a header block, without adding it to the dynamic table.
+ Uses the static table for the name, or for the whole field when possible. Strings are never Huffman-encoded.
+ */
+extern bool SRHPACKEncodeHeader(const SRCoreIO *io, const char *name, size_t nameLength, const char *value, size_t valueLength);
+
+/**
+ Decodes a Huffman-encoded string.
+
+ @return Decoded length or `-1` if the string is malformed or doesn't fit in `capacity` bytes.
+ */
+extern ptrdiff_t SRHPACKHuffmanDecode(const uint8_t *bytes, size_t length, uint8_t *output, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
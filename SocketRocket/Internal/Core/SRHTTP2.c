@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#include "SRHTTP2.h"
+
+static inline void SRHTTP2WriteUInt32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = (uint8_t)(value >> 24);
+    buffer[1] = (uint8_t)(value >> 16);
+    buffer[2] = (uint8_t)(value >> 8);
+    buffer[3] = (uint8_t)value;
+}
+
+///--------------------------------------
+// Header
+///--------------------------------------
+
+SRFrameResult SRHTTP2FrameHeaderParse(const uint8_t *bytes, size_t length, SRHTTP2FrameHeader *header)
+{
+    if (length < SRHTTP2FrameHeaderLength) {
+        return SRFrameResultNeedMoreData;
+    }
+    header->length = ((uint32_t)bytes[0] << 16) | ((uint32_t)bytes[1] << 8) | (uint32_t)bytes[2];
+    header->type = bytes[3];
+    header->flags = bytes[4];
+    header->streamID = SRHTTP2ReadUInt31(bytes + 5);
+    return SRFrameResultOK;
+}
+
+void SRHTTP2FrameHeaderWrite(uint8_t *buffer, const SRHTTP2FrameHeader *header)
+{
+    buffer[0] = (uint8_t)(header->length >> 16);
+    buffer[1] = (uint8_t)(header->length >> 8);
+    buffer[2] = (uint8_t)header->length;
+    buffer[3] = header->type;
+    buffer[4] = header->flags;
+    SRHTTP2WriteUInt32(buffer + 5, header->streamID & 0x7FFFFFFF);
+}
+
+SRFrameResult SRHTTP2FramePayloadStrip(const SRHTTP2FrameHeader *header,
+                                       const uint8_t *payload,
+                                       const uint8_t **strippedPayload,
+                                       size_t *strippedLength)
+{
+    size_t offset = 0;
+    size_t padLength = 0;
+    if (header->flags & SRHTTP2FlagPadded) {
+        if (header->length < 1) {
+            return SRFrameResultProtocolError;
+        }
+        padLength = payload[0];
+        offset += 1;
+    }
+    // Stream dependency (4 bytes) and weight (1 byte).
+    if (header->type == SRHTTP2FrameTypeHeaders && (header->flags & SRHTTP2FlagPriority)) {
+        offset += 5;
+    }
+    if (offset + padLength > header->length) {
+        return SRFrameResultProtocolError;
+    }
+    *strippedPayload = payload + offset;
+    *strippedLength = header->length - offset - padLength;
+    return SRFrameResultOK;
+}
+
+bool SRHTTP2SettingRead(const uint8_t *payload, size_t length, size_t index, SRHTTP2Setting *setting)
+{
+    size_t offset = index * SRHTTP2SettingLength;
+    if (offset + SRHTTP2SettingLength > length) {
+        return false;
+    }
+    const uint8_t *bytes = payload + offset;
+    setting->identifier = (SRHTTP2SettingIdentifier)(((uint16_t)bytes[0] << 8) | bytes[1]);
+    setting->value = ((uint32_t)bytes[2] << 24) | ((uint32_t)bytes[3] << 16) | ((uint32_t)bytes[4] << 8) | (uint32_t)bytes[5];
+    return true;
+}
+
+///--------------------------------------
+// Writing
+///--------------------------------------
+
+bool SRHTTP2FrameWrite(const SRCoreIO *io,
+                       SRHTTP2FrameType type,
+                       uint8_t flags,
+                       uint32_t streamID,
+                       const uint8_t *payload,
+                       size_t payloadLength)
+{
+    SRHTTP2FrameHeader header = {
+        .length = (uint32_t)payloadLength,
+        .type = type,
+        .flags = flags,
+        .streamID = streamID,
+    };
+    uint8_t headerBytes[SRHTTP2FrameHeaderLength];
+    SRHTTP2FrameHeaderWrite(headerBytes, &header);
+    return (io->write(io->context, headerBytes, sizeof(headerBytes)) &&
+            (payloadLength == 0 || io->write(io->context, payload, payloadLength)));
+}
+
+bool SRHTTP2WriteSettings(const SRCoreIO *io, const SRHTTP2Setting *settings, size_t count, bool ack)
+{
+    // There are only a handful of defined settings, which is plenty for a single frame.
+    uint8_t payload[16 * SRHTTP2SettingLength];
+    if (ack) {
+        count = 0;
+    }
+    if (count > sizeof(payload) / SRHTTP2SettingLength) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *bytes = payload + i * SRHTTP2SettingLength;
+        bytes[0] = (uint8_t)(settings[i].identifier >> 8);
+        bytes[1] = (uint8_t)settings[i].identifier;
+        SRHTTP2WriteUInt32(bytes + 2, settings[i].value);
+    }
+    return SRHTTP2FrameWrite(io, SRHTTP2FrameTypeSettings, (ack ? SRHTTP2FlagAck : 0), 0, payload, count * SRHTTP2SettingLength);
+}
+
+bool SRHTTP2WriteWindowUpdate(const SRCoreIO *io, uint32_t streamID, uint32_t increment)
+{
+    uint8_t payload[4];
+    SRHTTP2WriteUInt32(payload, increment & 0x7FFFFFFF);
+    return SRHTTP2FrameWrite(io, SRHTTP2FrameTypeWindowUpdate, 0, streamID, payload, sizeof(payload));
+}
+
+bool SRHTTP2WriteRSTStream(const SRCoreIO *io, uint32_t streamID, SRHTTP2ErrorCode errorCode)
+{
+    uint8_t payload[4];
+    SRHTTP2WriteUInt32(payload, errorCode);
+    return SRHTTP2FrameWrite(io, SRHTTP2FrameTypeRSTStream, 0, streamID, payload, sizeof(payload));
+}
+
+bool SRHTTP2WriteGoAway(const SRCoreIO *io, uint32_t lastStreamID, SRHTTP2ErrorCode errorCode)
+{
+    uint8_t payload[8];
+    SRHTTP2WriteUInt32(payload, lastStreamID & 0x7FFFFFFF);
+    SRHTTP2WriteUInt32(payload + 4, errorCode);
+    return SRHTTP2FrameWrite(io, SRHTTP2FrameTypeGoAway, 0, 0, payload, sizeof(payload));
+}
@@ -0,0 +1,164 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SRFrame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ HTTP/2 (RFC 7540) framing, as needed to bootstrap WebSockets with extended CONNECT (RFC 8441).
+ */
+
+// Sent by the client before any frame.
+#define SRHTTP2ConnectionPreface "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+
+enum {
+    SRHTTP2ConnectionPrefaceLength = 24,
+    SRHTTP2FrameHeaderLength = 9,
+    SRHTTP2SettingLength = 6,
+};
+
+#define SRHTTP2DefaultMaxFrameSize 16384
+#define SRHTTP2DefaultInitialWindowSize 65535
+#define SRHTTP2MaxWindowSize 0x7FFFFFFF
+
+typedef uint8_t SRHTTP2FrameType;
+enum {
+    SRHTTP2FrameTypeData = 0x0,
+    SRHTTP2FrameTypeHeaders = 0x1,
+    SRHTTP2FrameTypePriority = 0x2,
+    SRHTTP2FrameTypeRSTStream = 0x3,
+    SRHTTP2FrameTypeSettings = 0x4,
+    SRHTTP2FrameTypePushPromise = 0x5,
+    SRHTTP2FrameTypePing = 0x6,
+    SRHTTP2FrameTypeGoAway = 0x7,
+    SRHTTP2FrameTypeWindowUpdate = 0x8,
+    SRHTTP2FrameTypeContinuation = 0x9,
+};
+
+enum {
+    SRHTTP2FlagEndStream = 0x1,
+    SRHTTP2FlagAck = 0x1,
+    SRHTTP2FlagEndHeaders = 0x4,
+    SRHTTP2FlagPadded = 0x8,
+    SRHTTP2FlagPriority = 0x20,
+};
+
+typedef uint16_t SRHTTP2SettingIdentifier;
+enum {
+    SRHTTP2SettingHeaderTableSize = 0x1,
+    SRHTTP2SettingEnablePush = 0x2,
+    SRHTTP2SettingMaxConcurrentStreams = 0x3,
+    SRHTTP2SettingInitialWindowSize = 0x4,
+    SRHTTP2SettingMaxFrameSize = 0x5,
+    SRHTTP2SettingMaxHeaderListSize = 0x6,
+    // RFC 8441
+    SRHTTP2SettingEnableConnectProtocol = 0x8,
+};
+
+typedef uint32_t SRHTTP2ErrorCode;
+enum {
+    SRHTTP2ErrorCodeNoError = 0x0,
+    SRHTTP2ErrorCodeProtocolError = 0x1,
+    SRHTTP2ErrorCodeInternalError = 0x2,
+    SRHTTP2ErrorCodeFlowControlError = 0x3,
+    SRHTTP2ErrorCodeSettingsTimeout = 0x4,
+    SRHTTP2ErrorCodeStreamClosed = 0x5,
+    SRHTTP2ErrorCodeFrameSizeError = 0x6,
+    SRHTTP2ErrorCodeRefusedStream = 0x7,
+    SRHTTP2ErrorCodeCancel = 0x8,
+    SRHTTP2ErrorCodeCompressionError = 0x9,
+    SRHTTP2ErrorCodeConnectError = 0xA,
+    SRHTTP2ErrorCodeEnhanceYourCalm = 0xB,
+    SRHTTP2ErrorCodeInadequateSecurity = 0xC,
+    SRHTTP2ErrorCodeHTTP11Required = 0xD,
+};
+
+typedef struct {
+    uint32_t length; // 24 bits.
+    SRHTTP2FrameType type;
+    uint8_t flags;
+    uint32_t streamID; // 31 bits, the reserved bit is dropped.
+} SRHTTP2FrameHeader;
+
+typedef struct {
+    SRHTTP2SettingIdentifier identifier;
+    uint32_t value;
+} SRHTTP2Setting;
+
+/**
+ Parses a frame header from the beginning of `bytes`.
+
+ @return `SRFrameResultNeedMoreData` if `bytes` don't contain `SRHTTP2FrameHeaderLength` bytes.
+ */
+extern SRFrameResult SRHTTP2FrameHeaderParse(const uint8_t *bytes, size_t length, SRHTTP2FrameHeader *header);
+
+/**
+ Writes a frame header into `buffer`, which must be at least `SRHTTP2FrameHeaderLength` bytes long.
+ */
+extern void SRHTTP2FrameHeaderWrite(uint8_t *buffer, const SRHTTP2FrameHeader *header);
+
+/**
+ Returns the payload of a DATA or HEADERS frame without padding and, for HEADERS, priority fields.
+
+ @return `SRFrameResultProtocolError` if the padding is longer than the payload.
+ */
+extern SRFrameResult SRHTTP2FramePayloadStrip(const SRHTTP2FrameHeader *header,
+                                              const uint8_t *payload,
+                                              const uint8_t **strippedPayload,
+                                              size_t *strippedLength);
+
+/**
+ Reads the setting at `index` from the payload of a SETTINGS frame.
+
+ @return `false` if `index` is past the end of the payload.
+ */
+extern bool SRHTTP2SettingRead(const uint8_t *payload, size_t length, size_t index, SRHTTP2Setting *setting);
+
+/**
+ Reads a big-endian 31-bit value, dropping the reserved bit, as used by stream identifiers and window increments.
+ */
+static inline uint32_t SRHTTP2ReadUInt31(const uint8_t *bytes)
+{
+    return (((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3]) & 0x7FFFFFFF;
+}
+
+///--------------------------------------
+// Writing
+///--------------------------------------
+
+extern bool SRHTTP2FrameWrite(const SRCoreIO *io,
+                              SRHTTP2FrameType type,
+                              uint8_t flags,
+                              uint32_t streamID,
+                              const uint8_t *payload,
+                              size_t payloadLength);
+
+/**
+ Writes a SETTINGS frame. An acknowledgement (`ack` is `true`) must not carry any settings.
+ */
+extern bool SRHTTP2WriteSettings(const SRCoreIO *io, const SRHTTP2Setting *settings, size_t count, bool ack);
+
+extern bool SRHTTP2WriteWindowUpdate(const SRCoreIO *io, uint32_t streamID, uint32_t increment);
+
+extern bool SRHTTP2WriteRSTStream(const SRCoreIO *io, uint32_t streamID, SRHTTP2ErrorCode errorCode);
+
+extern bool SRHTTP2WriteGoAway(const SRCoreIO *io, uint32_t lastStreamID, SRHTTP2ErrorCode errorCode);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#include "SRHandshake.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char SRBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const char SRHandshakeKeyGUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+size_t SRBase64Encode(const uint8_t *bytes, size_t length, char *output)
+{
+    size_t outputLength = 0;
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3) {
+        uint32_t triple = ((uint32_t)bytes[i] << 16) | ((uint32_t)bytes[i + 1] << 8) | (uint32_t)bytes[i + 2];
+        output[outputLength++] = SRBase64Alphabet[(triple >> 18) & 0x3F];
+        output[outputLength++] = SRBase64Alphabet[(triple >> 12) & 0x3F];
+        output[outputLength++] = SRBase64Alphabet[(triple >> 6) & 0x3F];
+        output[outputLength++] = SRBase64Alphabet[triple & 0x3F];
+    }
+
+    size_t remaining = length - i;
+    if (remaining > 0) {
+        uint32_t triple = (uint32_t)bytes[i] << 16;
+        if (remaining == 2) {
+            triple |= (uint32_t)bytes[i + 1] << 8;
+        }
+        output[outputLength++] = SRBase64Alphabet[(triple >> 18) & 0x3F];
+        output[outputLength++] = SRBase64Alphabet[(triple >> 12) & 0x3F];
+        output[outputLength++] = (remaining == 2 ? SRBase64Alphabet[(triple >> 6) & 0x3F] : '=');
+        output[outputLength++] = '=';
+    }
+
+    output[outputLength] = '\0';
+    return outputLength;
+}
+
+bool SRHandshakeKeyCreate(const SRCoreCrypto *crypto, char key[SRHandshakeKeyLength + 1])
+{
+    uint8_t randomBytes[16];
+    if (!crypto->randomBytes(crypto->context, randomBytes, sizeof(randomBytes))) {
+        return false;
+    }
+    SRBase64Encode(randomBytes, sizeof(randomBytes), key);
+    return true;
+}
+
+bool SRHandshakeAcceptKeyCreate(const SRCoreCrypto *crypto, const char *key, size_t keyLength, char acceptKey[SRHandshakeAcceptKeyLength + 1])
+{
+    // Keys longer than the ones we generate are hashed too, the peer decides what to send.
+    size_t guidLength = sizeof(SRHandshakeKeyGUID) - 1;
+    uint8_t stackBuffer[SRHandshakeKeyLength + sizeof(SRHandshakeKeyGUID)];
+    uint8_t *buffer = stackBuffer;
+    uint8_t *heapBuffer = NULL;
+    if (keyLength + guidLength > sizeof(stackBuffer)) {
+        heapBuffer = malloc(keyLength + guidLength);
+        if (!heapBuffer) {
+            return false;
+        }
+        buffer = heapBuffer;
+    }
+    memcpy(buffer, key, keyLength);
+    memcpy(buffer + keyLength, SRHandshakeKeyGUID, guidLength);
+
+    uint8_t digest[SRSHA1DigestLength];
+    crypto->sha1(crypto->context, buffer, keyLength + guidLength, digest);
+    free(heapBuffer);
+
+    SRBase64Encode(digest, sizeof(digest), acceptKey);
+    return true;
+}
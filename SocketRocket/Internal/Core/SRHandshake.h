@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SRCoreCrypto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Base64 of 16 random bytes.
+#define SRHandshakeKeyLength 24
+// Base64 of SHA-1 digest.
+#define SRHandshakeAcceptKeyLength 28
+
+/**
+ Returns the length of Base64 encoding of `length` bytes, without the terminating NUL.
+ */
+static inline size_t SRBase64EncodedLength(size_t length)
+{
+    return ((length + 2) / 3) * 4;
+}
+
+/**
+ Encodes `bytes` with standard Base64 with padding into `output`, which must hold `SRBase64EncodedLength(length) + 1` bytes.
+ The output is NUL-terminated.
+
+ @return Number of characters written, not including the terminating NUL.
+ */
+extern size_t SRBase64Encode(const uint8_t *bytes, size_t length, char *output);
+
+/**
+ Generates a random `Sec-WebSocket-Key` value.
+
+ @return `false` if random bytes couldn't be generated.
+ */
+extern bool SRHandshakeKeyCreate(const SRCoreCrypto *crypto, char key[SRHandshakeKeyLength + 1]);
+
+/**
+ Computes the `Sec-WebSocket-Accept` value expected for a given `Sec-WebSocket-Key`.
+
+ @return `false` if memory couldn't be allocated for an unusually long key.
+ */
+extern bool SRHandshakeAcceptKeyCreate(const SRCoreCrypto *crypto, const char *key, size_t keyLength, char acceptKey[SRHandshakeAcceptKeyLength + 1]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#include "SRMasking.h"
+
+#include <string.h>
+
+typedef uint8_t uint8x32_t __attribute__((vector_size(32)));
+
+static void SRMaskBytesManual(uint8_t *bytes, size_t length, const uint8_t *maskKey, size_t maskOffset)
+{
+    for (size_t i = 0; i < length; i++) {
+        bytes[i] = bytes[i] ^ maskKey[(maskOffset + i) % sizeof(uint32_t)];
+    }
+}
+
+void SRMaskBytes(uint8_t *bytes, size_t length, const uint8_t *maskKey, size_t maskOffset)
+{
+    size_t alignmentBytes = (sizeof(uint8x32_t) - ((uintptr_t)bytes % sizeof(uint8x32_t))) % sizeof(uint8x32_t);
+
+    // If the number of bytes that can be processed after aligning is
+    // less than the number of bytes we can put into a vector,
+    // then there's no work to do with SIMD, just call the manual version.
+    if (alignmentBytes > length || (length - alignmentBytes) < sizeof(uint8x32_t)) {
+        SRMaskBytesManual(bytes, length, maskKey, maskOffset);
+        return;
+    }
+
+    size_t vectorLength = (length - alignmentBytes) / sizeof(uint8x32_t);
+    size_t manualStartOffset = alignmentBytes + (vectorLength * sizeof(uint8x32_t));
+
+    SRMaskBytesManual(bytes, alignmentBytes, maskKey, maskOffset);
+
+    // Vector size is a multiple of the key size, so the same rotated key works for every vector.
+    uint8x32_t maskVector;
+    uint8_t *maskVectorBytes = (uint8_t *)&maskVector;
+    for (size_t i = 0; i < sizeof(uint8x32_t); i++) {
+        maskVectorBytes[i] = maskKey[(maskOffset + alignmentBytes + i) % sizeof(uint32_t)];
+    }
+
+    uint8x32_t *vector = (uint8x32_t *)(bytes + alignmentBytes);
+    for (size_t vectorIndex = 0; vectorIndex < vectorLength; vectorIndex++) {
+        vector[vectorIndex] = vector[vectorIndex] ^ maskVector;
+    }
+
+    SRMaskBytesManual(bytes + manualStartOffset, length - manualStartOffset, maskKey, maskOffset + manualStartOffset);
+}
+
+void SRMaskBytesCopy(uint8_t *destination, const uint8_t *source, size_t length, const uint8_t *maskKey, size_t maskOffset)
+{
+    uint8x32_t maskVector;
+    uint8_t *maskVectorBytes = (uint8_t *)&maskVector;
+    for (size_t i = 0; i < sizeof(uint8x32_t); i++) {
+        maskVectorBytes[i] = maskKey[(maskOffset + i) % sizeof(uint32_t)];
+    }
+
+    // Buffers are rarely aligned the same way, so vectors are loaded and stored unaligned, which `memcpy` compiles to.
+    size_t offset = 0;
+    for (; length - offset >= sizeof(uint8x32_t); offset += sizeof(uint8x32_t)) {
+        uint8x32_t vector;
+        memcpy(&vector, source + offset, sizeof(vector));
+        vector ^= maskVector;
+        memcpy(destination + offset, &vector, sizeof(vector));
+    }
+    for (; offset < length; offset++) {
+        destination[offset] = source[offset] ^ maskKey[(maskOffset + offset) % sizeof(uint32_t)];
+    }
+}
+
+typedef struct {
+    uint8_t *destination;
+    const uint8_t *source;
+    size_t length;
+    const uint8_t *maskKey;
+    size_t maskOffset;
+} SRMaskBytesCopyWork;
+
+static void SRMaskBytesCopyChunk(void *workContext, size_t index)
+{
+    const SRMaskBytesCopyWork *work = workContext;
+    size_t start = index * SRCoreApplyChunkSize;
+    size_t length = work->length - start;
+    if (length > SRCoreApplyChunkSize) {
+        length = SRCoreApplyChunkSize;
+    }
+    SRMaskBytesCopy(work->destination + start, work->source + start, length, work->maskKey, work->maskOffset + start);
+}
+
+void SRMaskBytesCopyConcurrently(const SRCoreApply *apply,
+                                 uint8_t *destination,
+                                 const uint8_t *source,
+                                 size_t length,
+                                 const uint8_t *maskKey,
+                                 size_t maskOffset)
+{
+    size_t chunkCount = SRCoreApplyChunkCount(length);
+    if (chunkCount < 2) {
+        SRMaskBytesCopy(destination, source, length, maskKey, maskOffset);
+        return;
+    }
+
+    SRMaskBytesCopyWork work = {
+        .destination = destination,
+        .source = source,
+        .length = length,
+        .maskKey = maskKey,
+        .maskOffset = maskOffset,
+    };
+    apply->apply(apply->context, chunkCount, &work, SRMaskBytesCopyChunk);
+}
@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SRCoreApply.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ Mask or unmask bytes in place using XOR via SIMD.
+
+ @param bytes      The bytes to mask.
+ @param length     The number of bytes to mask.
+ @param maskKey    The mask to XOR with, MUST be of length sizeof(uint32_t).
+ @param maskOffset The offset of `bytes` from the beginning of the frame payload, used to continue masking a payload in chunks.
+ */
+extern void SRMaskBytes(uint8_t *bytes, size_t length, const uint8_t *maskKey, size_t maskOffset);
+
+/**
+ Masks `length` bytes of `source` into `destination` in a single pass, instead of copying and then masking in place.
+ The buffers must not overlap and may have any alignment.
+
+ @param maskOffset The offset of `source` from the beginning of the frame payload.
+ */
+extern void SRMaskBytesCopy(uint8_t *destination, const uint8_t *source, size_t length, const uint8_t *maskKey, size_t maskOffset);
+
+/**
+ Same as `SRMaskBytesCopy`, but splits the payload into chunks that are masked through `apply`, e.g. on all cores.
+ Each chunk continues the mask where the previous one ended, so the result is identical.
+ */
+extern void SRMaskBytesCopyConcurrently(const SRCoreApply *apply,
+                                        uint8_t *destination,
+                                        const uint8_t *source,
+                                        size_t length,
+                                        const uint8_t *maskKey,
+                                        size_t maskOffset);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,166 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#include "SRUTF8.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const uint64_t SRUTF8NonASCIIMask = 0x8080808080808080ULL;
+
+bool SRUTF8ValidatorUpdate(SRUTF8Validator *validator, const uint8_t *bytes, size_t length)
+{
+    if (validator->invalid) {
+        return false;
+    }
+
+    uint8_t remaining = validator->remaining;
+    uint8_t lowerBound = validator->lowerBound;
+    uint8_t upperBound = validator->upperBound;
+
+    size_t i = 0;
+    while (i < length) {
+        if (remaining == 0) {
+            // Skip ASCII 8 bytes at a time, since it's the most common case.
+            while (i + sizeof(uint64_t) <= length) {
+                uint64_t chunk;
+                memcpy(&chunk, bytes + i, sizeof(chunk));
+                if (chunk & SRUTF8NonASCIIMask) {
+                    break;
+                }
+                i += sizeof(uint64_t);
+            }
+            if (i == length) {
+                break;
+            }
+
+            uint8_t byte = bytes[i++];
+            if (byte < 0x80) {
+                continue;
+            }
+
+            lowerBound = 0x80;
+            upperBound = 0xBF;
+            if (byte >= 0xC2 && byte <= 0xDF) {
+                remaining = 1;
+            } else if (byte >= 0xE0 && byte <= 0xEF) {
+                remaining = 2;
+                if (byte == 0xE0) {
+                    lowerBound = 0xA0; // Overlong encoding.
+                } else if (byte == 0xED) {
+                    upperBound = 0x9F; // UTF-16 surrogates.
+                }
+            } else if (byte >= 0xF0 && byte <= 0xF4) {
+                remaining = 3;
+                if (byte == 0xF0) {
+                    lowerBound = 0x90; // Overlong encoding.
+                } else if (byte == 0xF4) {
+                    upperBound = 0x8F; // Above U+10FFFF.
+                }
+            } else {
+                validator->invalid = true;
+                return false;
+            }
+        } else {
+            uint8_t byte = bytes[i++];
+            if (byte < lowerBound || byte > upperBound) {
+                validator->invalid = true;
+                return false;
+            }
+            remaining--;
+            lowerBound = 0x80;
+            upperBound = 0xBF;
+        }
+    }
+
+    validator->remaining = remaining;
+    validator->lowerBound = lowerBound;
+    validator->upperBound = upperBound;
+    return true;
+}
+
+typedef struct {
+    const uint8_t *bytes;
+    size_t *chunkStarts; // One more than the number of chunks, the last one is the total length.
+    SRUTF8Validator *validators;
+} SRUTF8ValidationWork;
+
+static void SRUTF8ValidateChunk(void *workContext, size_t index)
+{
+    const SRUTF8ValidationWork *work = workContext;
+    size_t start = work->chunkStarts[index];
+    SRUTF8ValidatorUpdate(&work->validators[index], work->bytes + start, work->chunkStarts[index + 1] - start);
+}
+
+bool SRUTF8ValidatorUpdateConcurrently(const SRCoreApply *apply, SRUTF8Validator *validator, const uint8_t *bytes, size_t length)
+{
+    size_t chunkCount = SRCoreApplyChunkCount(length);
+    if (chunkCount < 2 || validator->invalid) {
+        return SRUTF8ValidatorUpdate(validator, bytes, length);
+    }
+
+    size_t *chunkStarts = malloc((chunkCount + 1) * sizeof(size_t));
+    SRUTF8Validator *validators = malloc(chunkCount * sizeof(SRUTF8Validator));
+    if (!chunkStarts || !validators) {
+        free(chunkStarts);
+        free(validators);
+        return SRUTF8ValidatorUpdate(validator, bytes, length);
+    }
+
+    chunkStarts[0] = 0;
+    validators[0] = *validator;
+    for (size_t i = 1; i < chunkCount; i++) {
+        // Move every other chunk start past continuation bytes, so it can be validated from the initial state.
+        // A code point has at most 3 of them, a chunk starting with more fails, as they are invalid anyway.
+        size_t start = i * SRCoreApplyChunkSize;
+        for (size_t skipped = 0; skipped < 3 && start < length && (bytes[start] & 0xC0) == 0x80; skipped++) {
+            start++;
+        }
+        if (start == length) {
+            // Input ends in the code point that was skipped, so the previous chunk carries it over instead.
+            chunkCount = i;
+            break;
+        }
+        chunkStarts[i] = start;
+        SRUTF8ValidatorInit(&validators[i]);
+    }
+    chunkStarts[chunkCount] = length;
+
+    SRUTF8ValidationWork work = {
+        .bytes = bytes,
+        .chunkStarts = chunkStarts,
+        .validators = validators,
+    };
+    apply->apply(apply->context, chunkCount, &work, SRUTF8ValidateChunk);
+
+    // Every chunk but the last is followed by the start of a code point, so it must not end in the middle of one.
+    bool valid = true;
+    for (size_t i = 0; i < chunkCount; i++) {
+        if (validators[i].invalid || (i + 1 < chunkCount && validators[i].remaining != 0)) {
+            valid = false;
+            break;
+        }
+    }
+    if (valid) {
+        *validator = validators[chunkCount - 1];
+    } else {
+        validator->invalid = true;
+    }
+
+    free(chunkStarts);
+    free(validators);
+    return valid;
+}
+
+bool SRUTF8IsValid(const uint8_t *bytes, size_t length)
+{
+    SRUTF8Validator validator;
+    SRUTF8ValidatorInit(&validator);
+    return (SRUTF8ValidatorUpdate(&validator, bytes, length) && SRUTF8ValidatorIsComplete(&validator));
+}
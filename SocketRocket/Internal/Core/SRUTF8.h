@@ -0,0 +1,66 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SRCoreApply.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ Incremental UTF-8 validator (RFC 3629), that accepts input split at arbitrary byte boundaries,
+ so a text message can be validated as its fragments arrive, without copying or rescanning.
+ */
+typedef struct {
+    uint8_t remaining; // Number of continuation bytes expected for the current code point.
+    uint8_t lowerBound; // Allowed range of the next continuation byte.
+    uint8_t upperBound;
+    bool invalid;
+} SRUTF8Validator;
+
+static inline void SRUTF8ValidatorInit(SRUTF8Validator *validator)
+{
+    *validator = (SRUTF8Validator){ .remaining = 0, .lowerBound = 0x80, .upperBound = 0xBF, .invalid = false };
+}
+
+/**
+ Validates the next chunk of bytes.
+
+ @return `false` if the input so far can't be a prefix of valid UTF-8.
+ */
+extern bool SRUTF8ValidatorUpdate(SRUTF8Validator *validator, const uint8_t *bytes, size_t length);
+
+/**
+ Same as `SRUTF8ValidatorUpdate`, but splits `bytes` at code point boundaries into chunks that are validated through `apply`,
+ e.g. on all cores. The first chunk continues a code point carried over in `validator`, and the last one may leave one for the next update.
+ */
+extern bool SRUTF8ValidatorUpdateConcurrently(const SRCoreApply *apply, SRUTF8Validator *validator, const uint8_t *bytes, size_t length);
+
+/**
+ Returns `true` if all input was valid and didn't end in the middle of a code point.
+ */
+static inline bool SRUTF8ValidatorIsComplete(const SRUTF8Validator *validator)
+{
+    return (!validator->invalid && validator->remaining == 0);
+}
+
+/**
+ Returns whether `bytes` are valid and complete UTF-8.
+ */
+extern bool SRUTF8IsValid(const uint8_t *bytes, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
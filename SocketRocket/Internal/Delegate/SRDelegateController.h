@@ -24,6 +24,8 @@ struct SRDelegateAvailableMethods {
     BOOL didCloseWithCode : 1;
     BOOL didReceivePing : 1;
     BOOL didReceivePong : 1;
+    BOOL didReceiveDecodedMessage : 1;
+    BOOL didFailToDecodeMessage : 1;
     BOOL shouldConvertTextFrameToString : 1;
 };
 
@@ -38,6 +40,8 @@ struct SRDelegateAvailableMethods {
     BOOL didCloseWithCode;
     BOOL didReceivePing;
     BOOL didReceivePong;
+    BOOL didReceiveDecodedMessage;
+    BOOL didFailToDecodeMessage;
     BOOL shouldConvertTextFrameToString;
 };
 
@@ -46,6 +50,11 @@ struct SRDelegateAvailableMethods {
 typedef struct SRDelegateAvailableMethods SRDelegateAvailableMethods;
 
 typedef void(^SRDelegateBlock)(id<SRWebSocketDelegate> _Nullable delegate, SRDelegateAvailableMethods availableMethods);
+typedef id _Nullable (^SRDecodeBlock)(NSError **error);
+typedef void(^SRDecodedDelegateBlock)(id<SRWebSocketDelegate> _Nullable delegate,
+                                      SRDelegateAvailableMethods availableMethods,
+                                      id _Nullable decodedMessage,
+                                      NSError *_Nullable error);
 
 @interface SRDelegateController : NSObject
 
@@ -62,6 +71,12 @@ typedef void(^SRDelegateBlock)(id<SRWebSocketDelegate> _Nullable delegate, SRDel
 - (void)performDelegateBlock:(SRDelegateBlock)block;
 - (void)performDelegateQueueBlock:(dispatch_block_t)block;
 
+/**
+ Runs `decodeBlock` on a concurrent decode queue, then calls `delegateBlock` with its result on the delegate queue.
+ Delegate blocks are still performed in the order all perform methods were called in, regardless of how long decoding takes.
+ */
+- (void)performDecodeBlock:(SRDecodeBlock)decodeBlock delegateBlock:(SRDecodedDelegateBlock)delegateBlock;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -9,6 +9,8 @@
 
 #import "SRDelegateController.h"
 
+#import <os/lock.h>
+
 NS_ASSUME_NONNULL_BEGIN
 
 @interface SRDelegateController ()
@@ -20,6 +22,14 @@ NS_ASSUME_NONNULL_BEGIN
 @end
 
 @implementation SRDelegateController
+{
+    // Reorder buffer, which keeps delegate blocks in order while messages are decoded concurrently.
+    dispatch_queue_t _decodeQueue;
+    os_unfair_lock _orderLock;
+    uint64_t _nextSequence; // Sequence number of the next perform call.
+    uint64_t _nextDeliverySequence; // Sequence number of the next block to hand over to the delegate queue.
+    NSMutableDictionary<NSNumber *, dispatch_block_t> *_completedBlocks; // Blocks waiting for earlier ones to complete.
+}
 
 @synthesize delegate = _delegate;
 @synthesize dispatchQueue = _dispatchQueue;
@@ -37,6 +47,10 @@ NS_ASSUME_NONNULL_BEGIN
     _accessQueue = dispatch_queue_create("com.facebook.socketrocket.delegate.access", DISPATCH_QUEUE_CONCURRENT);
     _dispatchQueue = dispatch_get_main_queue();
 
+    _decodeQueue = dispatch_queue_create("com.facebook.socketrocket.delegate.decode", DISPATCH_QUEUE_CONCURRENT);
+    _orderLock = OS_UNFAIR_LOCK_INIT;
+    _completedBlocks = [NSMutableDictionary dictionary];
+
     return self;
 }
 
@@ -58,6 +72,8 @@ NS_ASSUME_NONNULL_BEGIN
             .didCloseWithCode = [delegate respondsToSelector:@selector(webSocket:didCloseWithCode:reason:wasClean:)],
             .didReceivePing = [delegate respondsToSelector:@selector(webSocket:didReceivePingWithData:)],
             .didReceivePong = [delegate respondsToSelector:@selector(webSocket:didReceivePong:)],
+            .didReceiveDecodedMessage = [delegate respondsToSelector:@selector(webSocket:didReceiveDecodedMessage:)],
+            .didFailToDecodeMessage = [delegate respondsToSelector:@selector(webSocket:didFailToDecodeMessage:error:)],
             .shouldConvertTextFrameToString = [delegate respondsToSelector:@selector(webSocketShouldConvertTextFrameToString:)]
         };
     });
@@ -111,6 +127,37 @@ NS_ASSUME_NONNULL_BEGIN
 ///--------------------------------------
 
 - (void)performDelegateBlock:(SRDelegateBlock)block
+{
+    [self performDelegateQueueBlock:[self _delegateQueueBlockWithBlock:block]];
+}
+
+- (void)performDelegateQueueBlock:(dispatch_block_t)block
+{
+    os_unfair_lock_lock(&_orderLock);
+    [self _completeSequence:_nextSequence++ block:block];
+    os_unfair_lock_unlock(&_orderLock);
+}
+
+- (void)performDecodeBlock:(SRDecodeBlock)decodeBlock delegateBlock:(SRDecodedDelegateBlock)delegateBlock
+{
+    os_unfair_lock_lock(&_orderLock);
+    uint64_t sequence = _nextSequence++;
+    os_unfair_lock_unlock(&_orderLock);
+
+    dispatch_async(_decodeQueue, ^{
+        NSError *error = nil;
+        id decodedMessage = decodeBlock(&error);
+        dispatch_block_t block = [self _delegateQueueBlockWithBlock:^(id<SRWebSocketDelegate> _Nullable delegate, SRDelegateAvailableMethods availableMethods) {
+            delegateBlock(delegate, availableMethods, decodedMessage, error);
+        }];
+
+        os_unfair_lock_lock(&self->_orderLock);
+        [self _completeSequence:sequence block:block];
+        os_unfair_lock_unlock(&self->_orderLock);
+    });
+}
+
+- (dispatch_block_t)_delegateQueueBlockWithBlock:(SRDelegateBlock)block
 {
     __block __strong id<SRWebSocketDelegate> delegate = nil;
     __block SRDelegateAvailableMethods availableMethods;
@@ -118,12 +165,35 @@ NS_ASSUME_NONNULL_BEGIN
         delegate = self->_delegate; // Not `OK` to go through `self`, since queue sync.
         availableMethods = self.availableDelegateMethods; // `OK` to call through `self`, since no queue sync.
     });
-    [self performDelegateQueueBlock:^{
+    return ^{
         block(delegate, availableMethods);
-    }];
+    };
 }
 
-- (void)performDelegateQueueBlock:(dispatch_block_t)block
+// Must be called with `_orderLock` held, so blocks are handed over to the delegate queue in sequence order.
+- (void)_completeSequence:(uint64_t)sequence block:(dispatch_block_t)block
+{
+    if (sequence != _nextDeliverySequence) {
+        _completedBlocks[@(sequence)] = block;
+        return;
+    }
+
+    [self _dispatchDelegateQueueBlock:block];
+    _nextDeliverySequence++;
+
+    while (_completedBlocks.count) {
+        NSNumber *key = @(_nextDeliverySequence);
+        dispatch_block_t nextBlock = _completedBlocks[key];
+        if (!nextBlock) {
+            break;
+        }
+        [_completedBlocks removeObjectForKey:key];
+        [self _dispatchDelegateQueueBlock:nextBlock];
+        _nextDeliverySequence++;
+    }
+}
+
+- (void)_dispatchDelegateQueueBlock:(dispatch_block_t)block
 {
     dispatch_queue_t dispatchQueue = self.dispatchQueue;
     if (dispatchQueue) {
@@ -0,0 +1,52 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Called once the server responded to an extended CONNECT request.
+
+ - On a `2xx` response, `inputStream` and `outputStream` carry the WebSocket connection, already opened.
+ - On any other response, only `responseHeaders` are set.
+ - If the stream couldn't be opened, only `error` is set.
+ - If the server doesn't support WebSockets over HTTP/2, all arguments are `nil` and the caller should fall back to HTTP/1.1.
+ */
+typedef void(^SRHTTP2StreamOpenCompletion)(NSInputStream *_Nullable inputStream,
+                                           NSOutputStream *_Nullable outputStream,
+                                           NSDictionary<NSString *, NSString *> *_Nullable responseHeaders,
+                                           NSError *_Nullable error);
+
+/**
+ A single HTTP/2 connection to an origin that multiplexes any number of WebSockets, bootstrapped with
+ extended CONNECT (RFC 8441). Every WebSocket is exposed to its socket as a pair of bound streams, with flow control
+ applied per stream, so a socket that stops reading only stalls its own stream.
+
+ Connections are made with prior knowledge over cleartext TCP (h2c).
+ All methods are thread-safe, completions are called on a private queue.
+ */
+@interface SRHTTP2Connection : NSObject
+
+- (instancetype)initWithURL:(NSURL *)url;
+
+/**
+ `NO` once the connection was closed, received GOAWAY or turned out to not support WebSockets.
+ */
+@property (atomic, assign, readonly, getter=isReusable) BOOL reusable;
+
+/**
+ Sends an extended CONNECT request with `headers`, given as ordered `[name, value]` pairs, pseudo-headers first.
+ Connects on the first call. Streams above the server's concurrency limit wait for other streams to finish.
+ */
+- (void)openStreamWithHeaders:(NSArray<NSArray<NSString *> *> *)headers completion:(SRHTTP2StreamOpenCompletion)completion;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,938 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRHTTP2Connection.h"
+
+#import <stdatomic.h>
+
+#import "NSRunLoop+SRWebSocket.h"
+#import "SRError.h"
+#import "SRHPACK.h"
+#import "SRHTTP2.h"
+#import "SRLog.h"
+#import "SRProxyConnect.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Receive window of every stream. Bytes are acknowledged once the socket's input stream accepted them.
+static const uint32_t SRHTTP2StreamWindowSize = 1024 * 1024;
+// Receive window of the whole connection. Bytes are acknowledged as soon as they arrive, streams limit buffering.
+static const uint32_t SRHTTP2ConnectionWindowSize = 16 * 1024 * 1024;
+// Capacity of the bound stream pairs between a socket and its stream.
+static const CFIndex SRHTTP2StreamBufferSize = 256 * 1024;
+// Largest header block accepted, including CONTINUATION frames.
+static const NSUInteger SRHTTP2MaxHeaderBlockLength = 64 * 1024;
+// Servers that don't reply with SETTINGS by then are assumed to not speak HTTP/2.
+static const NSTimeInterval SRHTTP2SettingsTimeout = 5.0;
+// Connections without streams are closed after this interval.
+static const NSTimeInterval SRHTTP2IdleTimeout = 30.0;
+
+typedef NS_ENUM(NSUInteger, SRHTTP2ConnectionState) {
+    SRHTTP2ConnectionStateIdle,
+    SRHTTP2ConnectionStateConnecting,
+    SRHTTP2ConnectionStateReady,
+    SRHTTP2ConnectionStateClosed,
+};
+
+static NSError *SRHTTP2Error(NSString *description)
+{
+    return SRErrorWithCodeDescription(2139, description);
+}
+
+static bool SRHTTP2ConnectionWriteOutput(void *context, const uint8_t *bytes, size_t length)
+{
+    [(__bridge NSMutableData *)context appendBytes:bytes length:length];
+    return true;
+}
+
+static void SRHTTP2DetachStream(NSStream *_Nullable stream)
+{
+    stream.delegate = nil;
+    [stream removeFromRunLoop:[NSRunLoop SR_networkRunLoop] forMode:NSDefaultRunLoopMode];
+    [stream close];
+}
+
+static void SRHTTP2ConnectionAppendHeader(void *context, const uint8_t *name, size_t nameLength, const uint8_t *value, size_t valueLength)
+{
+    NSMutableDictionary<NSString *, NSString *> *headers = (__bridge NSMutableDictionary *)context;
+    NSString *nameString = [[NSString alloc] initWithBytes:name length:nameLength encoding:NSUTF8StringEncoding];
+    NSString *valueString = [[NSString alloc] initWithBytes:value length:valueLength encoding:NSISOLatin1StringEncoding];
+    if (!nameString || !valueString) {
+        return;
+    }
+    NSString *existingValue = headers[nameString];
+    headers[nameString] = (existingValue ? [existingValue stringByAppendingFormat:@", %@", valueString] : valueString);
+}
+
+///--------------------------------------
+#pragma mark - SRHTTP2Stream
+///--------------------------------------
+
+@interface SRHTTP2Stream : NSObject
+
+@property (nonatomic, copy) NSArray<NSArray<NSString *> *> *requestHeaders;
+@property (nullable, nonatomic, copy) SRHTTP2StreamOpenCompletion completion; // Set until the response arrives.
+@property (nonatomic, assign) uint32_t streamID;
+
+// Inbound bytes are written into `feedStream`, which the socket reads from the other end of the pair.
+@property (nullable, nonatomic, strong) NSOutputStream *feedStream;
+@property (nonatomic, strong) NSMutableData *pendingInbound; // Received, but not yet accepted by `feedStream`.
+@property (nonatomic, assign) int64_t receiveWindow;
+@property (nonatomic, assign) uint32_t unacknowledgedBytes;
+@property (nonatomic, assign) BOOL remoteEnded;
+
+// Outbound bytes are read from `drainStream`, which the socket writes into on the other end of the pair.
+@property (nullable, nonatomic, strong) NSInputStream *drainStream;
+@property (nonatomic, assign) int64_t sendWindow;
+@property (nonatomic, assign) BOOL drainEnded;
+@property (nonatomic, assign) BOOL localEnded;
+
+@end
+
+@implementation SRHTTP2Stream
+@end
+
+///--------------------------------------
+#pragma mark - SRHTTP2Connection
+///--------------------------------------
+
+@interface SRHTTP2Connection () <NSStreamDelegate>
+@end
+
+@implementation SRHTTP2Connection
+{
+    NSURL *_url;
+    dispatch_queue_t _workQueue;
+    SRHTTP2ConnectionState _state;
+    atomic_bool _reusable;
+
+    // We use this to retain ourselves while connected, the pool only holds reusable connections.
+    __strong SRHTTP2Connection *_Nullable _selfRetain;
+
+    SRProxyConnect *_Nullable _proxyConnect;
+    NSInputStream *_Nullable _inputStream;
+    NSOutputStream *_Nullable _outputStream;
+
+    NSMutableData *_readBuffer;
+    NSMutableData *_outputBuffer;
+    SRCoreIO _outputIO;
+
+    NSMutableArray<SRHTTP2Stream *> *_pendingStreams;
+    NSMutableDictionary<NSNumber *, SRHTTP2Stream *> *_streams;
+    uint32_t _nextStreamID;
+
+    // Peer settings.
+    uint32_t _maxConcurrentStreams;
+    uint32_t _initialSendWindow;
+    uint32_t _maxFrameSize;
+    int64_t _connectionSendWindow;
+
+    // Header block of HEADERS that continues in CONTINUATION frames.
+    uint32_t _headerBlockStreamID;
+    uint8_t _headerBlockFlags;
+    NSMutableData *_headerBlock;
+
+    NSUInteger _idleGeneration;
+}
+
+///--------------------------------------
+#pragma mark - Init
+///--------------------------------------
+
+- (instancetype)initWithURL:(NSURL *)url
+{
+    self = [super init];
+    if (!self) return self;
+
+    _url = url;
+    _workQueue = dispatch_queue_create("com.facebook.socketrocket.http2", DISPATCH_QUEUE_SERIAL);
+    _state = SRHTTP2ConnectionStateIdle;
+    atomic_init(&_reusable, true);
+
+    _readBuffer = [NSMutableData data];
+    _outputBuffer = [NSMutableData data];
+    _outputIO = (SRCoreIO){ .write = SRHTTP2ConnectionWriteOutput, .context = (__bridge void *)_outputBuffer };
+
+    _pendingStreams = [NSMutableArray array];
+    _streams = [NSMutableDictionary dictionary];
+    _nextStreamID = 1;
+
+    _maxConcurrentStreams = UINT32_MAX;
+    _initialSendWindow = SRHTTP2DefaultInitialWindowSize;
+    _maxFrameSize = SRHTTP2DefaultMaxFrameSize;
+    _connectionSendWindow = SRHTTP2DefaultInitialWindowSize;
+
+    return self;
+}
+
+- (BOOL)isReusable
+{
+    return atomic_load(&_reusable);
+}
+
+///--------------------------------------
+#pragma mark - Open
+///--------------------------------------
+
+- (void)openStreamWithHeaders:(NSArray<NSArray<NSString *> *> *)headers completion:(SRHTTP2StreamOpenCompletion)completion
+{
+    SRHTTP2Stream *stream = [[SRHTTP2Stream alloc] init];
+    stream.requestHeaders = headers;
+    stream.completion = completion;
+    stream.pendingInbound = [NSMutableData data];
+    stream.receiveWindow = SRHTTP2StreamWindowSize;
+
+    dispatch_async(_workQueue, ^{
+        switch (self->_state) {
+            case SRHTTP2ConnectionStateIdle:
+                [self->_pendingStreams addObject:stream];
+                [self _connect];
+                break;
+            case SRHTTP2ConnectionStateConnecting:
+                [self->_pendingStreams addObject:stream];
+                break;
+            case SRHTTP2ConnectionStateReady:
+                [self->_pendingStreams addObject:stream];
+                [self _startPendingStreams];
+                break;
+            case SRHTTP2ConnectionStateClosed:
+                completion(nil, nil, nil, SRHTTP2Error(@"HTTP/2 connection is closed."));
+                break;
+        }
+    });
+}
+
+- (void)_connect
+{
+    _state = SRHTTP2ConnectionStateConnecting;
+    _selfRetain = self;
+
+    _proxyConnect = [[SRProxyConnect alloc] initWithURL:_url];
+    __weak typeof(self) wself = self;
+    [_proxyConnect openNetworkStreamWithCompletion:^(NSError *error, NSInputStream *readStream, NSOutputStream *writeStream) {
+        __strong SRHTTP2Connection *sself = wself;
+        if (!sself) {
+            return;
+        }
+        // Not inline, to avoid deallocating `SRProxyConnect` inside its own completion.
+        dispatch_async(sself->_workQueue, ^{
+            sself->_proxyConnect = nil;
+            if (error) {
+                [sself _closeWithError:error unsupported:NO];
+            } else {
+                [sself _connectionDoneWithReadStream:readStream writeStream:writeStream];
+            }
+        });
+    }];
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(SRHTTP2SettingsTimeout * NSEC_PER_SEC)), _workQueue, ^{
+        if (self->_state == SRHTTP2ConnectionStateConnecting) {
+            [self _closeWithError:nil unsupported:YES];
+        }
+    });
+}
+
+- (void)_connectionDoneWithReadStream:(NSInputStream *)readStream writeStream:(NSOutputStream *)writeStream
+{
+    if (_state != SRHTTP2ConnectionStateConnecting) {
+        [readStream close];
+        [writeStream close];
+        return;
+    }
+
+    _inputStream = readStream;
+    _outputStream = writeStream;
+    _inputStream.delegate = self;
+    _outputStream.delegate = self;
+    [_inputStream scheduleInRunLoop:[NSRunLoop SR_networkRunLoop] forMode:NSDefaultRunLoopMode];
+    [_outputStream scheduleInRunLoop:[NSRunLoop SR_networkRunLoop] forMode:NSDefaultRunLoopMode];
+
+    // The dynamic table is disabled, which keeps HPACK stateless, and so is server push.
+    const SRHTTP2Setting settings[] = {
+        { SRHTTP2SettingHeaderTableSize, 0 },
+        { SRHTTP2SettingEnablePush, 0 },
+        { SRHTTP2SettingInitialWindowSize, SRHTTP2StreamWindowSize },
+    };
+    [_outputBuffer appendBytes:SRHTTP2ConnectionPreface length:SRHTTP2ConnectionPrefaceLength];
+    SRHTTP2WriteSettings(&_outputIO, settings, sizeof(settings) / sizeof(settings[0]), false);
+    SRHTTP2WriteWindowUpdate(&_outputIO, 0, SRHTTP2ConnectionWindowSize - SRHTTP2DefaultInitialWindowSize);
+    [self _pumpWriting];
+    [self _readFromInputStream];
+}
+
+///--------------------------------------
+#pragma mark - Close
+///--------------------------------------
+
+- (void)_closeWithError:(nullable NSError *)error unsupported:(BOOL)unsupported
+{
+    if (_state == SRHTTP2ConnectionStateClosed) {
+        return;
+    }
+    SRDebugLog(@"Closing HTTP/2 connection to %@, error: %@", _url.host, error);
+
+    _state = SRHTTP2ConnectionStateClosed;
+    atomic_store(&_reusable, false);
+
+    NSArray<SRHTTP2Stream *> *streams = [_pendingStreams arrayByAddingObjectsFromArray:_streams.allValues];
+    [_pendingStreams removeAllObjects];
+    for (SRHTTP2Stream *stream in streams) {
+        [self _closeStream:stream error:(unsupported ? nil : (error ?: SRHTTP2Error(@"HTTP/2 connection was closed.")))];
+    }
+
+    _inputStream.delegate = nil;
+    _outputStream.delegate = nil;
+    [_inputStream removeFromRunLoop:[NSRunLoop SR_networkRunLoop] forMode:NSDefaultRunLoopMode];
+    [_outputStream removeFromRunLoop:[NSRunLoop SR_networkRunLoop] forMode:NSDefaultRunLoopMode];
+    [_inputStream close];
+    [_outputStream close];
+    _inputStream = nil;
+    _outputStream = nil;
+    _proxyConnect = nil;
+
+    _selfRetain = nil;
+}
+
+- (void)_failWithErrorCode:(SRHTTP2ErrorCode)errorCode description:(NSString *)description
+{
+    BOOL connecting = (_state == SRHTTP2ConnectionStateConnecting);
+    if (!connecting) {
+        // The server can't open streams, so none of its streams were processed.
+        SRHTTP2WriteGoAway(&_outputIO, 0, errorCode);
+        [self _pumpWriting];
+    }
+    // Anything unexpected before the server's SETTINGS means it doesn't speak HTTP/2.
+    [self _closeWithError:SRHTTP2Error(description) unsupported:connecting];
+}
+
+- (void)_scheduleIdleClose
+{
+    NSUInteger generation = ++_idleGeneration;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(SRHTTP2IdleTimeout * NSEC_PER_SEC)), _workQueue, ^{
+        if (self->_idleGeneration != generation || self->_streams.count > 0 || self->_pendingStreams.count > 0) {
+            return;
+        }
+        if (self->_state == SRHTTP2ConnectionStateReady) {
+            SRHTTP2WriteGoAway(&self->_outputIO, 0, SRHTTP2ErrorCodeNoError);
+            [self _pumpWriting];
+            [self _closeWithError:nil unsupported:NO];
+        }
+    });
+}
+
+///--------------------------------------
+#pragma mark - Streams
+///--------------------------------------
+
+- (void)_startPendingStreams
+{
+    while (_pendingStreams.count > 0 && _streams.count < _maxConcurrentStreams) {
+        SRHTTP2Stream *stream = _pendingStreams.firstObject;
+        [_pendingStreams removeObjectAtIndex:0];
+
+        // Stream identifiers can't be reused, a new connection is needed once they run out.
+        if (_nextStreamID > SRHTTP2MaxWindowSize) {
+            atomic_store(&_reusable, false);
+            [self _closeStream:stream error:SRHTTP2Error(@"HTTP/2 connection ran out of stream identifiers.")];
+            continue;
+        }
+        stream.streamID = _nextStreamID;
+        stream.sendWindow = _initialSendWindow;
+        _nextStreamID += 2;
+        _streams[@(stream.streamID)] = stream;
+
+        NSMutableData *headerBlock = [NSMutableData data];
+        SRCoreIO headerIO = { .write = SRHTTP2ConnectionWriteOutput, .context = (__bridge void *)headerBlock };
+        for (NSArray<NSString *> *header in stream.requestHeaders) {
+            NSData *name = [header[0].lowercaseString dataUsingEncoding:NSUTF8StringEncoding];
+            NSData *value = [header[1] dataUsingEncoding:NSUTF8StringEncoding];
+            SRHPACKEncodeHeader(&headerIO, name.bytes, name.length, value.bytes, value.length);
+        }
+
+        const uint8_t *bytes = headerBlock.bytes;
+        NSUInteger offset = 0;
+        do {
+            NSUInteger length = MIN(headerBlock.length - offset, (NSUInteger)_maxFrameSize);
+            BOOL last = (offset + length == headerBlock.length);
+            SRHTTP2FrameWrite(&_outputIO,
+                              (offset == 0 ? SRHTTP2FrameTypeHeaders : SRHTTP2FrameTypeContinuation),
+                              (last ? SRHTTP2FlagEndHeaders : 0),
+                              stream.streamID,
+                              bytes + offset,
+                              length);
+            offset += length;
+        } while (offset < headerBlock.length);
+    }
+    [self _pumpWriting];
+}
+
+- (void)_streamDidReceiveResponse:(SRHTTP2Stream *)stream headers:(NSDictionary<NSString *, NSString *> *)headers
+{
+    SRHTTP2StreamOpenCompletion completion = stream.completion;
+    stream.completion = nil;
+
+    NSInteger status = headers[@":status"].integerValue;
+    if (status < 200 || status >= 300) {
+        [self _resetStream:stream errorCode:SRHTTP2ErrorCodeCancel];
+        completion(nil, nil, headers, nil);
+        return;
+    }
+
+    CFReadStreamRef socketReadStream = NULL;
+    CFWriteStreamRef feedWriteStream = NULL;
+    CFStreamCreateBoundPair(kCFAllocatorDefault, &socketReadStream, &feedWriteStream, SRHTTP2StreamBufferSize);
+    CFReadStreamRef drainReadStream = NULL;
+    CFWriteStreamRef socketWriteStream = NULL;
+    CFStreamCreateBoundPair(kCFAllocatorDefault, &drainReadStream, &socketWriteStream, SRHTTP2StreamBufferSize);
+
+    NSInputStream *inputStream = CFBridgingRelease(socketReadStream);
+    NSOutputStream *outputStream = CFBridgingRelease(socketWriteStream);
+    stream.feedStream = CFBridgingRelease(feedWriteStream);
+    stream.drainStream = CFBridgingRelease(drainReadStream);
+
+    for (NSStream *aStream in @[ stream.feedStream, stream.drainStream ]) {
+        aStream.delegate = self;
+        [aStream scheduleInRunLoop:[NSRunLoop SR_networkRunLoop] forMode:NSDefaultRunLoopMode];
+        [aStream open];
+    }
+    [inputStream open];
+    [outputStream open];
+
+    completion(inputStream, outputStream, headers, nil);
+}
+
+- (void)_resetStream:(SRHTTP2Stream *)stream errorCode:(SRHTTP2ErrorCode)errorCode
+{
+    if (!(stream.localEnded && stream.remoteEnded)) {
+        SRHTTP2WriteRSTStream(&_outputIO, stream.streamID, errorCode);
+        [self _pumpWriting];
+    }
+    [self _closeStream:stream error:SRHTTP2Error(@"HTTP/2 stream was reset.")];
+}
+
+- (void)_closeStream:(SRHTTP2Stream *)stream error:(nullable NSError *)error
+{
+    SRHTTP2StreamOpenCompletion completion = stream.completion;
+    stream.completion = nil;
+    if (completion) {
+        completion(nil, nil, nil, error);
+    }
+
+    // The socket sees the end of its input stream.
+    SRHTTP2DetachStream(stream.feedStream);
+    SRHTTP2DetachStream(stream.drainStream);
+    stream.feedStream = nil;
+    stream.drainStream = nil;
+
+    if (stream.streamID != 0 && _streams[@(stream.streamID)] == stream) {
+        [_streams removeObjectForKey:@(stream.streamID)];
+        if (_state == SRHTTP2ConnectionStateReady) {
+            [self _startPendingStreams];
+            if (_streams.count == 0 && _pendingStreams.count == 0) {
+                [self _scheduleIdleClose];
+            }
+        }
+    }
+}
+
+- (void)_closeStreamIfFinished:(SRHTTP2Stream *)stream
+{
+    if (stream.localEnded && stream.remoteEnded && stream.pendingInbound.length == 0) {
+        [self _closeStream:stream error:nil];
+    }
+}
+
+- (nullable SRHTTP2Stream *)_streamForStream:(NSStream *)aStream
+{
+    for (SRHTTP2Stream *stream in _streams.objectEnumerator) {
+        if (stream.feedStream == aStream || stream.drainStream == aStream) {
+            return stream;
+        }
+    }
+    return nil;
+}
+
+///--------------------------------------
+#pragma mark - Inbound Data
+///--------------------------------------
+
+- (void)_flushInboundForStream:(SRHTTP2Stream *)stream
+{
+    NSOutputStream *feedStream = stream.feedStream;
+    NSMutableData *pendingInbound = stream.pendingInbound;
+    while (pendingInbound.length > 0 && feedStream.hasSpaceAvailable) {
+        NSInteger written = [feedStream write:pendingInbound.bytes maxLength:pendingInbound.length];
+        if (written <= 0) {
+            // The socket closed its input stream and won't read anything anymore.
+            [self _resetStream:stream errorCode:SRHTTP2ErrorCodeCancel];
+            return;
+        }
+        [pendingInbound replaceBytesInRange:NSMakeRange(0, (NSUInteger)written) withBytes:NULL length:0];
+        stream.unacknowledgedBytes += (uint32_t)written;
+    }
+    [self _acknowledgeInboundForStream:stream];
+
+    if (stream.remoteEnded && pendingInbound.length == 0 && feedStream) {
+        SRHTTP2DetachStream(feedStream);
+        stream.feedStream = nil;
+        [self _closeStreamIfFinished:stream];
+    }
+}
+
+- (void)_acknowledgeInboundForStream:(SRHTTP2Stream *)stream
+{
+    // Batch updates, there's no point in a frame for every read the socket makes.
+    if (stream.remoteEnded || stream.unacknowledgedBytes < SRHTTP2StreamWindowSize / 2) {
+        return;
+    }
+    SRHTTP2WriteWindowUpdate(&_outputIO, stream.streamID, stream.unacknowledgedBytes);
+    stream.receiveWindow += stream.unacknowledgedBytes;
+    stream.unacknowledgedBytes = 0;
+    [self _pumpWriting];
+}
+
+///--------------------------------------
+#pragma mark - Outbound Data
+///--------------------------------------
+
+- (void)_pumpOutboundForStream:(SRHTTP2Stream *)stream
+{
+    NSInputStream *drainStream = stream.drainStream;
+    if (!drainStream || stream.localEnded) {
+        return;
+    }
+
+    uint8_t buffer[SRHTTP2DefaultMaxFrameSize];
+    while (drainStream.hasBytesAvailable) {
+        int64_t window = MIN(stream.sendWindow, _connectionSendWindow);
+        if (window <= 0) {
+            break;
+        }
+        NSUInteger maxLength = (NSUInteger)MIN(MIN(window, (int64_t)_maxFrameSize), (int64_t)sizeof(buffer));
+        NSInteger bytesRead = [drainStream read:buffer maxLength:maxLength];
+        if (bytesRead < 0) {
+            [self _resetStream:stream errorCode:SRHTTP2ErrorCodeCancel];
+            return;
+        }
+        if (bytesRead == 0) {
+            stream.drainEnded = YES;
+            break;
+        }
+        SRHTTP2FrameWrite(&_outputIO, SRHTTP2FrameTypeData, 0, stream.streamID, buffer, (size_t)bytesRead);
+        stream.sendWindow -= bytesRead;
+        _connectionSendWindow -= bytesRead;
+    }
+
+    if (stream.drainEnded && !drainStream.hasBytesAvailable) {
+        SRHTTP2FrameWrite(&_outputIO, SRHTTP2FrameTypeData, SRHTTP2FlagEndStream, stream.streamID, NULL, 0);
+        stream.localEnded = YES;
+        SRHTTP2DetachStream(drainStream);
+        stream.drainStream = nil;
+    }
+    [self _pumpWriting];
+    [self _closeStreamIfFinished:stream];
+}
+
+- (void)_pumpOutboundForAllStreams
+{
+    for (SRHTTP2Stream *stream in _streams.allValues) {
+        [self _pumpOutboundForStream:stream];
+    }
+}
+
+///--------------------------------------
+#pragma mark - Connection I/O
+///--------------------------------------
+
+- (void)_pumpWriting
+{
+    while (_outputBuffer.length > 0 && _outputStream.hasSpaceAvailable) {
+        NSInteger written = [_outputStream write:_outputBuffer.bytes maxLength:_outputBuffer.length];
+        if (written < 0) {
+            [self _closeWithError:_outputStream.streamError unsupported:NO];
+            return;
+        }
+        if (written == 0) {
+            break;
+        }
+        [_outputBuffer replaceBytesInRange:NSMakeRange(0, (NSUInteger)written) withBytes:NULL length:0];
+    }
+}
+
+- (void)_readFromInputStream
+{
+    uint8_t buffer[SRHTTP2DefaultMaxFrameSize];
+    while (_inputStream.hasBytesAvailable) {
+        NSInteger bytesRead = [_inputStream read:buffer maxLength:sizeof(buffer)];
+        if (bytesRead < 0) {
+            [self _closeWithError:_inputStream.streamError unsupported:NO];
+            return;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        [_readBuffer appendBytes:buffer length:(NSUInteger)bytesRead];
+    }
+    [self _processReadBuffer];
+}
+
+- (void)_processReadBuffer
+{
+    const uint8_t *bytes = _readBuffer.bytes;
+    NSUInteger offset = 0;
+    while (_state != SRHTTP2ConnectionStateClosed) {
+        SRHTTP2FrameHeader header;
+        if (SRHTTP2FrameHeaderParse(bytes + offset, _readBuffer.length - offset, &header) != SRFrameResultOK) {
+            break;
+        }
+        // SETTINGS_MAX_FRAME_SIZE is never raised, so anything larger is an error, or not HTTP/2 at all.
+        if (header.length > SRHTTP2DefaultMaxFrameSize) {
+            [self _failWithErrorCode:SRHTTP2ErrorCodeFrameSizeError description:@"Received HTTP/2 frame that is too large."];
+            return;
+        }
+        if (_readBuffer.length - offset < SRHTTP2FrameHeaderLength + header.length) {
+            break;
+        }
+        [self _handleFrame:&header payload:bytes + offset + SRHTTP2FrameHeaderLength];
+        offset += SRHTTP2FrameHeaderLength + header.length;
+    }
+    if (_state != SRHTTP2ConnectionStateClosed) {
+        [_readBuffer replaceBytesInRange:NSMakeRange(0, offset) withBytes:NULL length:0];
+    }
+    [self _pumpWriting];
+}
+
+///--------------------------------------
+#pragma mark - Frames
+///--------------------------------------
+
+- (void)_handleFrame:(const SRHTTP2FrameHeader *)header payload:(const uint8_t *)payload
+{
+    if (_state == SRHTTP2ConnectionStateConnecting && !(header->type == SRHTTP2FrameTypeSettings && !(header->flags & SRHTTP2FlagAck))) {
+        [self _failWithErrorCode:SRHTTP2ErrorCodeProtocolError description:@"Server didn't start with HTTP/2 SETTINGS."];
+        return;
+    }
+    if (_headerBlock && header->type != SRHTTP2FrameTypeContinuation) {
+        [self _failWithErrorCode:SRHTTP2ErrorCodeProtocolError description:@"Expected HTTP/2 CONTINUATION frame."];
+        return;
+    }
+
+    switch (header->type) {
+        case SRHTTP2FrameTypeSettings:
+            [self _handleSettings:header payload:payload];
+            break;
+        case SRHTTP2FrameTypePing:
+            if (header->length != 8 || header->streamID != 0) {
+                [self _failWithErrorCode:SRHTTP2ErrorCodeFrameSizeError description:@"Received malformed HTTP/2 PING."];
+            } else if (!(header->flags & SRHTTP2FlagAck)) {
+                SRHTTP2FrameWrite(&_outputIO, SRHTTP2FrameTypePing, SRHTTP2FlagAck, 0, payload, header->length);
+            }
+            break;
+        case SRHTTP2FrameTypeWindowUpdate:
+            [self _handleWindowUpdate:header payload:payload];
+            break;
+        case SRHTTP2FrameTypeHeaders:
+        case SRHTTP2FrameTypeContinuation:
+            [self _handleHeaders:header payload:payload];
+            break;
+        case SRHTTP2FrameTypeData:
+            [self _handleData:header payload:payload];
+            break;
+        case SRHTTP2FrameTypeRSTStream: {
+            SRHTTP2Stream *stream = _streams[@(header->streamID)];
+            if (header->length != 4) {
+                [self _failWithErrorCode:SRHTTP2ErrorCodeFrameSizeError description:@"Received malformed HTTP/2 RST_STREAM."];
+            } else if (stream) {
+                [self _closeStream:stream error:SRHTTP2Error(@"HTTP/2 stream was reset by the server.")];
+            }
+            break;
+        }
+        case SRHTTP2FrameTypeGoAway:
+            [self _handleGoAway:header payload:payload];
+            break;
+        case SRHTTP2FrameTypePushPromise:
+            [self _failWithErrorCode:SRHTTP2ErrorCodeProtocolError description:@"Received HTTP/2 PUSH_PROMISE with push disabled."];
+            break;
+        default:
+            // PRIORITY and unknown frame types are ignored.
+            break;
+    }
+}
+
+- (void)_handleSettings:(const SRHTTP2FrameHeader *)header payload:(const uint8_t *)payload
+{
+    if (header->flags & SRHTTP2FlagAck) {
+        return;
+    }
+    if (header->streamID != 0 || header->length % SRHTTP2SettingLength != 0) {
+        [self _failWithErrorCode:SRHTTP2ErrorCodeFrameSizeError description:@"Received malformed HTTP/2 SETTINGS."];
+        return;
+    }
+
+    BOOL enablesConnectProtocol = NO;
+    SRHTTP2Setting setting;
+    for (size_t i = 0; SRHTTP2SettingRead(payload, header->length, i, &setting); i++) {
+        switch (setting.identifier) {
+            case SRHTTP2SettingMaxConcurrentStreams:
+                _maxConcurrentStreams = setting.value;
+                break;
+            case SRHTTP2SettingInitialWindowSize: {
+                if (setting.value > SRHTTP2MaxWindowSize) {
+                    [self _failWithErrorCode:SRHTTP2ErrorCodeFlowControlError description:@"Received invalid HTTP/2 initial window size."];
+                    return;
+                }
+                // Changes apply to the windows of all open streams.
+                int64_t delta = (int64_t)setting.value - (int64_t)_initialSendWindow;
+                for (SRHTTP2Stream *stream in _streams.objectEnumerator) {
+                    stream.sendWindow += delta;
+                }
+                _initialSendWindow = setting.value;
+                break;
+            }
+            case SRHTTP2SettingMaxFrameSize:
+                if (setting.value < SRHTTP2DefaultMaxFrameSize || setting.value > 0xFFFFFF) {
+                    [self _failWithErrorCode:SRHTTP2ErrorCodeProtocolError description:@"Received invalid HTTP/2 max frame size."];
+                    return;
+                }
+                _maxFrameSize = setting.value;
+                break;
+            case SRHTTP2SettingEnableConnectProtocol:
+                enablesConnectProtocol = (setting.value == 1);
+                break;
+            default:
+                break;
+        }
+    }
+    SRHTTP2WriteSettings(&_outputIO, NULL, 0, true);
+
+    if (_state == SRHTTP2ConnectionStateConnecting) {
+        if (!enablesConnectProtocol) {
+            SRHTTP2WriteGoAway(&_outputIO, 0, SRHTTP2ErrorCodeNoError);
+            [self _pumpWriting];
+            [self _closeWithError:nil unsupported:YES];
+            return;
+        }
+        _state = SRHTTP2ConnectionStateReady;
+        [self _startPendingStreams];
+    }
+    [self _pumpOutboundForAllStreams];
+}
+
+- (void)_handleWindowUpdate:(const SRHTTP2FrameHeader *)header payload:(const uint8_t *)payload
+{
+    if (header->length != 4) {
+        [self _failWithErrorCode:SRHTTP2ErrorCodeFrameSizeError description:@"Received malformed HTTP/2 WINDOW_UPDATE."];
+        return;
+    }
+    uint32_t increment = SRHTTP2ReadUInt31(payload);
+
+    if (header->streamID == 0) {
+        if (increment == 0 || _connectionSendWindow + increment > SRHTTP2MaxWindowSize) {
+            [self _failWithErrorCode:SRHTTP2ErrorCodeFlowControlError description:@"Received invalid HTTP/2 window update."];
+            return;
+        }
+        _connectionSendWindow += increment;
+        [self _pumpOutboundForAllStreams];
+        return;
+    }
+
+    SRHTTP2Stream *stream = _streams[@(header->streamID)];
+    if (!stream) {
+        return;
+    }
+    if (increment == 0 || stream.sendWindow + increment > SRHTTP2MaxWindowSize) {
+        [self _resetStream:stream errorCode:SRHTTP2ErrorCodeFlowControlError];
+        return;
+    }
+    stream.sendWindow += increment;
+    [self _pumpOutboundForStream:stream];
+}
+
+- (void)_handleHeaders:(const SRHTTP2FrameHeader *)header payload:(const uint8_t *)payload
+{
+    if (header->type == SRHTTP2FrameTypeContinuation) {
+        if (!_headerBlock || header->streamID != _headerBlockStreamID) {
+            [self _failWithErrorCode:SRHTTP2ErrorCodeProtocolError description:@"Received unexpected HTTP/2 CONTINUATION."];
+            return;
+        }
+        [_headerBlock appendBytes:payload length:header->length];
+    } else {
+        const uint8_t *fragment = NULL;
+        size_t fragmentLength = 0;
+        if (SRHTTP2FramePayloadStrip(header, payload, &fragment, &fragmentLength) != SRFrameResultOK) {
+            [self _failWithErrorCode:SRHTTP2ErrorCodeProtocolError description:@"Received malformed HTTP/2 HEADERS."];
+            return;
+        }
+        _headerBlockStreamID = header->streamID;
+        _headerBlockFlags = header->flags;
+        _headerBlock = [NSMutableData dataWithBytes:fragment length:fragmentLength];
+    }
+
+    if (_headerBlock.length > SRHTTP2MaxHeaderBlockLength) {
+        [self _failWithErrorCode:SRHTTP2ErrorCodeEnhanceYourCalm description:@"Received HTTP/2 header block that is too large."];
+        return;
+    }
+    if (!(header->flags & SRHTTP2FlagEndHeaders)) {
+        return;
+    }
+
+    NSData *headerBlock = _headerBlock;
+    _headerBlock = nil;
+
+    // Header blocks are decoded even for unknown streams, HPACK requires that to keep the connection state in sync.
+    NSMutableDictionary<NSString *, NSString *> *headers = [NSMutableDictionary dictionary];
+    NSMutableData *scratch = [NSMutableData dataWithLength:SRHTTP2MaxHeaderBlockLength];
+    SRHPACKDecoderCallbacks callbacks = { .header = SRHTTP2ConnectionAppendHeader, .context = (__bridge void *)headers };
+    if (SRHPACKDecode(headerBlock.bytes, headerBlock.length, scratch.mutableBytes, scratch.length, callbacks) != SRFrameResultOK) {
+        [self _failWithErrorCode:SRHTTP2ErrorCodeCompressionError description:@"Received malformed HTTP/2 header block."];
+        return;
+    }
+
+    SRHTTP2Stream *stream = _streams[@(_headerBlockStreamID)];
+    if (!stream) {
+        return;
+    }
+    if (_headerBlockFlags & SRHTTP2FlagEndStream) {
+        stream.remoteEnded = YES;
+    }
+    if (stream.completion) {
+        [self _streamDidReceiveResponse:stream headers:headers];
+    } else {
+        // Trailers don't carry anything useful for a WebSocket.
+        [self _flushInboundForStream:stream];
+    }
+}
+
+- (void)_handleData:(const SRHTTP2FrameHeader *)header payload:(const uint8_t *)payload
+{
+    // Acknowledge on the connection right away, only the stream's window limits buffering.
+    if (header->length > 0) {
+        SRHTTP2WriteWindowUpdate(&_outputIO, 0, header->length);
+    }
+
+    SRHTTP2Stream *stream = _streams[@(header->streamID)];
+    if (!stream) {
+        // Frames for streams that were already closed on our side may still be in flight.
+        if (header->streamID == 0 || header->streamID >= _nextStreamID) {
+            [self _failWithErrorCode:SRHTTP2ErrorCodeProtocolError description:@"Received HTTP/2 DATA for an idle stream."];
+        }
+        return;
+    }
+    if (stream.completion || stream.remoteEnded) {
+        [self _resetStream:stream errorCode:SRHTTP2ErrorCodeStreamClosed];
+        return;
+    }
+
+    stream.receiveWindow -= header->length;
+    if (stream.receiveWindow < 0) {
+        [self _resetStream:stream errorCode:SRHTTP2ErrorCodeFlowControlError];
+        return;
+    }
+
+    const uint8_t *data = NULL;
+    size_t dataLength = 0;
+    if (SRHTTP2FramePayloadStrip(header, payload, &data, &dataLength) != SRFrameResultOK) {
+        [self _failWithErrorCode:SRHTTP2ErrorCodeProtocolError description:@"Received malformed HTTP/2 DATA."];
+        return;
+    }
+    [stream.pendingInbound appendBytes:data length:dataLength];
+    // Padding is never delivered, so it's acknowledged along with the next delivered bytes.
+    stream.unacknowledgedBytes += (uint32_t)(header->length - dataLength);
+    if (header->flags & SRHTTP2FlagEndStream) {
+        stream.remoteEnded = YES;
+    }
+    [self _flushInboundForStream:stream];
+}
+
+- (void)_handleGoAway:(const SRHTTP2FrameHeader *)header payload:(const uint8_t *)payload
+{
+    if (header->length < 8) {
+        [self _failWithErrorCode:SRHTTP2ErrorCodeFrameSizeError description:@"Received malformed HTTP/2 GOAWAY."];
+        return;
+    }
+    atomic_store(&_reusable, false);
+
+    // Streams above the last processed one were never seen by the server.
+    uint32_t lastStreamID = SRHTTP2ReadUInt31(payload);
+    for (SRHTTP2Stream *stream in _streams.allValues) {
+        if (stream.streamID > lastStreamID) {
+            [self _closeStream:stream error:SRHTTP2Error(@"HTTP/2 connection is going away.")];
+        }
+    }
+    for (SRHTTP2Stream *stream in [_pendingStreams copy]) {
+        [self _closeStream:stream error:SRHTTP2Error(@"HTTP/2 connection is going away.")];
+    }
+    [_pendingStreams removeAllObjects];
+
+    if (_streams.count == 0) {
+        [self _closeWithError:nil unsupported:NO];
+    }
+}
+
+///--------------------------------------
+#pragma mark - NSStreamDelegate
+///--------------------------------------
+
+- (void)stream:(NSStream *)aStream handleEvent:(NSStreamEvent)eventCode
+{
+    __weak typeof(self) wself = self;
+    dispatch_async(_workQueue, ^{
+        [wself _handleEvent:eventCode stream:aStream];
+    });
+}
+
+- (void)_handleEvent:(NSStreamEvent)eventCode stream:(NSStream *)aStream
+{
+    if (aStream == _inputStream || aStream == _outputStream) {
+        switch (eventCode) {
+            case NSStreamEventHasBytesAvailable:
+                [self _readFromInputStream];
+                break;
+            case NSStreamEventHasSpaceAvailable:
+                [self _pumpWriting];
+                break;
+            case NSStreamEventErrorOccurred:
+                [self _closeWithError:aStream.streamError unsupported:NO];
+                break;
+            case NSStreamEventEndEncountered:
+                [self _readFromInputStream];
+                [self _closeWithError:nil unsupported:(_state == SRHTTP2ConnectionStateConnecting)];
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+
+    SRHTTP2Stream *stream = [self _streamForStream:aStream];
+    if (!stream) {
+        return;
+    }
+    switch (eventCode) {
+        case NSStreamEventHasSpaceAvailable:
+            [self _flushInboundForStream:stream];
+            break;
+        case NSStreamEventHasBytesAvailable:
+            [self _pumpOutboundForStream:stream];
+            break;
+        case NSStreamEventEndEncountered:
+            stream.drainEnded = YES;
+            [self _pumpOutboundForStream:stream];
+            break;
+        case NSStreamEventErrorOccurred:
+            [self _resetStream:stream errorCode:SRHTTP2ErrorCodeCancel];
+            break;
+        default:
+            break;
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
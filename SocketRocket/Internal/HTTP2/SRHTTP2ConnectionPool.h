@@ -0,0 +1,34 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "SRHTTP2Connection.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Process-wide set of HTTP/2 connections, one per origin, shared by all sockets that allow HTTP/2.
+
+ Origins that turned out to not support WebSockets over HTTP/2 are remembered until the network configuration changes,
+ and all further opens for them fall back to HTTP/1.1 right away, as do `wss://` URLs,
+ since TLS streams provide no way to negotiate `h2` with ALPN.
+ This class is thread-safe.
+ */
+@interface SRHTTP2ConnectionPool : NSObject
+
++ (instancetype)sharedPool;
+
+- (void)openStreamWithURL:(NSURL *)url
+                  headers:(NSArray<NSArray<NSString *> *> *)headers
+               completion:(SRHTTP2StreamOpenCompletion)completion;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRHTTP2ConnectionPool.h"
+
+#import <notify.h>
+#import <notify_keys.h>
+#import <os/lock.h>
+
+#import "SRLog.h"
+#import "SRURLUtilities.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation SRHTTP2ConnectionPool
+{
+    os_unfair_lock _lock;
+
+    NSMutableDictionary<NSString *, SRHTTP2Connection *> *_connections;
+    NSMutableSet<NSString *> *_unsupportedOrigins;
+
+    int _networkChangeToken;
+}
+
+///--------------------------------------
+#pragma mark - Init
+///--------------------------------------
+
++ (instancetype)sharedPool
+{
+    static SRHTTP2ConnectionPool *pool;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pool = [[self alloc] init];
+    });
+    return pool;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (!self) return self;
+
+    _lock = OS_UNFAIR_LOCK_INIT;
+    _connections = [NSMutableDictionary dictionary];
+    _unsupportedOrigins = [NSMutableSet set];
+
+    // A different network might route to a different server, give unsupported origins another chance.
+    __weak typeof(self) wself = self;
+    _networkChangeToken = NOTIFY_TOKEN_INVALID;
+    notify_register_dispatch(kNotifySCNetworkChange,
+                             &_networkChangeToken,
+                             dispatch_get_global_queue(QOS_CLASS_UTILITY, 0),
+                             ^(int token) {
+                                 [wself _forgetUnsupportedOrigins];
+                             });
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_networkChangeToken != NOTIFY_TOKEN_INVALID) {
+        notify_cancel(_networkChangeToken);
+    }
+}
+
+///--------------------------------------
+#pragma mark - Streams
+///--------------------------------------
+
+static NSString *SRHTTP2ConnectionPoolKey(NSURL *url)
+{
+    return [NSString stringWithFormat:@"%@:%@", url.host.lowercaseString, url.port ?: @80];
+}
+
+- (void)openStreamWithURL:(NSURL *)url
+                  headers:(NSArray<NSArray<NSString *> *> *)headers
+               completion:(SRHTTP2StreamOpenCompletion)completion
+{
+    if (SRURLRequiresSSL(url) || !url.host) {
+        completion(nil, nil, nil, nil);
+        return;
+    }
+
+    NSString *key = SRHTTP2ConnectionPoolKey(url);
+
+    os_unfair_lock_lock(&_lock);
+    if ([_unsupportedOrigins containsObject:key]) {
+        os_unfair_lock_unlock(&_lock);
+        completion(nil, nil, nil, nil);
+        return;
+    }
+    SRHTTP2Connection *connection = _connections[key];
+    if (!connection.reusable) {
+        connection = [[SRHTTP2Connection alloc] initWithURL:url];
+        _connections[key] = connection;
+    }
+    os_unfair_lock_unlock(&_lock);
+
+    __weak typeof(self) wself = self;
+    [connection openStreamWithHeaders:headers completion:^(NSInputStream *_Nullable inputStream,
+                                                           NSOutputStream *_Nullable outputStream,
+                                                           NSDictionary<NSString *, NSString *> *_Nullable responseHeaders,
+                                                           NSError *_Nullable error) {
+        if (!inputStream && !responseHeaders && !error) {
+            [wself _markOriginUnsupported:key connection:connection];
+        }
+        completion(inputStream, outputStream, responseHeaders, error);
+    }];
+}
+
+///--------------------------------------
+#pragma mark - Unsupported Origins
+///--------------------------------------
+
+- (void)_markOriginUnsupported:(NSString *)key connection:(SRHTTP2Connection *)connection
+{
+    SRDebugLog(@"%@ doesn't support WebSockets over HTTP/2, falling back to HTTP/1.1.", key);
+
+    os_unfair_lock_lock(&_lock);
+    [_unsupportedOrigins addObject:key];
+    if (_connections[key] == connection) {
+        [_connections removeObjectForKey:key];
+    }
+    os_unfair_lock_unlock(&_lock);
+}
+
+- (void)_forgetUnsupportedOrigins
+{
+    os_unfair_lock_lock(&_lock);
+    [_unsupportedOrigins removeAllObjects];
+    os_unfair_lock_unlock(&_lock);
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -61,4 +61,9 @@
     }
 }
 
+- (void)removeAllConsumers
+{
+    [_bufferedConsumers removeAllObjects];
+}
+
 @end
@@ -0,0 +1,130 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+#import <SocketRocket/SRPreparedMessage.h>
+#import <SocketRocket/SRSendHandle.h>
+#import <SocketRocket/SRWebSocket.h>
+
+#import "SRConstants.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Outgoing lanes, in the order they are drained. Control frames always use `SROutgoingLaneControl`,
+ data messages use one of the lanes mapped from `SRSendPriority`.
+ */
+typedef NS_ENUM(NSUInteger, SROutgoingLane) {
+    SROutgoingLaneControl = 0,
+    SROutgoingLaneHigh,
+    SROutgoingLaneDefault,
+    SROutgoingLaneLow,
+};
+
+static NSUInteger const SROutgoingLaneCount = SROutgoingLaneLow + 1;
+
+extern SROutgoingLane SROutgoingLaneFromSendPriority(SRSendPriority priority);
+
+@interface SROutgoingMessage : NSObject
+
+@property (nonatomic, assign, readonly) SROpCode opcode;
+@property (nonatomic, strong, readonly) NSData *data;
+@property (nonatomic, assign, readonly) SROutgoingLane lane;
+@property (nullable, nonatomic, strong, readonly) SRSendHandle *sendHandle;
+
+// Key of a data message that is replaced by newer messages with the same key while it is still waiting to be sent.
+@property (nullable, nonatomic, copy, readonly) NSString *conflationKey;
+
+// Message sent with `sendPreparedMessage:`, whose frame is laid out in advance, if it is sent in a single frame.
+@property (nullable, nonatomic, strong) SRPreparedMessage *preparedMessage;
+
+// Number of payload bytes that were already framed and handed to the output buffer.
+@property (nonatomic, assign) size_t framedLength;
+
+- (instancetype)initWithOpcode:(SROpCode)opcode data:(NSData *)data lane:(SROutgoingLane)lane;
+- (instancetype)initWithOpcode:(SROpCode)opcode
+                          data:(NSData *)data
+                          lane:(SROutgoingLane)lane
+                    sendHandle:(nullable SRSendHandle *)sendHandle;
+- (instancetype)initWithOpcode:(SROpCode)opcode
+                          data:(NSData *)data
+                          lane:(SROutgoingLane)lane
+                    sendHandle:(nullable SRSendHandle *)sendHandle
+                 conflationKey:(nullable NSString *)conflationKey NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+/**
+ Queue of messages waiting to be framed, split into priority lanes.
+
+ Control frames (except close) always go first and may be interleaved between fragments of a data message.
+ Data messages are never interleaved with each other, as required by RFC 6455, so a message that started
+ transmitting is always finished before the next data message is picked from the highest non-empty lane.
+ A close frame is sent only after all data messages that were queued before it.
+
+ A message with a conflation key takes the place of a message with the same key that did not start transmitting yet,
+ instead of being appended, so only the latest value per key is sent.
+
+ This class is not thread-safe, except for queue depth accessors, and is expected to always be used on the same queue.
+ */
+@interface SROutgoingMessageQueue : NSObject
+
+@property (nonatomic, assign, readonly, getter=isEmpty) BOOL empty;
+
+/**
+ Appends `message` to its lane, or replaces the payload of a pending message with the same conflation key in place.
+ */
+- (void)enqueueMessage:(SROutgoingMessage *)message;
+
+/**
+ Returns the message that the next frame should be produced from or `nil` if there is nothing to send.
+ */
+- (nullable SROutgoingMessage *)nextMessage;
+
+/**
+ Records that `length` bytes of the payload of `message` were framed. Removes the message when fully framed.
+ */
+- (void)message:(SROutgoingMessage *)message didFrameLength:(size_t)length;
+
+/**
+ Removes the message that `sendHandle` belongs to, if none of its frames were produced yet.
+
+ @return The removed message or `nil`.
+ */
+- (nullable SROutgoingMessage *)removeMessageWithSendHandle:(SRSendHandle *)sendHandle;
+
+/**
+ Removes all messages. Messages with a conflation key that were not fully framed are counted as dropped.
+
+ @return Removed messages that have a send handle.
+ */
+- (NSArray<SROutgoingMessage *> *)removeAllMessages;
+
+///--------------------------------------
+#pragma mark - Queue Depth
+///--------------------------------------
+
+- (NSUInteger)messageCountInLane:(SROutgoingLane)lane;
+- (NSUInteger)byteCountInLane:(SROutgoingLane)lane;
+
+///--------------------------------------
+#pragma mark - Conflation
+///--------------------------------------
+
+// Number of pending messages that were replaced by a newer message with the same conflation key.
+@property (atomic, assign, readonly) uint64_t conflatedMessageCount;
+// Number of messages with a conflation key that were removed before they were fully framed.
+@property (atomic, assign, readonly) uint64_t droppedMessageCount;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,276 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SROutgoingMessageQueue.h"
+
+#import <stdatomic.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+SROutgoingLane SROutgoingLaneFromSendPriority(SRSendPriority priority)
+{
+    switch (priority) {
+        case SRSendPriorityHigh:
+            return SROutgoingLaneHigh;
+        case SRSendPriorityDefault:
+            return SROutgoingLaneDefault;
+        case SRSendPriorityLow:
+            return SROutgoingLaneLow;
+    }
+    return SROutgoingLaneDefault;
+}
+
+@interface SROutgoingMessage ()
+
+@property (nonatomic, assign, readwrite) SROpCode opcode;
+@property (nonatomic, strong, readwrite) NSData *data;
+
+@end
+
+@implementation SROutgoingMessage
+
+- (instancetype)initWithOpcode:(SROpCode)opcode data:(NSData *)data lane:(SROutgoingLane)lane
+{
+    return [self initWithOpcode:opcode data:data lane:lane sendHandle:nil];
+}
+
+- (instancetype)initWithOpcode:(SROpCode)opcode
+                          data:(NSData *)data
+                          lane:(SROutgoingLane)lane
+                    sendHandle:(nullable SRSendHandle *)sendHandle
+{
+    return [self initWithOpcode:opcode data:data lane:lane sendHandle:sendHandle conflationKey:nil];
+}
+
+- (instancetype)initWithOpcode:(SROpCode)opcode
+                          data:(NSData *)data
+                          lane:(SROutgoingLane)lane
+                    sendHandle:(nullable SRSendHandle *)sendHandle
+                 conflationKey:(nullable NSString *)conflationKey
+{
+    self = [super init];
+    if (!self) return self;
+
+    _opcode = opcode;
+    _data = data;
+    _lane = lane;
+    _sendHandle = sendHandle;
+    _conflationKey = [conflationKey copy];
+
+    return self;
+}
+
+@end
+
+@implementation SROutgoingMessageQueue
+{
+    NSMutableArray<SROutgoingMessage *> *_lanes[SROutgoingLaneCount];
+
+    // Data message that has some, but not all, of its fragments framed.
+    SROutgoingMessage *_Nullable _currentDataMessage;
+
+    _Atomic(NSUInteger) _messageCounts[SROutgoingLaneCount];
+    _Atomic(NSUInteger) _byteCounts[SROutgoingLaneCount];
+
+    // Messages with a conflation key that did not start transmitting yet, by key.
+    NSMutableDictionary<NSString *, SROutgoingMessage *> *_pendingConflatedMessages;
+
+    _Atomic(uint64_t) _conflatedMessageCount;
+    _Atomic(uint64_t) _droppedMessageCount;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (!self) return self;
+
+    for (NSUInteger lane = 0; lane < SROutgoingLaneCount; lane++) {
+        _lanes[lane] = [NSMutableArray array];
+        atomic_init(&_messageCounts[lane], 0);
+        atomic_init(&_byteCounts[lane], 0);
+    }
+    _pendingConflatedMessages = [NSMutableDictionary dictionary];
+    atomic_init(&_conflatedMessageCount, 0);
+    atomic_init(&_droppedMessageCount, 0);
+
+    return self;
+}
+
+///--------------------------------------
+#pragma mark - Accessors
+///--------------------------------------
+
+- (BOOL)isEmpty
+{
+    for (NSUInteger lane = 0; lane < SROutgoingLaneCount; lane++) {
+        if (_lanes[lane].count) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+- (BOOL)_hasDataMessages
+{
+    for (NSUInteger lane = SROutgoingLaneControl + 1; lane < SROutgoingLaneCount; lane++) {
+        if (_lanes[lane].count) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+///--------------------------------------
+#pragma mark - Queue
+///--------------------------------------
+
+- (void)enqueueMessage:(SROutgoingMessage *)message
+{
+    NSString *conflationKey = message.conflationKey;
+    if (conflationKey) {
+        SROutgoingMessage *pendingMessage = _pendingConflatedMessages[conflationKey];
+        if (pendingMessage) {
+            // Keep the position and lane of the pending message, so a frequently updated key is not pushed behind other messages.
+            SROutgoingLane pendingLane = pendingMessage.lane;
+            atomic_fetch_sub_explicit(&_byteCounts[pendingLane], pendingMessage.data.length, memory_order_relaxed);
+            atomic_fetch_add_explicit(&_byteCounts[pendingLane], message.data.length, memory_order_relaxed);
+            pendingMessage.opcode = message.opcode;
+            pendingMessage.data = message.data;
+            atomic_fetch_add_explicit(&_conflatedMessageCount, 1, memory_order_relaxed);
+            return;
+        }
+        _pendingConflatedMessages[conflationKey] = message;
+    }
+
+    SROutgoingLane lane = message.lane;
+    [_lanes[lane] addObject:message];
+    atomic_fetch_add_explicit(&_messageCounts[lane], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_byteCounts[lane], message.data.length, memory_order_relaxed);
+}
+
+- (nullable SROutgoingMessage *)nextMessage
+{
+    SROutgoingMessage *controlMessage = _lanes[SROutgoingLaneControl].firstObject;
+    if (controlMessage) {
+        // Nothing can be sent after a close frame, so it waits for all data that was queued before it.
+        if (controlMessage.opcode != SROpCodeConnectionClose || ![self _hasDataMessages]) {
+            return controlMessage;
+        }
+    }
+
+    if (_currentDataMessage) {
+        return _currentDataMessage;
+    }
+
+    for (NSUInteger lane = SROutgoingLaneControl + 1; lane < SROutgoingLaneCount; lane++) {
+        SROutgoingMessage *message = _lanes[lane].firstObject;
+        if (message) {
+            _currentDataMessage = message;
+            // Once the first fragment is framed the payload can't change, so later messages with this key are appended.
+            if (message.conflationKey) {
+                [_pendingConflatedMessages removeObjectForKey:(NSString *_Nonnull)message.conflationKey];
+            }
+            return message;
+        }
+    }
+    return nil;
+}
+
+- (void)message:(SROutgoingMessage *)message didFrameLength:(size_t)length
+{
+    SROutgoingLane lane = message.lane;
+    assert(_lanes[lane].firstObject == message);
+
+    message.framedLength += length;
+    atomic_fetch_sub_explicit(&_byteCounts[lane], length, memory_order_relaxed);
+
+    if (message.framedLength >= message.data.length) {
+        [_lanes[lane] removeObjectAtIndex:0];
+        atomic_fetch_sub_explicit(&_messageCounts[lane], 1, memory_order_relaxed);
+        if (_currentDataMessage == message) {
+            _currentDataMessage = nil;
+        }
+    }
+}
+
+- (nullable SROutgoingMessage *)removeMessageWithSendHandle:(SRSendHandle *)sendHandle
+{
+    for (NSUInteger lane = 0; lane < SROutgoingLaneCount; lane++) {
+        NSMutableArray<SROutgoingMessage *> *messages = _lanes[lane];
+        NSUInteger index = [messages indexOfObjectPassingTest:^BOOL(SROutgoingMessage *message, NSUInteger idx, BOOL *stop) {
+            return (message.sendHandle == sendHandle);
+        }];
+        if (index == NSNotFound) {
+            continue;
+        }
+
+        SROutgoingMessage *message = messages[index];
+        if (message.framedLength > 0 || message == _currentDataMessage) {
+            return nil;
+        }
+        [messages removeObjectAtIndex:index];
+        atomic_fetch_sub_explicit(&_messageCounts[lane], 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&_byteCounts[lane], message.data.length, memory_order_relaxed);
+        return message;
+    }
+    return nil;
+}
+
+- (NSArray<SROutgoingMessage *> *)removeAllMessages
+{
+    NSMutableArray<SROutgoingMessage *> *removedMessages = [NSMutableArray array];
+    for (NSUInteger lane = 0; lane < SROutgoingLaneCount; lane++) {
+        for (SROutgoingMessage *message in _lanes[lane]) {
+            if (message.sendHandle) {
+                [removedMessages addObject:message];
+            }
+            if (message.conflationKey) {
+                atomic_fetch_add_explicit(&_droppedMessageCount, 1, memory_order_relaxed);
+            }
+        }
+        [_lanes[lane] removeAllObjects];
+        atomic_store_explicit(&_messageCounts[lane], 0, memory_order_relaxed);
+        atomic_store_explicit(&_byteCounts[lane], 0, memory_order_relaxed);
+    }
+    [_pendingConflatedMessages removeAllObjects];
+    _currentDataMessage = nil;
+    return removedMessages;
+}
+
+///--------------------------------------
+#pragma mark - Queue Depth
+///--------------------------------------
+
+- (NSUInteger)messageCountInLane:(SROutgoingLane)lane
+{
+    return atomic_load_explicit(&_messageCounts[lane], memory_order_relaxed);
+}
+
+- (NSUInteger)byteCountInLane:(SROutgoingLane)lane
+{
+    return atomic_load_explicit(&_byteCounts[lane], memory_order_relaxed);
+}
+
+///--------------------------------------
+#pragma mark - Conflation
+///--------------------------------------
+
+- (uint64_t)conflatedMessageCount
+{
+    return atomic_load_explicit(&_conflatedMessageCount, memory_order_relaxed);
+}
+
+- (uint64_t)droppedMessageCount
+{
+    return atomic_load_explicit(&_droppedMessageCount, memory_order_relaxed);
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,62 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef void(^SRProxyCachePACScriptCompletion)(NSString *_Nullable script);
+
+/**
+ Process-wide cache of system proxy settings, PAC scripts and per-host PAC evaluation results.
+
+ Entries expire after `timeToLive` and are dropped whenever the system reports a network configuration change.
+ This class is thread-safe.
+ */
+@interface SRProxyCache : NSObject
+
++ (instancetype)sharedCache;
+
+/**
+ Time interval after which all cached values are discarded. Default: 300 seconds.
+ */
+@property (atomic, assign) NSTimeInterval timeToLive;
+
+/**
+ Returns the result of `CFNetworkCopySystemProxySettings`, reusing the previous value if it has not expired.
+ */
+- (NSDictionary *)systemProxySettings;
+
+/**
+ Loads a PAC script from a `file://`, `http://` or `https://` URL, or returns the cached script for this URL.
+ The completion is called with `nil` if the script could not be loaded.
+ */
+- (void)fetchPACScriptFromURL:(NSURL *)PACURL completion:(SRProxyCachePACScriptCompletion)completion;
+
+/**
+ Evaluates a PAC script for a given URL, or returns the cached result for the same script and URL host.
+
+ @param url           An `http://` or `https://` URL to find the proxy for.
+ @param script        PAC script contents.
+ @param proxySettings System proxy settings, as returned by `systemProxySettings`.
+
+ @return The first proxy dictionary returned by the script or `nil` if there is none.
+ */
+- (nullable NSDictionary *)proxySettingsForURL:(NSURL *)url
+                                     PACScript:(NSString *)script
+                                 proxySettings:(NSDictionary *)proxySettings;
+
+/**
+ Discards all cached values.
+ */
+- (void)invalidate;
+
+@end
+
+NS_ASSUME_NONNULL_END
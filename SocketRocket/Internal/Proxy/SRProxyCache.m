@@ -0,0 +1,243 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRProxyCache.h"
+
+#import <notify.h>
+#import <notify_keys.h>
+#import <os/lock.h>
+
+#import "SRHash.h"
+#import "SRLog.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+static NSTimeInterval const SRProxyCacheDefaultTimeToLive = 300.0;
+
+// `-[NSString hash]` only looks at a few characters of long strings, so different scripts are told apart by a digest.
+static NSString *SRPACResultKey(NSString *script, NSURL *url)
+{
+    NSUInteger length = script.length;
+    NSMutableData *characters = [NSMutableData dataWithLength:length * sizeof(unichar)];
+    [script getCharacters:characters.mutableBytes range:NSMakeRange(0, length)];
+
+    NSData *scriptHash = SRSHA256HashFromBytes(characters.bytes, characters.length);
+    return [NSString stringWithFormat:@"%@|%@", SRBase64EncodedStringFromData(scriptHash), url.absoluteString];
+}
+
+@implementation SRProxyCache
+{
+    os_unfair_lock _lock;
+
+    NSTimeInterval _expirationTime;
+    NSDictionary *_Nullable _systemProxySettings;
+    NSMutableDictionary<NSURL *, NSString *> *_PACScripts;
+    NSMutableDictionary<NSString *, id> *_PACResults; // Value is `NSDictionary` or `NSNull` for no proxy.
+
+    int _networkChangeToken;
+}
+
+///--------------------------------------
+#pragma mark - Init
+///--------------------------------------
+
++ (instancetype)sharedCache
+{
+    static SRProxyCache *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [[self alloc] init];
+    });
+    return cache;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (!self) return self;
+
+    _lock = OS_UNFAIR_LOCK_INIT;
+    _timeToLive = SRProxyCacheDefaultTimeToLive;
+    _PACScripts = [NSMutableDictionary dictionary];
+    _PACResults = [NSMutableDictionary dictionary];
+
+    // Any change in network configuration (interface, Wi-Fi network, VPN, proxy settings) drops everything cached.
+    __weak typeof(self) wself = self;
+    _networkChangeToken = NOTIFY_TOKEN_INVALID;
+    notify_register_dispatch(kNotifySCNetworkChange,
+                             &_networkChangeToken,
+                             dispatch_get_global_queue(QOS_CLASS_UTILITY, 0),
+                             ^(int token) {
+                                 SRDebugLog(@"Network configuration changed, invalidating proxy cache.");
+                                 [wself invalidate];
+                             });
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_networkChangeToken != NOTIFY_TOKEN_INVALID) {
+        notify_cancel(_networkChangeToken);
+    }
+}
+
+///--------------------------------------
+#pragma mark - System Settings
+///--------------------------------------
+
+- (NSDictionary *)systemProxySettings
+{
+    os_unfair_lock_lock(&_lock);
+    [self _purgeIfExpired];
+    NSDictionary *settings = _systemProxySettings;
+    os_unfair_lock_unlock(&_lock);
+
+    if (settings) {
+        return settings;
+    }
+
+    settings = CFBridgingRelease(CFNetworkCopySystemProxySettings()) ?: @{};
+
+    os_unfair_lock_lock(&_lock);
+    _systemProxySettings = settings;
+    os_unfair_lock_unlock(&_lock);
+
+    return settings;
+}
+
+///--------------------------------------
+#pragma mark - PAC
+///--------------------------------------
+
+- (void)fetchPACScriptFromURL:(NSURL *)PACURL completion:(SRProxyCachePACScriptCompletion)completion
+{
+    os_unfair_lock_lock(&_lock);
+    [self _purgeIfExpired];
+    NSString *script = _PACScripts[PACURL];
+    os_unfair_lock_unlock(&_lock);
+
+    if (script) {
+        SRDebugLog(@"Using cached PAC script for %@", PACURL);
+        completion(script);
+        return;
+    }
+
+    if ([PACURL isFileURL]) {
+        script = [NSString stringWithContentsOfURL:PACURL usedEncoding:NULL error:NULL];
+        [self _setPACScript:script forURL:PACURL];
+        completion(script);
+        return;
+    }
+
+    NSString *scheme = [PACURL.scheme lowercaseString];
+    if (![scheme isEqualToString:@"http"] && ![scheme isEqualToString:@"https"]) {
+        // Don't know how to read data from this URL, we'll have to give up
+        completion(nil);
+        return;
+    }
+
+    NSURLRequest *request = [NSURLRequest requestWithURL:PACURL];
+    NSURLSession *session = [NSURLSession sharedSession];
+    [[session dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        NSString *fetchedScript = nil;
+        if (!error && data) {
+            fetchedScript = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+        }
+        [self _setPACScript:fetchedScript forURL:PACURL];
+        completion(fetchedScript);
+    }] resume];
+}
+
+- (nullable NSDictionary *)proxySettingsForURL:(NSURL *)url
+                                     PACScript:(NSString *)script
+                                 proxySettings:(NSDictionary *)proxySettings
+{
+    NSString *key = SRPACResultKey(script, url);
+
+    os_unfair_lock_lock(&_lock);
+    [self _purgeIfExpired];
+    id cachedResult = _PACResults[key];
+    os_unfair_lock_unlock(&_lock);
+
+    if (cachedResult) {
+        SRDebugLog(@"Using cached PAC result for %@", url);
+        return (cachedResult == [NSNull null] ? nil : cachedResult);
+    }
+
+    // From: http://developer.apple.com/samplecode/CFProxySupportTool/listing1.html
+    // Work around <rdar://problem/5530166>.  This dummy call to
+    // CFNetworkCopyProxiesForURL initialise some state within CFNetwork
+    // that is required by CFNetworkCopyProxiesForAutoConfigurationScript.
+    CFBridgingRelease(CFNetworkCopyProxiesForURL((__bridge CFURLRef)url, (__bridge CFDictionaryRef)proxySettings));
+
+    // Obtain the list of proxies by running the autoconfiguration script
+    CFErrorRef err = NULL;
+    NSArray *proxies = CFBridgingRelease(CFNetworkCopyProxiesForAutoConfigurationScript((__bridge CFStringRef)script, (__bridge CFURLRef)url, &err));
+
+    NSDictionary *settings = nil;
+    if (err) {
+        // Don't cache failures, the script might be evaluated successfully next time.
+        CFRelease(err);
+        return nil;
+    }
+    if (proxies.count > 0) {
+        settings = proxies.firstObject;
+    }
+
+    os_unfair_lock_lock(&_lock);
+    _PACResults[key] = settings ?: [NSNull null];
+    os_unfair_lock_unlock(&_lock);
+
+    return settings;
+}
+
+///--------------------------------------
+#pragma mark - Invalidation
+///--------------------------------------
+
+- (void)invalidate
+{
+    os_unfair_lock_lock(&_lock);
+    [self _purge];
+    os_unfair_lock_unlock(&_lock);
+}
+
+- (void)_setPACScript:(nullable NSString *)script forURL:(NSURL *)PACURL
+{
+    if (!script) {
+        return;
+    }
+    os_unfair_lock_lock(&_lock);
+    _PACScripts[PACURL] = script;
+    os_unfair_lock_unlock(&_lock);
+}
+
+// Must be called with `_lock` held.
+- (void)_purgeIfExpired
+{
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    if (now >= _expirationTime) {
+        [self _purge];
+        _expirationTime = now + self.timeToLive;
+    }
+}
+
+// Must be called with `_lock` held.
+- (void)_purge
+{
+    _systemProxySettings = nil;
+    [_PACScripts removeAllObjects];
+    [_PACResults removeAllObjects];
+    _expirationTime = 0;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -13,6 +13,7 @@
 #import "SRConstants.h"
 #import "SRError.h"
 #import "SRLog.h"
+#import "SRProxyCache.h"
 #import "SRURLUtilities.h"
 
 @interface SRProxyConnect() <NSStreamDelegate>
@@ -145,7 +146,7 @@
 - (void)_configureProxy
 {
     SRDebugLog(@"configureProxy");
-    NSDictionary *proxySettings = CFBridgingRelease(CFNetworkCopySystemProxySettings());
+    NSDictionary *proxySettings = [[SRProxyCache sharedCache] systemProxySettings];
 
     // CFNetworkCopyProxiesForURL doesn't understand ws:// or wss://
     NSURL *httpURL;
@@ -213,39 +214,16 @@
 {
     SRDebugLog(@"SRWebSocket fetchPAC:%@", PACurl);
 
-    if ([PACurl isFileURL]) {
-        NSError *error = nil;
-        NSString *script = [NSString stringWithContentsOfURL:PACurl
-                                                usedEncoding:NULL
-                                                       error:&error];
-
-        if (error) {
-            [self _openConnection];
-        } else {
-            [self _runPACScript:script withProxySettings:proxySettings];
-        }
-        return;
-    }
-
-    NSString *scheme = [PACurl.scheme lowercaseString];
-    if (![scheme isEqualToString:@"http"] && ![scheme isEqualToString:@"https"]) {
-        // Don't know how to read data from this URL, we'll have to give up
-        // We'll simply assume no proxies, and start the request as normal
-        [self _openConnection];
-        return;
-    }
     __weak typeof(self) wself = self;
-    NSURLRequest *request = [NSURLRequest requestWithURL:PACurl];
-    NSURLSession *session = [NSURLSession sharedSession];
-    [[session dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+    [[SRProxyCache sharedCache] fetchPACScriptFromURL:PACurl completion:^(NSString *_Nullable script) {
         __strong typeof(wself) sself = wself;
-        if (!error) {
-            NSString *script = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+        if (script) {
             [sself _runPACScript:script withProxySettings:proxySettings];
         } else {
+            // We'll simply assume no proxies, and start the request as normal
             [sself _openConnection];
         }
-    }] resume];
+    }];
 }
 
 - (void)_runPACScript:(NSString *)script withProxySettings:(NSDictionary *)proxySettings
@@ -255,14 +233,6 @@
         return;
     }
     SRDebugLog(@"runPACScript");
-    // From: http://developer.apple.com/samplecode/CFProxySupportTool/listing1.html
-    // Work around <rdar://problem/5530166>.  This dummy call to
-    // CFNetworkCopyProxiesForURL initialise some state within CFNetwork
-    // that is required by CFNetworkCopyProxiesForAutoConfigurationScript.
-    CFBridgingRelease(CFNetworkCopyProxiesForURL((__bridge CFURLRef)_url, (__bridge CFDictionaryRef)proxySettings));
-
-    // Obtain the list of proxies by running the autoconfiguration script
-    CFErrorRef err = NULL;
 
     // CFNetworkCopyProxiesForAutoConfigurationScript doesn't understand ws:// or wss://
     NSURL *httpURL;
@@ -271,9 +241,10 @@
     else
         httpURL = [NSURL URLWithString:[NSString stringWithFormat:@"http://%@", _url.host]];
 
-    NSArray *proxies = CFBridgingRelease(CFNetworkCopyProxiesForAutoConfigurationScript((__bridge CFStringRef)script,(__bridge CFURLRef)httpURL, &err));
-    if (!err && [proxies count] > 0) {
-        NSDictionary *settings = [proxies objectAtIndex:0];
+    NSDictionary *settings = [[SRProxyCache sharedCache] proxySettingsForURL:httpURL
+                                                                  PACScript:script
+                                                              proxySettings:proxySettings];
+    if (settings) {
         NSString *proxyType = settings[(NSString *)kCFProxyTypeKey];
         [self _readProxySettingWithType:proxyType settings:settings];
     }
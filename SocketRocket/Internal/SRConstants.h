@@ -9,16 +9,8 @@
 
 #import <Foundation/Foundation.h>
 
-typedef NS_ENUM(uint8_t, SROpCode)
-{
-    SROpCodeTextFrame = 0x1,
-    SROpCodeBinaryFrame = 0x2,
-    // 3-7 reserved.
-    SROpCodeConnectionClose = 0x8,
-    SROpCodePing = 0x9,
-    SROpCodePong = 0xA,
-    // B-F reserved.
-};
+// `SROpCode` is shared with the framing core.
+#import "SRFrame.h"
 
 /**
  Default buffer size that is used for reading/writing to streams.
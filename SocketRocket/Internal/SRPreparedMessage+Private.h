@@ -0,0 +1,28 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRPreparedMessage.h"
+
+#import "SRConstants.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface SRPreparedMessage ()
+
+@property (nonatomic, assign, readonly) SROpCode opcode;
+
+/**
+ Returns a single masked frame carrying the whole message, with a new random mask key, or `nil` if it can't be allocated.
+ Payloads of at least `threshold` bytes are masked on all cores, `0` always masks serially.
+ */
+- (nullable NSData *)maskedFrameDataWithConcurrentMaskingThreshold:(NSUInteger)threshold;
+
+@end
+
+NS_ASSUME_NONNULL_END
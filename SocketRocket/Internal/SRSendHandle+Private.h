@@ -0,0 +1,40 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRSendHandle.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface SRSendHandle ()
+
+// Number of bytes the socket has to write in total, before the last byte of this message is written.
+@property (nonatomic, assign) uint64_t outputEndOffset;
+
+/**
+ Initializes a handle. `cancelHandler` is called on an arbitrary thread after the message was cancelled.
+ */
+- (instancetype)initWithCompletion:(nullable SRSendCompletionHandler)completion
+                     cancelHandler:(void (^)(SRSendHandle *handle))cancelHandler NS_DESIGNATED_INITIALIZER;
+
+/**
+ Marks the message as started transmitting, after which it can't be cancelled.
+
+ @return `NO` if the message was cancelled.
+ */
+- (BOOL)beginTransmitting;
+
+/**
+ Marks the message as finished and returns the completion handler, which should be called with the result.
+ Returns `nil` if there is no completion handler or the message was already finished.
+ */
+- (nullable SRSendCompletionHandler)finish;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,24 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRUTF8String.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface SRUTF8String ()
+
+/**
+ Initializes a string with bytes that were already validated, without validating or copying them.
+ `data` must not be mutated afterwards.
+ */
+- (instancetype)initWithValidatedUTF8Data:(NSData *)data;
+
+@end
+
+NS_ASSUME_NONNULL_END
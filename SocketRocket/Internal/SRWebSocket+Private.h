@@ -0,0 +1,24 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <SocketRocket/SRWebSocket.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface SRWebSocket ()
+
+/**
+ Opens the socket over already opened streams instead of connecting to `url`, and uses a given `Sec-WebSocket-Key`.
+ Used to replay captures.
+ */
+- (void)_openWithInputStream:(NSInputStream *)inputStream outputStream:(NSOutputStream *)outputStream handshakeKey:(NSString *)handshakeKey;
+
+@end
+
+NS_ASSUME_NONNULL_END
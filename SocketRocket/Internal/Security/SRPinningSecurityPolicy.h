@@ -17,11 +17,36 @@ NS_ASSUME_NONNULL_BEGIN
  * NOTE: While publicly, SocketRocket does not support configuring the security policy with pinned certificates,
  * it is still possible to manually construct a security policy of this class. If you do this, note that you may
  * be open to MitM attacks, and we will not support any issues you may have. Dive at your own risk.
+ * Pinning to public keys is supported with `+[SRSecurityPolicy pinningPolicyWithPublicKeyHashes:]`.
  */
 @interface SRPinningSecurityPolicy : SRSecurityPolicy
 
+/**
+ Pins to exact certificates. Every pinned certificate must be present in the server certificate chain.
+
+ @param pinnedCertificates Array of `SecCertificateRef` certificates.
+ */
 - (instancetype)initWithCertificates:(NSArray *)pinnedCertificates;
 
+/**
+ Pins to public keys. The server is trusted if its certificate chain is valid for the domain,
+ and any certificate of the evaluated chain has a public key with a SHA-256 hash of DER-encoded
+ `SubjectPublicKeyInfo` that is present in the given set.
+
+ @param publicKeyHashes Array of 32 byte SHA-256 hashes of `SubjectPublicKeyInfo`.
+ */
+- (instancetype)initWithPublicKeyHashes:(NSArray<NSData *> *)publicKeyHashes;
+
 @end
 
+/**
+ Returns SHA-256 hash of the DER-encoded `SubjectPublicKeyInfo` of a given certificate or `nil` if it can't be parsed.
+ */
+extern NSData *_Nullable SRPublicKeyHashFromCertificate(SecCertificateRef certificate);
+
+/**
+ Returns SHA-256 hash of the `SubjectPublicKeyInfo` of a DER-encoded certificate or `nil` if it can't be parsed.
+ */
+extern NSData *_Nullable SRPublicKeyHashFromCertificateData(NSData *certificateData);
+
 NS_ASSUME_NONNULL_END
@@ -10,62 +10,268 @@
 #import "SRPinningSecurityPolicy.h"
 
 #import <Foundation/Foundation.h>
+#import <os/lock.h>
 
+#import "SRHash.h"
 #import "SRLog.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
+// Number of validated leaf certificates to remember before the cache is reset.
+static NSUInteger const SRPinningSecurityPolicyValidatedLeafCacheLimit = 16;
+
+static NSData *SRCertificateHash(SecCertificateRef certificate)
+{
+    NSData *data = CFBridgingRelease(SecCertificateCopyData(certificate));
+    return SRSHA256HashFromBytes(data.bytes, data.length);
+}
+
+// Evaluates `serverTrust` as an SSL server for `domain` and returns certificates of the evaluated chain,
+// from the leaf to the anchor, or `nil` if the server is not trusted.
+static NSArray *_Nullable SRCopyEvaluatedCertificateChain(SecTrustRef serverTrust, NSString *domain)
+{
+    SecPolicyRef policy = SecPolicyCreateSSL(true, (__bridge CFStringRef)domain);
+    OSStatus status = SecTrustSetPolicies(serverTrust, policy);
+    CFRelease(policy);
+    if (status != errSecSuccess) {
+        return nil;
+    }
+
+    BOOL trusted = NO;
+    if (@available(iOS 12.0, macOS 10.14, tvOS 12.0, *)) {
+        trusted = SecTrustEvaluateWithError(serverTrust, NULL);
+    } else {
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+        SecTrustResultType result = kSecTrustResultInvalid;
+        trusted = (SecTrustEvaluate(serverTrust, &result) == errSecSuccess &&
+                   (result == kSecTrustResultUnspecified || result == kSecTrustResultProceed));
+#pragma clang diagnostic pop
+    }
+    if (!trusted) {
+        return nil;
+    }
+
+    if (@available(iOS 15.0, macOS 12.0, tvOS 15.0, *)) {
+        return CFBridgingRelease(SecTrustCopyCertificateChain(serverTrust));
+    }
+    // Once evaluated, certificates of a trust are the ones of the evaluated chain.
+    CFIndex count = SecTrustGetCertificateCount(serverTrust);
+    NSMutableArray *chain = [NSMutableArray arrayWithCapacity:(NSUInteger)count];
+    for (CFIndex i = 0; i < count; i++) {
+        [chain addObject:(__bridge id)SecTrustGetCertificateAtIndex(serverTrust, i)];
+    }
+    return chain;
+}
+
 @interface SRPinningSecurityPolicy ()
 
-@property (nonatomic, copy, readonly) NSArray *pinnedCertificates;
+// SHA-256 of DER for every pinned certificate, when pinning to certificates.
+@property (nullable, nonatomic, copy, readonly) NSSet<NSData *> *pinnedCertificateHashes;
+// SHA-256 of SubjectPublicKeyInfo, when pinning to public keys.
+@property (nullable, nonatomic, copy, readonly) NSSet<NSData *> *pinnedPublicKeyHashes;
 
 @end
 
 @implementation SRPinningSecurityPolicy
+{
+    os_unfair_lock _validatedLeafLock;
+    NSMutableSet<NSString *> *_validatedLeafKeys; // Leaf certificate hash and domain it was validated for.
+}
 
-- (instancetype)initWithCertificates:(NSArray *)pinnedCertificates
+- (instancetype)_initPinningWithCertificateChainValidationEnabled:(BOOL)enabled
 {
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated"
-    // Do not validate certificate chain since we're pinning to specific certificates.
-    self = [super initWithCertificateChainValidationEnabled:NO];
+    self = [super initWithCertificateChainValidationEnabled:enabled];
 #pragma clang diagnostic pop
 
     if (!self) { return self; }
 
+    _validatedLeafLock = OS_UNFAIR_LOCK_INIT;
+    _validatedLeafKeys = [NSMutableSet set];
+
+    return self;
+}
+
+- (instancetype)initWithCertificates:(NSArray *)pinnedCertificates
+{
+    // Do not validate certificate chain since we're pinning to specific certificates.
+    self = [self _initPinningWithCertificateChainValidationEnabled:NO];
+    if (!self) { return self; }
+
     if (pinnedCertificates.count == 0) {
         @throw [NSException exceptionWithName:@"Creating security policy failed."
                                        reason:@"Must specify at least one certificate when creating a pinning policy."
                                      userInfo:nil];
     }
-    _pinnedCertificates = [pinnedCertificates copy];
+
+    NSMutableSet<NSData *> *hashes = [NSMutableSet setWithCapacity:pinnedCertificates.count];
+    for (id ref in pinnedCertificates) {
+        [hashes addObject:SRCertificateHash((__bridge SecCertificateRef)ref)];
+    }
+    _pinnedCertificateHashes = hashes;
 
     return self;
 }
 
-- (BOOL)evaluateServerTrust:(SecTrustRef)serverTrust forDomain:(NSString *)domain
+- (instancetype)initWithPublicKeyHashes:(NSArray<NSData *> *)publicKeyHashes
 {
-    SRDebugLog(@"Pinned cert count: %d", self.pinnedCertificates.count);
-    NSUInteger requiredCertCount = self.pinnedCertificates.count;
+    // Keys are pinned on top of the regular validation, so a presented certificate can't borrow a pinned key.
+    self = [self _initPinningWithCertificateChainValidationEnabled:YES];
+    if (!self) { return self; }
 
-    NSUInteger validatedCertCount = 0;
+    if (publicKeyHashes.count == 0) {
+        @throw [NSException exceptionWithName:@"Creating security policy failed."
+                                       reason:@"Must specify at least one public key hash when creating a pinning policy."
+                                     userInfo:nil];
+    }
+    _pinnedPublicKeyHashes = [NSSet setWithArray:publicKeyHashes];
+
+    return self;
+}
+
+- (BOOL)evaluateServerTrust:(SecTrustRef)serverTrust forDomain:(NSString *)domain
+{
     CFIndex serverCertCount = SecTrustGetCertificateCount(serverTrust);
-    for (CFIndex i = 0; i < serverCertCount; i++) {
-        SecCertificateRef cert = SecTrustGetCertificateAtIndex(serverTrust, i);
-        NSData *data = CFBridgingRelease(SecCertificateCopyData(cert));
-        for (id ref in self.pinnedCertificates) {
-            SecCertificateRef trustedCert = (__bridge SecCertificateRef)ref;
-            // TODO: (nlutsenko) Add caching, so we don't copy the data for every pinned cert all the time.
-            NSData *trustedCertData = CFBridgingRelease(SecCertificateCopyData(trustedCert));
-            if ([trustedCertData isEqualToData:data]) {
-                validatedCertCount++;
+    if (serverCertCount == 0) {
+        return NO;
+    }
+
+    // Leaf certificate is hashed once and reused for both lookups.
+    NSData *leafHash = SRCertificateHash(SecTrustGetCertificateAtIndex(serverTrust, 0));
+    NSString *leafKey = [NSString stringWithFormat:@"%@|%@", SRBase64EncodedStringFromData(leafHash), domain];
+
+    os_unfair_lock_lock(&_validatedLeafLock);
+    BOOL leafValidated = [_validatedLeafKeys containsObject:leafKey];
+    os_unfair_lock_unlock(&_validatedLeafLock);
+    if (leafValidated) {
+        SRDebugLog(@"Leaf certificate was already validated.");
+        return YES;
+    }
+
+    BOOL trusted = NO;
+    if (self.pinnedPublicKeyHashes) {
+        // Only certificates that the leaf actually chains to count, not any certificate the server presented.
+        NSArray *chain = SRCopyEvaluatedCertificateChain(serverTrust, domain);
+        for (id certificate in chain) {
+            NSData *publicKeyHash = SRPublicKeyHashFromCertificate((__bridge SecCertificateRef)certificate);
+            if (publicKeyHash && [self.pinnedPublicKeyHashes containsObject:publicKeyHash]) {
+                trusted = YES;
                 break;
             }
         }
+    } else {
+        SRDebugLog(@"Pinned cert count: %lu", (unsigned long)self.pinnedCertificateHashes.count);
+        NSUInteger requiredCertCount = self.pinnedCertificateHashes.count;
+
+        NSUInteger validatedCertCount = 0;
+        for (CFIndex i = 0; i < serverCertCount; i++) {
+            NSData *certificateHash = (i == 0 ? leafHash : SRCertificateHash(SecTrustGetCertificateAtIndex(serverTrust, i)));
+            if ([self.pinnedCertificateHashes containsObject:certificateHash]) {
+                validatedCertCount++;
+            }
+        }
+        trusted = (requiredCertCount == validatedCertCount);
     }
-    return (requiredCertCount == validatedCertCount);
+
+    // Remembered only once every check passed, so later connections with the same leaf skip no check that could fail.
+    if (trusted) {
+        os_unfair_lock_lock(&_validatedLeafLock);
+        if (_validatedLeafKeys.count >= SRPinningSecurityPolicyValidatedLeafCacheLimit) {
+            [_validatedLeafKeys removeAllObjects];
+        }
+        [_validatedLeafKeys addObject:leafKey];
+        os_unfair_lock_unlock(&_validatedLeafLock);
+    }
+    return trusted;
 }
 
 @end
 
+///--------------------------------------
+#pragma mark - SubjectPublicKeyInfo
+///--------------------------------------
+
+// Reads a DER element header at `*offset`, advancing `*offset` to the element content.
+static BOOL SRDERReadHeader(const uint8_t *bytes, size_t length, size_t *offset, uint8_t *tag, size_t *contentLength)
+{
+    size_t position = *offset;
+    if (position + 2 > length) {
+        return NO;
+    }
+    *tag = bytes[position++];
+
+    size_t elementLength = bytes[position++];
+    if (elementLength & 0x80) {
+        size_t lengthBytes = elementLength & 0x7F;
+        if (lengthBytes == 0 || lengthBytes > sizeof(uint32_t) || position + lengthBytes > length) {
+            return NO;
+        }
+        elementLength = 0;
+        for (size_t i = 0; i < lengthBytes; i++) {
+            elementLength = (elementLength << 8) | bytes[position++];
+        }
+    }
+    if (elementLength > length - position) {
+        return NO;
+    }
+    *offset = position;
+    *contentLength = elementLength;
+    return YES;
+}
+
+static NSRange SRSubjectPublicKeyInfoRange(const uint8_t *bytes, size_t length)
+{
+    static uint8_t const SRDERSequenceTag = 0x30;
+    static uint8_t const SRDERVersionTag = 0xA0;
+    NSRange notFound = NSMakeRange(NSNotFound, 0);
+
+    uint8_t tag = 0;
+    size_t contentLength = 0;
+    size_t offset = 0;
+
+    // Certificate ::= SEQUENCE { tbsCertificate, ... }
+    if (!SRDERReadHeader(bytes, length, &offset, &tag, &contentLength) || tag != SRDERSequenceTag) {
+        return notFound;
+    }
+    // TBSCertificate ::= SEQUENCE { [0] version OPTIONAL, serialNumber, signature, issuer, validity, subject, subjectPublicKeyInfo, ... }
+    if (!SRDERReadHeader(bytes, length, &offset, &tag, &contentLength) || tag != SRDERSequenceTag) {
+        return notFound;
+    }
+
+    NSUInteger elementsToSkip = 5;
+    while (YES) {
+        size_t elementStart = offset;
+        if (!SRDERReadHeader(bytes, length, &offset, &tag, &contentLength)) {
+            return notFound;
+        }
+        if (elementsToSkip == 0) {
+            if (tag != SRDERSequenceTag) {
+                return notFound;
+            }
+            return NSMakeRange(elementStart, offset + contentLength - elementStart);
+        }
+        if (tag != SRDERVersionTag) {
+            elementsToSkip--;
+        }
+        offset += contentLength;
+    }
+}
+
+NSData *_Nullable SRPublicKeyHashFromCertificate(SecCertificateRef certificate)
+{
+    NSData *data = CFBridgingRelease(SecCertificateCopyData(certificate));
+    return SRPublicKeyHashFromCertificateData(data);
+}
+
+NSData *_Nullable SRPublicKeyHashFromCertificateData(NSData *data)
+{
+    NSRange range = SRSubjectPublicKeyInfoRange(data.bytes, data.length);
+    if (range.location == NSNotFound) {
+        return nil;
+    }
+    return SRSHA256HashFromBytes((const uint8_t *)data.bytes + range.location, range.length);
+}
+
 NS_ASSUME_NONNULL_END
@@ -0,0 +1,31 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+#import <SocketRocket/SRTransport.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Transport over a pair of streams, like the TCP streams from `SRProxyConnect` or the bound pairs of an HTTP/2 stream.
+ Events are reported on the run loops the streams are scheduled in.
+ */
+@interface SRStreamTransport : NSObject <SRTransport>
+
+@property (nonatomic, strong, readonly) NSInputStream *inputStream;
+@property (nonatomic, strong, readonly) NSOutputStream *outputStream;
+
+- (instancetype)initWithInputStream:(NSInputStream *)inputStream outputStream:(NSOutputStream *)outputStream NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRStreamTransport.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface SRStreamTransport () <NSStreamDelegate>
+
+@property (nullable, atomic, strong, readwrite) NSError *error;
+
+@end
+
+@implementation SRStreamTransport
+
+@synthesize delegate = _delegate;
+
+- (instancetype)initWithInputStream:(NSInputStream *)inputStream outputStream:(NSOutputStream *)outputStream
+{
+    self = [super init];
+    if (!self) return self;
+
+    _inputStream = inputStream;
+    _outputStream = outputStream;
+    _inputStream.delegate = self;
+    _outputStream.delegate = self;
+
+    return self;
+}
+
+///--------------------------------------
+#pragma mark - SRTransport
+///--------------------------------------
+
+- (BOOL)isOpen
+{
+    NSStreamStatus status = _inputStream.streamStatus;
+    return (status != NSStreamStatusNotOpen && status != NSStreamStatusClosed);
+}
+
+- (BOOL)hasBytesAvailable
+{
+    return _inputStream.hasBytesAvailable;
+}
+
+- (BOOL)hasSpaceAvailable
+{
+    return _outputStream.hasSpaceAvailable;
+}
+
+- (void)openTransport
+{
+    if (_inputStream.streamStatus != NSStreamStatusNotOpen) {
+        // Streams are usually handed over already connected, so their open event was delivered to someone else.
+        [self.delegate transport:self handleEvent:SRTransportEventOpenCompleted];
+        return;
+    }
+    [_outputStream open];
+    [_inputStream open];
+}
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)maxLength
+{
+    NSInteger result = [_inputStream read:buffer maxLength:maxLength];
+    if (result < 0) {
+        self.error = _inputStream.streamError;
+    }
+    return result;
+}
+
+- (NSInteger)write:(const uint8_t *)buffer maxLength:(NSUInteger)maxLength
+{
+    NSInteger result = [_outputStream write:buffer maxLength:maxLength];
+    if (result < 0) {
+        self.error = _outputStream.streamError;
+    }
+    return result;
+}
+
+- (void)close
+{
+    _inputStream.delegate = nil;
+    _outputStream.delegate = nil;
+    [_outputStream close];
+    [_inputStream close];
+}
+
+- (nullable SecTrustRef)peerTrust
+{
+    id trust = [_inputStream propertyForKey:(__bridge NSString *)kCFStreamPropertySSLPeerTrust] ?:
+        [_outputStream propertyForKey:(__bridge NSString *)kCFStreamPropertySSLPeerTrust];
+    return (__bridge SecTrustRef)trust;
+}
+
+- (void)scheduleInRunLoop:(NSRunLoop *)runLoop forMode:(NSRunLoopMode)mode
+{
+    [_outputStream scheduleInRunLoop:runLoop forMode:mode];
+    [_inputStream scheduleInRunLoop:runLoop forMode:mode];
+}
+
+- (void)removeFromRunLoop:(NSRunLoop *)runLoop forMode:(NSRunLoopMode)mode
+{
+    [_outputStream removeFromRunLoop:runLoop forMode:mode];
+    [_inputStream removeFromRunLoop:runLoop forMode:mode];
+}
+
+///--------------------------------------
+#pragma mark - NSStreamDelegate
+///--------------------------------------
+
+- (void)stream:(NSStream *)aStream handleEvent:(NSStreamEvent)eventCode
+{
+    id<SRTransportDelegate> delegate = self.delegate;
+    switch (eventCode) {
+        case NSStreamEventOpenCompleted:
+            // Both streams open together, the socket only cares about the connection.
+            if (aStream == _inputStream) {
+                [delegate transport:self handleEvent:SRTransportEventOpenCompleted];
+            }
+            break;
+        case NSStreamEventHasBytesAvailable:
+            [delegate transport:self handleEvent:SRTransportEventHasBytesAvailable];
+            break;
+        case NSStreamEventHasSpaceAvailable:
+            [delegate transport:self handleEvent:SRTransportEventHasSpaceAvailable];
+            break;
+        case NSStreamEventErrorOccurred:
+            self.error = aStream.streamError;
+            [delegate transport:self handleEvent:SRTransportEventErrorOccurred];
+            break;
+        case NSStreamEventEndEncountered:
+            if (aStream.streamError) {
+                self.error = aStream.streamError;
+            }
+            [delegate transport:self handleEvent:SRTransportEventEndEncountered];
+            break;
+        case NSStreamEventNone:
+            break;
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
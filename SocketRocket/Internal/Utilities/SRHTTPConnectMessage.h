@@ -18,4 +18,13 @@ extern CFHTTPMessageRef SRHTTPConnectMessageCreate(NSURLRequest *request,
                                                    NSArray<NSHTTPCookie *> *_Nullable cookies,
                                                    NSArray<NSString *> *_Nullable requestedProtocols);
 
+/**
+ Returns headers of an extended CONNECT request (RFC 8441) that opens a WebSocket over HTTP/2,
+ as ordered `[name, value]` pairs with lowercase names, pseudo-headers first.
+ */
+extern NSArray<NSArray<NSString *> *> *SRHTTP2ConnectHeaders(NSURLRequest *request,
+                                                             uint8_t webSocketProtocolVersion,
+                                                             NSArray<NSHTTPCookie *> *_Nullable cookies,
+                                                             NSArray<NSString *> *_Nullable requestedProtocols);
+
 NS_ASSUME_NONNULL_END
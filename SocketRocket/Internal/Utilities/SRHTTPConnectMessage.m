@@ -70,4 +70,64 @@ CFHTTPMessageRef SRHTTPConnectMessageCreate(NSURLRequest *request,
     return message;
 }
 
+NSArray<NSArray<NSString *> *> *SRHTTP2ConnectHeaders(NSURLRequest *request,
+                                                      uint8_t webSocketProtocolVersion,
+                                                      NSArray<NSHTTPCookie *> *_Nullable cookies,
+                                                      NSArray<NSString *> *_Nullable requestedProtocols)
+{
+    NSURL *url = request.URL;
+
+    NSString *path = url.path.length ? url.path : @"/";
+    if (url.query) {
+        path = [path stringByAppendingFormat:@"?%@", url.query];
+    }
+
+    NSMutableArray<NSArray<NSString *> *> *headers = [NSMutableArray array];
+    [headers addObject:@[ @":method", @"CONNECT" ]];
+    [headers addObject:@[ @":protocol", @"websocket" ]];
+    [headers addObject:@[ @":scheme", (SRURLRequiresSSL(url) ? @"https" : @"http") ]];
+    [headers addObject:@[ @":path", path ]];
+    [headers addObject:@[ @":authority", _SRHTTPConnectMessageHost(url) ]];
+
+    if (cookies) {
+        NSDictionary<NSString *, NSString *> *messageCookies = [NSHTTPCookie requestHeaderFieldsWithCookies:(NSArray<NSHTTPCookie*> *_Nonnull)cookies];
+        [messageCookies enumerateKeysAndObjectsUsingBlock:^(NSString * _Nonnull key, NSString * _Nonnull obj, BOOL * _Nonnull stop) {
+            if (key.length && obj.length) {
+                [headers addObject:@[ key.lowercaseString, obj ]];
+            }
+        }];
+    }
+
+    NSString *basicAuthorizationString = SRBasicAuthorizationHeaderFromURL(url);
+    if (basicAuthorizationString) {
+        [headers addObject:@[ @"authorization", basicAuthorizationString ]];
+    }
+
+    // There's no `Sec-WebSocket-Key` with HTTP/2, the stream itself proves that the server accepted the WebSocket.
+    [headers addObject:@[ @"sec-websocket-version", @(webSocketProtocolVersion).stringValue ]];
+    [headers addObject:@[ @"origin", SRURLOrigin(url) ]];
+
+    if (requestedProtocols.count) {
+        [headers addObject:@[ @"sec-websocket-protocol", [requestedProtocols componentsJoinedByString:@", "] ]];
+    }
+
+    // Connection-specific headers are not allowed in HTTP/2.
+    NSSet<NSString *> *connectionHeaders = [NSSet setWithObjects:@"connection", @"upgrade", @"host", @"keep-alive",
+                                            @"transfer-encoding", @"te", @"proxy-connection", nil];
+    [request.allHTTPHeaderFields enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *obj, BOOL *stop) {
+        NSString *name = key.lowercaseString;
+        if ([connectionHeaders containsObject:name]) {
+            return;
+        }
+        // Like with HTTP/1.1, headers of the request replace the default ones.
+        NSIndexSet *replacedIndexes = [headers indexesOfObjectsPassingTest:^BOOL(NSArray<NSString *> *header, NSUInteger idx, BOOL *stopTest) {
+            return [header[0] isEqualToString:name];
+        }];
+        [headers removeObjectsAtIndexes:replacedIndexes];
+        [headers addObject:@[ name, obj ]];
+    }];
+
+    return headers;
+}
+
 NS_ASSUME_NONNULL_END
@@ -9,11 +9,20 @@
 
 #import <Foundation/Foundation.h>
 
+#import "SRCoreCrypto.h"
+
 NS_ASSUME_NONNULL_BEGIN
 
 extern NSData *SRSHA1HashFromString(NSString *string);
 extern NSData *SRSHA1HashFromBytes(const char *bytes, size_t length);
 
+extern NSData *SRSHA256HashFromBytes(const void *bytes, size_t length);
+
 extern NSString *SRBase64EncodedStringFromData(NSData *data);
 
+/**
+ Crypto for the framing core backed by CommonCrypto and Security framework.
+ */
+extern const SRCoreCrypto SRSystemCrypto;
+
 NS_ASSUME_NONNULL_END
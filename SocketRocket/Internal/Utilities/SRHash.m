@@ -10,6 +10,7 @@
 #import "SRHash.h"
 
 #import <CommonCrypto/CommonDigest.h>
+#import <Security/SecRandom.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -32,6 +33,15 @@ NSData *SRSHA1HashFromBytes(const char *bytes, size_t length)
     return [NSData dataWithBytes:output length:outputLength];
 }
 
+NSData *SRSHA256HashFromBytes(const void *bytes, size_t length)
+{
+    uint8_t outputLength = CC_SHA256_DIGEST_LENGTH;
+    unsigned char output[outputLength];
+    CC_SHA256(bytes, (CC_LONG)length, output);
+
+    return [NSData dataWithBytes:output length:outputLength];
+}
+
 NSString *SRBase64EncodedStringFromData(NSData *data)
 {
     if ([data respondsToSelector:@selector(base64EncodedStringWithOptions:)]) {
@@ -44,4 +54,20 @@ NSString *SRBase64EncodedStringFromData(NSData *data)
 #pragma clang diagnostic pop
 }
 
+static void SRSystemCryptoSHA1(void *context, const uint8_t *bytes, size_t length, uint8_t digest[SRSHA1DigestLength])
+{
+    CC_SHA1(bytes, (CC_LONG)length, digest);
+}
+
+static bool SRSystemCryptoRandomBytes(void *context, uint8_t *bytes, size_t length)
+{
+    return (SecRandomCopyBytes(kSecRandomDefault, length, bytes) == errSecSuccess);
+}
+
+const SRCoreCrypto SRSystemCrypto = {
+    .sha1 = SRSystemCryptoSHA1,
+    .randomBytes = SRSystemCryptoRandomBytes,
+    .context = NULL,
+};
+
 NS_ASSUME_NONNULL_END
@@ -15,6 +15,12 @@ NS_ASSUME_NONNULL_BEGIN
 //#define SR_DEBUG_LOG_ENABLED
 
 extern void SRErrorLog(NSString *format, ...);
-extern void SRDebugLog(NSString *format, ...);
+
+// Debug logging compiles away entirely when disabled, including evaluation of the arguments.
+#ifdef SR_DEBUG_LOG_ENABLED
+#define SRDebugLog(format, ...) SRErrorLog(format, ##__VA_ARGS__)
+#else
+#define SRDebugLog(format, ...) do {} while (0)
+#endif
 
 NS_ASSUME_NONNULL_END
@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ An object that holds memory charged to `SRMemoryBudget`, usually a socket.
+ All methods are called on the budget's private queue and are expected to dispatch to the client's own queue.
+ */
+@protocol SRMemoryBudgetClient <NSObject>
+
+/**
+ Number of bytes the client currently holds. Must be thread-safe.
+ */
+- (NSUInteger)memoryBudgetChargedBytes;
+
+/**
+ Release memory that can be recreated on demand, like pooled objects and already consumed buffer regions.
+ */
+- (void)memoryBudgetTrimMemory;
+
+/**
+ Stop or resume reading data that can't be consumed immediately.
+ */
+- (void)memoryBudgetSetReadsPaused:(BOOL)paused;
+
+/**
+ Charged bytes dropped below the limit, after the client paused reading with `waitForAvailableBudget:`.
+ */
+- (void)memoryBudgetDidBecomeAvailable;
+
+@end
+
+/**
+ Process-wide memory budget shared by all sockets.
+
+ Clients report their usage with `chargeBytes:` and `releaseBytes:` and are expected to stop buffering more data
+ while the budget `isExhausted`. When the system reports memory pressure, all clients are asked to trim memory,
+ and on critical pressure the largest clients are asked to pause reads until the pressure returns to normal,
+ if `pausesReadsUnderMemoryPressure` is enabled.
+
+ This class is thread-safe.
+ */
+@interface SRMemoryBudget : NSObject
+
++ (instancetype)sharedBudget;
+
+/**
+ Maximum number of bytes all clients may hold together. `0` means there is no limit. Default: `0`.
+ */
+@property (atomic, assign) NSUInteger limit;
+
+/**
+ Whether the largest clients are paused on critical memory pressure. Default: `NO`.
+ */
+@property (atomic, assign) BOOL pausesReadsUnderMemoryPressure;
+
+/**
+ Number of bytes currently held by all clients.
+ */
+@property (nonatomic, assign, readonly) NSUInteger chargedBytes;
+
+/**
+ `YES` if there is a limit and it was reached.
+ */
+@property (nonatomic, assign, readonly, getter=isExhausted) BOOL exhausted;
+
+- (void)chargeBytes:(NSUInteger)bytes;
+- (void)releaseBytes:(NSUInteger)bytes;
+
+/**
+ Calls `memoryBudgetDidBecomeAvailable` on `client` once, as soon as the budget is not exhausted,
+ so a client that paused reading because of another client's usage resumes once that usage is released.
+ */
+- (void)waitForAvailableBudget:(id<SRMemoryBudgetClient>)client;
+
+/**
+ Clients are held weakly. `removeClient:` must not be called from the client's `dealloc`, deallocated clients are dropped automatically.
+ */
+- (void)addClient:(id<SRMemoryBudgetClient>)client;
+- (void)removeClient:(id<SRMemoryBudgetClient>)client;
+
+/**
+ Handles a memory pressure event, as if it was reported by the system.
+ */
+- (void)handleMemoryPressure:(dispatch_source_memorypressure_flags_t)pressure;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,236 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRMemoryBudget.h"
+
+#import <stdatomic.h>
+
+#import "SRLog.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation SRMemoryBudget
+{
+    _Atomic(NSUInteger) _chargedBytes;
+    _Atomic(NSUInteger) _limit;
+
+    dispatch_queue_t _queue;
+    dispatch_source_t _memoryPressureSource;
+    NSHashTable<id<SRMemoryBudgetClient>> *_clients; // Only accessed on `_queue`.
+    NSHashTable<id<SRMemoryBudgetClient>> *_pausedClients; // Only accessed on `_queue`.
+    NSHashTable<id<SRMemoryBudgetClient>> *_waitingClients; // Only accessed on `_queue`.
+}
+
+///--------------------------------------
+#pragma mark - Init
+///--------------------------------------
+
++ (instancetype)sharedBudget
+{
+    static SRMemoryBudget *budget;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        budget = [[self alloc] init];
+    });
+    return budget;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (!self) return self;
+
+    atomic_init(&_chargedBytes, 0);
+    atomic_init(&_limit, 0);
+    _queue = dispatch_queue_create("com.facebook.socketrocket.memorybudget", DISPATCH_QUEUE_SERIAL);
+    _clients = [NSHashTable weakObjectsHashTable];
+    _pausedClients = [NSHashTable weakObjectsHashTable];
+    _waitingClients = [NSHashTable weakObjectsHashTable];
+
+    _memoryPressureSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                                   DISPATCH_MEMORYPRESSURE_NORMAL | DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+                                                   _queue);
+    __weak typeof(self) wself = self;
+    dispatch_source_set_event_handler(_memoryPressureSource, ^{
+        __strong typeof(wself) sself = wself;
+        if (sself) {
+            [sself _handleMemoryPressure:dispatch_source_get_data(sself->_memoryPressureSource)];
+        }
+    });
+    dispatch_resume(_memoryPressureSource);
+
+    return self;
+}
+
+- (void)dealloc
+{
+    dispatch_source_cancel(_memoryPressureSource);
+}
+
+///--------------------------------------
+#pragma mark - Accounting
+///--------------------------------------
+
+- (NSUInteger)limit
+{
+    return atomic_load(&_limit);
+}
+
+- (void)setLimit:(NSUInteger)limit
+{
+    atomic_store(&_limit, limit);
+    [self _notifyWaitingClientsIfAvailable];
+}
+
+- (NSUInteger)chargedBytes
+{
+    return atomic_load_explicit(&_chargedBytes, memory_order_relaxed);
+}
+
+- (BOOL)isExhausted
+{
+    NSUInteger limit = self.limit;
+    return (limit != 0 && self.chargedBytes >= limit);
+}
+
+- (void)chargeBytes:(NSUInteger)bytes
+{
+    atomic_fetch_add_explicit(&_chargedBytes, bytes, memory_order_relaxed);
+}
+
+- (void)releaseBytes:(NSUInteger)bytes
+{
+    NSUInteger previousBytes = atomic_fetch_sub(&_chargedBytes, bytes);
+    NSUInteger limit = self.limit;
+    // Only the release that brings usage back under the limit wakes waiting clients.
+    if (limit != 0 && previousBytes >= limit && previousBytes - bytes < limit) {
+        [self _notifyWaitingClientsIfAvailable];
+    }
+}
+
+- (void)waitForAvailableBudget:(id<SRMemoryBudgetClient>)client
+{
+    dispatch_async(_queue, ^{
+        [self->_waitingClients addObject:client];
+        // Bytes may have been released since the client saw the budget exhausted.
+        [self _notifyWaitingClientsIfAvailableOnQueue];
+    });
+}
+
+- (void)_notifyWaitingClientsIfAvailable
+{
+    dispatch_async(_queue, ^{
+        [self _notifyWaitingClientsIfAvailableOnQueue];
+    });
+}
+
+- (void)_notifyWaitingClientsIfAvailableOnQueue
+{
+    if (self.isExhausted || _waitingClients.count == 0) {
+        return;
+    }
+    NSArray<id<SRMemoryBudgetClient>> *clients = _waitingClients.allObjects;
+    [_waitingClients removeAllObjects];
+    for (id<SRMemoryBudgetClient> client in clients) {
+        [client memoryBudgetDidBecomeAvailable];
+    }
+}
+
+///--------------------------------------
+#pragma mark - Clients
+///--------------------------------------
+
+- (void)addClient:(id<SRMemoryBudgetClient>)client
+{
+    dispatch_async(_queue, ^{
+        [self->_clients addObject:client];
+    });
+}
+
+- (void)removeClient:(id<SRMemoryBudgetClient>)client
+{
+    dispatch_async(_queue, ^{
+        [self->_clients removeObject:client];
+        [self->_pausedClients removeObject:client];
+        [self->_waitingClients removeObject:client];
+    });
+}
+
+///--------------------------------------
+#pragma mark - Memory Pressure
+///--------------------------------------
+
+- (void)handleMemoryPressure:(dispatch_source_memorypressure_flags_t)pressure
+{
+    dispatch_async(_queue, ^{
+        [self _handleMemoryPressure:pressure];
+    });
+}
+
+- (void)_handleMemoryPressure:(dispatch_source_memorypressure_flags_t)pressure
+{
+    if (pressure & DISPATCH_MEMORYPRESSURE_NORMAL) {
+        for (id<SRMemoryBudgetClient> client in _pausedClients) {
+            [client memoryBudgetSetReadsPaused:NO];
+        }
+        [_pausedClients removeAllObjects];
+        return;
+    }
+
+    SRDebugLog(@"Memory pressure %lu, %lu bytes charged", (unsigned long)pressure, (unsigned long)self.chargedBytes);
+
+    NSArray<id<SRMemoryBudgetClient>> *clients = _clients.allObjects;
+    for (id<SRMemoryBudgetClient> client in clients) {
+        [client memoryBudgetTrimMemory];
+    }
+
+    if (!(pressure & DISPATCH_MEMORYPRESSURE_CRITICAL) || !self.pausesReadsUnderMemoryPressure) {
+        return;
+    }
+
+    // Pause the largest clients, that together hold at least half of all charged bytes.
+    NSMutableArray<NSNumber *> *chargedBytes = [NSMutableArray arrayWithCapacity:clients.count];
+    NSUInteger totalBytes = 0;
+    for (id<SRMemoryBudgetClient> client in clients) {
+        NSUInteger bytes = [client memoryBudgetChargedBytes];
+        [chargedBytes addObject:@(bytes)];
+        totalBytes += bytes;
+    }
+    NSArray<NSNumber *> *indexes = [[self class] _indexesSortedByValueDescending:chargedBytes];
+
+    NSUInteger pausedBytes = 0;
+    for (NSNumber *index in indexes) {
+        NSUInteger bytes = chargedBytes[index.unsignedIntegerValue].unsignedIntegerValue;
+        if (bytes == 0 || pausedBytes >= totalBytes / 2) {
+            break;
+        }
+        id<SRMemoryBudgetClient> client = clients[index.unsignedIntegerValue];
+        if (![_pausedClients containsObject:client]) {
+            [_pausedClients addObject:client];
+            [client memoryBudgetSetReadsPaused:YES];
+        }
+        pausedBytes += bytes;
+    }
+}
+
++ (NSArray<NSNumber *> *)_indexesSortedByValueDescending:(NSArray<NSNumber *> *)values
+{
+    NSMutableArray<NSNumber *> *indexes = [NSMutableArray arrayWithCapacity:values.count];
+    for (NSUInteger i = 0; i < values.count; i++) {
+        [indexes addObject:@(i)];
+    }
+    [indexes sortUsingComparator:^NSComparisonResult(NSNumber *lhs, NSNumber *rhs) {
+        return [values[rhs.unsignedIntegerValue] compare:values[lhs.unsignedIntegerValue]];
+    }];
+    return indexes;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
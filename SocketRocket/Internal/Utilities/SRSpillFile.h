@@ -0,0 +1,49 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ An anonymous temporary file that a large message is assembled in, instead of in memory.
+
+ The file is unlinked as soon as it is created, so its storage is reclaimed once the file
+ and all data mapped from it are released, even if the process is killed.
+ This class is not thread-safe, and is expected to always be used on the same queue.
+ */
+@interface SRSpillFile : NSObject
+
+@property (nonatomic, assign, readonly) NSUInteger length;
+
+/**
+ Creates a file in the temporary directory.
+ */
+- (nullable instancetype)initWithError:(NSError **)error;
+
+/**
+ Appends bytes at the end of the file.
+ A failed append closes the file, so that nothing can be appended or mapped after a gap.
+
+ @return `YES` if all bytes were written, otherwise `NO`.
+ */
+- (BOOL)appendBytes:(const void *)bytes length:(size_t)length;
+
+/**
+ Maps the contents of the file into memory, read-only, and closes the file.
+ Mapped pages are backed by the file, so they can be evicted under memory pressure instead of staying resident.
+ Nothing can be appended afterwards.
+
+ @return Mapped data, which unmaps itself when deallocated, or `nil` if mapping failed.
+ */
+- (nullable NSData *)mapData;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRSpillFile.h"
+
+#import <errno.h>
+#import <sys/mman.h>
+#import <unistd.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation SRSpillFile
+{
+    int _fileDescriptor;
+}
+
+- (nullable instancetype)initWithError:(NSError **)error
+{
+    self = [super init];
+    if (!self) return self;
+
+    NSString *template = [NSTemporaryDirectory() stringByAppendingPathComponent:@"SocketRocket.message.XXXXXX"];
+    char path[PATH_MAX];
+    if (![template getFileSystemRepresentation:path maxLength:sizeof(path)]) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENAMETOOLONG userInfo:nil];
+        }
+        return nil;
+    }
+
+    _fileDescriptor = mkstemp(path);
+    if (_fileDescriptor == -1) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        }
+        return nil;
+    }
+    unlink(path);
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self _close];
+}
+
+- (BOOL)appendBytes:(const void *)bytes length:(size_t)length
+{
+    if (_fileDescriptor == -1) {
+        return NO;
+    }
+
+    size_t offset = 0;
+    while (offset < length) {
+        ssize_t result = write(_fileDescriptor, (const uint8_t *)bytes + offset, length - offset);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            [self _close];
+            return NO;
+        }
+        offset += (size_t)result;
+    }
+    _length += length;
+    return YES;
+}
+
+- (nullable NSData *)mapData
+{
+    if (_fileDescriptor == -1) {
+        return nil;
+    }
+    if (_length == 0) {
+        [self _close];
+        return [NSData data];
+    }
+
+    void *bytes = mmap(NULL, _length, PROT_READ, MAP_PRIVATE, _fileDescriptor, 0);
+    [self _close];
+    if (bytes == MAP_FAILED) {
+        return nil;
+    }
+
+    return [[NSData alloc] initWithBytesNoCopy:bytes length:_length deallocator:^(void *mappedBytes, NSUInteger length) {
+        munmap(mappedBytes, length);
+    }];
+}
+
+- (void)_close
+{
+    if (_fileDescriptor != -1) {
+        close(_fileDescriptor);
+        _fileDescriptor = -1;
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
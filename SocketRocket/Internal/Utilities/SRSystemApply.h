@@ -9,11 +9,13 @@
 
 #import <Foundation/Foundation.h>
 
-/**
- Unmask bytes using XOR via SIMD.
+#import "SRCoreApply.h"
+
+NS_ASSUME_NONNULL_BEGIN
 
- @param bytes    The bytes to unmask.
- @param length   The number of bytes to unmask.
- @param maskKey The mask to XOR with MUST be of length sizeof(uint32_t).
+/**
+ Runs work of the framing core on all cores with `dispatch_apply`.
  */
-void SRMaskBytesSIMD(uint8_t *bytes, size_t length, uint8_t *maskKey);
+extern const SRCoreApply SRSystemApply;
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,25 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRSystemApply.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+static void SRSystemApplyApply(void *_Nullable context, size_t count, void *workContext, void (*work)(void *workContext, size_t index))
+{
+    // The calling thread takes part as well, so a socket's work queue is only blocked until all chunks are done.
+    dispatch_apply_f(count, DISPATCH_APPLY_AUTO, workContext, work);
+}
+
+const SRCoreApply SRSystemApply = {
+    .apply = SRSystemApplyApply,
+    .context = NULL,
+};
+
+NS_ASSUME_NONNULL_END
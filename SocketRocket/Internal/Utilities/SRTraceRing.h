@@ -0,0 +1,64 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(uint8_t, SRTraceEventType) {
+    SRTraceEventTypeFrameIn = 1,
+    SRTraceEventTypeFrameOut,
+    SRTraceEventTypeStateChange,
+    SRTraceEventTypeError,
+};
+
+typedef NS_OPTIONS(uint8_t, SRTraceEventFlags) {
+    SRTraceEventFlagFin = 1 << 0,
+    SRTraceEventFlagMasked = 1 << 1,
+};
+
+typedef struct {
+    uint64_t timestamp; // `mach_absolute_time()`
+    uint32_t value; // Payload length for frames (clamped to `UINT32_MAX`), error code for errors.
+    SRTraceEventType type;
+    uint8_t code; // Opcode for frames, ready state for state changes.
+    SRTraceEventFlags flags;
+} SRTraceEvent;
+
+/**
+ Fixed-size ring of compact trace events, that overwrites the oldest events when full.
+
+ Recording is lock-free and safe to call from any thread. Reading is safe concurrently with recording,
+ events that are overwritten while being read are skipped.
+ */
+@interface SRTraceRing : NSObject
+
+@property (nonatomic, assign, readonly) NSUInteger capacity;
+
+/**
+ @param capacity Maximum number of events to keep, rounded up to a power of 2.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+- (void)recordEventOfType:(SRTraceEventType)type code:(uint8_t)code flags:(SRTraceEventFlags)flags value:(uint64_t)value;
+
+/**
+ Enumerates recorded events, oldest first.
+ */
+- (void)enumerateEventsUsingBlock:(void (^)(SRTraceEvent event))block;
+
+/**
+ Returns a human-readable dump of recorded events, one per line, with timestamps relative to the oldest event.
+ */
+- (NSString *)eventsDescription;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRTraceRing.h"
+
+#import <mach/mach_time.h>
+#import <stdatomic.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct {
+    // Index of the event stored in the slot plus one, `0` while the slot is empty or being written.
+    _Atomic(uint64_t) sequence;
+    SRTraceEvent event;
+} SRTraceSlot;
+
+static NSString *SRTraceEventTypeName(SRTraceEventType type)
+{
+    switch (type) {
+        case SRTraceEventTypeFrameIn:
+            return @"frame-in";
+        case SRTraceEventTypeFrameOut:
+            return @"frame-out";
+        case SRTraceEventTypeStateChange:
+            return @"state";
+        case SRTraceEventTypeError:
+            return @"error";
+    }
+    return @"unknown";
+}
+
+@implementation SRTraceRing
+{
+    SRTraceSlot *_slots;
+    uint64_t _mask;
+    _Atomic(uint64_t) _nextIndex;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity
+{
+    self = [super init];
+    if (!self) return self;
+
+    NSUInteger roundedCapacity = 1;
+    while (roundedCapacity < capacity) {
+        roundedCapacity <<= 1;
+    }
+    _capacity = roundedCapacity;
+    _mask = roundedCapacity - 1;
+    _slots = calloc(roundedCapacity, sizeof(SRTraceSlot));
+    atomic_init(&_nextIndex, 0);
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_slots);
+}
+
+///--------------------------------------
+#pragma mark - Recording
+///--------------------------------------
+
+- (void)recordEventOfType:(SRTraceEventType)type code:(uint8_t)code flags:(SRTraceEventFlags)flags value:(uint64_t)value
+{
+    uint64_t index = atomic_fetch_add_explicit(&_nextIndex, 1, memory_order_relaxed);
+    SRTraceSlot *slot = &_slots[index & _mask];
+
+    atomic_store_explicit(&slot->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->event = (SRTraceEvent){
+        .timestamp = mach_absolute_time(),
+        .value = (uint32_t)MIN(value, (uint64_t)UINT32_MAX),
+        .type = type,
+        .code = code,
+        .flags = flags,
+    };
+
+    atomic_store_explicit(&slot->sequence, index + 1, memory_order_release);
+}
+
+///--------------------------------------
+#pragma mark - Reading
+///--------------------------------------
+
+- (void)enumerateEventsUsingBlock:(void (^)(SRTraceEvent event))block
+{
+    uint64_t endIndex = atomic_load_explicit(&_nextIndex, memory_order_acquire);
+    uint64_t startIndex = (endIndex > _capacity ? endIndex - _capacity : 0);
+
+    for (uint64_t index = startIndex; index < endIndex; index++) {
+        SRTraceSlot *slot = &_slots[index & _mask];
+
+        uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        SRTraceEvent event = slot->event;
+        atomic_thread_fence(memory_order_acquire);
+        // Skip events that were not finished yet or were overwritten while being copied.
+        if (sequence != index + 1 || atomic_load_explicit(&slot->sequence, memory_order_relaxed) != sequence) {
+            continue;
+        }
+        block(event);
+    }
+}
+
+- (NSString *)eventsDescription
+{
+    static mach_timebase_info_data_t timebase;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info(&timebase);
+    });
+
+    NSMutableString *description = [NSMutableString string];
+    __block uint64_t startTimestamp = 0;
+    [self enumerateEventsUsingBlock:^(SRTraceEvent event) {
+        if (startTimestamp == 0) {
+            startTimestamp = event.timestamp;
+        }
+        uint64_t elapsedNanoseconds = (event.timestamp - startTimestamp) * timebase.numer / timebase.denom;
+        [description appendFormat:@"+%llu.%06llus %@ code=%u value=%u%@%@\n",
+         elapsedNanoseconds / NSEC_PER_SEC,
+         (elapsedNanoseconds % NSEC_PER_SEC) / NSEC_PER_USEC,
+         SRTraceEventTypeName(event.type),
+         event.code,
+         event.value,
+         (event.flags & SRTraceEventFlagFin ? @" fin" : @""),
+         (event.flags & SRTraceEventFlagMasked ? @" masked" : @"")];
+    }];
+    return description;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,35 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "SRCapture.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Writes raw bytes read from and written to the network into a file in the `SRCapture.h` format.
+
+ Writes are buffered, so recording costs a `memcpy` per read or write.
+ This class is not thread-safe, and is expected to always be used on the same queue.
+ */
+@interface SRWireCaptureWriter : NSObject
+
+- (nullable instancetype)initWithURL:(NSURL *)url error:(NSError **)error;
+
+- (void)recordBytes:(const void *)bytes length:(size_t)length direction:(SRCaptureDirection)direction;
+
+/**
+ Flushes and closes the file. Nothing is recorded after this.
+ */
+- (void)close;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,89 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRWireCaptureWriter.h"
+
+#import <mach/mach_time.h>
+#import <stdio.h>
+
+#import "SRLog.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+static bool SRWireCaptureWriterWrite(void *context, const uint8_t *bytes, size_t length)
+{
+    return (fwrite(bytes, 1, length, (FILE *)context) == length);
+}
+
+@implementation SRWireCaptureWriter
+{
+    FILE *_file;
+    SRCoreIO _io;
+    uint64_t _startTime;
+    mach_timebase_info_data_t _timebase;
+}
+
+- (nullable instancetype)initWithURL:(NSURL *)url error:(NSError **)error
+{
+    self = [super init];
+    if (!self) return self;
+
+    _file = fopen(url.fileSystemRepresentation, "wb");
+    if (!_file) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{ NSURLErrorKey : url }];
+        }
+        return nil;
+    }
+    _io = (SRCoreIO){ .write = SRWireCaptureWriterWrite, .context = _file };
+    _startTime = mach_absolute_time();
+    mach_timebase_info(&_timebase);
+
+    if (!SRCaptureWriteFileHeader(&_io)) {
+        SRErrorLog(@"Failed to write capture header to %@", url.path);
+        [self close];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self close];
+}
+
+- (void)recordBytes:(const void *)bytes length:(size_t)length direction:(SRCaptureDirection)direction
+{
+    if (!_file || length == 0) {
+        return;
+    }
+
+    uint64_t elapsed = mach_absolute_time() - _startTime;
+    SRCaptureRecord record = {
+        .timestamp = elapsed * _timebase.numer / _timebase.denom,
+        .length = (uint32_t)length,
+        .direction = direction,
+    };
+    if (!SRCaptureWriteRecord(&_io, &record, bytes)) {
+        SRErrorLog(@"Failed to write capture record, stopping capture.");
+        [self close];
+    }
+}
+
+- (void)close
+{
+    if (_file) {
+        fclose(_file);
+        _file = NULL;
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
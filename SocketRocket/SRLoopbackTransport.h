@@ -0,0 +1,73 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+#import <SocketRocket/SRTransport.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ One end of an in-memory connection. Ends are created in pairs, bytes written to one end become readable from the other.
+
+ Delivery can be shaped with a latency, a bandwidth and a chunk size, so the framing and dispatch pipeline of a socket
+ can be benchmarked or fault-injected in-process, without the kernel TCP stack or the network run loop in the measurement.
+ Events of both ends are reported on a private serial queue, in the order bytes were written.
+ */
+@interface SRLoopbackTransport : NSObject <SRTransport>
+
+/**
+ Creates a connected pair of transports.
+ Usually the client end is passed to `-[SRWebSocket openWithTransport:]`, and the server end is driven by a test.
+ */
++ (void)getClientTransport:(SRLoopbackTransport *_Nullable *_Nonnull)clientTransport
+           serverTransport:(SRLoopbackTransport *_Nullable *_Nonnull)serverTransport;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+///--------------------------------------
+#pragma mark - Link Shaping
+///--------------------------------------
+
+// These apply to bytes written to this end after they are set.
+
+/**
+ Time after which bytes written to this end become readable from the other end. Default: `0`.
+ */
+@property (atomic, assign) NSTimeInterval latency;
+
+/**
+ Rate at which bytes written to this end are delivered to the other end. `0` means there is no limit. Default: `0`.
+ */
+@property (atomic, assign) NSUInteger bytesPerSecond;
+
+/**
+ Largest number of bytes delivered at once and returned by a single read on the other end,
+ to exercise frames split across reads. `0` means there is no limit. Default: `0`.
+ */
+@property (atomic, assign) NSUInteger chunkSize;
+
+/**
+ Number of bytes written to this end that may wait to be read by the other end, before writes accept no more. Default: 64 KB.
+ */
+@property (atomic, assign) NSUInteger bufferSize;
+
+///--------------------------------------
+#pragma mark - Fault Injection
+///--------------------------------------
+
+/**
+ Simulates a broken connection: bytes that were not read yet are discarded,
+ and both ends report `SRTransportEventErrorOccurred` with `error`.
+ */
+- (void)failWithError:(NSError *)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,411 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRLoopbackTransport.h"
+
+#import <os/lock.h>
+#import <time.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+static const NSUInteger SRLoopbackTransportDefaultBufferSize = 64 * 1024;
+
+static uint64_t SRLoopbackTransportNow(void)
+{
+    // Same clock as `dispatch_time(DISPATCH_TIME_NOW, ...)`.
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+///--------------------------------------
+#pragma mark - Link
+///--------------------------------------
+
+// State shared by both ends of a pair.
+@interface SRLoopbackLink : NSObject
+{
+@public
+    dispatch_queue_t _queue;
+    os_unfair_lock _lock;
+}
+@end
+
+@implementation SRLoopbackLink
+
+- (instancetype)init
+{
+    self = [super init];
+    if (!self) return self;
+
+    _queue = dispatch_queue_create("com.facebook.socketrocket.loopback", DISPATCH_QUEUE_SERIAL);
+    _lock = OS_UNFAIR_LOCK_INIT;
+
+    return self;
+}
+
+@end
+
+// Bytes on their way to an end, readable once `deadline` passes.
+@interface SRLoopbackChunk : NSObject
+{
+@public
+    NSData *_data;
+    uint64_t _deadline;
+}
+@end
+
+@implementation SRLoopbackChunk
+@end
+
+///--------------------------------------
+#pragma mark - Transport
+///--------------------------------------
+
+@interface SRLoopbackTransport ()
+
+@property (nullable, atomic, strong, readwrite) NSError *error;
+
+@end
+
+@implementation SRLoopbackTransport
+{
+    SRLoopbackLink *_link;
+    __weak SRLoopbackTransport *_peer;
+
+    // All of the following are guarded by the link lock, and describe bytes travelling towards this end.
+    BOOL _opened;
+    BOOL _closed;
+    BOOL _remoteClosed;
+    BOOL _endReported;
+    BOOL _waitingForSpace; // Writes from this end found the peer full, it reports space once the peer reads.
+    NSMutableArray<SRLoopbackChunk *> *_pendingChunks;
+    NSUInteger _pendingLength;
+    NSMutableArray<NSData *> *_readableChunks;
+    NSUInteger _readableOffset; // Into the first readable chunk.
+    NSUInteger _readableLength;
+    NSUInteger _readLimit; // `chunkSize` of the peer, `0` for no limit.
+    uint64_t _transmitEndTime; // When the bytes scheduled so far finished "transmitting" at the peer's bandwidth.
+    uint64_t _lastDeadline;
+}
+
+@synthesize delegate = _delegate;
+
++ (void)getClientTransport:(SRLoopbackTransport *_Nullable *_Nonnull)clientTransport
+           serverTransport:(SRLoopbackTransport *_Nullable *_Nonnull)serverTransport
+{
+    SRLoopbackLink *link = [[SRLoopbackLink alloc] init];
+    SRLoopbackTransport *client = [[SRLoopbackTransport alloc] _initWithLink:link];
+    SRLoopbackTransport *server = [[SRLoopbackTransport alloc] _initWithLink:link];
+    client->_peer = server;
+    server->_peer = client;
+    *clientTransport = client;
+    *serverTransport = server;
+}
+
+- (instancetype)_initWithLink:(SRLoopbackLink *)link
+{
+    self = [super init];
+    if (!self) return self;
+
+    _link = link;
+    _pendingChunks = [NSMutableArray array];
+    _readableChunks = [NSMutableArray array];
+    _bufferSize = SRLoopbackTransportDefaultBufferSize;
+
+    return self;
+}
+
+///--------------------------------------
+#pragma mark - SRTransport
+///--------------------------------------
+
+- (BOOL)isOpen
+{
+    os_unfair_lock_lock(&_link->_lock);
+    BOOL open = (_opened && !_closed);
+    os_unfair_lock_unlock(&_link->_lock);
+    return open;
+}
+
+- (BOOL)hasBytesAvailable
+{
+    os_unfair_lock_lock(&_link->_lock);
+    BOOL hasBytesAvailable = (_readableLength > 0);
+    os_unfair_lock_unlock(&_link->_lock);
+    return hasBytesAvailable;
+}
+
+- (BOOL)hasSpaceAvailable
+{
+    os_unfair_lock_lock(&_link->_lock);
+    BOOL hasSpaceAvailable = (_opened && !_closed && !self.error && [self _spaceAvailableLocked] > 0);
+    if (!hasSpaceAvailable) {
+        // Like a stream, report space once the peer reads something.
+        _waitingForSpace = YES;
+    }
+    os_unfair_lock_unlock(&_link->_lock);
+    return hasSpaceAvailable;
+}
+
+// Writes to a closed or released peer are discarded, so there is always space for them.
+- (NSUInteger)_spaceAvailableLocked
+{
+    SRLoopbackTransport *peer = _peer;
+    if (!peer || peer->_closed) {
+        return NSUIntegerMax;
+    }
+    NSUInteger bufferedLength = peer->_pendingLength + peer->_readableLength;
+    NSUInteger bufferSize = self.bufferSize;
+    return (bufferedLength < bufferSize ? bufferSize - bufferedLength : 0);
+}
+
+- (void)openTransport
+{
+    os_unfair_lock_lock(&_link->_lock);
+    if (_opened || _closed) {
+        os_unfair_lock_unlock(&_link->_lock);
+        return;
+    }
+    _opened = YES;
+    os_unfair_lock_unlock(&_link->_lock);
+
+    dispatch_async(_link->_queue, ^{
+        [self _reportEvent:SRTransportEventOpenCompleted];
+        [self _reportEvent:SRTransportEventHasSpaceAvailable];
+        // Bytes that arrived before opening were not reported yet.
+        if (self.hasBytesAvailable) {
+            [self _reportEvent:SRTransportEventHasBytesAvailable];
+        }
+        [self _reportEndIfNeeded];
+    });
+}
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)maxLength
+{
+    os_unfair_lock_lock(&_link->_lock);
+    if (!_opened || _closed || self.error) {
+        os_unfair_lock_unlock(&_link->_lock);
+        return -1;
+    }
+
+    NSUInteger length = MIN(maxLength, _readableLength);
+    if (_readLimit > 0) {
+        length = MIN(length, _readLimit);
+    }
+    NSUInteger copied = 0;
+    while (copied < length) {
+        NSData *chunk = _readableChunks.firstObject;
+        NSUInteger chunkLength = MIN(chunk.length - _readableOffset, length - copied);
+        memcpy(buffer + copied, (const uint8_t *)chunk.bytes + _readableOffset, chunkLength);
+        copied += chunkLength;
+        _readableOffset += chunkLength;
+        if (_readableOffset == chunk.length) {
+            [_readableChunks removeObjectAtIndex:0];
+            _readableOffset = 0;
+        }
+    }
+    _readableLength -= copied;
+
+    SRLoopbackTransport *peer = _peer;
+    BOOL notifyPeer = (copied > 0 && peer && peer->_waitingForSpace);
+    if (notifyPeer) {
+        peer->_waitingForSpace = NO;
+    }
+    BOOL drained = (_readableLength == 0 && _remoteClosed);
+    os_unfair_lock_unlock(&_link->_lock);
+
+    if (notifyPeer) {
+        dispatch_async(_link->_queue, ^{
+            [peer _reportEvent:SRTransportEventHasSpaceAvailable];
+        });
+    }
+    if (drained) {
+        dispatch_async(_link->_queue, ^{
+            [self _reportEndIfNeeded];
+        });
+    }
+    return (NSInteger)copied;
+}
+
+- (NSInteger)write:(const uint8_t *)buffer maxLength:(NSUInteger)maxLength
+{
+    NSTimeInterval latency = self.latency;
+    NSUInteger bytesPerSecond = self.bytesPerSecond;
+    NSUInteger chunkSize = self.chunkSize;
+
+    os_unfair_lock_lock(&_link->_lock);
+    if (!_opened || _closed || self.error) {
+        os_unfair_lock_unlock(&_link->_lock);
+        return -1;
+    }
+    SRLoopbackTransport *peer = _peer;
+    if (!peer || peer->_closed) {
+        os_unfair_lock_unlock(&_link->_lock);
+        return (NSInteger)maxLength;
+    }
+
+    NSUInteger length = MIN(maxLength, [self _spaceAvailableLocked]);
+    if (length < maxLength) {
+        _waitingForSpace = YES;
+    }
+    if (length == 0) {
+        os_unfair_lock_unlock(&_link->_lock);
+        return 0;
+    }
+
+    uint64_t now = SRLoopbackTransportNow();
+    uint64_t latencyNanoseconds = (uint64_t)(latency * NSEC_PER_SEC);
+    peer->_readLimit = chunkSize;
+    NSUInteger offset = 0;
+    while (offset < length) {
+        NSUInteger chunkLength = (chunkSize > 0 ? MIN(chunkSize, length - offset) : length - offset);
+
+        // Chunks go out back to back at the link's bandwidth, and each one arrives `latency` after it was sent.
+        uint64_t transmitStartTime = MAX(now, peer->_transmitEndTime);
+        uint64_t transmitDuration = (bytesPerSecond > 0 ? (uint64_t)chunkLength * NSEC_PER_SEC / bytesPerSecond : 0);
+        peer->_transmitEndTime = transmitStartTime + transmitDuration;
+        // Deadlines never decrease, so bytes are delivered in order even if the latency changes.
+        peer->_lastDeadline = MAX(peer->_transmitEndTime + latencyNanoseconds, peer->_lastDeadline);
+
+        SRLoopbackChunk *chunk = [[SRLoopbackChunk alloc] init];
+        chunk->_data = [NSData dataWithBytes:buffer + offset length:chunkLength];
+        chunk->_deadline = peer->_lastDeadline;
+        [peer->_pendingChunks addObject:chunk];
+        peer->_pendingLength += chunkLength;
+        offset += chunkLength;
+
+        uint64_t delay = (chunk->_deadline > now ? chunk->_deadline - now : 0);
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)delay), _link->_queue, ^{
+            [peer _deliverDueChunks];
+        });
+    }
+    os_unfair_lock_unlock(&_link->_lock);
+
+    return (NSInteger)length;
+}
+
+- (void)close
+{
+    os_unfair_lock_lock(&_link->_lock);
+    if (_closed) {
+        os_unfair_lock_unlock(&_link->_lock);
+        return;
+    }
+    _closed = YES;
+    [self _discardBytesLocked];
+
+    SRLoopbackTransport *peer = _peer;
+    uint64_t deadline = 0;
+    if (peer) {
+        peer->_remoteClosed = YES;
+        deadline = peer->_lastDeadline;
+    }
+    os_unfair_lock_unlock(&_link->_lock);
+
+    if (peer) {
+        // The peer sees the end after everything that was written before closing.
+        uint64_t now = SRLoopbackTransportNow();
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(deadline > now ? deadline - now : 0)), _link->_queue, ^{
+            [peer _reportEndIfNeeded];
+        });
+    }
+}
+
+///--------------------------------------
+#pragma mark - Fault Injection
+///--------------------------------------
+
+- (void)failWithError:(NSError *)error
+{
+    SRLoopbackTransport *peer = _peer;
+
+    os_unfair_lock_lock(&_link->_lock);
+    for (SRLoopbackTransport *transport in (peer ? @[ self, peer ] : @[ self ])) {
+        if (!transport->_closed && !transport.error) {
+            transport.error = error;
+            [transport _discardBytesLocked];
+        }
+    }
+    os_unfair_lock_unlock(&_link->_lock);
+
+    dispatch_async(_link->_queue, ^{
+        [self _reportEvent:SRTransportEventErrorOccurred];
+        [peer _reportEvent:SRTransportEventErrorOccurred];
+    });
+}
+
+///--------------------------------------
+#pragma mark - Delivery
+///--------------------------------------
+
+- (void)_discardBytesLocked
+{
+    [_pendingChunks removeAllObjects];
+    [_readableChunks removeAllObjects];
+    _pendingLength = 0;
+    _readableLength = 0;
+    _readableOffset = 0;
+}
+
+- (void)_deliverDueChunks
+{
+    os_unfair_lock_lock(&_link->_lock);
+    uint64_t now = SRLoopbackTransportNow();
+    NSUInteger deliveredLength = 0;
+    while (_pendingChunks.count > 0 && _pendingChunks.firstObject->_deadline <= now) {
+        NSData *data = _pendingChunks.firstObject->_data;
+        [_pendingChunks removeObjectAtIndex:0];
+        [_readableChunks addObject:data];
+        _pendingLength -= data.length;
+        _readableLength += data.length;
+        deliveredLength += data.length;
+    }
+    // Timers may fire slightly before the deadline, try again for the chunk this call was scheduled for.
+    uint64_t nextDeadline = (_pendingChunks.count > 0 ? _pendingChunks.firstObject->_deadline : 0);
+    os_unfair_lock_unlock(&_link->_lock);
+
+    if (nextDeadline > now) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(nextDeadline - now)), _link->_queue, ^{
+            [self _deliverDueChunks];
+        });
+    }
+
+    if (deliveredLength > 0) {
+        [self _reportEvent:SRTransportEventHasBytesAvailable];
+    }
+}
+
+- (void)_reportEndIfNeeded
+{
+    os_unfair_lock_lock(&_link->_lock);
+    BOOL ended = (_remoteClosed && !_endReported && _pendingLength == 0 && _readableLength == 0 && _opened && !_closed);
+    if (ended) {
+        _endReported = YES;
+    }
+    os_unfair_lock_unlock(&_link->_lock);
+
+    if (ended) {
+        [self _reportEvent:SRTransportEventEndEncountered];
+    }
+}
+
+// Called on the link queue.
+- (void)_reportEvent:(SRTransportEvent)event
+{
+    os_unfair_lock_lock(&_link->_lock);
+    BOOL open = (_opened && !_closed);
+    os_unfair_lock_unlock(&_link->_lock);
+
+    if (open) {
+        [self.delegate transport:self handleEvent:event];
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,58 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A message that is encoded once and then sent any number of times, on one or many sockets,
+ with `-[SRWebSocket sendPreparedMessage:error:]`.
+
+ Text is converted to UTF-8 and validated, and the frame header is laid out when the message is created.
+ Every send then only writes a fresh mask key and masks the payload into the frame, instead of converting, copying and framing it again.
+ This class is immutable and thread-safe.
+ */
+@interface SRPreparedMessage : NSObject
+
+/**
+ Prepares a text message.
+
+ @param error Set if `string` can't be encoded as UTF-8, e.g. because it contains unpaired surrogates.
+ */
+- (nullable instancetype)initWithString:(NSString *)string error:(NSError **)error;
+
+/**
+ Prepares a text message from bytes that are already UTF-8 encoded.
+
+ @param error Set if `data` is not valid UTF-8.
+ */
+- (nullable instancetype)initWithUTF8Data:(NSData *)data error:(NSError **)error;
+
+/**
+ Prepares a binary message.
+ */
+- (instancetype)initWithData:(NSData *)data;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+/**
+ Whether this is a text message, otherwise it is a binary message.
+ */
+@property (nonatomic, assign, readonly, getter=isText) BOOL text;
+
+/**
+ Payload of the message, UTF-8 encoded for text messages.
+ */
+@property (nonatomic, copy, readonly) NSData *payload;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRPreparedMessage.h"
+#import "SRPreparedMessage+Private.h"
+
+#import "SRError.h"
+#import "SRHash.h"
+#import "SRMasking.h"
+#import "SRSystemApply.h"
+#import "SRUTF8.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation SRPreparedMessage
+{
+    // Header of a single masked frame carrying the whole payload, the mask key is written for every send.
+    uint8_t _frameHeader[SRFrameHeaderMaxLength];
+    size_t _frameHeaderLength;
+}
+
+///--------------------------------------
+#pragma mark - Init
+///--------------------------------------
+
+- (nullable instancetype)initWithString:(NSString *)string error:(NSError **)error
+{
+    NSData *payload = [string dataUsingEncoding:NSUTF8StringEncoding];
+    if (!payload) {
+        if (error) {
+            *error = SRErrorWithCodeDescription(2140, @"String can't be encoded as UTF-8.");
+        }
+        return nil;
+    }
+    return [self _initWithOpcode:SROpCodeTextFrame payload:payload];
+}
+
+- (nullable instancetype)initWithUTF8Data:(NSData *)data error:(NSError **)error
+{
+    if (!SRUTF8IsValid(data.bytes, data.length)) {
+        if (error) {
+            *error = SRErrorWithCodeDescription(2140, @"Text messages must be valid UTF-8.");
+        }
+        return nil;
+    }
+    return [self _initWithOpcode:SROpCodeTextFrame payload:[data copy]];
+}
+
+- (instancetype)initWithData:(NSData *)data
+{
+    return [self _initWithOpcode:SROpCodeBinaryFrame payload:[data copy]];
+}
+
+- (instancetype)_initWithOpcode:(SROpCode)opcode payload:(NSData *)payload
+{
+    self = [super init];
+    if (!self) return self;
+
+    _opcode = opcode;
+    _payload = payload;
+
+    const uint8_t maskKeyPlaceholder[sizeof(uint32_t)] = { 0 };
+    _frameHeaderLength = SRFrameHeaderWrite(_frameHeader, opcode, true, payload.length, maskKeyPlaceholder);
+
+    return self;
+}
+
+///--------------------------------------
+#pragma mark - Accessors
+///--------------------------------------
+
+- (BOOL)isText
+{
+    return (_opcode == SROpCodeTextFrame);
+}
+
+///--------------------------------------
+#pragma mark - Framing
+///--------------------------------------
+
+- (nullable NSData *)maskedFrameDataWithConcurrentMaskingThreshold:(NSUInteger)threshold
+{
+    size_t payloadLength = _payload.length;
+    size_t frameLength = _frameHeaderLength + payloadLength;
+
+    // Every byte is written below, so the buffer doesn't need to be zeroed.
+    uint8_t *frameBuffer = malloc(frameLength);
+    if (!frameBuffer) {
+        return nil;
+    }
+
+    memcpy(frameBuffer, _frameHeader, _frameHeaderLength);
+    // The mask key is always the last 4 bytes of the header.
+    uint8_t *maskKey = frameBuffer + _frameHeaderLength - sizeof(uint32_t);
+    if (!SRSystemCrypto.randomBytes(SRSystemCrypto.context, maskKey, sizeof(uint32_t))) {
+        free(frameBuffer);
+        [NSException raise:NSInternalInconsistencyException format:@"Failed to generate random bytes for the mask key"];
+    }
+    if (threshold > 0 && payloadLength >= threshold) {
+        SRMaskBytesCopyConcurrently(&SRSystemApply, frameBuffer + _frameHeaderLength, _payload.bytes, payloadLength, maskKey, 0);
+    } else {
+        SRMaskBytesCopy(frameBuffer + _frameHeaderLength, _payload.bytes, payloadLength, maskKey, 0);
+    }
+
+    return [NSData dataWithBytesNoCopy:frameBuffer length:frameLength freeWhenDone:YES];
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
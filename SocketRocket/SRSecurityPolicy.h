@@ -32,6 +32,20 @@ NS_ASSUME_NONNULL_BEGIN
     DEPRECATED_MSG_ATTRIBUTE("Using pinned certificates is neither secure nor supported in SocketRocket, "
                              "and leads to security issues. Please use a proper, trust chain validated certificate.");
 
+/**
+ Specifies socket security and pins the server to public keys, in addition to certificate chain validation.
+ The server is trusted if its certificate chain is valid for the domain, and any certificate of the evaluated chain
+ has a public key whose SHA-256 hash of the DER-encoded `SubjectPublicKeyInfo` is one of `publicKeyHashes`,
+ so certificates can be reissued for the same key.
+
+ A hash can be computed from a PEM certificate with:
+ `openssl x509 -in cert.pem -pubkey -noout | openssl pkey -pubin -outform der | openssl dgst -sha256 -binary`
+
+ @param publicKeyHashes Array of 32 byte SHA-256 hashes of `SubjectPublicKeyInfo`, must not be empty.
+ Pin a backup key as well, so the server can move to it without breaking existing clients.
+ */
++ (instancetype)pinningPolicyWithPublicKeyHashes:(NSArray<NSData *> *)publicKeyHashes;
+
 /**
  Specifies socket security and optional certificate chain validation.
 
@@ -34,6 +34,11 @@ NS_ASSUME_NONNULL_BEGIN
     return nil;
 }
 
++ (instancetype)pinningPolicyWithPublicKeyHashes:(NSArray<NSData *> *)publicKeyHashes
+{
+    return [[SRPinningSecurityPolicy alloc] initWithPublicKeyHashes:publicKeyHashes];
+}
+
 - (instancetype)initWithCertificateChainValidationEnabled:(BOOL)enabled
 {
     self = [super init];
@@ -0,0 +1,47 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Called once for every message sent with a completion handler.
+
+ @param error `nil` if the message was fully written to the network stream,
+ otherwise an error describing why it wasn't, with code `2137` if it was cancelled,
+ `2138` if the connection closed first, or `2141` if a frame for it couldn't be allocated.
+ */
+typedef void (^SRSendCompletionHandler)(NSError *_Nullable error);
+
+/**
+ A handle for a message queued by `SRWebSocket`, which can be used to cancel it before it starts transmitting.
+ This class is thread-safe.
+ */
+@interface SRSendHandle : NSObject
+
+/**
+ Whether the message was cancelled before any of it was written.
+ */
+@property (nonatomic, assign, readonly, getter=isCancelled) BOOL cancelled;
+
+/**
+ Cancels the message, if none of its frames were produced yet.
+ The completion handler of a cancelled message is called with an error.
+
+ @return `YES` if the message was cancelled and will never be sent, `NO` if it already started transmitting or was finished.
+ */
+- (BOOL)cancel;
+
+- (instancetype)init NS_UNAVAILABLE;
++ (instancetype)new NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
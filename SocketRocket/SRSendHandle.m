@@ -0,0 +1,102 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRSendHandle.h"
+#import "SRSendHandle+Private.h"
+
+#import <os/lock.h>
+#import <stdatomic.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSUInteger, SRSendHandleState) {
+    SRSendHandleStateQueued = 0,
+    SRSendHandleStateTransmitting,
+    SRSendHandleStateCancelled,
+};
+
+@implementation SRSendHandle
+{
+    _Atomic(SRSendHandleState) _state;
+
+    os_unfair_lock _completionLock;
+    SRSendCompletionHandler _Nullable _completion;
+    void (^_Nullable _cancelHandler)(SRSendHandle *handle);
+}
+
+///--------------------------------------
+#pragma mark - Init
+///--------------------------------------
+
+- (instancetype)initWithCompletion:(nullable SRSendCompletionHandler)completion
+                     cancelHandler:(void (^)(SRSendHandle *handle))cancelHandler
+{
+    self = [super init];
+    if (!self) return self;
+
+    atomic_init(&_state, SRSendHandleStateQueued);
+    _completionLock = OS_UNFAIR_LOCK_INIT;
+    _completion = [completion copy];
+    _cancelHandler = [cancelHandler copy];
+
+    return self;
+}
+
+///--------------------------------------
+#pragma mark - Accessors
+///--------------------------------------
+
+- (BOOL)isCancelled
+{
+    return (atomic_load_explicit(&_state, memory_order_acquire) == SRSendHandleStateCancelled);
+}
+
+///--------------------------------------
+#pragma mark - State
+///--------------------------------------
+
+- (BOOL)cancel
+{
+    SRSendHandleState expectedState = SRSendHandleStateQueued;
+    if (!atomic_compare_exchange_strong_explicit(&_state, &expectedState, SRSendHandleStateCancelled,
+                                                 memory_order_acq_rel, memory_order_acquire)) {
+        return (expectedState == SRSendHandleStateCancelled);
+    }
+
+    os_unfair_lock_lock(&_completionLock);
+    void (^cancelHandler)(SRSendHandle *) = _cancelHandler;
+    _cancelHandler = nil;
+    os_unfair_lock_unlock(&_completionLock);
+
+    if (cancelHandler) {
+        cancelHandler(self);
+    }
+    return YES;
+}
+
+- (BOOL)beginTransmitting
+{
+    SRSendHandleState expectedState = SRSendHandleStateQueued;
+    return atomic_compare_exchange_strong_explicit(&_state, &expectedState, SRSendHandleStateTransmitting,
+                                                   memory_order_acq_rel, memory_order_acquire);
+}
+
+- (nullable SRSendCompletionHandler)finish
+{
+    os_unfair_lock_lock(&_completionLock);
+    SRSendCompletionHandler completion = _completion;
+    _completion = nil;
+    _cancelHandler = nil;
+    os_unfair_lock_unlock(&_completionLock);
+    return completion;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+#import <Security/Security.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Events reported by a transport to its delegate. They mirror the `NSStreamEvent` values a socket handles.
+ */
+typedef NS_ENUM(NSUInteger, SRTransportEvent) {
+    // The transport finished opening, reported once after `openTransport`.
+    SRTransportEventOpenCompleted = 0,
+    // Bytes can be read without blocking.
+    SRTransportEventHasBytesAvailable,
+    // Bytes can be written without blocking.
+    SRTransportEventHasSpaceAvailable,
+    // The remote end closed, and all bytes it sent were read. `error` is set if the connection ended abnormally.
+    SRTransportEventEndEncountered,
+    // The transport failed, its `error` describes why.
+    SRTransportEventErrorOccurred,
+};
+
+@protocol SRTransport;
+
+@protocol SRTransportDelegate <NSObject>
+
+/**
+ Called on an arbitrary thread, but never concurrently for the same transport.
+ */
+- (void)transport:(id<SRTransport>)transport handleEvent:(SRTransportEvent)event;
+
+@end
+
+/**
+ A bidirectional, non-blocking byte stream that a socket reads frames from and writes frames to.
+
+ By default sockets use a transport over the TCP streams created for their URL,
+ `-[SRWebSocket openWithTransport:]` opens a socket over any other implementation, like `SRLoopbackTransport`.
+ All methods may be called from any thread.
+ */
+@protocol SRTransport <NSObject>
+
+@property (nullable, atomic, weak) id<SRTransportDelegate> delegate;
+
+/**
+ `YES` once the transport was opened, until it is closed.
+ */
+@property (atomic, assign, readonly, getter=isOpen) BOOL open;
+
+@property (atomic, assign, readonly) BOOL hasBytesAvailable;
+@property (atomic, assign, readonly) BOOL hasSpaceAvailable;
+
+/**
+ Error that failed the transport, or `nil`.
+ */
+@property (nullable, atomic, strong, readonly) NSError *error;
+
+/**
+ Opens the transport, `SRTransportEventOpenCompleted` is reported once it is ready.
+ Transports that are already connected report it right away.
+ */
+- (void)openTransport;
+
+/**
+ Reads up to `maxLength` bytes into `buffer`.
+
+ @return Number of bytes read, `0` at the end of the stream, or `-1` if the transport failed.
+ */
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)maxLength;
+
+/**
+ Writes up to `maxLength` bytes from `buffer`, as many as fit without blocking.
+
+ @return Number of bytes written, which may be `0` if there is no space, or `-1` if the transport failed.
+ */
+- (NSInteger)write:(const uint8_t *)buffer maxLength:(NSUInteger)maxLength;
+
+/**
+ Closes both directions. No more events are reported.
+ */
+- (void)close;
+
+@optional
+
+/**
+ Trust of the TLS peer, evaluated by the socket's security policy before it sends the handshake.
+ */
+- (nullable SecTrustRef)peerTrust CF_RETURNS_NOT_RETAINED;
+
+/**
+ Schedules event delivery in a given run loop, see `-[SRWebSocket scheduleInRunLoop:forMode:]`.
+ */
+- (void)scheduleInRunLoop:(NSRunLoop *)runLoop forMode:(NSRunLoopMode)mode;
+- (void)removeFromRunLoop:(NSRunLoop *)runLoop forMode:(NSRunLoopMode)mode;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,39 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ An immutable `NSString` backed by UTF-8 bytes, which is used for text messages received by `SRWebSocket`.
+
+ The bytes are available via `UTF8Data` without a copy, for example to pass them straight to a JSON parser.
+ UTF-16 characters are produced only when they are first requested (e.g. by `characterAtIndex:` or `isEqualToString:`),
+ and are cached after that. `length` is computed from the UTF-8 bytes without transcoding.
+ */
+@interface SRUTF8String : NSString
+
+/**
+ Initializes a string with UTF-8 encoded bytes.
+
+ @param data UTF-8 encoded bytes, which are copied if mutable.
+
+ @return An initialized string or `nil` if `data` isn't valid UTF-8.
+ */
+- (nullable instancetype)initWithUTF8Data:(NSData *)data;
+
+/**
+ UTF-8 encoded bytes of the string.
+ */
+@property (nonatomic, strong, readonly) NSData *UTF8Data;
+
+@end
+
+NS_ASSUME_NONNULL_END
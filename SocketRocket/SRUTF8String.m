@@ -0,0 +1,228 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRUTF8String.h"
+#import "SRUTF8String+Private.h"
+
+#import <os/lock.h>
+
+#import "SRUTF8.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Number of UTF-16 code units needed to represent valid UTF-8 bytes.
+static NSUInteger SRUTF16LengthOfUTF8Bytes(const uint8_t *bytes, size_t length)
+{
+    NSUInteger utf16Length = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t byte = bytes[i];
+        if ((byte & 0xC0) != 0x80) {
+            // Every code point takes one code unit, except 4-byte sequences, that need a surrogate pair.
+            utf16Length += (byte >= 0xF0 ? 2 : 1);
+        }
+    }
+    return utf16Length;
+}
+
+// Decodes valid UTF-8 bytes into `utf16Length` code units. Unlike `NSUTF8StringEncoding`, this keeps a leading BOM,
+// so the string has exactly the characters that `SRUTF16LengthOfUTF8Bytes` counts.
+static void SRUTF16FromUTF8Bytes(const uint8_t *bytes, size_t length, unichar *characters)
+{
+    size_t i = 0;
+    while (i < length) {
+        uint8_t byte = bytes[i];
+        uint32_t codePoint = 0;
+        if (byte < 0x80) {
+            codePoint = byte;
+            i += 1;
+        } else if (byte < 0xE0) {
+            codePoint = ((uint32_t)(byte & 0x1F) << 6) | (bytes[i + 1] & 0x3F);
+            i += 2;
+        } else if (byte < 0xF0) {
+            codePoint = ((uint32_t)(byte & 0x0F) << 12) | ((uint32_t)(bytes[i + 1] & 0x3F) << 6) | (bytes[i + 2] & 0x3F);
+            i += 3;
+        } else {
+            codePoint = (((uint32_t)(byte & 0x07) << 18) |
+                         ((uint32_t)(bytes[i + 1] & 0x3F) << 12) |
+                         ((uint32_t)(bytes[i + 2] & 0x3F) << 6) |
+                         (bytes[i + 3] & 0x3F));
+            i += 4;
+        }
+
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            *characters++ = (unichar)(0xD800 + (codePoint >> 10));
+            *characters++ = (unichar)(0xDC00 + (codePoint & 0x3FF));
+        } else {
+            *characters++ = (unichar)codePoint;
+        }
+    }
+}
+
+@implementation SRUTF8String {
+    os_unfair_lock _lock;
+    NSUInteger _length;
+    BOOL _hasLength;
+    NSString *_string;
+    NSData *_nullTerminatedData;
+}
+
+///--------------------------------------
+#pragma mark - Init
+///--------------------------------------
+
+- (nullable instancetype)initWithUTF8Data:(NSData *)data
+{
+    if (!SRUTF8IsValid(data.bytes, data.length)) {
+        return nil;
+    }
+    return [self initWithValidatedUTF8Data:[data copy]];
+}
+
+- (instancetype)initWithValidatedUTF8Data:(NSData *)data
+{
+    self = [super init];
+    if (!self) return self;
+
+    _UTF8Data = data;
+    _lock = OS_UNFAIR_LOCK_INIT;
+
+    return self;
+}
+
+///--------------------------------------
+#pragma mark - Transcoding
+///--------------------------------------
+
+- (NSString *)_string
+{
+    os_unfair_lock_lock(&_lock);
+    if (!_string) {
+        NSUInteger length = (_hasLength ? _length : SRUTF16LengthOfUTF8Bytes(_UTF8Data.bytes, _UTF8Data.length));
+        unichar *characters = malloc(MAX(length, 1) * sizeof(unichar));
+        SRUTF16FromUTF8Bytes(_UTF8Data.bytes, _UTF8Data.length, characters);
+        _string = [[NSString alloc] initWithCharactersNoCopy:characters length:length freeWhenDone:YES];
+        _length = length;
+        _hasLength = YES;
+    }
+    NSString *string = _string;
+    os_unfair_lock_unlock(&_lock);
+    return string;
+}
+
+///--------------------------------------
+#pragma mark - NSString
+///--------------------------------------
+
+- (NSUInteger)length
+{
+    os_unfair_lock_lock(&_lock);
+    if (!_hasLength) {
+        _length = (_string ? _string.length : SRUTF16LengthOfUTF8Bytes(_UTF8Data.bytes, _UTF8Data.length));
+        _hasLength = YES;
+    }
+    NSUInteger length = _length;
+    os_unfair_lock_unlock(&_lock);
+    return length;
+}
+
+- (unichar)characterAtIndex:(NSUInteger)index
+{
+    return [[self _string] characterAtIndex:index];
+}
+
+- (void)getCharacters:(unichar *)buffer range:(NSRange)range
+{
+    [[self _string] getCharacters:buffer range:range];
+}
+
+- (NSStringEncoding)fastestEncoding
+{
+    return NSUTF8StringEncoding;
+}
+
+- (NSStringEncoding)smallestEncoding
+{
+    return NSUTF8StringEncoding;
+}
+
+- (NSUInteger)lengthOfBytesUsingEncoding:(NSStringEncoding)encoding
+{
+    if (encoding == NSUTF8StringEncoding) {
+        return _UTF8Data.length;
+    }
+    return [super lengthOfBytesUsingEncoding:encoding];
+}
+
+- (nullable NSData *)dataUsingEncoding:(NSStringEncoding)encoding
+{
+    if (encoding == NSUTF8StringEncoding) {
+        return _UTF8Data;
+    }
+    return [super dataUsingEncoding:encoding];
+}
+
+- (nullable const char *)UTF8String
+{
+    // The returned pointer must stay valid at least as long as the autorelease pool,
+    // so the terminated copy is kept for the lifetime of the string.
+    os_unfair_lock_lock(&_lock);
+    if (!_nullTerminatedData) {
+        NSMutableData *data = [NSMutableData dataWithCapacity:_UTF8Data.length + 1];
+        [data appendData:_UTF8Data];
+        [data appendBytes:"" length:1];
+        _nullTerminatedData = data;
+    }
+    const char *string = _nullTerminatedData.bytes;
+    os_unfair_lock_unlock(&_lock);
+    return string;
+}
+
+- (BOOL)getCString:(char *)buffer maxLength:(NSUInteger)maxBufferCount encoding:(NSStringEncoding)encoding
+{
+    if (encoding != NSUTF8StringEncoding) {
+        return [super getCString:buffer maxLength:maxBufferCount encoding:encoding];
+    }
+    if (_UTF8Data.length + 1 > maxBufferCount) {
+        return NO;
+    }
+    [_UTF8Data getBytes:buffer length:_UTF8Data.length];
+    buffer[_UTF8Data.length] = '\0';
+    return YES;
+}
+
+- (BOOL)isEqualToString:(NSString *)string
+{
+    if ([string isKindOfClass:[SRUTF8String class]]) {
+        return [_UTF8Data isEqualToData:((SRUTF8String *)string).UTF8Data];
+    }
+    return [super isEqualToString:string];
+}
+
+///--------------------------------------
+#pragma mark - NSCopying
+///--------------------------------------
+
+- (id)copyWithZone:(nullable NSZone *)zone
+{
+    return self;
+}
+
+///--------------------------------------
+#pragma mark - NSCoding
+///--------------------------------------
+
+- (Class)classForCoder
+{
+    return [NSString class];
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
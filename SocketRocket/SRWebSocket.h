@@ -11,6 +11,8 @@
 
 #import <Foundation/Foundation.h>
 
+#import <SocketRocket/SRSendHandle.h>
+
 NS_ASSUME_NONNULL_BEGIN
 
 typedef NS_ENUM(NSInteger, SRReadyState) {
@@ -45,8 +47,45 @@ typedef NS_ENUM(NSInteger, SRStatusCode) {
     // 4000-4999: Available for use by applications.
 };
 
+/**
+ Priority of an outgoing data message.
+
+ Control frames (ping, pong) are always sent before any data messages and may be interleaved between fragments of a large message.
+ Data messages are never interleaved with each other, so a higher priority message waits only for the message that is currently being sent.
+ */
+typedef NS_ENUM(NSInteger, SRSendPriority) {
+    SRSendPriorityHigh = 0,
+    SRSendPriorityDefault = 1,
+    SRSendPriorityLow = 2,
+};
+
+/**
+ Counters of the work done while reading incoming messages, returned by `-[SRWebSocket readStatistics]`.
+ */
+typedef struct {
+    /** Number of text and binary messages delivered to the delegate. */
+    uint64_t messageCount;
+    /** Number of messages delivered without copying the payload out of the buffer it was read into. */
+    uint64_t zeroCopyMessageCount;
+    /** Number of buffers allocated to assemble or unmask message payloads. */
+    uint64_t bufferAllocationCount;
+    /** Number of payload bytes copied to assemble or unmask messages. */
+    uint64_t bytesCopied;
+} SRReadStatistics;
+
+/**
+ Counters of messages sent with a conflation key, returned by `-[SRWebSocket conflationStatistics]`.
+ */
+typedef struct {
+    /** Number of queued messages that were replaced by a newer message with the same key before they were sent. */
+    uint64_t conflatedMessageCount;
+    /** Number of queued messages that were discarded without being fully sent, because the connection closed or failed. */
+    uint64_t droppedMessageCount;
+} SRConflationStatistics;
+
 @class SRWebSocket;
 @class SRSecurityPolicy;
+@class SRPreparedMessage;
 
 /**
  Error domain used for errors reported by SRWebSocket.
@@ -58,7 +97,9 @@ extern NSString *const SRWebSocketErrorDomain;
  */
 extern NSString *const SRHTTPResponseErrorKey;
 
+@protocol SRTransport;
 @protocol SRWebSocketDelegate;
+@protocol SRWebSocketMessageDecoder;
 
 ///--------------------------------------
 #pragma mark - SRWebSocket
@@ -90,6 +131,15 @@ extern NSString *const SRHTTPResponseErrorKey;
  */
 @property (nullable, nonatomic, strong) NSOperationQueue *delegateOperationQueue;
 
+/**
+ A decoder for received text and binary messages, e.g. from JSON or protobuf into model objects.
+
+ When set, messages are decoded concurrently on a background queue, and decoded objects are delivered
+ to `webSocket:didReceiveDecodedMessage:` instead of the other message delegate methods.
+ All delegate calls, including the ones for decoded messages, are still made in the order events happened on the connection.
+ */
+@property (nullable, atomic, strong) id<SRWebSocketMessageDecoder> messageDecoder;
+
 /**
  Current ready state of the socket. Default: `SR_CONNECTING`.
 
@@ -123,6 +173,82 @@ extern NSString *const SRHTTPResponseErrorKey;
  */
 @property (nonatomic, assign, readonly) BOOL allowsUntrustedSSLCertificates;
 
+/**
+ Maximum payload size of a single outgoing frame. Data messages larger than this are split into fragments,
+ so that control frames (like pong) don't wait for the whole message to be written.
+ Messages of at least `concurrentProcessingThreshold` are split into fragments of at least that size instead.
+ Set to `0` to disable fragmentation. Default: `64KB`.
+ */
+@property (atomic, assign) NSUInteger outgoingFragmentSize;
+
+/**
+ Maximum number of received bytes this socket holds, including messages that are being assembled
+ and messages that were read but not yet handled by the delegate.
+ When reached, the socket stops reading from the network until the delegate catches up.
+ Messages larger than this close the connection with `SRStatusCodeMessageTooBig`. Default: `256MB`.
+ */
+@property (atomic, assign) NSUInteger maximumReceiveBufferSize;
+
+/**
+ Maximum number of received messages that were dispatched to the delegate, but not yet handled by it.
+ When reached, the socket stops parsing frames and reading from the network until the delegate catches up,
+ so a stalled delegate queue applies TCP backpressure to the sender instead of accumulating messages in memory.
+ Default: `0`, the number of messages is limited only by `maximumReceiveBufferSize`.
+ */
+@property (atomic, assign) NSUInteger maximumUndeliveredMessageCount;
+
+/**
+ Size above which an incoming message is assembled in a temporary file instead of in memory,
+ and delivered to the delegate as memory-mapped `NSData`, so that large messages don't stay resident.
+ Such messages don't count towards `maximumReceiveBufferSize`, but are limited by `maximumSpilledMessageSize`.
+ Default: `0`, all messages are assembled in memory.
+ */
+@property (atomic, assign) NSUInteger messageSpillThreshold;
+
+/**
+ Maximum size of an incoming message that is assembled in a temporary file, see `messageSpillThreshold`.
+ Larger messages close the connection with `SRStatusCodeMessageTooBig`, so a peer can't fill the disk. Default: `1GB`.
+ */
+@property (atomic, assign) NSUInteger maximumSpilledMessageSize;
+
+/**
+ Payload size above which masking of an outgoing frame, and UTF-8 validation of an incoming text message,
+ are split into chunks processed on all cores, so a single huge message doesn't hold up the connection for as long.
+ Every frame is masked with its own key, so an outgoing message of at least this size is sent in fragments
+ of at least this size (see `outgoingFragmentSize`), and control frames may wait for as many bytes to be written.
+ Set to `0` to always process payloads serially. Default: `1MB`.
+ */
+@property (atomic, assign) NSUInteger concurrentProcessingThreshold;
+
+/**
+ A boolean value indicating whether text and binary messages can be sent while the socket is still connecting.
+ Such messages are queued and written right after the opening handshake succeeds, before `webSocketDidOpen:` is called,
+ or are discarded if the socket fails or is closed before opening. Default: `NO`, sending fails until the socket is open.
+ */
+@property (atomic, assign) BOOL queuesMessagesBeforeOpen;
+
+/**
+ A boolean value indicating whether this socket tries to open over a shared HTTP/2 connection with extended CONNECT (RFC 8441),
+ multiplexed with other sockets to the same origin. Servers that don't support it are remembered and opened with an HTTP/1.1 upgrade,
+ as are all `wss://` URLs, since HTTP/2 is only negotiated over cleartext connections with prior knowledge.
+ Must be set before calling `open`. Default: `NO`.
+ */
+@property (atomic, assign) BOOL allowsHTTP2;
+
+/**
+ URL of a file to record all raw bytes read from and written to the network into, with timestamps.
+ The file can be replayed through a socket with `SRWebSocketReplay`, without a network connection.
+ Must be set before calling `open`. Default: `nil`, nothing is recorded.
+ */
+@property (nullable, nonatomic, copy) NSURL *captureURL;
+
+/**
+ A boolean value indicating whether this socket records recent frames and state transitions into a small in-memory ring,
+ which is logged when the socket fails and is available via `traceDescription`.
+ Recording is lock-free and cheap enough to leave enabled in production. Must be set before calling `open`. Default: `NO`.
+ */
+@property (nonatomic, assign, getter=isTraceEnabled) BOOL traceEnabled;
+
 ///--------------------------------------
 #pragma mark - Constructors
 ///--------------------------------------
@@ -245,6 +371,15 @@ extern NSString *const SRHTTPResponseErrorKey;
  */
 - (void)open;
 
+/**
+ Opens web socket over a given transport instead of connecting to its URL, and performs the opening handshake over it.
+ `allowsHTTP2` and TLS settings don't apply, the transport is responsible for delivering bytes to the server.
+ Like `open`, this method should be called once and only once, instead of `open`.
+
+ @param transport A transport that was not opened yet, for example one end of an `SRLoopbackTransport` pair.
+ */
+- (void)openWithTransport:(id<SRTransport>)transport NS_SWIFT_NAME(open(transport:));
+
 /**
  Closes a web socket using `SRStatusCodeNormal` code and no reason.
  */
@@ -295,6 +430,68 @@ extern NSString *const SRHTTPResponseErrorKey;
  */
 - (BOOL)sendData:(nullable NSData *)data error:(NSError **)error NS_SWIFT_NAME(send(data:));
 
+/**
+ Send a UTF-8 String to the server with a given priority.
+
+ @param string   String to send.
+ @param priority Priority of the message relative to other queued messages.
+ @param error    On input, a pointer to variable for an `NSError` object.
+ If an error occurs, this pointer is set to an `NSError` object containing information about the error.
+ You may specify `nil` to ignore the error information.
+
+ @return `YES` if the string was scheduled to send, otherwise - `NO`.
+ */
+- (BOOL)sendString:(NSString *)string priority:(SRSendPriority)priority error:(NSError **)error NS_SWIFT_NAME(send(string:priority:));
+
+/**
+ Send binary data to the server with a given priority.
+
+ @param data     Data to send.
+ @param priority Priority of the message relative to other queued messages.
+ @param error    On input, a pointer to variable for an `NSError` object.
+ If an error occurs, this pointer is set to an `NSError` object containing information about the error.
+ You may specify `nil` to ignore the error information.
+
+ @return `YES` if the data was scheduled to send, otherwise - `NO`.
+ */
+- (BOOL)sendData:(nullable NSData *)data priority:(SRSendPriority)priority error:(NSError **)error NS_SWIFT_NAME(send(data:priority:));
+
+/**
+ Send a UTF-8 String to the server with a given priority, and get notified once it was written.
+
+ @param string     String to send.
+ @param priority   Priority of the message relative to other queued messages.
+ @param completion Called on the delegate queue once the message was fully written to the network stream,
+ or with an error if it was cancelled or the connection closed before that.
+ @param error      On input, a pointer to variable for an `NSError` object.
+ If an error occurs, this pointer is set to an `NSError` object containing information about the error.
+ You may specify `nil` to ignore the error information.
+
+ @return A handle that can cancel the message until it starts transmitting, or `nil` if the string couldn't be scheduled to send.
+ */
+- (nullable SRSendHandle *)sendString:(NSString *)string
+                             priority:(SRSendPriority)priority
+                           completion:(nullable SRSendCompletionHandler)completion
+                                error:(NSError **)error NS_SWIFT_NAME(send(string:priority:completion:));
+
+/**
+ Send binary data to the server with a given priority, and get notified once it was written.
+
+ @param data       Data to send.
+ @param priority   Priority of the message relative to other queued messages.
+ @param completion Called on the delegate queue once the message was fully written to the network stream,
+ or with an error if it was cancelled or the connection closed before that.
+ @param error      On input, a pointer to variable for an `NSError` object.
+ If an error occurs, this pointer is set to an `NSError` object containing information about the error.
+ You may specify `nil` to ignore the error information.
+
+ @return A handle that can cancel the message until it starts transmitting, or `nil` if the data couldn't be scheduled to send.
+ */
+- (nullable SRSendHandle *)sendData:(nullable NSData *)data
+                           priority:(SRSendPriority)priority
+                         completion:(nullable SRSendCompletionHandler)completion
+                              error:(NSError **)error NS_SWIFT_NAME(send(data:priority:completion:));
+
 /**
  Send binary data to the server, without making a defensive copy of it first.
 
@@ -307,6 +504,64 @@ extern NSString *const SRHTTPResponseErrorKey;
  */
 - (BOOL)sendDataNoCopy:(nullable NSData *)data error:(NSError **)error NS_SWIFT_NAME(send(dataNoCopy:));
 
+/**
+ Send a UTF-8 String to the server, replacing a queued message with the same key that did not start transmitting yet.
+ The replaced message is never sent, and the new one takes its place in the queue.
+ Use this for state updates where only the latest value per key matters.
+
+ @param string        String to send.
+ @param conflationKey Key identifying the value that `string` is an update of.
+ @param error         On input, a pointer to variable for an `NSError` object.
+ If an error occurs, this pointer is set to an `NSError` object containing information about the error.
+ You may specify `nil` to ignore the error information.
+
+ @return `YES` if the string was scheduled to send, otherwise - `NO`.
+ */
+- (BOOL)sendString:(NSString *)string conflationKey:(NSString *)conflationKey error:(NSError **)error NS_SWIFT_NAME(send(string:conflationKey:));
+
+/**
+ Send binary data to the server, replacing a queued message with the same key that did not start transmitting yet.
+ The replaced message is never sent, and the new one takes its place in the queue.
+ Use this for state updates where only the latest value per key matters.
+
+ @param data          Data to send.
+ @param conflationKey Key identifying the value that `data` is an update of.
+ @param error         On input, a pointer to variable for an `NSError` object.
+ If an error occurs, this pointer is set to an `NSError` object containing information about the error.
+ You may specify `nil` to ignore the error information.
+
+ @return `YES` if the data was scheduled to send, otherwise - `NO`.
+ */
+- (BOOL)sendData:(NSData *)data conflationKey:(NSString *)conflationKey error:(NSError **)error NS_SWIFT_NAME(send(data:conflationKey:));
+
+/**
+ Send a message that was encoded in advance. Use this to send the same payload repeatedly, or to many sockets,
+ without converting, copying and framing it again every time.
+
+ @param message Message to send.
+ @param error   On input, a pointer to variable for an `NSError` object.
+ If an error occurs, this pointer is set to an `NSError` object containing information about the error.
+ You may specify `nil` to ignore the error information.
+
+ @return `YES` if the message was scheduled to send, otherwise - `NO`.
+ */
+- (BOOL)sendPreparedMessage:(SRPreparedMessage *)message error:(NSError **)error NS_SWIFT_NAME(send(preparedMessage:));
+
+/**
+ Send a message that was encoded in advance with a given priority.
+
+ @param message  Message to send.
+ @param priority Priority of the message relative to other queued messages.
+ @param error    On input, a pointer to variable for an `NSError` object.
+ If an error occurs, this pointer is set to an `NSError` object containing information about the error.
+ You may specify `nil` to ignore the error information.
+
+ @return `YES` if the message was scheduled to send, otherwise - `NO`.
+ */
+- (BOOL)sendPreparedMessage:(SRPreparedMessage *)message
+                   priority:(SRSendPriority)priority
+                      error:(NSError **)error NS_SWIFT_NAME(send(preparedMessage:priority:));
+
 /**
  Send Ping message to the server with optional data.
 
@@ -319,6 +574,72 @@ extern NSString *const SRHTTPResponseErrorKey;
  */
 - (BOOL)sendPing:(nullable NSData *)data error:(NSError **)error NS_SWIFT_NAME(sendPing(_:));
 
+///--------------------------------------
+#pragma mark Queue Depth
+///--------------------------------------
+
+/**
+ Number of messages with a given priority that are queued and were not yet fully framed.
+ Framed messages may still wait in the output buffer until the transport accepts them, they are not counted here.
+ This method is thread-safe.
+ */
+- (NSUInteger)queuedMessageCountForPriority:(SRSendPriority)priority;
+
+/**
+ Number of payload bytes with a given priority that are queued and were not yet framed.
+ A message is framed in `outgoingFragmentSize` fragments as the output buffer drains,
+ framed bytes that wait in the output buffer are not counted here.
+ This method is thread-safe.
+ */
+- (NSUInteger)queuedByteCountForPriority:(SRSendPriority)priority;
+
+/**
+ Counters of messages sent with `sendString:conflationKey:error:` or `sendData:conflationKey:error:`
+ that were replaced by newer values or dropped before being sent.
+ This method is thread-safe.
+ */
+- (SRConflationStatistics)conflationStatistics;
+
+///--------------------------------------
+#pragma mark Memory Budget
+///--------------------------------------
+
+/**
+ Maximum number of bytes that all sockets in the process may buffer together, for both received and queued outgoing data.
+ When it is reached, sockets stop reading until their delegates catch up or other sockets release enough of it,
+ and sending new messages fails. `0` means there is no limit.
+ Default: `0`.
+ */
+@property (class, atomic, assign) NSUInteger globalMemoryBudget;
+
+/**
+ A boolean value indicating whether sockets that buffer the most data stop reading from the network
+ when the system reports critical memory pressure, until the pressure returns to normal.
+ Regardless of this value, sockets release pooled objects and consumed buffers on memory pressure. Default: `NO`.
+ */
+@property (class, atomic, assign) BOOL pausesReadsUnderMemoryPressure;
+
+///--------------------------------------
+#pragma mark Read Statistics
+///--------------------------------------
+
+/**
+ Counters of messages read by this socket and of the payload copies that were made for them.
+ Single-frame messages that arrive complete and in one contiguous read are delivered without a copy,
+ as `NSData` that references the read buffer directly.
+ This method is thread-safe.
+ */
+- (SRReadStatistics)readStatistics;
+
+///--------------------------------------
+#pragma mark Tracing
+///--------------------------------------
+
+/**
+ Returns a human-readable dump of recorded trace events, oldest first, or `nil` if tracing is not enabled.
+ */
+- (nullable NSString *)traceDescription;
+
 @end
 
 ///--------------------------------------
@@ -349,6 +670,7 @@ extern NSString *const SRHTTPResponseErrorKey;
 
  @param webSocket An instance of `SRWebSocket` that received a message.
  @param string    Received text in a form of UTF-8 `String`.
+ The string is an instance of `SRUTF8String`, which exposes the received bytes as `UTF8Data` without transcoding them.
  */
 - (void)webSocket:(SRWebSocket *)webSocket didReceiveMessageWithString:(NSString *)string;
 
@@ -360,6 +682,23 @@ extern NSString *const SRHTTPResponseErrorKey;
  */
 - (void)webSocket:(SRWebSocket *)webSocket didReceiveMessageWithData:(NSData *)data;
 
+/**
+ Called when a message was decoded by the `messageDecoder` of a web socket.
+
+ @param webSocket An instance of `SRWebSocket` that received a message.
+ @param message   Object returned by `messageDecoder`.
+ */
+- (void)webSocket:(SRWebSocket *)webSocket didReceiveDecodedMessage:(id)message;
+
+/**
+ Called when the `messageDecoder` of a web socket failed to decode a message.
+
+ @param webSocket An instance of `SRWebSocket` that received a message.
+ @param message   Received message that failed to decode. Either a `String` or `NSData`.
+ @param error     Error returned by `messageDecoder` or `nil`.
+ */
+- (void)webSocket:(SRWebSocket *)webSocket didFailToDecodeMessage:(id)message error:(nullable NSError *)error;
+
 #pragma mark Status & Connection
 
 /**
@@ -415,4 +754,26 @@ extern NSString *const SRHTTPResponseErrorKey;
 
 @end
 
+///--------------------------------------
+#pragma mark - SRWebSocketMessageDecoder
+///--------------------------------------
+
+/**
+ Decodes received messages off the delegate queue. Methods are called concurrently from multiple threads.
+ */
+@protocol SRWebSocketMessageDecoder <NSObject>
+
+/**
+ Decodes a received message.
+
+ @param webSocket An instance of `SRWebSocket` that received a message.
+ @param message   Received message. Either an `SRUTF8String` for text messages, or `NSData` for binary messages.
+ @param error     On failure, set to an `NSError` object describing the failure, which is passed to the delegate.
+
+ @return Decoded message or `nil` if decoding failed.
+ */
+- (nullable id)webSocket:(SRWebSocket *)webSocket decodeMessage:(id)message error:(NSError **)error;
+
+@end
+
 NS_ASSUME_NONNULL_END
@@ -11,15 +11,8 @@
 
 #import "SRWebSocket.h"
 
-#if __has_include(<unicode/utf8.h>)
-#define HAS_ICU
-#endif
-
-#ifdef HAS_ICU
-#import <unicode/utf8.h>
-#endif
-
 #import <os/lock.h>
+#import <stdatomic.h>
 
 #import "SRDelegateController.h"
 #import "SRIOConsumer.h"
@@ -32,10 +25,24 @@
 #import "SRProxyConnect.h"
 #import "SRSecurityPolicy.h"
 #import "SRHTTPConnectMessage.h"
-#import "SRRandom.h"
+#import "SRHTTP2ConnectionPool.h"
 #import "SRLog.h"
+#import "SRMemoryBudget.h"
 #import "SRMutex.h"
-#import "SRSIMDHelpers.h"
+#import "SRFrame.h"
+#import "SRHandshake.h"
+#import "SRMasking.h"
+#import "SRUTF8.h"
+#import "SRUTF8String+Private.h"
+#import "SROutgoingMessageQueue.h"
+#import "SRPreparedMessage+Private.h"
+#import "SRSendHandle+Private.h"
+#import "SRSpillFile.h"
+#import "SRSystemApply.h"
+#import "SRStreamTransport.h"
+#import "SRTraceRing.h"
+#import "SRWireCaptureWriter.h"
+#import "SRWebSocket+Private.h"
 #import "NSURLRequest+SRWebSocketPrivate.h"
 #import "NSRunLoop+SRWebSocketPrivate.h"
 #import "SRConstants.h"
@@ -50,29 +57,62 @@ __attribute__((used)) static void importCategories(void)
     import_NSRunLoop_SRWebSocket();
 }
 
-typedef struct {
-    BOOL fin;
-    //  BOOL rsv1;
-    //  BOOL rsv2;
-    //  BOOL rsv3;
-    uint8_t opcode;
-    BOOL masked;
-    uint64_t payload_length;
-} frame_header;
-
-static NSString *const SRWebSocketAppendToSecKeyString = @"258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
-
-static inline int32_t validate_dispatch_data_partial_string(NSData *data);
-
 static uint8_t const SRWebSocketProtocolVersion = 13;
 
 // Max frame payload length for all frames is 256MB, which is reasonable max.
 static const uint32_t SRWebSocketMaxFramePayloadLength = 256 * 1024 * 1024;
+static const NSUInteger SRWebSocketDefaultMaximumSpilledMessageSize = 1024 * 1024 * 1024;
+
+// Default max payload length of outgoing frames, larger messages are fragmented.
+static const NSUInteger SRWebSocketDefaultOutgoingFragmentSize = 64 * 1024;
+
+// Default payload size above which masking and UTF-8 validation run on all cores.
+static const NSUInteger SRWebSocketDefaultConcurrentProcessingThreshold = 1024 * 1024;
+
+static NSError *SRSendCancelledError(void)
+{
+    return SRErrorWithCodeDescription(2137, @"Message was cancelled before it was sent.");
+}
+
+static NSError *SRSendConnectionClosedError(void)
+{
+    return SRErrorWithCodeDescription(2138, @"Connection closed before the message was sent.");
+}
+
+static NSError *SRSendMessageTooBigError(void)
+{
+    return SRErrorWithCodeDescription(2141, @"Message is too big to be sent.");
+}
+
+// Number of most recent events kept when tracing is enabled.
+static const NSUInteger SRWebSocketTraceRingCapacity = 256;
+
+typedef NS_ENUM(NSUInteger, SRReadCounter) {
+    SRReadCounterMessages = 0,
+    SRReadCounterZeroCopyMessages,
+    SRReadCounterBufferAllocations,
+    SRReadCounterBytesCopied,
+    SRReadCounterCount
+};
+
+// Allowed state transitions, indexed by [from][to]. States only move forward.
+static const BOOL SRReadyStateTransitions[SR_CLOSED + 1][SR_CLOSED + 1] = {
+    //                 CONNECTING  OPEN  CLOSING  CLOSED
+    [SR_CONNECTING] = { NO,        YES,  YES,     YES },
+    [SR_OPEN]       = { NO,        NO,   YES,     YES },
+    [SR_CLOSING]    = { NO,        NO,   NO,      YES },
+    [SR_CLOSED]     = { NO,        NO,   NO,      NO  },
+};
+
+static inline BOOL SRReadyStateTransitionIsAllowed(SRReadyState from, SRReadyState to)
+{
+    return SRReadyStateTransitions[from][to];
+}
 
 NSString *const SRWebSocketErrorDomain = @"SRWebSocketErrorDomain";
 NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 
-@interface SRWebSocket ()  <NSStreamDelegate>
+@interface SRWebSocket ()  <SRTransportDelegate, SRMemoryBudgetClient>
 
 @property (atomic, assign, readwrite) SRReadyState readyState;
 
@@ -87,26 +127,42 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 @end
 
 @implementation SRWebSocket {
-    SRMutex _kvoLock;
-    os_unfair_lock _propertyLock;
+    _Atomic(SRReadyState) _readyState;
+    SRMutex _kvoLock; // Only used when `readyState` is observed.
+    // Guards `_scheduledRunloops` and writes to `_transport`. `_transport` is read unlocked only where it can't change
+    // concurrently: on the work queue, right after attaching it and in `dealloc`. Never held while calling into the transport.
+    os_unfair_lock _streamLock;
 
     dispatch_queue_t _workQueue;
     NSMutableArray<SRIOConsumer *> *_consumers;
 
-    NSInputStream *_inputStream;
-    NSOutputStream *_outputStream;
+    id<SRTransport> _transport;
 
     dispatch_data_t _readBuffer;
     NSUInteger _readBufferOffset;
 
     dispatch_data_t _outputBuffer;
     NSUInteger _outputBufferOffset;
+    uint64_t _outputBytesWritten; // Total number of bytes written to `_transport`.
+    SROutgoingMessageQueue *_outgoingQueue;
+    NSMutableArray<SRSendHandle *> *_pendingSendHandles; // Messages that were framed, but not yet written, ordered by `outputEndOffset`.
+    SRTraceRing *_traceRing;
+    SRWireCaptureWriter *_captureWriter;
 
     uint8_t _currentFrameOpcode;
     size_t _currentFrameCount;
     size_t _readOpCount;
-    uint32_t _currentStringScanPosition;
+    SRUTF8Validator _currentStringValidator;
     NSMutableData *_currentFrameData;
+    SRSpillFile *_currentFrameFile; // Used instead of `_currentFrameData` for messages above `messageSpillThreshold`.
+    _Atomic(uint64_t) _readCounters[SRReadCounterCount];
+
+    _Atomic(NSUInteger) _chargedMemoryBytes; // Buffered bytes charged to the memory budget, except `_pendingDelegateBytes`.
+    _Atomic(NSUInteger) _pendingDelegateBytes; // Bytes of messages that were dispatched to the delegate, but not yet handled.
+    _Atomic(NSUInteger) _pendingDelegateMessageCount; // Messages that were dispatched to the delegate, but not yet handled.
+    atomic_bool _readsPaused; // Reading stopped while bytes were still available.
+    atomic_bool _scanningPaused; // Parsing stopped while the delegate has `maximumUndeliveredMessageCount` messages to handle.
+    BOOL _readsPausedForMemoryPressure;
 
     NSString *_closeReason;
 
@@ -126,7 +182,7 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 
     BOOL _sentClose;
     BOOL _didFail;
-    BOOL _cleanupScheduled;
+    atomic_bool _cleanupScheduled;
     int _closeCode;
 
     BOOL _isPumping;
@@ -143,8 +199,6 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
     SRProxyConnect *_proxyConnect;
 }
 
-@synthesize readyState = _readyState;
-
 ///--------------------------------------
 #pragma mark - Init
 ///--------------------------------------
@@ -161,9 +215,10 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
     _securityPolicy = securityPolicy;
     _requestRequiresSSL = SRURLRequiresSSL(_url);
 
-    _readyState = SR_CONNECTING;
+    atomic_init(&_readyState, SR_CONNECTING);
+    atomic_init(&_cleanupScheduled, false);
 
-    _propertyLock = OS_UNFAIR_LOCK_INIT;
+    _streamLock = OS_UNFAIR_LOCK_INIT;
     _kvoLock = SRMutexInitRecursive();
     _workQueue = dispatch_queue_create(NULL, DISPATCH_QUEUE_SERIAL);
 
@@ -174,8 +229,21 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 
     _readBuffer = dispatch_data_empty;
     _outputBuffer = dispatch_data_empty;
+    _outgoingQueue = [[SROutgoingMessageQueue alloc] init];
+    _pendingSendHandles = [NSMutableArray array];
+    _outgoingFragmentSize = SRWebSocketDefaultOutgoingFragmentSize;
+    _concurrentProcessingThreshold = SRWebSocketDefaultConcurrentProcessingThreshold;
 
-    _currentFrameData = [[NSMutableData alloc] init];
+    for (NSUInteger i = 0; i < SRReadCounterCount; i++) {
+        atomic_init(&_readCounters[i], 0);
+    }
+    _maximumReceiveBufferSize = SRWebSocketMaxFramePayloadLength;
+    _maximumSpilledMessageSize = SRWebSocketDefaultMaximumSpilledMessageSize;
+    atomic_init(&_chargedMemoryBytes, 0);
+    atomic_init(&_pendingDelegateBytes, 0);
+    atomic_init(&_pendingDelegateMessageCount, 0);
+    atomic_init(&_readsPaused, false);
+    atomic_init(&_scanningPaused, false);
 
     _consumers = [[NSMutableArray alloc] init];
 
@@ -257,11 +325,8 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 
 - (void)dealloc
 {
-    _inputStream.delegate = nil;
-    _outputStream.delegate = nil;
-
-    [_inputStream close];
-    [_outputStream close];
+    _transport.delegate = nil;
+    [_transport close];
 
     if (_receivedHTTPHeaders) {
         CFRelease(_receivedHTTPHeaders);
@@ -279,28 +344,49 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 
 - (void)setReadyState:(SRReadyState)readyState
 {
+    [self _transitionToReadyState:readyState];
+}
+
+- (SRReadyState)readyState
+{
+    return atomic_load_explicit(&_readyState, memory_order_acquire);
+}
+
+// Returns `YES` if the state was changed, or `NO` if the transition isn't allowed from the current state.
+- (BOOL)_transitionToReadyState:(SRReadyState)readyState
+{
+    // Observers are rare, so don't pay for the lock and change notifications unless there are any.
+    // An observer that is added concurrently with a transition may miss it, same as with any KVO-compliant property.
+    if (self.observationInfo == NULL) {
+        return [self _compareAndSwapReadyState:readyState];
+    }
+
+    BOOL changed = NO;
+    SRMutexLock(_kvoLock);
     @try {
-        SRMutexLock(_kvoLock);
-        if (_readyState != readyState) {
+        if (SRReadyStateTransitionIsAllowed(self.readyState, readyState)) {
             [self willChangeValueForKey:@"readyState"];
-            os_unfair_lock_lock(&_propertyLock);
-            _readyState = readyState;
-            os_unfair_lock_unlock(&_propertyLock);
+            changed = [self _compareAndSwapReadyState:readyState];
             [self didChangeValueForKey:@"readyState"];
         }
     }
     @finally {
         SRMutexUnlock(_kvoLock);
     }
+    return changed;
 }
 
-- (SRReadyState)readyState
+- (BOOL)_compareAndSwapReadyState:(SRReadyState)readyState
 {
-    SRReadyState state = 0;
-    os_unfair_lock_lock(&_propertyLock);
-    state = _readyState;
-    os_unfair_lock_unlock(&_propertyLock);
-    return state;
+    SRReadyState currentState = atomic_load_explicit(&_readyState, memory_order_acquire);
+    do {
+        if (!SRReadyStateTransitionIsAllowed(currentState, readyState)) {
+            return NO;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&_readyState, &currentState, readyState, memory_order_acq_rel, memory_order_acquire));
+
+    [_traceRing recordEventOfType:SRTraceEventTypeStateChange code:(uint8_t)readyState flags:0 value:0];
+    return YES;
 }
 
 + (BOOL)automaticallyNotifiesObserversOfReadyState {
@@ -319,9 +405,30 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
         [self _failWithError:error];
         return;
     }
+    [self _beginOpening];
+
+    if (self.allowsHTTP2) {
+        [self _openHTTP2Stream];
+    } else {
+        [self _openNetworkStream];
+    }
+}
+
+// Work shared by all ways of opening, before a connection exists.
+- (void)_beginOpening
+{
     NSAssert(self.readyState == SR_CONNECTING, @"Cannot call -(void)open on SRWebSocket more than once.");
 
     _selfRetain = self;
+    [[SRMemoryBudget sharedBudget] addClient:self];
+
+    if (self.captureURL) {
+        NSError *captureError = nil;
+        _captureWriter = [[SRWireCaptureWriter alloc] initWithURL:self.captureURL error:&captureError];
+        if (!_captureWriter) {
+            SRErrorLog(@"Unable to record capture: %@", captureError);
+        }
+    }
 
     if (_urlRequest.timeoutInterval > 0) {
         dispatch_time_t popTime = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_urlRequest.timeoutInterval * NSEC_PER_SEC));
@@ -337,8 +444,11 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
             }
         });
     }
+}
 
-    _proxyConnect = [[SRProxyConnect alloc] initWithURL:url];
+- (void)_openNetworkStream
+{
+    _proxyConnect = [[SRProxyConnect alloc] initWithURL:_url];
 
     __weak typeof(self) wself = self;
     [_proxyConnect openNetworkStreamWithCompletion:^(NSError *error, NSInputStream *readStream, NSOutputStream *writeStream) {
@@ -346,29 +456,99 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
     }];
 }
 
+- (void)_openHTTP2Stream
+{
+    NSArray<NSArray<NSString *> *> *headers = SRHTTP2ConnectHeaders(_urlRequest,
+                                                                    SRWebSocketProtocolVersion,
+                                                                    self.requestCookies,
+                                                                    _requestedProtocols);
+    __weak typeof(self) wself = self;
+    [[SRHTTP2ConnectionPool sharedPool] openStreamWithURL:_url headers:headers completion:^(NSInputStream *_Nullable inputStream,
+                                                                                            NSOutputStream *_Nullable outputStream,
+                                                                                            NSDictionary<NSString *, NSString *> *_Nullable responseHeaders,
+                                                                                            NSError *_Nullable error) {
+        __strong SRWebSocket *sself = wself;
+        if (!sself) {
+            [inputStream close];
+            [outputStream close];
+            return;
+        }
+        dispatch_async(sself->_workQueue, ^{
+            [sself _HTTP2StreamDidOpenWithInputStream:inputStream
+                                         outputStream:outputStream
+                                      responseHeaders:responseHeaders
+                                                error:error];
+        });
+    }];
+}
+
+- (void)_HTTP2StreamDidOpenWithInputStream:(nullable NSInputStream *)inputStream
+                              outputStream:(nullable NSOutputStream *)outputStream
+                           responseHeaders:(nullable NSDictionary<NSString *, NSString *> *)responseHeaders
+                                     error:(nullable NSError *)error
+{
+    [self assertOnWorkQueue];
+
+    // The socket may have timed out or been closed while the request was in flight.
+    if (self.readyState != SR_CONNECTING) {
+        [inputStream close];
+        [outputStream close];
+        return;
+    }
+    if (error) {
+        [self _failWithError:error];
+        return;
+    }
+    if (!responseHeaders) {
+        SRDebugLog(@"Falling back to HTTP/1.1 for %@", _url);
+        [self _openNetworkStream];
+        return;
+    }
+    if (!inputStream || !outputStream) {
+        [self _failWithResponseCode:responseHeaders[@":status"].integerValue];
+        return;
+    }
+    if (![self _setNegotiatedProtocol:responseHeaders[@"sec-websocket-protocol"]]) {
+        [inputStream close];
+        [outputStream close];
+        return;
+    }
+
+    [self _attachInputStream:inputStream outputStream:outputStream];
+    [self _didOpen];
+}
+
+- (void)openWithTransport:(id<SRTransport>)transport
+{
+    [self _openWithTransport:transport handshakeKey:nil];
+}
+
+- (void)_openWithInputStream:(NSInputStream *)inputStream outputStream:(NSOutputStream *)outputStream handshakeKey:(NSString *)handshakeKey
+{
+    [self _openWithTransport:[[SRStreamTransport alloc] initWithInputStream:inputStream outputStream:outputStream] handshakeKey:handshakeKey];
+}
+
+- (void)_openWithTransport:(id<SRTransport>)transport handshakeKey:(nullable NSString *)handshakeKey
+{
+    [self _beginOpening];
+    _secKey = [handshakeKey copy];
+    // The transport already carries plain bytes, TLS (if any) is not the socket's concern.
+    _requestRequiresSSL = NO;
+    [self _attachTransport:transport];
+    // The handshake is sent once the transport reports that it is open.
+    [transport openTransport];
+}
+
 - (void)_connectionDoneWithError:(NSError *)error readStream:(NSInputStream *)readStream writeStream:(NSOutputStream *)writeStream
 {
     if (error != nil) {
         [self _failWithError:error];
     } else {
-        _outputStream = writeStream;
-        _inputStream = readStream;
-
-        _inputStream.delegate = self;
-        _outputStream.delegate = self;
-        [self _updateSecureStreamOptions];
+        [self _attachInputStream:readStream outputStream:writeStream];
 
-        if (!_scheduledRunloops.count) {
-            [self scheduleInRunLoop:[NSRunLoop SR_networkRunLoop] forMode:NSDefaultRunLoopMode];
-        }
-
-        // If we don't require SSL validation - consider that we connected.
+        // If we don't require SSL validation - the open event sends the handshake.
         // Otherwise `didConnect` is called when SSL validation finishes.
-        if (!_requestRequiresSSL) {
-            dispatch_async(_workQueue, ^{
-                [self didConnect];
-            });
-        }
+        [_transport openTransport];
     }
     // Schedule to run on a work queue, to make sure we don't run this inline and deallocate `self` inside `SRProxyConnect`.
     // TODO: (nlutsenko) Find a better structure for this, maybe Bolts Tasks?
@@ -377,6 +557,25 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
     });
 }
 
+- (void)_attachInputStream:(NSInputStream *)inputStream outputStream:(NSOutputStream *)outputStream
+{
+    [self _updateSecureOptionsInInputStream:inputStream outputStream:outputStream];
+    [self _attachTransport:[[SRStreamTransport alloc] initWithInputStream:inputStream outputStream:outputStream]];
+}
+
+- (void)_attachTransport:(id<SRTransport>)transport
+{
+    os_unfair_lock_lock(&_streamLock);
+    _transport = transport;
+    BOOL scheduled = (_scheduledRunloops.count > 0);
+    os_unfair_lock_unlock(&_streamLock);
+    transport.delegate = self;
+
+    if (!scheduled) {
+        [self scheduleInRunLoop:[NSRunLoop SR_networkRunLoop] forMode:NSDefaultRunLoopMode];
+    }
+}
+
 - (BOOL)_checkHandshake:(CFHTTPMessageRef)httpMessage
 {
     NSString *acceptHeader = CFBridgingRelease(CFHTTPMessageCopyHeaderFieldValue(httpMessage, CFSTR("Sec-WebSocket-Accept")));
@@ -385,21 +584,19 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
         return NO;
     }
 
-    NSString *concattedString = [_secKey stringByAppendingString:SRWebSocketAppendToSecKeyString];
-    NSData *hashedString = SRSHA1HashFromString(concattedString);
-    NSString *expectedAccept = SRBase64EncodedStringFromData(hashedString);
-    return [acceptHeader isEqualToString:expectedAccept];
+    const char *key = _secKey.UTF8String;
+    char expectedAccept[SRHandshakeAcceptKeyLength + 1];
+    if (!SRHandshakeAcceptKeyCreate(&SRSystemCrypto, key, strlen(key), expectedAccept)) {
+        return NO;
+    }
+    return [acceptHeader isEqualToString:@(expectedAccept)];
 }
 
 - (void)_HTTPHeadersDidFinish:(CFHTTPMessageRef)httpMessage
 {
     NSInteger responseCode = CFHTTPMessageGetResponseStatusCode(httpMessage);
     if (responseCode >= 400) {
-        SRDebugLog(@"Request failed with response code %d", responseCode);
-        NSError *error = SRHTTPErrorWithCodeDescription(responseCode, 2132,
-                                                        [NSString stringWithFormat:@"Received bad response code from server: %d.",
-                                                         (int)responseCode]);
-        [self _failWithError:error];
+        [self _failWithResponseCode:responseCode];
         return;
     }
 
@@ -410,18 +607,46 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
     }
 
     NSString *negotiatedProtocol = CFBridgingRelease(CFHTTPMessageCopyHeaderFieldValue(httpMessage, CFSTR("Sec-WebSocket-Protocol")));
+    if (![self _setNegotiatedProtocol:negotiatedProtocol]) {
+        return;
+    }
+
+    [self _didOpen];
+}
+
+- (void)_failWithResponseCode:(NSInteger)responseCode
+{
+    SRDebugLog(@"Request failed with response code %d", responseCode);
+    NSError *error = SRHTTPErrorWithCodeDescription(responseCode, 2132,
+                                                    [NSString stringWithFormat:@"Received bad response code from server: %d.",
+                                                     (int)responseCode]);
+    [self _failWithError:error];
+}
+
+- (BOOL)_setNegotiatedProtocol:(nullable NSString *)negotiatedProtocol
+{
     if (negotiatedProtocol) {
         // Make sure we requested the protocol
         if ([_requestedProtocols indexOfObject:negotiatedProtocol] == NSNotFound) {
             NSError *error = SRErrorWithCodeDescription(2133, @"Server specified Sec-WebSocket-Protocol that wasn't requested.");
             [self _failWithError:error];
-            return;
+            return NO;
         }
 
         _protocol = negotiatedProtocol;
     }
+    return YES;
+}
 
-    self.readyState = SR_OPEN;
+- (void)_didOpen
+{
+    // The socket may have failed or been closed while the handshake was in flight.
+    if (![self _transitionToReadyState:SR_OPEN]) {
+        return;
+    }
+
+    // Write messages that were sent while connecting, before anything is read or the delegate is called.
+    [self _pumpWriting];
 
     if (!_didFail) {
         [self _readFrameNew];
@@ -462,8 +687,14 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 {
     SRDebugLog(@"Connected");
 
-    _secKey = SRBase64EncodedStringFromData(SRRandomData(16));
-    assert([_secKey length] == 24);
+    // The key is only set in advance when replaying a capture, so the recorded handshake response matches it.
+    if (!_secKey) {
+        char secKey[SRHandshakeKeyLength + 1];
+        if (!SRHandshakeKeyCreate(&SRSystemCrypto, secKey)) {
+            [NSException raise:NSInternalInconsistencyException format:@"Failed to generate random bytes for Sec-WebSocket-Key"];
+        }
+        _secKey = @(secKey);
+    }
 
     CFHTTPMessageRef message = SRHTTPConnectMessageCreate(_urlRequest,
                                                           _secKey,
@@ -479,35 +710,44 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
     [self _readHTTPHeader];
 }
 
-- (void)_updateSecureStreamOptions
+- (void)_updateSecureOptionsInInputStream:(NSInputStream *)inputStream outputStream:(NSOutputStream *)outputStream
 {
     if (_requestRequiresSSL) {
         SRDebugLog(@"Setting up security for streams.");
-        [_securityPolicy updateSecurityOptionsInStream:_inputStream];
-        [_securityPolicy updateSecurityOptionsInStream:_outputStream];
+        [_securityPolicy updateSecurityOptionsInStream:inputStream];
+        [_securityPolicy updateSecurityOptionsInStream:outputStream];
     }
 
     NSString *networkServiceType = SRStreamNetworkServiceTypeFromURLRequest(_urlRequest);
     if (networkServiceType != nil) {
-        [_inputStream setProperty:networkServiceType forKey:NSStreamNetworkServiceType];
-        [_outputStream setProperty:networkServiceType forKey:NSStreamNetworkServiceType];
+        [inputStream setProperty:networkServiceType forKey:NSStreamNetworkServiceType];
+        [outputStream setProperty:networkServiceType forKey:NSStreamNetworkServiceType];
     }
 }
 
 - (void)scheduleInRunLoop:(NSRunLoop *)aRunLoop forMode:(NSString *)mode
 {
-    [_outputStream scheduleInRunLoop:aRunLoop forMode:mode];
-    [_inputStream scheduleInRunLoop:aRunLoop forMode:mode];
-
+    // May be called on any thread, while the transport is being attached.
+    os_unfair_lock_lock(&_streamLock);
+    id<SRTransport> transport = _transport;
     [_scheduledRunloops addObject:@[aRunLoop, mode]];
+    os_unfair_lock_unlock(&_streamLock);
+
+    if ([transport respondsToSelector:@selector(scheduleInRunLoop:forMode:)]) {
+        [transport scheduleInRunLoop:aRunLoop forMode:mode];
+    }
 }
 
 - (void)unscheduleFromRunLoop:(NSRunLoop *)aRunLoop forMode:(NSString *)mode
 {
-    [_outputStream removeFromRunLoop:aRunLoop forMode:mode];
-    [_inputStream removeFromRunLoop:aRunLoop forMode:mode];
-
+    os_unfair_lock_lock(&_streamLock);
+    id<SRTransport> transport = _transport;
     [_scheduledRunloops removeObject:@[aRunLoop, mode]];
+    os_unfair_lock_unlock(&_streamLock);
+
+    if ([transport respondsToSelector:@selector(removeFromRunLoop:forMode:)]) {
+        [transport removeFromRunLoop:aRunLoop forMode:mode];
+    }
 }
 
 - (void)close
@@ -524,17 +764,17 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
         if (!sself) {
           return;
         }
-        if (sself.readyState == SR_CLOSING || sself.readyState == SR_CLOSED) {
-            return;
-        }
-
         BOOL wasConnecting = sself.readyState == SR_CONNECTING;
 
-        sself.readyState = SR_CLOSING;
+        if (![sself _transitionToReadyState:SR_CLOSING]) {
+            return;
+        }
 
         SRDebugLog(@"Closing with code %d reason %@", code, reason);
 
         if (wasConnecting) {
+            // Messages sent while connecting can't be written without a handshake.
+            [sself _failPendingSends];
             [sself closeConnection];
             return;
         }
@@ -592,6 +832,14 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 
             SRDebugLog(@"Failing with error %@", error.localizedDescription);
 
+            SRTraceRing *traceRing = self->_traceRing;
+            if (traceRing) {
+                [traceRing recordEventOfType:SRTraceEventTypeError code:0 flags:0 value:(uint64_t)MAX(error.code, 0)];
+                SRErrorLog(@"Failed with error %@, recent events:\n%@", error.localizedDescription, [traceRing eventsDescription]);
+            }
+
+            // Nothing queued can be delivered anymore.
+            [self _failPendingSends];
             [self closeConnection];
             [self _scheduleCleanup];
         }
@@ -628,9 +876,43 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
     }
 }
 
+- (BOOL)_canSendMessages
+{
+    SRReadyState readyState = self.readyState;
+    return (readyState == SR_OPEN || (readyState == SR_CONNECTING && self.queuesMessagesBeforeOpen));
+}
+
 - (BOOL)sendString:(NSString *)string error:(NSError **)error
 {
-    if (self.readyState != SR_OPEN) {
+    return [self sendString:string priority:SRSendPriorityDefault error:error];
+}
+
+- (BOOL)sendString:(NSString *)string priority:(SRSendPriority)priority error:(NSError **)error
+{
+    return [self _sendString:string priority:priority sendHandle:nil conflationKey:nil error:error];
+}
+
+- (nullable SRSendHandle *)sendString:(NSString *)string
+                             priority:(SRSendPriority)priority
+                           completion:(nullable SRSendCompletionHandler)completion
+                                error:(NSError **)error
+{
+    SRSendHandle *sendHandle = [self _sendHandleWithCompletion:completion];
+    return ([self _sendString:string priority:priority sendHandle:sendHandle conflationKey:nil error:error] ? sendHandle : nil);
+}
+
+- (BOOL)sendString:(NSString *)string conflationKey:(NSString *)conflationKey error:(NSError **)error
+{
+    return [self _sendString:string priority:SRSendPriorityDefault sendHandle:nil conflationKey:conflationKey error:error];
+}
+
+- (BOOL)_sendString:(NSString *)string
+           priority:(SRSendPriority)priority
+         sendHandle:(nullable SRSendHandle *)sendHandle
+      conflationKey:(nullable NSString *)conflationKey
+              error:(NSError **)error
+{
+    if (![self _canSendMessages]) {
         NSString *message = @"Invalid State: Cannot call `sendString:error:` until connection is open.";
         if (error) {
             *error = SRErrorWithCodeDescription(2134, message);
@@ -639,22 +921,67 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
         return NO;
     }
 
+    if ([SRMemoryBudget sharedBudget].isExhausted) {
+        NSString *message = @"Memory budget exhausted: Cannot queue more data until buffered data is sent or received.";
+        if (error) {
+            *error = SRErrorWithCodeDescription(2136, message);
+        }
+        SRDebugLog(message);
+        return NO;
+    }
+
     string = [string copy];
+    conflationKey = [conflationKey copy];
+    SROutgoingLane lane = SROutgoingLaneFromSendPriority(priority);
     dispatch_async(_workQueue, ^{
-        [self _sendFrameWithOpcode:SROpCodeTextFrame data:[string dataUsingEncoding:NSUTF8StringEncoding]];
+        [self _sendFrameWithOpcode:SROpCodeTextFrame
+                              data:[string dataUsingEncoding:NSUTF8StringEncoding]
+                              lane:lane
+                        sendHandle:sendHandle
+                     conflationKey:conflationKey];
     });
     return YES;
 }
 
 - (BOOL)sendData:(nullable NSData *)data error:(NSError **)error
+{
+    return [self sendData:data priority:SRSendPriorityDefault error:error];
+}
+
+- (BOOL)sendData:(nullable NSData *)data priority:(SRSendPriority)priority error:(NSError **)error
+{
+    data = [data copy];
+    return [self _sendDataNoCopy:data priority:priority sendHandle:nil conflationKey:nil error:error];
+}
+
+- (nullable SRSendHandle *)sendData:(nullable NSData *)data
+                           priority:(SRSendPriority)priority
+                         completion:(nullable SRSendCompletionHandler)completion
+                              error:(NSError **)error
+{
+    data = [data copy];
+    SRSendHandle *sendHandle = [self _sendHandleWithCompletion:completion];
+    return ([self _sendDataNoCopy:data priority:priority sendHandle:sendHandle conflationKey:nil error:error] ? sendHandle : nil);
+}
+
+- (BOOL)sendData:(NSData *)data conflationKey:(NSString *)conflationKey error:(NSError **)error
 {
     data = [data copy];
-    return [self sendDataNoCopy:data error:error];
+    return [self _sendDataNoCopy:data priority:SRSendPriorityDefault sendHandle:nil conflationKey:conflationKey error:error];
 }
 
 - (BOOL)sendDataNoCopy:(nullable NSData *)data error:(NSError **)error
 {
-    if (self.readyState != SR_OPEN) {
+    return [self _sendDataNoCopy:data priority:SRSendPriorityDefault sendHandle:nil conflationKey:nil error:error];
+}
+
+- (BOOL)_sendDataNoCopy:(nullable NSData *)data
+               priority:(SRSendPriority)priority
+             sendHandle:(nullable SRSendHandle *)sendHandle
+          conflationKey:(nullable NSString *)conflationKey
+                  error:(NSError **)error
+{
+    if (![self _canSendMessages]) {
         NSString *message = @"Invalid State: Cannot call `sendDataNoCopy:error:` until connection is open.";
         if (error) {
             *error = SRErrorWithCodeDescription(2134, message);
@@ -663,12 +990,57 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
         return NO;
     }
 
+    if ([SRMemoryBudget sharedBudget].isExhausted) {
+        NSString *message = @"Memory budget exhausted: Cannot queue more data until buffered data is sent or received.";
+        if (error) {
+            *error = SRErrorWithCodeDescription(2136, message);
+        }
+        SRDebugLog(message);
+        return NO;
+    }
+
+    conflationKey = [conflationKey copy];
+    SROutgoingLane lane = SROutgoingLaneFromSendPriority(priority);
     dispatch_async(_workQueue, ^{
         if (data) {
-            [self _sendFrameWithOpcode:SROpCodeBinaryFrame data:data];
+            [self _sendFrameWithOpcode:SROpCodeBinaryFrame data:data lane:lane sendHandle:sendHandle conflationKey:conflationKey];
         } else {
-            [self _sendFrameWithOpcode:SROpCodeTextFrame data:nil];
+            [self _sendFrameWithOpcode:SROpCodeTextFrame data:nil lane:lane sendHandle:sendHandle conflationKey:conflationKey];
+        }
+    });
+    return YES;
+}
+
+- (BOOL)sendPreparedMessage:(SRPreparedMessage *)message error:(NSError **)error
+{
+    return [self sendPreparedMessage:message priority:SRSendPriorityDefault error:error];
+}
+
+- (BOOL)sendPreparedMessage:(SRPreparedMessage *)message priority:(SRSendPriority)priority error:(NSError **)error
+{
+    if (![self _canSendMessages]) {
+        NSString *errorMessage = @"Invalid State: Cannot call `sendPreparedMessage:error:` until connection is open.";
+        if (error) {
+            *error = SRErrorWithCodeDescription(2134, errorMessage);
         }
+        SRDebugLog(errorMessage);
+        return NO;
+    }
+
+    if ([SRMemoryBudget sharedBudget].isExhausted) {
+        NSString *errorMessage = @"Memory budget exhausted: Cannot queue more data until buffered data is sent or received.";
+        if (error) {
+            *error = SRErrorWithCodeDescription(2136, errorMessage);
+        }
+        SRDebugLog(errorMessage);
+        return NO;
+    }
+
+    SROutgoingLane lane = SROutgoingLaneFromSendPriority(priority);
+    dispatch_async(_workQueue, ^{
+        SROutgoingMessage *outgoingMessage = [[SROutgoingMessage alloc] initWithOpcode:message.opcode data:message.payload lane:lane];
+        outgoingMessage.preparedMessage = message;
+        [self _enqueueOutgoingMessage:outgoingMessage];
     });
     return YES;
 }
@@ -691,6 +1063,315 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
     return YES;
 }
 
+///--------------------------------------
+#pragma mark - Send Completion
+///--------------------------------------
+
+- (SRSendHandle *)_sendHandleWithCompletion:(nullable SRSendCompletionHandler)completion
+{
+    __weak typeof(self) wself = self;
+    return [[SRSendHandle alloc] initWithCompletion:completion cancelHandler:^(SRSendHandle *handle) {
+        __strong typeof(wself) sself = wself;
+        if (!sself) {
+            return;
+        }
+        // Drop the message right away, instead of when it reaches the front of its lane.
+        dispatch_async(sself->_workQueue, ^{
+            if ([sself->_outgoingQueue removeMessageWithSendHandle:handle]) {
+                [sself _finishSendHandle:handle error:SRSendCancelledError()];
+                [sself _pumpWriting];
+            }
+        });
+    }];
+}
+
+- (void)_finishSendHandle:(SRSendHandle *)sendHandle error:(nullable NSError *)error
+{
+    SRSendCompletionHandler completion = [sendHandle finish];
+    if (completion) {
+        [self.delegateController performDelegateQueueBlock:^{
+            completion(error);
+        }];
+    }
+}
+
+- (void)_finishWrittenSendHandles
+{
+    [self assertOnWorkQueue];
+
+    NSUInteger count = 0;
+    for (SRSendHandle *sendHandle in _pendingSendHandles) {
+        if (sendHandle.outputEndOffset > _outputBytesWritten) {
+            break;
+        }
+        [self _finishSendHandle:sendHandle error:nil];
+        count++;
+    }
+    if (count) {
+        [_pendingSendHandles removeObjectsInRange:NSMakeRange(0, count)];
+    }
+}
+
+// Removes all queued messages, and reports all messages that weren't fully written as failed.
+- (void)_failPendingSends
+{
+    [self assertOnWorkQueue];
+
+    NSError *closedError = SRSendConnectionClosedError();
+    for (SRSendHandle *sendHandle in _pendingSendHandles) {
+        [self _finishSendHandle:sendHandle error:closedError];
+    }
+    [_pendingSendHandles removeAllObjects];
+    for (SROutgoingMessage *message in [_outgoingQueue removeAllMessages]) {
+        [self _finishSendHandle:message.sendHandle error:(message.sendHandle.isCancelled ? SRSendCancelledError() : closedError)];
+    }
+}
+
+///--------------------------------------
+#pragma mark - Queue Depth
+///--------------------------------------
+
+- (NSUInteger)queuedMessageCountForPriority:(SRSendPriority)priority
+{
+    return [_outgoingQueue messageCountInLane:SROutgoingLaneFromSendPriority(priority)];
+}
+
+- (NSUInteger)queuedByteCountForPriority:(SRSendPriority)priority
+{
+    return [_outgoingQueue byteCountInLane:SROutgoingLaneFromSendPriority(priority)];
+}
+
+- (SRConflationStatistics)conflationStatistics
+{
+    return (SRConflationStatistics){
+        .conflatedMessageCount = _outgoingQueue.conflatedMessageCount,
+        .droppedMessageCount = _outgoingQueue.droppedMessageCount,
+    };
+}
+
+///--------------------------------------
+#pragma mark - Memory Budget
+///--------------------------------------
+
++ (NSUInteger)globalMemoryBudget
+{
+    return [SRMemoryBudget sharedBudget].limit;
+}
+
++ (void)setGlobalMemoryBudget:(NSUInteger)globalMemoryBudget
+{
+    [SRMemoryBudget sharedBudget].limit = globalMemoryBudget;
+}
+
++ (BOOL)pausesReadsUnderMemoryPressure
+{
+    return [SRMemoryBudget sharedBudget].pausesReadsUnderMemoryPressure;
+}
+
++ (void)setPausesReadsUnderMemoryPressure:(BOOL)pausesReadsUnderMemoryPressure
+{
+    [SRMemoryBudget sharedBudget].pausesReadsUnderMemoryPressure = pausesReadsUnderMemoryPressure;
+}
+
+// Bytes that were read, but not yet consumed by the parser or the delegate.
+- (NSUInteger)_inboundBacklogSize
+{
+    return (dispatch_data_get_size(_readBuffer) - _readBufferOffset) + atomic_load_explicit(&_pendingDelegateBytes, memory_order_relaxed);
+}
+
+- (void)_updateMemoryCharge
+{
+    [self assertOnWorkQueue];
+
+    NSUInteger chargedBytes = ((dispatch_data_get_size(_readBuffer) - _readBufferOffset) +
+                               _currentFrameData.length +
+                               (dispatch_data_get_size(_outputBuffer) - _outputBufferOffset));
+    for (SROutgoingLane lane = 0; lane < SROutgoingLaneCount; lane++) {
+        chargedBytes += [_outgoingQueue byteCountInLane:lane];
+    }
+
+    NSUInteger previousBytes = atomic_exchange_explicit(&_chargedMemoryBytes, chargedBytes, memory_order_relaxed);
+    if (chargedBytes > previousBytes) {
+        [[SRMemoryBudget sharedBudget] chargeBytes:chargedBytes - previousBytes];
+    } else if (chargedBytes < previousBytes) {
+        [[SRMemoryBudget sharedBudget] releaseBytes:previousBytes - chargedBytes];
+    }
+}
+
+- (void)_releaseMemoryCharge
+{
+    NSUInteger previousBytes = atomic_exchange_explicit(&_chargedMemoryBytes, 0, memory_order_relaxed);
+    [[SRMemoryBudget sharedBudget] releaseBytes:previousBytes];
+}
+
+- (void)_willDeliverMessageWithLength:(NSUInteger)length
+{
+    atomic_fetch_add_explicit(&_pendingDelegateBytes, length, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_pendingDelegateMessageCount, 1, memory_order_relaxed);
+    [[SRMemoryBudget sharedBudget] chargeBytes:length];
+}
+
+// Called on the delegate queue.
+- (void)_didDeliverMessageWithLength:(NSUInteger)length
+{
+    atomic_fetch_sub_explicit(&_pendingDelegateBytes, length, memory_order_relaxed);
+    atomic_fetch_sub(&_pendingDelegateMessageCount, 1);
+    [[SRMemoryBudget sharedBudget] releaseBytes:length];
+
+    if (atomic_load(&_readsPaused) || atomic_load(&_scanningPaused)) {
+        dispatch_async(_workQueue, ^{
+            [self _resumeReadingIfNeeded];
+        });
+    }
+}
+
+// Whether the delegate has as many messages to handle as it may, so no more are parsed.
+- (BOOL)_isDelegateBacklogFull
+{
+    NSUInteger maximumCount = self.maximumUndeliveredMessageCount;
+    return (maximumCount > 0 && atomic_load(&_pendingDelegateMessageCount) >= maximumCount);
+}
+
+- (BOOL)_shouldPauseReading
+{
+    // Reading always continues once everything read so far was consumed, so a message that is being assembled
+    // can always complete. Its size is limited by `maximumReceiveBufferSize` instead.
+    NSUInteger backlogSize = [self _inboundBacklogSize];
+    if (backlogSize == 0) {
+        return NO;
+    }
+    return (_readsPausedForMemoryPressure ||
+            backlogSize + _currentFrameData.length >= self.maximumReceiveBufferSize ||
+            [self _isDelegateBacklogFull] ||
+            [SRMemoryBudget sharedBudget].isExhausted);
+}
+
+- (void)_resumeReadingIfNeeded
+{
+    [self assertOnWorkQueue];
+
+    if (atomic_load(&_scanningPaused) && ![self _isDelegateBacklogFull]) {
+        atomic_store(&_scanningPaused, false);
+        // Parse what was read while paused, this may pause reading again or let it resume below.
+        [self _pumpScanner];
+    }
+    if (atomic_load(&_readsPaused)) {
+        if (![self _shouldPauseReading]) {
+            atomic_store(&_readsPaused, false);
+            // The stream doesn't report available bytes again until they are read, so read them now.
+            [self _readFromTransport];
+        } else {
+            [self _waitForMemoryBudgetIfNeeded];
+        }
+    }
+}
+
+// Nothing this socket does may free the budget, when other sockets hold it, so it asks to be woken up once they do.
+- (void)_waitForMemoryBudgetIfNeeded
+{
+    SRMemoryBudget *budget = [SRMemoryBudget sharedBudget];
+    if (budget.isExhausted) {
+        [budget waitForAvailableBudget:self];
+    }
+}
+
+#pragma mark SRMemoryBudgetClient
+
+- (NSUInteger)memoryBudgetChargedBytes
+{
+    return (atomic_load_explicit(&_chargedMemoryBytes, memory_order_relaxed) +
+            atomic_load_explicit(&_pendingDelegateBytes, memory_order_relaxed));
+}
+
+- (void)memoryBudgetTrimMemory
+{
+    dispatch_async(_workQueue, ^{
+        [self->_consumerPool removeAllConsumers];
+
+        // Drop already consumed regions of the buffers.
+        self->_readBuffer = dispatch_data_create_subrange(self->_readBuffer, self->_readBufferOffset, dispatch_data_get_size(self->_readBuffer) - self->_readBufferOffset);
+        self->_readBufferOffset = 0;
+        self->_outputBuffer = dispatch_data_create_subrange(self->_outputBuffer, self->_outputBufferOffset, dispatch_data_get_size(self->_outputBuffer) - self->_outputBufferOffset);
+        self->_outputBufferOffset = 0;
+
+        [self _updateMemoryCharge];
+    });
+}
+
+- (void)memoryBudgetSetReadsPaused:(BOOL)paused
+{
+    dispatch_async(_workQueue, ^{
+        self->_readsPausedForMemoryPressure = paused;
+        [self _resumeReadingIfNeeded];
+    });
+}
+
+- (void)memoryBudgetDidBecomeAvailable
+{
+    dispatch_async(_workQueue, ^{
+        [self _resumeReadingIfNeeded];
+    });
+}
+
+///--------------------------------------
+#pragma mark - Read Statistics
+///--------------------------------------
+
+- (void)_incrementReadCounter:(SRReadCounter)counter by:(uint64_t)value
+{
+    atomic_fetch_add_explicit(&_readCounters[counter], value, memory_order_relaxed);
+}
+
+- (uint64_t)_readCounter:(SRReadCounter)counter
+{
+    return atomic_load_explicit(&_readCounters[counter], memory_order_relaxed);
+}
+
+- (SRReadStatistics)readStatistics
+{
+    return (SRReadStatistics){
+        .messageCount = [self _readCounter:SRReadCounterMessages],
+        .zeroCopyMessageCount = [self _readCounter:SRReadCounterZeroCopyMessages],
+        .bufferAllocationCount = [self _readCounter:SRReadCounterBufferAllocations],
+        .bytesCopied = [self _readCounter:SRReadCounterBytesCopied],
+    };
+}
+
+///--------------------------------------
+#pragma mark - Tracing
+///--------------------------------------
+
+- (void)setTraceEnabled:(BOOL)traceEnabled
+{
+    _traceRing = (traceEnabled ? (_traceRing ?: [[SRTraceRing alloc] initWithCapacity:SRWebSocketTraceRingCapacity]) : nil);
+}
+
+- (BOOL)isTraceEnabled
+{
+    return (_traceRing != nil);
+}
+
+- (nullable NSString *)traceDescription
+{
+    return [_traceRing eventsDescription];
+}
+
+- (void)_decodeMessage:(id)message withDecoder:(id<SRWebSocketMessageDecoder>)messageDecoder length:(NSUInteger)length
+{
+    [self.delegateController performDecodeBlock:^id _Nullable(NSError **error) {
+        return [messageDecoder webSocket:self decodeMessage:message error:error];
+    } delegateBlock:^(id<SRWebSocketDelegate> _Nullable delegate, SRDelegateAvailableMethods availableMethods, id _Nullable decodedMessage, NSError *_Nullable error) {
+        if (decodedMessage) {
+            if (availableMethods.didReceiveDecodedMessage) {
+                [delegate webSocket:self didReceiveDecodedMessage:decodedMessage];
+            }
+        } else if (availableMethods.didFailToDecodeMessage) {
+            [delegate webSocket:self didFailToDecodeMessage:message error:error];
+        }
+        [self _didDeliverMessageWithLength:length];
+    }];
+}
+
 - (void)_handlePingWithData:(nullable NSData *)data
 {
     // Need to pingpong this off _callbackQueue first to make sure messages happen in order
@@ -715,31 +1396,6 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 }
 
 
-static inline BOOL closeCodeIsValid(int closeCode) {
-    if (closeCode < 1000) {
-        return NO;
-    }
-
-    if (closeCode >= 1000 && closeCode <= 1011) {
-        if (closeCode == 1004 ||
-            closeCode == 1005 ||
-            closeCode == 1006) {
-            return NO;
-        }
-        return YES;
-    }
-
-    if (closeCode >= 3000 && closeCode <= 3999) {
-        return YES;
-    }
-
-    if (closeCode >= 4000 && closeCode <= 4999) {
-        return YES;
-    }
-
-    return NO;
-}
-
 //  Note from RFC:
 //
 //  If there is a body, the first two
@@ -763,7 +1419,7 @@ static inline BOOL closeCodeIsValid(int closeCode) {
     } else if (dataSize >= 2) {
         [data getBytes:&closeCode length:sizeof(closeCode)];
         _closeCode = CFSwapInt16BigToHost(closeCode);
-        if (!closeCodeIsValid(_closeCode)) {
+        if (!SRCloseCodeIsValid((uint16_t)_closeCode)) {
             [self _closeWithProtocolError:[NSString stringWithFormat:@"Cannot have close code of %d", _closeCode]];
             return;
         }
@@ -800,23 +1456,25 @@ static inline BOOL closeCodeIsValid(int closeCode) {
 {
     // Check that the current data is valid UTF8
 
+    // frameData is never mutated after this point, since the current frame buffer is replaced for every new message,
+    // so it is passed to handlers without a copy.
     BOOL isControlFrame = (opcode == SROpCodePing || opcode == SROpCodePong || opcode == SROpCodeConnectionClose);
+    // Messages mapped from a temporary file aren't resident, so they aren't charged to the memory budget.
+    BOOL isMapped = (!isControlFrame && _currentFrameFile != nil);
+    id<SRWebSocketMessageDecoder> messageDecoder = (isControlFrame ? nil : self.messageDecoder);
     if (isControlFrame) {
-        //frameData will be copied before passing to handlers
-        //otherwise there can be misbehaviours when value at the pointer is changed
-        frameData = [frameData copy];
-
         dispatch_async(_workQueue, ^{
             [self _readFrameContinue];
         });
     } else {
+        [self _incrementReadCounter:SRReadCounterMessages by:1];
         [self _readFrameNew];
     }
 
     switch (opcode) {
         case SROpCodeTextFrame: {
-            NSString *string = [[NSString alloc] initWithData:frameData encoding:NSUTF8StringEncoding];
-            if (!string && frameData) {
+            // Every slice of the message was validated as it was read, so only check that it didn't end mid code point.
+            if (!SRUTF8ValidatorIsComplete(&_currentStringValidator)) {
                 [self closeWithCode:SRStatusCodeInvalidUTF8 reason:@"Text frames must be valid UTF-8."];
                 dispatch_async(_workQueue, ^{
                     [self closeConnection];
@@ -824,6 +1482,13 @@ static inline BOOL closeCodeIsValid(int closeCode) {
                 return;
             }
             SRDebugLog(@"Received text message.");
+            NSString *string = [[SRUTF8String alloc] initWithValidatedUTF8Data:frameData];
+            NSUInteger length = (isMapped ? 0 : frameData.length);
+            [self _willDeliverMessageWithLength:length];
+            if (messageDecoder) {
+                [self _decodeMessage:string withDecoder:messageDecoder length:length];
+                break;
+            }
             [self.delegateController performDelegateBlock:^(id<SRWebSocketDelegate>  _Nullable delegate, SRDelegateAvailableMethods availableMethods) {
                 // Don't convert into string - iff `delegate` tells us not to. Otherwise - create UTF8 string and handle that.
                 if (availableMethods.shouldConvertTextFrameToString && ![delegate webSocketShouldConvertTextFrameToString:self]) {
@@ -841,11 +1506,18 @@ static inline BOOL closeCodeIsValid(int closeCode) {
                         [delegate webSocket:self didReceiveMessageWithString:string];
                     }
                 }
+                [self _didDeliverMessageWithLength:length];
             }];
             break;
         }
         case SROpCodeBinaryFrame: {
             SRDebugLog(@"Received data message.");
+            NSUInteger length = (isMapped ? 0 : frameData.length);
+            [self _willDeliverMessageWithLength:length];
+            if (messageDecoder) {
+                [self _decodeMessage:frameData withDecoder:messageDecoder length:length];
+                break;
+            }
             [self.delegateController performDelegateBlock:^(id<SRWebSocketDelegate>  _Nullable delegate, SRDelegateAvailableMethods availableMethods) {
                 if (availableMethods.didReceiveMessage) {
                     [delegate webSocket:self didReceiveMessage:frameData];
@@ -853,6 +1525,7 @@ static inline BOOL closeCodeIsValid(int closeCode) {
                 if (availableMethods.didReceiveMessageWithData) {
                     [delegate webSocket:self didReceiveMessageWithData:frameData];
                 }
+                [self _didDeliverMessageWithLength:length];
             }];
         }
             break;
@@ -872,60 +1545,80 @@ static inline BOOL closeCodeIsValid(int closeCode) {
     }
 }
 
-- (void)_handleFrameHeader:(frame_header)frame_header curData:(NSData *)curData
+- (void)_handleFrameHeader:(SRFrameHeader)header
 {
-    assert(frame_header.opcode != 0);
+    assert(header.opcode != 0);
 
     if (self.readyState == SR_CLOSED) {
         return;
     }
 
+    [_traceRing recordEventOfType:SRTraceEventTypeFrameIn
+                             code:header.opcode
+                            flags:(header.fin ? SRTraceEventFlagFin : 0) | (header.masked ? SRTraceEventFlagMasked : 0)
+                            value:header.payloadLength];
 
-    BOOL isControlFrame = (frame_header.opcode == SROpCodePing || frame_header.opcode == SROpCodePong || frame_header.opcode == SROpCodeConnectionClose);
-
-    if (isControlFrame && !frame_header.fin) {
-        [self _closeWithProtocolError:@"Fragmented control frames not allowed"];
-        return;
-    }
-
-    if (isControlFrame && frame_header.payload_length >= 126) {
-        [self _closeWithProtocolError:@"Control frames cannot have payloads larger than 126 bytes"];
-        return;
-    }
+    BOOL isControlFrame = SROpCodeIsControl(header.opcode);
 
     if (!isControlFrame) {
-        _currentFrameOpcode = frame_header.opcode;
+        _currentFrameOpcode = header.opcode;
         _currentFrameCount += 1;
     }
 
-    if (frame_header.payload_length == 0) {
+    if (header.payloadLength == 0) {
         if (isControlFrame) {
-            [self _handleFrameWithData:curData opCode:frame_header.opcode];
+            [self _handleFrameWithData:[NSData data] opCode:header.opcode];
         } else {
-            if (frame_header.fin) {
-                [self _handleFrameWithData:_currentFrameData opCode:frame_header.opcode];
+            if (header.fin) {
+                [self _handleCurrentFrameWithOpCode:header.opcode];
             } else {
                 // TODO add assert that opcode is not a control;
                 [self _readFrameContinue];
             }
         }
     } else {
-        if (frame_header.payload_length > SRWebSocketMaxFramePayloadLength) {
+        if (header.payloadLength > SRWebSocketMaxFramePayloadLength) {
             [self _closeWithProtocolError:@"Payload length too large."];
             return;
         }
-        [self _addConsumerWithDataLength:(size_t)frame_header.payload_length callback:^(SRWebSocket *sself, NSData *newData) {
+        if (!isControlFrame) {
+            [self _spillCurrentFrameIfNeededForPayloadLength:header.payloadLength];
+        }
+        if (!isControlFrame && !_currentFrameFile && _currentFrameData.length + header.payloadLength > self.maximumReceiveBufferSize) {
+            [self closeWithCode:SRStatusCodeMessageTooBig reason:@"Message is larger than the receive buffer size."];
+            dispatch_async(_workQueue, ^{
+                [self closeConnection];
+            });
+            return;
+        }
+        if (!isControlFrame && _currentFrameFile && _currentFrameFile.length + header.payloadLength > self.maximumSpilledMessageSize) {
+            [self closeWithCode:SRStatusCodeMessageTooBig reason:@"Message is larger than the maximum spilled message size."];
+            dispatch_async(_workQueue, ^{
+                [self closeConnection];
+            });
+            return;
+        }
+        [self _addConsumerWithDataLength:(size_t)header.payloadLength callback:^(SRWebSocket *sself, NSData *newData) {
             if (isControlFrame) {
-                [sself _handleFrameWithData:newData opCode:frame_header.opcode];
+                [sself _handleFrameWithData:newData opCode:header.opcode];
             } else {
-                if (frame_header.fin) {
-                    [sself _handleFrameWithData:sself->_currentFrameData opCode:frame_header.opcode];
+                // `newData` is only set for a frame that was read without copying into the current frame buffer.
+                if (header.fin) {
+                    if (newData) {
+                        [sself _incrementReadCounter:SRReadCounterZeroCopyMessages by:1];
+                        [sself _handleFrameWithData:newData opCode:header.opcode];
+                    } else {
+                        [sself _handleCurrentFrameWithOpCode:header.opcode];
+                    }
                 } else {
                     // TODO add assert that opcode is not a control;
+                    if (newData && ![sself _appendToCurrentFrameData:(dispatch_data_t)newData]) {
+                        return;
+                    }
                     [sself _readFrameContinue];
                 }
             }
-        } readToCurrentFrame:!isControlFrame unmaskBytes:frame_header.masked];
+        } readToCurrentFrame:!isControlFrame unmaskBytes:header.masked];
     }
 }
 
@@ -951,172 +1644,265 @@ static inline BOOL closeCodeIsValid(int closeCode) {
  +---------------------------------------------------------------+
  */
 
-static const uint8_t SRFinMask          = 0x80;
-static const uint8_t SROpCodeMask       = 0x0F;
-static const uint8_t SRRsvMask          = 0x70;
-static const uint8_t SRMaskMask         = 0x80;
-static const uint8_t SRPayloadLenMask   = 0x7F;
-
 
 - (void)_readFrameContinue
 {
     assert((_currentFrameCount == 0 && _currentFrameOpcode == 0) || (_currentFrameCount > 0 && _currentFrameOpcode > 0));
 
     [self _addConsumerWithDataLength:2 callback:^(SRWebSocket *sself, NSData *data) {
-        __block frame_header header = {0};
-
-        const uint8_t *headerBuffer = data.bytes;
         assert(data.length >= 2);
 
-        if (headerBuffer[0] & SRRsvMask) {
-            [sself _closeWithProtocolError:@"Server used RSV bits"];
-            return;
-        }
-
-        uint8_t receivedOpcode = (SROpCodeMask & headerBuffer[0]);
-
-        BOOL isControlFrame = (receivedOpcode == SROpCodePing || receivedOpcode == SROpCodePong || receivedOpcode == SROpCodeConnectionClose);
-
-        if (!isControlFrame && receivedOpcode != 0 && sself->_currentFrameCount > 0) {
-            [sself _closeWithProtocolError:@"all data frames after the initial data frame must have opcode 0"];
-            return;
-        }
-
-        if (receivedOpcode == 0 && sself->_currentFrameCount == 0) {
-            [sself _closeWithProtocolError:@"cannot continue a message"];
-            return;
-        }
-
-        header.opcode = receivedOpcode == 0 ? sself->_currentFrameOpcode : receivedOpcode;
-
-        header.fin = !!(SRFinMask & headerBuffer[0]);
-
-
-        header.masked = !!(SRMaskMask & headerBuffer[1]);
-        header.payload_length = SRPayloadLenMask & headerBuffer[1];
-
-        headerBuffer = NULL;
+        SRFrameHeader header = {0};
+        SRFrameResult result = SRFrameHeaderParse(data.bytes, data.length, &header);
 
         if (header.masked) {
             [sself _closeWithProtocolError:@"Client must receive unmasked data"];
             return;
         }
 
-        size_t extra_bytes_needed = header.masked ? sizeof(sself->_currentReadMaskKey) : 0;
-
-        if (header.payload_length == 126) {
-            extra_bytes_needed += sizeof(uint16_t);
-        } else if (header.payload_length == 127) {
-            extra_bytes_needed += sizeof(uint64_t);
+        if (result == SRFrameResultOK) {
+            [sself _handleParsedFrameHeader:header];
+            return;
         }
 
-        if (extra_bytes_needed == 0) {
-            [sself _handleFrameHeader:header curData:sself->_currentFrameData];
-        } else {
-            [sself _addConsumerWithDataLength:extra_bytes_needed callback:^(SRWebSocket *eself, NSData *edata) {
-                size_t mapped_size = edata.length;
-#pragma unused (mapped_size)
-                const void *mapped_buffer = edata.bytes;
-                size_t offset = 0;
-
-                if (header.payload_length == 126) {
-                    assert(mapped_size >= sizeof(uint16_t));
-                    uint16_t payloadLength = 0;
-                    memcpy(&payloadLength, mapped_buffer, sizeof(uint16_t));
-                    payloadLength = CFSwapInt16BigToHost(payloadLength);
-
-                    header.payload_length = payloadLength;
-                    offset += sizeof(uint16_t);
-                } else if (header.payload_length == 127) {
-                    assert(mapped_size >= sizeof(uint64_t));
-                    uint64_t payloadLength = 0;
-                    memcpy(&payloadLength, mapped_buffer, sizeof(uint64_t));
-                    payloadLength = CFSwapInt64BigToHost(payloadLength);
-
-                    header.payload_length = payloadLength;
-                    offset += sizeof(uint64_t);
-                } else {
-                    assert(header.payload_length < 126 && header.payload_length >= 0);
-                }
+        [sself _addConsumerWithDataLength:header.headerLength - 2 callback:^(SRWebSocket *eself, NSData *edata) {
+            assert(2 + edata.length <= SRFrameHeaderMaxLength);
 
-                if (header.masked) {
-                    assert(mapped_size >= sizeof(eself->_currentReadMaskOffset) + offset);
-                    memcpy(eself->_currentReadMaskKey, ((uint8_t *)mapped_buffer) + offset, sizeof(eself->_currentReadMaskKey));
-                }
+            uint8_t headerBytes[SRFrameHeaderMaxLength];
+            memcpy(headerBytes, data.bytes, 2);
+            memcpy(headerBytes + 2, edata.bytes, edata.length);
 
-                [eself _handleFrameHeader:header curData:eself->_currentFrameData];
-            } readToCurrentFrame:NO unmaskBytes:NO];
-        }
+            SRFrameHeader extendedHeader = {0};
+            if (SRFrameHeaderParse(headerBytes, 2 + edata.length, &extendedHeader) != SRFrameResultOK) {
+                [eself _closeWithProtocolError:@"Invalid payload length"];
+                return;
+            }
+            [eself _handleParsedFrameHeader:extendedHeader];
+        } readToCurrentFrame:NO unmaskBytes:NO];
     } readToCurrentFrame:NO unmaskBytes:NO];
 }
 
+// The header is validated by the same function as `SRFrameDecoder` uses, so both reject the same frames.
+- (void)_handleParsedFrameHeader:(SRFrameHeader)header
+{
+    NSString *protocolError = nil;
+    switch (SRFrameHeaderValidate(&header, _currentFrameCount > 0)) {
+        case SRFrameHeaderValid:
+            break;
+        case SRFrameHeaderInvalidReservedBits:
+            protocolError = @"Server used RSV bits";
+            break;
+        case SRFrameHeaderInvalidReservedOpcode:
+            protocolError = [NSString stringWithFormat:@"Unknown opcode %ld", (long)header.opcode];
+            break;
+        case SRFrameHeaderInvalidFragmentedControlFrame:
+            protocolError = @"Fragmented control frames not allowed";
+            break;
+        case SRFrameHeaderInvalidControlFramePayloadLength:
+            protocolError = @"Control frames cannot have payloads larger than 126 bytes";
+            break;
+        case SRFrameHeaderInvalidUnexpectedContinuationFrame:
+            protocolError = @"cannot continue a message";
+            break;
+        case SRFrameHeaderInvalidUnexpectedDataFrame:
+            protocolError = @"all data frames after the initial data frame must have opcode 0";
+            break;
+    }
+    if (protocolError) {
+        [self _closeWithProtocolError:protocolError];
+        return;
+    }
+
+    if (header.opcode == 0) {
+        header.opcode = _currentFrameOpcode;
+    }
+    if (header.masked) {
+        memcpy(_currentReadMaskKey, header.maskKey, sizeof(_currentReadMaskKey));
+        _currentReadMaskOffset = 0;
+    }
+    [self _handleFrameHeader:header];
+}
+
 - (void)_readFrameNew
 {
     dispatch_async(_workQueue, ^{
         // Don't reset the length, since Apple doesn't guarantee that this will free the memory (and in tests on
         // some platforms, it doesn't seem to, effectively causing a leak the size of the biggest frame so far).
-        self->_currentFrameData = [[NSMutableData alloc] init];
+        // The buffer is allocated lazily, since most messages are delivered without one.
+        self->_currentFrameData = nil;
+        self->_currentFrameFile = nil;
 
         self->_currentFrameOpcode = 0;
         self->_currentFrameCount = 0;
         self->_readOpCount = 0;
-        self->_currentStringScanPosition = 0;
+        SRUTF8ValidatorInit(&self->_currentStringValidator);
 
         [self _readFrameContinue];
     });
 }
 
+// Returns `NO` if the data couldn't be written to the temporary file, in which case the connection is being closed
+// and the message that is being assembled must not be delivered.
+- (BOOL)_appendToCurrentFrameData:(dispatch_data_t)data
+{
+    if (_currentFrameFile) {
+        __block BOOL success = YES;
+        dispatch_data_apply(data, ^bool(dispatch_data_t region, size_t offset, const void *buffer, size_t size) {
+            success = [_currentFrameFile appendBytes:buffer length:size];
+            return success;
+        });
+        if (!success) {
+            [self closeWithCode:SRStatusCodeInternalError reason:@"Failed to write message to a temporary file."];
+            dispatch_async(_workQueue, ^{
+                [self closeConnection];
+            });
+            return NO;
+        }
+        [self _incrementReadCounter:SRReadCounterBytesCopied by:dispatch_data_get_size(data)];
+        return YES;
+    }
+
+    if (!_currentFrameData) {
+        _currentFrameData = [[NSMutableData alloc] init];
+        [self _incrementReadCounter:SRReadCounterBufferAllocations by:1];
+    }
+    dispatch_data_apply(data, ^bool(dispatch_data_t region, size_t offset, const void *buffer, size_t size) {
+        [_currentFrameData appendBytes:buffer length:size];
+        return true;
+    });
+    [self _incrementReadCounter:SRReadCounterBytesCopied by:dispatch_data_get_size(data)];
+    return YES;
+}
+
+// Validates bytes of the current text message that were just read, the validator carries partial code points over.
+// Large slices are validated on all cores, once they are contiguous in memory.
+- (BOOL)_validateUTF8Slice:(dispatch_data_t)slice handedOver:(BOOL)handedOver
+{
+    size_t length = dispatch_data_get_size(slice);
+    NSUInteger threshold = self.concurrentProcessingThreshold;
+    if (threshold > 0 && length >= threshold) {
+        const uint8_t *bytes = NULL;
+        if (handedOver) {
+            bytes = ((NSData *)slice).bytes;
+        } else if (!_currentFrameFile) {
+            // The slice was just appended to the message that is being assembled.
+            bytes = (const uint8_t *)_currentFrameData.bytes + _currentFrameData.length - length;
+        }
+        if (bytes) {
+            return SRUTF8ValidatorUpdateConcurrently(&SRSystemApply, &_currentStringValidator, bytes, length);
+        }
+    }
+
+    __block BOOL validUTF8 = YES;
+    dispatch_data_apply(slice, ^bool(dispatch_data_t region, size_t offset, const void *buffer, size_t size) {
+        validUTF8 = SRUTF8ValidatorUpdate(&_currentStringValidator, buffer, size);
+        return validUTF8;
+    });
+    return validUTF8;
+}
+
+// Moves the message that is being assembled into a temporary file, once it is going to exceed `messageSpillThreshold`.
+- (void)_spillCurrentFrameIfNeededForPayloadLength:(uint64_t)payloadLength
+{
+    NSUInteger threshold = self.messageSpillThreshold;
+    if (_currentFrameFile || threshold == 0 || _currentFrameData.length + payloadLength <= threshold) {
+        return;
+    }
+
+    NSError *error = nil;
+    SRSpillFile *file = [[SRSpillFile alloc] initWithError:&error];
+    if (!file || (_currentFrameData.length && ![file appendBytes:_currentFrameData.bytes length:_currentFrameData.length])) {
+        SRErrorLog(@"Failed to create a temporary file for a large message, assembling it in memory. %@", error);
+        return;
+    }
+    _currentFrameFile = file;
+    _currentFrameData = nil;
+}
+
+- (void)_handleCurrentFrameWithOpCode:(SROpCode)opcode
+{
+    NSData *frameData = _currentFrameData ?: [NSData data];
+    if (_currentFrameFile) {
+        frameData = [_currentFrameFile mapData];
+        if (!frameData) {
+            [self closeWithCode:SRStatusCodeInternalError reason:@"Failed to map message from a temporary file."];
+            dispatch_async(_workQueue, ^{
+                [self closeConnection];
+            });
+            return;
+        }
+    }
+    [self _handleFrameWithData:frameData opCode:opcode];
+}
+
 - (void)_pumpWriting
 {
     [self assertOnWorkQueue];
 
-    NSUInteger dataLength = dispatch_data_get_size(_outputBuffer);
-    if (dataLength - _outputBufferOffset > 0 && _outputStream.hasSpaceAvailable) {
+    while (YES) {
+        [self _frameOutgoingMessages];
+
+        NSUInteger dataLength = dispatch_data_get_size(_outputBuffer);
+        if (dataLength - _outputBufferOffset == 0 || !_transport.hasSpaceAvailable) {
+            break;
+        }
+
         __block NSInteger bytesWritten = 0;
         __block BOOL streamFailed = NO;
 
         dispatch_data_t dataToSend = dispatch_data_create_subrange(_outputBuffer, _outputBufferOffset, dataLength - _outputBufferOffset);
         dispatch_data_apply(dataToSend, ^bool(dispatch_data_t region, size_t offset, const void *buffer, size_t size) {
-            NSInteger sentLength = [_outputStream write:buffer maxLength:size];
+            NSInteger sentLength = [_transport write:buffer maxLength:size];
             if (sentLength == -1) {
                 streamFailed = YES;
                 return false;
             }
+            [_captureWriter recordBytes:buffer length:(size_t)sentLength direction:SRCaptureDirectionOutbound];
             bytesWritten += sentLength;
             return (sentLength >= (NSInteger)size); // If we can't write all the data into the stream - bail-out early.
         });
         if (streamFailed) {
             NSInteger code = 2145;
             NSString *description = @"Error writing to stream.";
-            NSError *streamError = _outputStream.streamError;
+            NSError *streamError = _transport.error;
             NSError *error = streamError ? SRErrorWithCodeDescriptionUnderlyingError(code, description, streamError) : SRErrorWithCodeDescription(code, description);
             [self _failWithError:error];
             return;
         }
 
         _outputBufferOffset += bytesWritten;
+        _outputBytesWritten += bytesWritten;
+        [self _finishWrittenSendHandles];
 
         if (_outputBufferOffset > SRDefaultBufferSize() && _outputBufferOffset > dataLength / 2) {
             _outputBuffer = dispatch_data_create_subrange(_outputBuffer, _outputBufferOffset, dataLength - _outputBufferOffset);
             _outputBufferOffset = 0;
         }
+
+        // Transport didn't accept everything - wait for the next `SRTransportEventHasSpaceAvailable`.
+        if (bytesWritten == 0 || _outputBufferOffset < dispatch_data_get_size(_outputBuffer)) {
+            break;
+        }
     }
 
+    [self _updateMemoryCharge];
+
     if (_closeWhenFinishedWriting &&
         (dispatch_data_get_size(_outputBuffer) - _outputBufferOffset) == 0 &&
-        (_inputStream.streamStatus != NSStreamStatusNotOpen &&
-         _inputStream.streamStatus != NSStreamStatusClosed) &&
+        _outgoingQueue.isEmpty &&
+        _transport.isOpen &&
         !_sentClose) {
         _sentClose = YES;
 
-        @synchronized(self) {
-            [_outputStream close];
-            [_inputStream close];
-
+        // The transport may call back into the socket or block, so it's never called with the lock held.
+        os_unfair_lock_lock(&_streamLock);
+        id<SRTransport> transport = _transport;
+        NSArray<NSArray *> *scheduledRunloops = _scheduledRunloops.allObjects;
+        os_unfair_lock_unlock(&_streamLock);
 
-            for (NSArray *runLoop in [_scheduledRunloops copy]) {
-                [self unscheduleFromRunLoop:[runLoop objectAtIndex:0] forMode:[runLoop objectAtIndex:1]];
-            }
+        [transport close];
+        for (NSArray *runLoop in scheduledRunloops) {
+            [self unscheduleFromRunLoop:[runLoop objectAtIndex:0] forMode:[runLoop objectAtIndex:1]];
         }
 
         if (!_failed) {
@@ -1157,34 +1943,34 @@ static const uint8_t SRPayloadLenMask   = 0x7F;
 
 - (void)_scheduleCleanup
 {
-    @synchronized(self) {
-        if (_cleanupScheduled) {
-            return;
-        }
-
-        _cleanupScheduled = YES;
-
-        // Cleanup NSStream delegate's in the same RunLoop used by the streams themselves:
-        // This way we'll prevent race conditions between handleEvent and SRWebsocket's dealloc
-        NSTimer *timer = [NSTimer timerWithTimeInterval:(0.0f) target:self selector:@selector(_cleanupSelfReference:) userInfo:nil repeats:NO];
-        [[NSRunLoop SR_networkRunLoop] addTimer:timer forMode:NSDefaultRunLoopMode];
+    if (atomic_exchange(&_cleanupScheduled, true)) {
+        return;
     }
+
+    // Cleanup transport delegate in the same RunLoop used by the streams themselves:
+    // This way we'll prevent race conditions between handleEvent and SRWebsocket's dealloc
+    NSTimer *timer = [NSTimer timerWithTimeInterval:(0.0f) target:self selector:@selector(_cleanupSelfReference:) userInfo:nil repeats:NO];
+    [[NSRunLoop SR_networkRunLoop] addTimer:timer forMode:NSDefaultRunLoopMode];
 }
 
 - (void)_cleanupSelfReference:(NSTimer *)timer
 {
-    @synchronized(self) {
-        // Nuke NSStream delegate's
-        _inputStream.delegate = nil;
-        _outputStream.delegate = nil;
+    os_unfair_lock_lock(&_streamLock);
+    id<SRTransport> transport = _transport;
+    os_unfair_lock_unlock(&_streamLock);
 
-        // Remove the streams, right now, from the networkRunLoop
-        [_inputStream close];
-        [_outputStream close];
-    }
+    // Nuke transport delegate
+    transport.delegate = nil;
+
+    // Remove the streams, right now, from the networkRunLoop
+    [transport close];
 
     // Cleanup selfRetain in the same GCD queue as usual
     dispatch_async(_workQueue, ^{
+        [self _failPendingSends];
+        [self->_captureWriter close];
+        [self _releaseMemoryCharge];
+        [[SRMemoryBudget sharedBudget] removeClient:self];
         self->_selfRetain = nil;
     });
 }
@@ -1223,6 +2009,16 @@ static const char CRLFCRLFBytes[] = {'\r', '\n', '\r', '\n'};
 }
 
 
+static BOOL SRDispatchDataIsContiguous(dispatch_data_t data)
+{
+    __block size_t regionCount = 0;
+    dispatch_data_apply(data, ^bool(dispatch_data_t region, size_t offset, const void *buffer, size_t size) {
+        regionCount += 1;
+        return (regionCount == 1);
+    });
+    return (regionCount <= 1);
+}
+
 // Returns true if did work
 - (BOOL)_innerPumpScanner {
 
@@ -1232,6 +2028,18 @@ static const char CRLFCRLFBytes[] = {'\r', '\n', '\r', '\n'};
         return didWork;
     }
 
+    // Bytes stay in the read buffer until the delegate catches up, which in turn pauses reading from the transport.
+    // The flag is set before checking, so a delivery that completes concurrently always sees it and resumes parsing.
+    // Without a limit there is nothing to wait for, so the flag isn't touched for every scanned consumer.
+    NSUInteger maximumCount = self.maximumUndeliveredMessageCount;
+    if (maximumCount > 0) {
+        atomic_store(&_scanningPaused, true);
+        if (atomic_load(&_pendingDelegateMessageCount) >= maximumCount) {
+            return didWork;
+        }
+        atomic_store(&_scanningPaused, false);
+    }
+
     size_t readBufferSize = dispatch_data_get_size(_readBuffer);
 
     if (!_consumers.count) {
@@ -1272,57 +2080,51 @@ static const char CRLFCRLFBytes[] = {'\r', '\n', '\r', '\n'};
 
         if (consumer.unmaskBytes) {
             __block NSMutableData *mutableSlice = [slice mutableCopy];
+            [self _incrementReadCounter:SRReadCounterBufferAllocations by:1];
+            [self _incrementReadCounter:SRReadCounterBytesCopied by:foundSize];
 
             NSUInteger len = mutableSlice.length;
             uint8_t *bytes = mutableSlice.mutableBytes;
 
-            for (NSUInteger i = 0; i < len; i++) {
-                bytes[i] = bytes[i] ^ _currentReadMaskKey[_currentReadMaskOffset % sizeof(_currentReadMaskKey)];
-                _currentReadMaskOffset += 1;
-            }
+            SRMaskBytes(bytes, len, _currentReadMaskKey, _currentReadMaskOffset);
+            _currentReadMaskOffset += len;
 
             slice = dispatch_data_create(bytes, len, nil, ^{
                 mutableSlice = nil;
             });
         }
 
+        // A frame that is read completely from a single contiguous region, with no earlier fragments buffered,
+        // is handed to the consumer as is and never copied into the current frame buffer.
+        BOOL handOverSlice = (consumer.readToCurrentFrame &&
+                              _currentFrameData.length == 0 &&
+                              !_currentFrameFile &&
+                              foundSize == consumer.bytesNeeded &&
+                              SRDispatchDataIsContiguous(slice));
+
         if (consumer.readToCurrentFrame) {
-            dispatch_data_apply(slice, ^bool(dispatch_data_t region, size_t offset, const void *buffer, size_t size) {
-                [_currentFrameData appendBytes:buffer length:size];
-                return true;
-            });
+            // The consumer isn't completed after a failed write, so a message with missing bytes is never delivered.
+            if (!handOverSlice && ![self _appendToCurrentFrameData:slice]) {
+                return didWork;
+            }
 
             _readOpCount += 1;
 
             if (_currentFrameOpcode == SROpCodeTextFrame) {
-                // Validate UTF8 stuff.
-                size_t currentDataSize = _currentFrameData.length;
-                if (_currentFrameOpcode == SROpCodeTextFrame && currentDataSize > 0) {
-                    // TODO: Optimize the crap out of this.  Don't really have to copy all the data each time
-
-                    size_t scanSize = currentDataSize - _currentStringScanPosition;
-
-                    NSData *scan_data = [_currentFrameData subdataWithRange:NSMakeRange(_currentStringScanPosition, scanSize)];
-                    int32_t valid_utf8_size = validate_dispatch_data_partial_string(scan_data);
-
-                    if (valid_utf8_size == -1) {
-                        [self closeWithCode:SRStatusCodeInvalidUTF8 reason:@"Text frames must be valid UTF-8"];
-                        dispatch_async(_workQueue, ^{
-                            [self closeConnection];
-                        });
-                        return didWork;
-                    } else {
-                        _currentStringScanPosition += valid_utf8_size;
-                    }
+                if (![self _validateUTF8Slice:slice handedOver:handOverSlice]) {
+                    [self closeWithCode:SRStatusCodeInvalidUTF8 reason:@"Text frames must be valid UTF-8"];
+                    dispatch_async(_workQueue, ^{
+                        [self closeConnection];
+                    });
+                    return didWork;
                 }
-
             }
 
             consumer.bytesNeeded -= foundSize;
 
             if (consumer.bytesNeeded == 0) {
                 [_consumers removeObjectAtIndex:0];
-                consumer.handler(self, nil);
+                consumer.handler(self, (handOverSlice ? (NSData *)slice : nil));
                 [_consumerPool returnConsumer:consumer];
                 didWork = YES;
             }
@@ -1351,87 +2153,183 @@ static const char CRLFCRLFBytes[] = {'\r', '\n', '\r', '\n'};
     }
 
     _isPumping = NO;
+
+    [self _updateMemoryCharge];
+    if (atomic_load(&_readsPaused)) {
+        dispatch_async(_workQueue, ^{
+            [self _resumeReadingIfNeeded];
+        });
+    }
 }
 
 //#define NOMASK
 
-static const size_t SRFrameHeaderOverhead = 32;
-
 - (void)_sendFrameWithOpcode:(SROpCode)opCode data:(NSData *)data
+{
+    BOOL isControlFrame = SROpCodeIsControl(opCode);
+    [self _sendFrameWithOpcode:opCode data:data lane:(isControlFrame ? SROutgoingLaneControl : SROutgoingLaneDefault)];
+}
+
+- (void)_sendFrameWithOpcode:(SROpCode)opCode data:(NSData *)data lane:(SROutgoingLane)lane
+{
+    [self _sendFrameWithOpcode:opCode data:data lane:lane sendHandle:nil];
+}
+
+- (void)_sendFrameWithOpcode:(SROpCode)opCode data:(nullable NSData *)data lane:(SROutgoingLane)lane sendHandle:(nullable SRSendHandle *)sendHandle
+{
+    [self _sendFrameWithOpcode:opCode data:data lane:lane sendHandle:sendHandle conflationKey:nil];
+}
+
+- (void)_sendFrameWithOpcode:(SROpCode)opCode
+                        data:(nullable NSData *)data
+                        lane:(SROutgoingLane)lane
+                  sendHandle:(nullable SRSendHandle *)sendHandle
+               conflationKey:(nullable NSString *)conflationKey
 {
     [self assertOnWorkQueue];
 
     if (!data) {
+        if (sendHandle) {
+            [self _finishSendHandle:sendHandle error:nil];
+        }
         return;
     }
 
-    size_t payloadLength = data.length;
+    [self _enqueueOutgoingMessage:[[SROutgoingMessage alloc] initWithOpcode:opCode
+                                                                       data:data
+                                                                       lane:lane
+                                                                 sendHandle:sendHandle
+                                                              conflationKey:conflationKey]];
+}
 
-    NSMutableData *frameData = [[NSMutableData alloc] initWithLength:payloadLength + SRFrameHeaderOverhead];
-    if (!frameData) {
-        [self closeWithCode:SRStatusCodeMessageTooBig reason:@"Message too big"];
+- (void)_enqueueOutgoingMessage:(SROutgoingMessage *)message
+{
+    [self assertOnWorkQueue];
+
+    if (_closeWhenFinishedWriting) {
+        SRSendHandle *sendHandle = message.sendHandle;
+        if (sendHandle) {
+            [self _finishSendHandle:sendHandle error:SRSendConnectionClosedError()];
+        }
         return;
     }
-    uint8_t *frameBuffer = (uint8_t *)frameData.mutableBytes;
 
-    // set fin
-    frameBuffer[0] = SRFinMask | opCode;
+    [_outgoingQueue enqueueMessage:message];
+    [self _pumpWriting];
+}
 
-    // set the mask and header
-    frameBuffer[1] |= SRMaskMask;
+// Frames queued messages into `_outputBuffer` until there is enough data to fill a write.
+// Only a small amount is framed ahead, so that control frames queued later can still go out before the rest of a large message.
+- (void)_frameOutgoingMessages
+{
+    [self assertOnWorkQueue];
 
-    size_t frameBufferSize = 2;
+    // Messages sent while connecting wait in the queue until the handshake succeeds.
+    if (self.readyState == SR_CONNECTING) {
+        return;
+    }
 
-    if (payloadLength < 126) {
-        frameBuffer[1] |= payloadLength;
-    } else {
-        uint64_t declaredPayloadLength = 0;
-        size_t declaredPayloadLengthSize = 0;
+    NSUInteger fragmentSize = self.outgoingFragmentSize;
+    NSUInteger concurrentProcessingThreshold = self.concurrentProcessingThreshold;
+    while ((dispatch_data_get_size(_outputBuffer) - _outputBufferOffset) < SRDefaultBufferSize()) {
+        SROutgoingMessage *message = [_outgoingQueue nextMessage];
+        if (!message) {
+            break;
+        }
 
-        if (payloadLength <= UINT16_MAX) {
-            frameBuffer[1] |= 126;
+        SRSendHandle *sendHandle = message.sendHandle;
+        if (sendHandle && message.framedLength == 0 && ![sendHandle beginTransmitting]) {
+            [_outgoingQueue message:message didFrameLength:message.data.length];
+            [self _finishSendHandle:sendHandle error:SRSendCancelledError()];
+            continue;
+        }
 
-            declaredPayloadLength = CFSwapInt16BigToHost((uint16_t)payloadLength);
-            declaredPayloadLengthSize = sizeof(uint16_t);
-        } else {
-            frameBuffer[1] |= 127;
+        size_t remainingLength = message.data.length - message.framedLength;
+        size_t payloadLength = remainingLength;
+        size_t messageFragmentSize = fragmentSize;
+        // Every frame has its own mask key, so a message that is masked on all cores is sent in fragments that are large enough to be.
+        if (messageFragmentSize > 0 && concurrentProcessingThreshold > 0 &&
+            message.data.length >= concurrentProcessingThreshold && messageFragmentSize < concurrentProcessingThreshold) {
+            messageFragmentSize = concurrentProcessingThreshold;
+        }
+        if (message.lane != SROutgoingLaneControl && messageFragmentSize > 0 && payloadLength > messageFragmentSize) {
+            payloadLength = messageFragmentSize;
+        }
+
+        SROpCode opCode = (message.framedLength == 0 ? message.opcode : SROpCodeContinuationFrame);
+        BOOL fin = (payloadLength == remainingLength);
+        const uint8_t *payload = (const uint8_t *)message.data.bytes + message.framedLength;
 
-            declaredPayloadLength = CFSwapInt64BigToHost((uint64_t)payloadLength);
-            declaredPayloadLengthSize = sizeof(uint64_t);
+        NSData *frameData = nil;
+        if (message.preparedMessage && message.framedLength == 0 && fin) {
+            // Sent in a single frame, so the header laid out in advance is used as is.
+            frameData = [message.preparedMessage maskedFrameDataWithConcurrentMaskingThreshold:concurrentProcessingThreshold];
+        } else {
+            frameData = [self _frameDataWithOpcode:opCode fin:fin payload:payload length:payloadLength];
+        }
+        if (!frameData) {
+            [_outgoingQueue message:message didFrameLength:remainingLength];
+            if (sendHandle) {
+                [self _finishSendHandle:sendHandle error:SRSendMessageTooBigError()];
+            }
+            [self closeWithCode:SRStatusCodeMessageTooBig reason:@"Message too big"];
+            break;
         }
+        [_outgoingQueue message:message didFrameLength:payloadLength];
+        [_traceRing recordEventOfType:SRTraceEventTypeFrameOut
+                                 code:opCode
+                                flags:(fin ? SRTraceEventFlagFin : 0) | SRTraceEventFlagMasked
+                                value:payloadLength];
+
+        __block NSData *strongData = frameData;
+        dispatch_data_t newData = dispatch_data_create(frameData.bytes, frameData.length, nil, ^{
+            strongData = nil;
+        });
+        (void)strongData;
+        _outputBuffer = dispatch_data_create_concat(_outputBuffer, newData);
 
-        memcpy((frameBuffer + frameBufferSize), &declaredPayloadLength, declaredPayloadLengthSize);
-        frameBufferSize += declaredPayloadLengthSize;
+        if (fin && sendHandle) {
+            sendHandle.outputEndOffset = _outputBytesWritten + (dispatch_data_get_size(_outputBuffer) - _outputBufferOffset);
+            [_pendingSendHandles addObject:sendHandle];
+        }
     }
+}
 
-    const uint8_t *unmaskedPayloadBuffer = (uint8_t *)data.bytes;
-    uint8_t *maskKey = frameBuffer + frameBufferSize;
-
-    size_t randomBytesSize = sizeof(uint32_t);
-    NSData *randomData = SRRandomData(randomBytesSize);
-    [randomData getBytes:maskKey range:NSMakeRange(0, randomBytesSize)];
-    frameBufferSize += randomBytesSize;
+- (nullable NSData *)_frameDataWithOpcode:(SROpCode)opCode fin:(BOOL)fin payload:(const uint8_t *)payload length:(size_t)payloadLength
+{
+    uint8_t maskKey[sizeof(uint32_t)];
+    if (!SRSystemCrypto.randomBytes(SRSystemCrypto.context, maskKey, sizeof(maskKey))) {
+        [NSException raise:NSInternalInconsistencyException format:@"Failed to generate random bytes for the mask key"];
+    }
 
-    // Copy and unmask the buffer
-    uint8_t *frameBufferPayloadPointer = frameBuffer + frameBufferSize;
+    size_t headerLength = SRFrameHeaderLength(payloadLength, YES);
+    NSMutableData *frameData = [[NSMutableData alloc] initWithLength:headerLength + payloadLength];
+    if (!frameData) {
+        return nil;
+    }
+    uint8_t *frameBuffer = (uint8_t *)frameData.mutableBytes;
 
-    memcpy(frameBufferPayloadPointer, unmaskedPayloadBuffer, payloadLength);
-    SRMaskBytesSIMD(frameBufferPayloadPointer, payloadLength, maskKey);
-    frameBufferSize += payloadLength;
+    size_t frameBufferSize = SRFrameHeaderWrite(frameBuffer, opCode, fin, payloadLength, maskKey);
+    assert(frameBufferSize == headerLength);
 
-    assert(frameBufferSize <= frameData.length);
-    frameData.length = frameBufferSize;
+    // Copy and mask the payload
+    NSUInteger concurrentProcessingThreshold = self.concurrentProcessingThreshold;
+    if (concurrentProcessingThreshold > 0 && payloadLength >= concurrentProcessingThreshold) {
+        SRMaskBytesCopyConcurrently(&SRSystemApply, frameBuffer + frameBufferSize, payload, payloadLength, maskKey, 0);
+    } else {
+        SRMaskBytesCopy(frameBuffer + frameBufferSize, payload, payloadLength, maskKey, 0);
+    }
 
-    [self _writeData:frameData];
+    return frameData;
 }
 
-- (void)stream:(NSStream *)aStream handleEvent:(NSStreamEvent)eventCode
+- (void)transport:(id<SRTransport>)transport handleEvent:(SRTransportEvent)event
 {
     __weak typeof(self) wself = self;
 
     if (_requestRequiresSSL && !_streamSecurityValidated &&
-        (eventCode == NSStreamEventHasBytesAvailable || eventCode == NSStreamEventHasSpaceAvailable)) {
-        SecTrustRef trust = (__bridge SecTrustRef)[aStream propertyForKey:(__bridge id)kCFStreamPropertySSLPeerTrust];
+        (event == SRTransportEventHasBytesAvailable || event == SRTransportEventHasSpaceAvailable)) {
+        SecTrustRef trust = ([transport respondsToSelector:@selector(peerTrust)] ? [transport peerTrust] : NULL);
         if (trust) {
             NSString *const host = _urlRequest.URL.host;
             if (!host || host.length == 0) {
@@ -1459,21 +2357,51 @@ static const size_t SRFrameHeaderOverhead = 32;
         });
     }
     dispatch_async(_workQueue, ^{
-        [wself safeHandleEvent:eventCode stream:aStream];
+        [wself safeHandleEvent:event transport:transport];
     });
 }
 
-- (void)safeHandleEvent:(NSStreamEvent)eventCode stream:(NSStream *)aStream
+- (void)_readFromTransport
+{
+    [self assertOnWorkQueue];
+
+    uint8_t buffer[SRDefaultBufferSize()];
+
+    while (_transport.hasBytesAvailable) {
+        if ([self _shouldPauseReading]) {
+            atomic_store(&_readsPaused, true);
+            [self _waitForMemoryBudgetIfNeeded];
+            break;
+        }
+        NSInteger bytesRead = [_transport read:buffer maxLength:SRDefaultBufferSize()];
+        if (bytesRead > 0) {
+            [_captureWriter recordBytes:buffer length:(size_t)bytesRead direction:SRCaptureDirectionInbound];
+            dispatch_data_t data = dispatch_data_create(buffer, bytesRead, nil, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+            if (!data) {
+                NSError *error = SRErrorWithCodeDescription(SRStatusCodeMessageTooBig,
+                                                            @"Unable to allocate memory to read from socket.");
+                [self _failWithError:error];
+                return;
+            }
+            _readBuffer = dispatch_data_create_concat(_readBuffer, data);
+        } else if (bytesRead == -1) {
+            [self _failWithError:_transport.error];
+        }
+    }
+    [self _pumpScanner];
+}
+
+- (void)safeHandleEvent:(SRTransportEvent)event transport:(id<SRTransport>)transport
 {
-    switch (eventCode) {
-        case NSStreamEventOpenCompleted: {
-            SRDebugLog(@"NSStreamEventOpenCompleted %@", aStream);
+    switch (event) {
+        case SRTransportEventOpenCompleted: {
+            SRDebugLog(@"SRTransportEventOpenCompleted %@", transport);
             if (self.readyState >= SR_CLOSING) {
                 return;
             }
             assert(_readBuffer);
 
-            if (!_requestRequiresSSL && self.readyState == SR_CONNECTING && aStream == _inputStream) {
+            if (!_requestRequiresSSL && self.readyState == SR_CONNECTING) {
                 [self didConnect];
             }
 
@@ -1483,21 +2411,21 @@ static const size_t SRFrameHeaderOverhead = 32;
             break;
         }
 
-        case NSStreamEventErrorOccurred: {
-            SRDebugLog(@"NSStreamEventErrorOccurred %@ %@", aStream, [[aStream streamError] copy]);
+        case SRTransportEventErrorOccurred: {
+            SRDebugLog(@"SRTransportEventErrorOccurred %@ %@", transport, transport.error);
             /// TODO specify error better!
-            [self _failWithError:aStream.streamError];
+            [self _failWithError:transport.error];
             _readBufferOffset = 0;
             _readBuffer = dispatch_data_empty;
             break;
 
         }
 
-        case NSStreamEventEndEncountered: {
+        case SRTransportEventEndEncountered: {
             [self _pumpScanner];
-            SRDebugLog(@"NSStreamEventEndEncountered %@", aStream);
-            if (aStream.streamError) {
-                [self _failWithError:aStream.streamError];
+            SRDebugLog(@"SRTransportEventEndEncountered %@", transport);
+            if (transport.error) {
+                [self _failWithError:transport.error];
             } else {
                 dispatch_async(_workQueue, ^{
                     if (self.readyState != SR_CLOSED) {
@@ -1523,38 +2451,17 @@ static const size_t SRFrameHeaderOverhead = 32;
             break;
         }
 
-        case NSStreamEventHasBytesAvailable: {
-            SRDebugLog(@"NSStreamEventHasBytesAvailable %@", aStream);
-            uint8_t buffer[SRDefaultBufferSize()];
-
-            while (_inputStream.hasBytesAvailable) {
-                NSInteger bytesRead = [_inputStream read:buffer maxLength:SRDefaultBufferSize()];
-                if (bytesRead > 0) {
-                    dispatch_data_t data = dispatch_data_create(buffer, bytesRead, nil, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
-                    if (!data) {
-                        NSError *error = SRErrorWithCodeDescription(SRStatusCodeMessageTooBig,
-                                                                    @"Unable to allocate memory to read from socket.");
-                        [self _failWithError:error];
-                        return;
-                    }
-                    _readBuffer = dispatch_data_create_concat(_readBuffer, data);
-                } else if (bytesRead == -1) {
-                    [self _failWithError:_inputStream.streamError];
-                }
-            }
-            [self _pumpScanner];
+        case SRTransportEventHasBytesAvailable: {
+            SRDebugLog(@"SRTransportEventHasBytesAvailable %@", transport);
+            [self _readFromTransport];
             break;
         }
 
-        case NSStreamEventHasSpaceAvailable: {
-            SRDebugLog(@"NSStreamEventHasSpaceAvailable %@", aStream);
+        case SRTransportEventHasSpaceAvailable: {
+            SRDebugLog(@"SRTransportEventHasSpaceAvailable %@", transport);
             [self _pumpWriting];
             break;
         }
-
-        case NSStreamEventNone:
-            SRDebugLog(@"(default)  %@", aStream);
-            break;
     }
 }
 
@@ -1593,70 +2500,3 @@ static const size_t SRFrameHeaderOverhead = 32;
 }
 
 @end
-
-#ifdef HAS_ICU
-
-static inline int32_t validate_dispatch_data_partial_string(NSData *data) {
-    if ([data length] > INT32_MAX) {
-        // INT32_MAX is the limit so long as this Framework is using 32 bit ints everywhere.
-        return -1;
-    }
-
-    int32_t size = (int32_t)[data length];
-
-    const void * contents = [data bytes];
-    const uint8_t *str = (const uint8_t *)contents;
-
-    UChar32 codepoint = 1;
-    int32_t offset = 0;
-    int32_t lastOffset = 0;
-    while(offset < size && codepoint > 0)  {
-        lastOffset = offset;
-        U8_NEXT(str, offset, size, codepoint);
-    }
-
-    if (codepoint == -1) {
-        // Check to see if the last byte is valid or whether it was just continuing
-        if (!U8_IS_LEAD(str[lastOffset]) || U8_COUNT_TRAIL_BYTES(str[lastOffset]) + lastOffset < (int32_t)size) {
-
-            size = -1;
-        } else {
-            uint8_t leadByte = str[lastOffset];
-            U8_MASK_LEAD_BYTE(leadByte, U8_COUNT_TRAIL_BYTES(leadByte));
-
-            for (int i = lastOffset + 1; i < offset; i++) {
-                if (U8_IS_SINGLE(str[i]) || U8_IS_LEAD(str[i]) || !U8_IS_TRAIL(str[i])) {
-                    size = -1;
-                }
-            }
-
-            if (size != -1) {
-                size = lastOffset;
-            }
-        }
-    }
-
-    if (size != -1 && ![[NSString alloc] initWithBytesNoCopy:(char *)[data bytes] length:size encoding:NSUTF8StringEncoding freeWhenDone:NO]) {
-        size = -1;
-    }
-
-    return size;
-}
-
-#else
-
-// This is a hack, and probably not optimal
-static inline int32_t validate_dispatch_data_partial_string(NSData *data) {
-    static const int maxCodepointSize = 3;
-
-    for (int i = 0; i < maxCodepointSize; i++) {
-        NSString *str = [[NSString alloc] initWithBytesNoCopy:(char *)data.bytes length:data.length - i encoding:NSUTF8StringEncoding freeWhenDone:NO];
-        if (str) {
-            return (int32_t)data.length - i;
-        }
-    }
-
-    return -1;
-}
-
-#endif
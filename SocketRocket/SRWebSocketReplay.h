@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class SRWebSocket;
+
+typedef NS_ENUM(NSInteger, SRWebSocketReplayPace) {
+    // Inbound bytes are fed as fast as the socket reads them.
+    SRWebSocketReplayPaceAsFastAsPossible = 0,
+    // Inbound bytes are fed with the same timing as they were recorded.
+    SRWebSocketReplayPaceRecorded,
+};
+
+/**
+ Replays a capture recorded with `-[SRWebSocket captureURL]` through a socket, without a network connection.
+
+ All recorded inbound bytes, including the handshake response, go through the same parsing and delegate dispatch as live traffic,
+ so parser changes can be benchmarked against real traffic and regressions bisected deterministically.
+ Bytes written by the socket are discarded.
+ */
+@interface SRWebSocketReplay : NSObject
+
+/**
+ Loads a capture.
+
+ @return A replay or `nil` if the file can't be read, is malformed, or doesn't contain the opening handshake request.
+ */
+- (nullable instancetype)initWithCaptureURL:(NSURL *)captureURL error:(NSError **)error;
+
+/**
+ Pace at which inbound bytes are fed into the socket. Default: `SRWebSocketReplayPaceAsFastAsPossible`.
+ */
+@property (nonatomic, assign) SRWebSocketReplayPace pace;
+
+/**
+ Total number of inbound bytes in the capture.
+ */
+@property (nonatomic, assign, readonly) NSUInteger inboundByteCount;
+
+/**
+ Opens a socket over in-memory streams and feeds the recorded inbound bytes into it.
+ The socket must not be opened yet, and should use a `ws://` URL. Its delegate is called as usual.
+ Once all bytes were fed, the input stream ends, which closes the socket if the capture didn't close it already.
+
+ @param webSocket  A socket to replay into.
+ @param completion Called on an arbitrary queue once all recorded inbound bytes were fed into the socket.
+ */
+- (void)replayIntoWebSocket:(SRWebSocket *)webSocket completion:(nullable dispatch_block_t)completion;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,184 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRWebSocketReplay.h"
+
+#import "SRCapture.h"
+#import "SRConstants.h"
+#import "SRWebSocket+Private.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Buffer size of the in-memory streams between the replay and the socket.
+static const CFIndex SRWebSocketReplayStreamBufferSize = 64 * 1024;
+
+static NSError *SRWebSocketReplayMalformedCaptureError(NSURL *captureURL, NSString *reason)
+{
+    return [NSError errorWithDomain:NSCocoaErrorDomain
+                               code:NSFileReadCorruptFileError
+                           userInfo:@{ NSURLErrorKey : captureURL, NSLocalizedFailureReasonErrorKey : reason }];
+}
+
+@implementation SRWebSocketReplay
+{
+    NSData *_capture;
+    NSData *_inboundRecords; // SRCaptureRecord, with `length` bytes following each record header in `_capture`.
+    NSData *_inboundRecordOffsets; // NSUInteger offsets of data of `_inboundRecords` in `_capture`.
+    NSString *_handshakeKey;
+    dispatch_queue_t _feedQueue;
+    dispatch_queue_t _drainQueue;
+}
+
+///--------------------------------------
+#pragma mark - Init
+///--------------------------------------
+
+- (nullable instancetype)initWithCaptureURL:(NSURL *)captureURL error:(NSError **)error
+{
+    self = [super init];
+    if (!self) return self;
+
+    _capture = [NSData dataWithContentsOfURL:captureURL options:NSDataReadingMappedIfSafe error:error];
+    if (!_capture) {
+        return nil;
+    }
+    if (![self _parseCaptureWithURL:captureURL error:error]) {
+        return nil;
+    }
+
+    _feedQueue = dispatch_queue_create("com.facebook.socketrocket.replay.feed", DISPATCH_QUEUE_SERIAL);
+    _drainQueue = dispatch_queue_create("com.facebook.socketrocket.replay.drain", DISPATCH_QUEUE_SERIAL);
+
+    return self;
+}
+
+- (BOOL)_parseCaptureWithURL:(NSURL *)captureURL error:(NSError **)error
+{
+    const uint8_t *bytes = _capture.bytes;
+    size_t length = _capture.length;
+    if (!SRCaptureFileHeaderIsValid(bytes, length)) {
+        if (error) {
+            *error = SRWebSocketReplayMalformedCaptureError(captureURL, @"Not a SocketRocket capture.");
+        }
+        return NO;
+    }
+
+    NSMutableData *inboundRecords = [NSMutableData data];
+    NSMutableData *inboundRecordOffsets = [NSMutableData data];
+    CFHTTPMessageRef request = CFHTTPMessageCreateEmpty(NULL, YES);
+
+    size_t offset = SRCaptureFileMagicLength;
+    while (offset < length) {
+        SRCaptureRecord record;
+        if (SRCaptureRecordParse(bytes + offset, length - offset, &record) != SRFrameResultOK) {
+            CFRelease(request);
+            if (error) {
+                *error = SRWebSocketReplayMalformedCaptureError(captureURL, @"Truncated or malformed capture record.");
+            }
+            return NO;
+        }
+        NSUInteger dataOffset = offset + SRCaptureRecordHeaderLength;
+        if (record.direction == SRCaptureDirectionInbound) {
+            [inboundRecords appendBytes:&record length:sizeof(record)];
+            [inboundRecordOffsets appendBytes:&dataOffset length:sizeof(dataOffset)];
+            _inboundByteCount += record.length;
+        } else if (!CFHTTPMessageIsHeaderComplete(request)) {
+            CFHTTPMessageAppendBytes(request, bytes + dataOffset, record.length);
+        }
+        offset = dataOffset + record.length;
+    }
+
+    if (CFHTTPMessageIsHeaderComplete(request)) {
+        _handshakeKey = CFBridgingRelease(CFHTTPMessageCopyHeaderFieldValue(request, CFSTR("Sec-WebSocket-Key")));
+    }
+    CFRelease(request);
+    if (!_handshakeKey) {
+        if (error) {
+            *error = SRWebSocketReplayMalformedCaptureError(captureURL, @"Capture doesn't contain the opening handshake request.");
+        }
+        return NO;
+    }
+
+    _inboundRecords = inboundRecords;
+    _inboundRecordOffsets = inboundRecordOffsets;
+    return YES;
+}
+
+///--------------------------------------
+#pragma mark - Replay
+///--------------------------------------
+
+- (void)replayIntoWebSocket:(SRWebSocket *)webSocket completion:(nullable dispatch_block_t)completion
+{
+    CFReadStreamRef socketReadStream = NULL;
+    CFWriteStreamRef feedWriteStream = NULL;
+    CFStreamCreateBoundPair(kCFAllocatorDefault, &socketReadStream, &feedWriteStream, SRWebSocketReplayStreamBufferSize);
+    CFReadStreamRef drainReadStream = NULL;
+    CFWriteStreamRef socketWriteStream = NULL;
+    CFStreamCreateBoundPair(kCFAllocatorDefault, &drainReadStream, &socketWriteStream, SRWebSocketReplayStreamBufferSize);
+
+    NSInputStream *inputStream = CFBridgingRelease(socketReadStream);
+    NSOutputStream *outputStream = CFBridgingRelease(socketWriteStream);
+    NSOutputStream *feedStream = CFBridgingRelease(feedWriteStream);
+    NSInputStream *drainStream = CFBridgingRelease(drainReadStream);
+    [inputStream open];
+    [outputStream open];
+    [feedStream open];
+    [drainStream open];
+
+    [webSocket _openWithInputStream:inputStream outputStream:outputStream handshakeKey:_handshakeKey];
+
+    dispatch_async(_drainQueue, ^{
+        uint8_t buffer[SRDefaultBufferSize()];
+        while ([drainStream read:buffer maxLength:sizeof(buffer)] > 0) {
+        }
+        [drainStream close];
+    });
+
+    SRWebSocketReplayPace pace = self.pace;
+    dispatch_async(_feedQueue, ^{
+        [self _feedStream:feedStream pace:pace];
+        [feedStream close];
+        if (completion) {
+            completion();
+        }
+    });
+}
+
+- (void)_feedStream:(NSOutputStream *)stream pace:(SRWebSocketReplayPace)pace
+{
+    const uint8_t *bytes = _capture.bytes;
+    const SRCaptureRecord *records = _inboundRecords.bytes;
+    const NSUInteger *offsets = _inboundRecordOffsets.bytes;
+    NSUInteger recordCount = _inboundRecords.length / sizeof(SRCaptureRecord);
+
+    NSDate *startDate = [NSDate date];
+    for (NSUInteger i = 0; i < recordCount; i++) {
+        if (pace == SRWebSocketReplayPaceRecorded) {
+            NSTimeInterval delay = records[i].timestamp / (double)NSEC_PER_SEC + startDate.timeIntervalSinceNow;
+            if (delay > 0) {
+                [NSThread sleepForTimeInterval:delay];
+            }
+        }
+
+        // Writes into a bound stream pair block until the socket reads enough to make space.
+        size_t written = 0;
+        while (written < records[i].length) {
+            NSInteger result = [stream write:bytes + offsets[i] + written maxLength:records[i].length - written];
+            if (result <= 0) {
+                return;
+            }
+            written += (size_t)result;
+        }
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -11,5 +11,11 @@
 
 #import <SocketRocket/NSRunLoop+SRWebSocket.h>
 #import <SocketRocket/NSURLRequest+SRWebSocket.h>
+#import <SocketRocket/SRLoopbackTransport.h>
+#import <SocketRocket/SRPreparedMessage.h>
 #import <SocketRocket/SRSecurityPolicy.h>
+#import <SocketRocket/SRSendHandle.h>
+#import <SocketRocket/SRTransport.h>
+#import <SocketRocket/SRUTF8String.h>
 #import <SocketRocket/SRWebSocket.h>
+#import <SocketRocket/SRWebSocketReplay.h>
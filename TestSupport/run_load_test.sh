@@ -0,0 +1,34 @@
+#
+# Copyright (c) 2016-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE-examples file in the root directory of this source tree.
+#
+
+# Usage: ./TestSupport/run_load_test.sh [load test options]
+# Builds the echo server and load generator, runs the generator against the server and prints a row per connection count.
+
+set -e
+
+BUILD_PATH=$(pwd)/build/LoadTest
+SERVER_PORT=9002
+
+mkdir -p $BUILD_PATH
+
+cmake -S . -B $BUILD_PATH/server -DCMAKE_BUILD_TYPE=Release
+cmake --build $BUILD_PATH/server --target SRLoadTestServer
+
+xcodebuild -project SocketRocket.xcodeproj -scheme SocketRocket-macOS -configuration Release \
+  CONFIGURATION_BUILD_DIR=$BUILD_PATH build > $BUILD_PATH/xcodebuild.log
+clang -fobjc-arc -O2 -F$BUILD_PATH -framework Foundation -framework SocketRocket \
+  -Wl,-rpath,$BUILD_PATH LoadTest/SRLoadTest.m -o $BUILD_PATH/SRLoadTest
+
+ulimit -n 65536 || ulimit -n $(ulimit -Hn)
+
+$BUILD_PATH/server/SRLoadTestServer -p $SERVER_PORT &
+SERVER_PID=$!
+trap "kill $SERVER_PID" EXIT
+sleep 1
+
+$BUILD_PATH/SRLoadTest -url ws://127.0.0.1:$SERVER_PORT/ "$@"
@@ -0,0 +1,196 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+// Measures latency per MB of masking and UTF-8 validation of a large payload, split into chunks
+// that are processed by 1, 2, 4... threads, up to the number of cores. Sockets do the same with `dispatch_apply`
+// for payloads above `concurrentProcessingThreshold`.
+// Also measures framing the payload as a message sent in fragments, each masked with its own key on all cores.
+//
+// Usage: SRCoreBenchmark [payload size in MB, default 16] [iterations, default 20] [maximum threads, default number of cores]
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "SRCoreApply.h"
+#include "SRFrame.h"
+#include "SRMasking.h"
+#include "SRUTF8.h"
+
+///--------------------------------------
+// Thread Apply
+///--------------------------------------
+
+typedef struct {
+    size_t count;
+    atomic_size_t nextIndex;
+    void *workContext;
+    void (*work)(void *workContext, size_t index);
+} SRBenchmarkApplyState;
+
+static void *SRBenchmarkApplyThread(void *context)
+{
+    SRBenchmarkApplyState *state = context;
+    for (;;) {
+        size_t index = atomic_fetch_add(&state->nextIndex, 1);
+        if (index >= state->count) {
+            return NULL;
+        }
+        state->work(state->workContext, index);
+    }
+}
+
+// Runs work on `*(size_t *)context` threads, including the calling one, which pull chunks until none are left.
+static void SRBenchmarkApply(void *context, size_t count, void *workContext, void (*work)(void *workContext, size_t index))
+{
+    size_t threadCount = *(const size_t *)context;
+    SRBenchmarkApplyState state = { .count = count, .workContext = workContext, .work = work };
+    atomic_init(&state.nextIndex, 0);
+
+    pthread_t threads[threadCount];
+    for (size_t i = 1; i < threadCount; i++) {
+        pthread_create(&threads[i], NULL, SRBenchmarkApplyThread, &state);
+    }
+    SRBenchmarkApplyThread(&state);
+    for (size_t i = 1; i < threadCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+///--------------------------------------
+// Framing
+///--------------------------------------
+
+// Default `concurrentProcessingThreshold` of a socket, which is also the smallest fragment of a message that large.
+static const size_t SRBenchmarkFragmentSize = 1024 * 1024;
+
+// Frames a message the way sockets do when it is at least `concurrentProcessingThreshold` long: every fragment
+// gets a header with its own mask key, and its payload is masked into the frame on all cores.
+static void SRBenchmarkFrameMessage(const SRCoreApply *apply, uint8_t *frames, const uint8_t *source, size_t length)
+{
+    uint32_t keySeed = 0x12345678;
+    for (size_t offset = 0; offset < length; offset += SRBenchmarkFragmentSize) {
+        size_t fragmentLength = (length - offset < SRBenchmarkFragmentSize ? length - offset : SRBenchmarkFragmentSize);
+
+        // Sockets use random keys, any distinct key costs the same.
+        keySeed = keySeed * 1664525 + 1013904223;
+        uint8_t maskKey[4];
+        memcpy(maskKey, &keySeed, sizeof(maskKey));
+
+        size_t headerLength = SRFrameHeaderWrite(frames,
+                                                 (offset == 0 ? SROpCodeBinaryFrame : SROpCodeContinuationFrame),
+                                                 (offset + fragmentLength == length),
+                                                 fragmentLength,
+                                                 maskKey);
+        SRMaskBytesCopyConcurrently(apply, frames + headerLength, source + offset, fragmentLength, maskKey, 0);
+        frames += headerLength + fragmentLength;
+    }
+}
+
+///--------------------------------------
+// Benchmark
+///--------------------------------------
+
+static double SRBenchmarkNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    size_t megabytes = (argc > 1 ? (size_t)atol(argv[1]) : 16);
+    size_t iterations = (argc > 2 ? (size_t)atol(argv[2]) : 20);
+    long coreCount = (argc > 3 ? atol(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN));
+    if (megabytes == 0 || iterations == 0 || coreCount < 1) {
+        fprintf(stderr, "usage: %s [payload size in MB] [iterations] [maximum threads]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Mostly ASCII text with some 2, 3 and 4 byte code points, like typical JSON.
+    static const char pattern[] = "{\"name\":\"caf\xC3\xA9\",\"price\":\"\xE2\x82\xAC" "10\",\"icon\":\"\xF0\x9F\x9A\x80\"},";
+    size_t length = megabytes * 1024 * 1024;
+    uint8_t *source = malloc(length);
+    uint8_t *destination = malloc(length);
+    uint8_t *frames = malloc(length + (length / SRBenchmarkFragmentSize + 1) * SRFrameHeaderMaxLength);
+    if (!source || !destination || !frames) {
+        fprintf(stderr, "Unable to allocate %zu MB\n", megabytes);
+        return EXIT_FAILURE;
+    }
+    size_t patternLength = sizeof(pattern) - 1;
+    size_t textLength = length - (length % patternLength);
+    for (size_t i = 0; i < length; i++) {
+        source[i] = (uint8_t)pattern[i % patternLength];
+    }
+    const uint8_t maskKey[4] = { 0x12, 0x34, 0x56, 0x78 };
+
+    printf("%zu MB payload, %zu KB chunks, %zu iterations\n", megabytes, SRCoreApplyChunkSize / 1024, iterations);
+    printf("%8s %14s %10s %14s %10s %14s %10s\n", "threads", "mask ms/MB", "speedup", "utf8 ms/MB", "speedup", "frame ms/MB", "speedup");
+
+    double serialMaskTime = 0;
+    double serialValidationTime = 0;
+    double serialFramingTime = 0;
+    size_t threadCount = 1;
+    for (;;) {
+        SRCoreApply apply = { .apply = SRBenchmarkApply, .context = &threadCount };
+
+        double start = SRBenchmarkNow();
+        for (size_t i = 0; i < iterations; i++) {
+            SRMaskBytesCopyConcurrently(&apply, destination, source, length, maskKey, 0);
+        }
+        double maskTime = (SRBenchmarkNow() - start) / iterations / megabytes;
+
+        start = SRBenchmarkNow();
+        for (size_t i = 0; i < iterations; i++) {
+            SRUTF8Validator validator;
+            SRUTF8ValidatorInit(&validator);
+            if (!SRUTF8ValidatorUpdateConcurrently(&apply, &validator, source, textLength) || !SRUTF8ValidatorIsComplete(&validator)) {
+                fprintf(stderr, "Validation failed\n");
+                return EXIT_FAILURE;
+            }
+        }
+        double validationTime = (SRBenchmarkNow() - start) / iterations / megabytes;
+
+        start = SRBenchmarkNow();
+        for (size_t i = 0; i < iterations; i++) {
+            SRBenchmarkFrameMessage(&apply, frames, source, length);
+        }
+        double framingTime = (SRBenchmarkNow() - start) / iterations / megabytes;
+
+        if (threadCount == 1) {
+            serialMaskTime = maskTime;
+            serialValidationTime = validationTime;
+            serialFramingTime = framingTime;
+        }
+        printf("%8zu %14.3f %9.2fx %14.3f %9.2fx %14.3f %9.2fx\n",
+               threadCount,
+               maskTime * 1000.0,
+               serialMaskTime / maskTime,
+               validationTime * 1000.0,
+               serialValidationTime / validationTime,
+               framingTime * 1000.0,
+               serialFramingTime / framingTime);
+        fflush(stdout);
+
+        if (threadCount == (size_t)coreCount) {
+            break;
+        }
+        threadCount = (threadCount * 2 < (size_t)coreCount ? threadCount * 2 : (size_t)coreCount);
+    }
+
+    free(source);
+    free(destination);
+    free(frames);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,673 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SRCapture.h"
+#include "SRCoreCrypto.h"
+#include "SRFrame.h"
+#include "SRHandshake.h"
+#include "SRHPACK.h"
+#include "SRHTTP2.h"
+#include "SRMasking.h"
+#include "SRUTF8.h"
+
+static int SRTestFailureCount = 0;
+
+#define SRTestAssert(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #condition); \
+            SRTestFailureCount++; \
+        } \
+    } while (0)
+
+// Runs work backwards, so results can't depend on chunks being processed in order.
+static void SRTestApplyReversed(void *context, size_t count, void *workContext, void (*work)(void *workContext, size_t index))
+{
+    (void)context;
+    for (size_t index = count; index > 0; index--) {
+        work(workContext, index - 1);
+    }
+}
+
+static const SRCoreApply SRTestApplyReversedOrder = { .apply = SRTestApplyReversed, .context = NULL };
+
+///--------------------------------------
+// Crypto & Handshake
+///--------------------------------------
+
+static void testSHA1(void)
+{
+    static const uint8_t expected[SRSHA1DigestLength] = {
+        0xA9, 0x99, 0x3E, 0x36, 0x47, 0x06, 0x81, 0x6A, 0xBA, 0x3E,
+        0x25, 0x71, 0x78, 0x50, 0xC2, 0x6C, 0x9C, 0xD0, 0xD8, 0x9D,
+    };
+    uint8_t digest[SRSHA1DigestLength];
+    SRCoreSHA1((const uint8_t *)"abc", 3, digest);
+    SRTestAssert(memcmp(digest, expected, sizeof(digest)) == 0);
+
+    // Padding spills into a second block.
+    static const char *message = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    static const uint8_t expectedLong[SRSHA1DigestLength] = {
+        0x84, 0x98, 0x3E, 0x44, 0x1C, 0x3B, 0xD2, 0x6E, 0xBA, 0xAE,
+        0x4A, 0xA1, 0xF9, 0x51, 0x29, 0xE5, 0xE5, 0x46, 0x70, 0xF1,
+    };
+    SRCoreSHA1((const uint8_t *)message, strlen(message), digest);
+    SRTestAssert(memcmp(digest, expectedLong, sizeof(digest)) == 0);
+}
+
+static void testBase64(void)
+{
+    char output[16];
+    SRTestAssert(SRBase64Encode((const uint8_t *)"", 0, output) == 0 && strcmp(output, "") == 0);
+    SRTestAssert(SRBase64Encode((const uint8_t *)"f", 1, output) == 4 && strcmp(output, "Zg==") == 0);
+    SRTestAssert(SRBase64Encode((const uint8_t *)"fo", 2, output) == 4 && strcmp(output, "Zm8=") == 0);
+    SRTestAssert(SRBase64Encode((const uint8_t *)"foo", 3, output) == 4 && strcmp(output, "Zm9v") == 0);
+    SRTestAssert(SRBase64Encode((const uint8_t *)"foobar", 6, output) == 8 && strcmp(output, "Zm9vYmFy") == 0);
+}
+
+static void testHandshake(void)
+{
+    // Example from RFC 6455, section 1.3.
+    const char *key = "dGhlIHNhbXBsZSBub25jZQ==";
+    char acceptKey[SRHandshakeAcceptKeyLength + 1];
+    SRTestAssert(SRHandshakeAcceptKeyCreate(&SRCoreCryptoPortable, key, strlen(key), acceptKey));
+    SRTestAssert(strcmp(acceptKey, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0);
+
+    char generatedKey[SRHandshakeKeyLength + 1];
+    char otherKey[SRHandshakeKeyLength + 1];
+    SRTestAssert(SRHandshakeKeyCreate(&SRCoreCryptoPortable, generatedKey));
+    SRTestAssert(SRHandshakeKeyCreate(&SRCoreCryptoPortable, otherKey));
+    SRTestAssert(strlen(generatedKey) == SRHandshakeKeyLength);
+    SRTestAssert(strcmp(generatedKey, otherKey) != 0);
+}
+
+///--------------------------------------
+// Masking
+///--------------------------------------
+
+static void testMasking(void)
+{
+    const uint8_t maskKey[4] = { 0x12, 0x34, 0x56, 0x78 };
+    uint8_t storage[300];
+    uint8_t expected[300];
+
+    for (size_t start = 0; start < 33; start++) {
+        for (size_t length = 0; length < sizeof(storage) - start; length += 7) {
+            for (size_t maskOffset = 0; maskOffset < 4; maskOffset++) {
+                uint8_t *bytes = storage + start;
+                for (size_t i = 0; i < length; i++) {
+                    bytes[i] = (uint8_t)(i * 31 + start);
+                    expected[i] = bytes[i] ^ maskKey[(maskOffset + i) % 4];
+                }
+                SRMaskBytes(bytes, length, maskKey, maskOffset);
+                SRTestAssert(memcmp(bytes, expected, length) == 0);
+            }
+        }
+    }
+}
+
+static void testMaskingCopy(void)
+{
+    const uint8_t maskKey[4] = { 0x12, 0x34, 0x56, 0x78 };
+    uint8_t source[300];
+    uint8_t destination[300];
+    uint8_t expected[300];
+
+    for (size_t i = 0; i < sizeof(source); i++) {
+        source[i] = (uint8_t)(i * 31);
+    }
+    // Source and destination misaligned relative to each other.
+    for (size_t start = 0; start < 33; start++) {
+        for (size_t length = 0; length < sizeof(source) - start; length += 7) {
+            for (size_t maskOffset = 0; maskOffset < 4; maskOffset++) {
+                memcpy(expected, source + start, length);
+                SRMaskBytes(expected, length, maskKey, maskOffset);
+                memset(destination, 0, sizeof(destination));
+                SRMaskBytesCopy(destination + (start / 2), source + start, length, maskKey, maskOffset);
+                SRTestAssert(memcmp(destination + (start / 2), expected, length) == 0);
+            }
+        }
+    }
+}
+
+static void testMaskingConcurrently(void)
+{
+    const uint8_t maskKey[4] = { 0x12, 0x34, 0x56, 0x78 };
+    const size_t length = 3 * SRCoreApplyChunkSize + 1001;
+    uint8_t *source = malloc(length);
+    uint8_t *destination = malloc(length);
+    uint8_t *expected = malloc(length);
+    for (size_t i = 0; i < length; i++) {
+        source[i] = (uint8_t)(i * 31);
+    }
+
+    for (size_t maskOffset = 0; maskOffset < 4; maskOffset++) {
+        SRMaskBytesCopy(expected, source, length, maskKey, maskOffset);
+        SRMaskBytesCopyConcurrently(&SRCoreApplySerial, destination, source, length, maskKey, maskOffset);
+        SRTestAssert(memcmp(destination, expected, length) == 0);
+        memset(destination, 0, length);
+        SRMaskBytesCopyConcurrently(&SRTestApplyReversedOrder, destination, source, length, maskKey, maskOffset);
+        SRTestAssert(memcmp(destination, expected, length) == 0);
+    }
+
+    free(source);
+    free(destination);
+    free(expected);
+}
+
+///--------------------------------------
+// UTF-8
+///--------------------------------------
+
+static void testUTF8(void)
+{
+    SRTestAssert(SRUTF8IsValid((const uint8_t *)"", 0));
+    SRTestAssert(SRUTF8IsValid((const uint8_t *)"Hello, world! Long enough for the fast path.", 44));
+
+    const uint8_t valid[] = { 0xCE, 0xBA, 0xE1, 0xBD, 0xB9, 0xCF, 0x83, 0xCE, 0xBC, 0xCE, 0xB5, 0xF0, 0x9F, 0x98, 0x80, 0xF4, 0x8F, 0xBF, 0xBF };
+    SRTestAssert(SRUTF8IsValid(valid, sizeof(valid)));
+
+    // Split at every possible position.
+    for (size_t split = 0; split <= sizeof(valid); split++) {
+        SRUTF8Validator validator;
+        SRUTF8ValidatorInit(&validator);
+        SRTestAssert(SRUTF8ValidatorUpdate(&validator, valid, split));
+        SRTestAssert(SRUTF8ValidatorUpdate(&validator, valid + split, sizeof(valid) - split));
+        SRTestAssert(SRUTF8ValidatorIsComplete(&validator));
+    }
+
+    // Truncated code point is a valid prefix, but not complete.
+    SRUTF8Validator validator;
+    SRUTF8ValidatorInit(&validator);
+    SRTestAssert(SRUTF8ValidatorUpdate(&validator, valid, 3));
+    SRTestAssert(!SRUTF8ValidatorIsComplete(&validator));
+
+    const uint8_t overlong[] = { 0xC0, 0xAF };
+    const uint8_t overlongThreeBytes[] = { 0xE0, 0x80, 0xAF };
+    const uint8_t surrogate[] = { 0xED, 0xA0, 0x80 };
+    const uint8_t tooLarge[] = { 0xF4, 0x90, 0x80, 0x80 };
+    const uint8_t unexpectedContinuation[] = { 0x61, 0x80 };
+    const uint8_t invalidLead[] = { 0xFF };
+    SRTestAssert(!SRUTF8IsValid(overlong, sizeof(overlong)));
+    SRTestAssert(!SRUTF8IsValid(overlongThreeBytes, sizeof(overlongThreeBytes)));
+    SRTestAssert(!SRUTF8IsValid(surrogate, sizeof(surrogate)));
+    SRTestAssert(!SRUTF8IsValid(tooLarge, sizeof(tooLarge)));
+    SRTestAssert(!SRUTF8IsValid(unexpectedContinuation, sizeof(unexpectedContinuation)));
+    SRTestAssert(!SRUTF8IsValid(invalidLead, sizeof(invalidLead)));
+}
+
+static void testUTF8Concurrently(void)
+{
+    // "€😀" is 7 bytes long, so code points straddle chunk boundaries at different positions.
+    const uint8_t pattern[] = { 0xE2, 0x82, 0xAC, 0xF0, 0x9F, 0x98, 0x80 };
+    const size_t length = 3 * SRCoreApplyChunkSize + 5;
+    uint8_t *bytes = malloc(length);
+    for (size_t i = 0; i < length; i++) {
+        bytes[i] = pattern[i % sizeof(pattern)];
+    }
+    // Ends with a complete code point.
+    const size_t validLength = length - (length % sizeof(pattern));
+
+    const SRCoreApply *applies[] = { &SRCoreApplySerial, &SRTestApplyReversedOrder };
+    for (size_t a = 0; a < sizeof(applies) / sizeof(applies[0]); a++) {
+        const SRCoreApply *apply = applies[a];
+
+        // Starting mid code point carries it over from a previous update, ending mid code point carries one into the next.
+        for (size_t split = 0; split < sizeof(pattern); split++) {
+            SRUTF8Validator validator;
+            SRUTF8ValidatorInit(&validator);
+            SRTestAssert(SRUTF8ValidatorUpdate(&validator, bytes, split));
+            SRTestAssert(SRUTF8ValidatorUpdateConcurrently(apply, &validator, bytes + split, validLength - 1 - split));
+            SRTestAssert(!SRUTF8ValidatorIsComplete(&validator));
+            SRTestAssert(SRUTF8ValidatorUpdate(&validator, bytes + validLength - 1, 1));
+            SRTestAssert(SRUTF8ValidatorIsComplete(&validator));
+        }
+
+        // Invalid bytes right before, at and after a chunk boundary.
+        for (size_t position = SRCoreApplyChunkSize - 2; position <= SRCoreApplyChunkSize + 2; position++) {
+            uint8_t original = bytes[position];
+            bytes[position] = 0xFF;
+            SRUTF8Validator validator;
+            SRUTF8ValidatorInit(&validator);
+            SRTestAssert(!SRUTF8ValidatorUpdateConcurrently(apply, &validator, bytes, validLength));
+            bytes[position] = original;
+        }
+
+        // "€" truncated after its second byte, which is where the next chunk starts, so only stitching can catch it.
+        SRTestAssert(SRCoreApplyChunkSize % sizeof(pattern) == 1);
+        uint8_t original = bytes[SRCoreApplyChunkSize + 1];
+        bytes[SRCoreApplyChunkSize + 1] = 'a';
+        SRUTF8Validator validator;
+        SRUTF8ValidatorInit(&validator);
+        SRTestAssert(!SRUTF8ValidatorUpdateConcurrently(apply, &validator, bytes, validLength));
+        bytes[SRCoreApplyChunkSize + 1] = original;
+    }
+
+    free(bytes);
+}
+
+///--------------------------------------
+// Frames
+///--------------------------------------
+
+static void testFrameHeader(void)
+{
+    const uint64_t payloadLengths[] = { 0, 1, 125, 126, 65535, 65536, 1ULL << 40 };
+    const uint8_t maskKey[4] = { 1, 2, 3, 4 };
+
+    for (size_t i = 0; i < sizeof(payloadLengths) / sizeof(payloadLengths[0]); i++) {
+        for (int masked = 0; masked < 2; masked++) {
+            uint8_t buffer[SRFrameHeaderMaxLength];
+            size_t length = SRFrameHeaderWrite(buffer, SROpCodeBinaryFrame, masked, payloadLengths[i], (masked ? maskKey : NULL));
+            SRTestAssert(length == SRFrameHeaderLength(payloadLengths[i], masked));
+
+            SRFrameHeader header;
+            SRTestAssert(SRFrameHeaderParse(buffer, length - 1, &header) == SRFrameResultNeedMoreData);
+            SRTestAssert(header.headerLength == length);
+
+            SRTestAssert(SRFrameHeaderParse(buffer, length, &header) == SRFrameResultOK);
+            SRTestAssert(header.fin == (bool)masked);
+            SRTestAssert(header.rsv == 0);
+            SRTestAssert(header.opcode == SROpCodeBinaryFrame);
+            SRTestAssert(header.masked == (bool)masked);
+            SRTestAssert(header.payloadLength == payloadLengths[i]);
+            SRTestAssert(!masked || memcmp(header.maskKey, maskKey, sizeof(maskKey)) == 0);
+        }
+    }
+
+    const uint8_t invalidLength[] = { 0x82, 127, 0x80, 0, 0, 0, 0, 0, 0, 0 };
+    SRFrameHeader header;
+    SRTestAssert(SRFrameHeaderParse(invalidLength, sizeof(invalidLength), &header) == SRFrameResultProtocolError);
+
+    const uint8_t rsv[] = { 0xF1, 0 };
+    SRTestAssert(SRFrameHeaderParse(rsv, sizeof(rsv), &header) == SRFrameResultOK);
+    SRTestAssert(header.rsv == 0x7);
+    SRTestAssert(header.fin && header.opcode == SROpCodeTextFrame);
+}
+
+static void testCloseCodes(void)
+{
+    SRTestAssert(SRCloseCodeIsValid(1000));
+    SRTestAssert(SRCloseCodeIsValid(1011));
+    SRTestAssert(SRCloseCodeIsValid(3000));
+    SRTestAssert(SRCloseCodeIsValid(4999));
+    SRTestAssert(!SRCloseCodeIsValid(999));
+    SRTestAssert(!SRCloseCodeIsValid(1005));
+    SRTestAssert(!SRCloseCodeIsValid(1012));
+    SRTestAssert(!SRCloseCodeIsValid(5000));
+}
+
+typedef struct {
+    uint8_t bytes[1 << 17];
+    size_t length;
+} SRTestBuffer;
+
+static bool SRTestBufferWrite(void *context, const uint8_t *bytes, size_t length)
+{
+    SRTestBuffer *buffer = context;
+    if (buffer->length + length > sizeof(buffer->bytes)) {
+        return false;
+    }
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+    return true;
+}
+
+typedef struct {
+    size_t frameCount;
+    SROpCode opcodes[4];
+    bool fins[4];
+    uint8_t payload[1 << 17];
+    size_t payloadLength;
+} SRTestDecoderState;
+
+static void SRTestDecoderFrameHeader(void *context, const SRFrameHeader *header)
+{
+    SRTestDecoderState *state = context;
+    state->opcodes[state->frameCount] = header->opcode;
+    state->fins[state->frameCount] = header->fin;
+}
+
+static void SRTestDecoderFramePayload(void *context, const SRFrameHeader *header, const uint8_t *bytes, size_t length)
+{
+    (void)header;
+    SRTestDecoderState *state = context;
+    memcpy(state->payload + state->payloadLength, bytes, length);
+    state->payloadLength += length;
+}
+
+static void SRTestDecoderFrameEnd(void *context, const SRFrameHeader *header)
+{
+    (void)header;
+    SRTestDecoderState *state = context;
+    state->frameCount++;
+}
+
+static void testFrameRoundTrip(void)
+{
+    static SRTestBuffer buffer;
+    static SRTestDecoderState state;
+    static uint8_t payload[70000];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 7);
+    }
+
+    // Stream chunk sizes, including a byte at a time.
+    const size_t chunkSizes[] = { 1, 3, 4096, sizeof(buffer.bytes) };
+    for (size_t c = 0; c < sizeof(chunkSizes) / sizeof(chunkSizes[0]); c++) {
+        memset(&buffer, 0, sizeof(buffer));
+        memset(&state, 0, sizeof(state));
+
+        SRCoreIO io = { .write = SRTestBufferWrite, .context = &buffer };
+        SRTestAssert(SRFrameWrite(&io, &SRCoreCryptoPortable, SROpCodeBinaryFrame, false, payload, sizeof(payload)));
+        SRTestAssert(SRFrameWrite(&io, &SRCoreCryptoPortable, SROpCodePing, true, NULL, 0));
+        SRTestAssert(SRFrameWrite(&io, NULL, SROpCodeContinuationFrame, true, payload, 10));
+
+        SRFrameDecoder decoder;
+        SRFrameDecoderCallbacks callbacks = {
+            .frameHeader = SRTestDecoderFrameHeader,
+            .framePayload = SRTestDecoderFramePayload,
+            .frameEnd = SRTestDecoderFrameEnd,
+            .context = &state,
+        };
+        SRFrameDecoderInit(&decoder, callbacks);
+        for (size_t offset = 0; offset < buffer.length; offset += chunkSizes[c]) {
+            size_t length = (buffer.length - offset < chunkSizes[c] ? buffer.length - offset : chunkSizes[c]);
+            SRTestAssert(SRFrameDecoderConsume(&decoder, buffer.bytes + offset, length) == SRFrameResultOK);
+        }
+
+        SRTestAssert(state.frameCount == 3);
+        SRTestAssert(state.opcodes[0] == SROpCodeBinaryFrame && !state.fins[0]);
+        SRTestAssert(state.opcodes[1] == SROpCodePing && state.fins[1]);
+        SRTestAssert(state.opcodes[2] == SROpCodeContinuationFrame && state.fins[2]);
+        SRTestAssert(state.payloadLength == sizeof(payload) + 10);
+        SRTestAssert(memcmp(state.payload, payload, sizeof(payload)) == 0);
+        SRTestAssert(memcmp(state.payload + sizeof(payload), payload, 10) == 0);
+    }
+}
+
+// Returns the result of decoding `bytes` in one go.
+static SRFrameResult SRTestDecode(const uint8_t *bytes, size_t length)
+{
+    static SRTestDecoderState state;
+    memset(&state, 0, sizeof(state));
+
+    uint8_t buffer[64];
+    memcpy(buffer, bytes, length);
+
+    SRFrameDecoder decoder;
+    SRFrameDecoderCallbacks callbacks = {
+        .frameHeader = SRTestDecoderFrameHeader,
+        .framePayload = SRTestDecoderFramePayload,
+        .frameEnd = SRTestDecoderFrameEnd,
+        .context = &state,
+    };
+    SRFrameDecoderInit(&decoder, callbacks);
+    return SRFrameDecoderConsume(&decoder, buffer, length);
+}
+
+static void testFrameDecoderValidation(void)
+{
+    // Ping between fragments of a message.
+    const uint8_t fragmented[] = { 0x01, 0x01, 'a', 0x89, 0x00, 0x80, 0x01, 'b' };
+    SRTestAssert(SRTestDecode(fragmented, sizeof(fragmented)) == SRFrameResultOK);
+
+    // RSV1 bit.
+    const uint8_t rsv[] = { 0xC1, 0x00 };
+    SRTestAssert(SRTestDecode(rsv, sizeof(rsv)) == SRFrameResultProtocolError);
+
+    // Reserved data and control opcodes.
+    const uint8_t reservedData[] = { 0x83, 0x00 };
+    SRTestAssert(SRTestDecode(reservedData, sizeof(reservedData)) == SRFrameResultProtocolError);
+    const uint8_t reservedControl[] = { 0x8B, 0x00 };
+    SRTestAssert(SRTestDecode(reservedControl, sizeof(reservedControl)) == SRFrameResultProtocolError);
+
+    // Fragmented ping.
+    const uint8_t fragmentedPing[] = { 0x09, 0x00 };
+    SRTestAssert(SRTestDecode(fragmentedPing, sizeof(fragmentedPing)) == SRFrameResultProtocolError);
+
+    // Ping with 126 bytes of payload, rejected before any payload arrives.
+    const uint8_t longPing[] = { 0x89, 0x7E, 0x00, 0x7E };
+    SRTestAssert(SRTestDecode(longPing, sizeof(longPing)) == SRFrameResultProtocolError);
+    const uint8_t maximumPing[] = { 0x89, 0x7D };
+    SRTestAssert(SRTestDecode(maximumPing, sizeof(maximumPing)) == SRFrameResultOK);
+
+    // Continuation without a message.
+    const uint8_t continuation[] = { 0x80, 0x00 };
+    SRTestAssert(SRTestDecode(continuation, sizeof(continuation)) == SRFrameResultProtocolError);
+
+    // New message before the last fragment of the previous one.
+    const uint8_t interleaved[] = { 0x01, 0x00, 0x82, 0x00 };
+    SRTestAssert(SRTestDecode(interleaved, sizeof(interleaved)) == SRFrameResultProtocolError);
+
+    // Most significant bit of a 64-bit length.
+    const uint8_t hugeLength[] = { 0x82, 0x7F, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    SRTestAssert(SRTestDecode(hugeLength, sizeof(hugeLength)) == SRFrameResultProtocolError);
+}
+
+// Returns the validity of the header at the beginning of `bytes`.
+static SRFrameHeaderValidity SRTestValidate(const uint8_t *bytes, size_t length, bool readingFragmentedMessage)
+{
+    SRFrameHeader header = {0};
+    SRTestAssert(SRFrameHeaderParse(bytes, length, &header) == SRFrameResultOK);
+    return SRFrameHeaderValidate(&header, readingFragmentedMessage);
+}
+
+static void testFrameHeaderValidation(void)
+{
+    const uint8_t text[] = { 0x81, 0x00 };
+    SRTestAssert(SRTestValidate(text, sizeof(text), false) == SRFrameHeaderValid);
+    SRTestAssert(SRTestValidate(text, sizeof(text), true) == SRFrameHeaderInvalidUnexpectedDataFrame);
+
+    const uint8_t continuation[] = { 0x80, 0x00 };
+    SRTestAssert(SRTestValidate(continuation, sizeof(continuation), true) == SRFrameHeaderValid);
+    SRTestAssert(SRTestValidate(continuation, sizeof(continuation), false) == SRFrameHeaderInvalidUnexpectedContinuationFrame);
+
+    // Control frames are allowed in the middle of a fragmented message.
+    const uint8_t ping[] = { 0x89, 0x7D };
+    SRTestAssert(SRTestValidate(ping, sizeof(ping), true) == SRFrameHeaderValid);
+
+    const uint8_t rsv[] = { 0xA2, 0x00 };
+    SRTestAssert(SRTestValidate(rsv, sizeof(rsv), false) == SRFrameHeaderInvalidReservedBits);
+    const uint8_t reserved[] = { 0x87, 0x00 };
+    SRTestAssert(SRTestValidate(reserved, sizeof(reserved), false) == SRFrameHeaderInvalidReservedOpcode);
+    const uint8_t fragmentedClose[] = { 0x08, 0x00 };
+    SRTestAssert(SRTestValidate(fragmentedClose, sizeof(fragmentedClose), false) == SRFrameHeaderInvalidFragmentedControlFrame);
+    const uint8_t longPong[] = { 0x8A, 0x7E, 0x00, 0x7E };
+    SRTestAssert(SRTestValidate(longPong, sizeof(longPong), false) == SRFrameHeaderInvalidControlFramePayloadLength);
+}
+
+///--------------------------------------
+// Capture
+///--------------------------------------
+
+static void testCaptureRoundTrip(void)
+{
+    static SRTestBuffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+
+    SRCoreIO io = { .write = SRTestBufferWrite, .context = &buffer };
+    const uint8_t data[] = { 0x81, 0x02, 'h', 'i' };
+    SRCaptureRecord first = { .timestamp = 0x0102030405060708ULL, .length = sizeof(data), .direction = SRCaptureDirectionInbound };
+    SRCaptureRecord second = { .timestamp = 42, .length = 0, .direction = SRCaptureDirectionOutbound };
+    SRTestAssert(SRCaptureWriteFileHeader(&io));
+    SRTestAssert(SRCaptureWriteRecord(&io, &first, data));
+    SRTestAssert(SRCaptureWriteRecord(&io, &second, NULL));
+    SRTestAssert(buffer.length == SRCaptureFileMagicLength + 2 * SRCaptureRecordHeaderLength + sizeof(data));
+
+    SRTestAssert(SRCaptureFileHeaderIsValid(buffer.bytes, buffer.length));
+    SRTestAssert(!SRCaptureFileHeaderIsValid(buffer.bytes, SRCaptureFileMagicLength - 1));
+
+    SRCaptureRecord record;
+    const uint8_t *cursor = buffer.bytes + SRCaptureFileMagicLength;
+    SRTestAssert(SRCaptureRecordParse(cursor, SRCaptureRecordHeaderLength - 1, &record) == SRFrameResultNeedMoreData);
+    SRTestAssert(SRCaptureRecordParse(cursor, SRCaptureRecordHeaderLength + 1, &record) == SRFrameResultNeedMoreData);
+    SRTestAssert(SRCaptureRecordParse(cursor, SRCaptureRecordHeaderLength + sizeof(data), &record) == SRFrameResultOK);
+    SRTestAssert(record.timestamp == first.timestamp && record.length == sizeof(data) && record.direction == SRCaptureDirectionInbound);
+    SRTestAssert(memcmp(cursor + SRCaptureRecordHeaderLength, data, sizeof(data)) == 0);
+
+    cursor += SRCaptureRecordHeaderLength + sizeof(data);
+    SRTestAssert(SRCaptureRecordParse(cursor, SRCaptureRecordHeaderLength, &record) == SRFrameResultOK);
+    SRTestAssert(record.timestamp == 42 && record.length == 0 && record.direction == SRCaptureDirectionOutbound);
+
+    uint8_t malformed[SRCaptureRecordHeaderLength] = {0};
+    malformed[12] = 7;
+    SRTestAssert(SRCaptureRecordParse(malformed, sizeof(malformed), &record) == SRFrameResultProtocolError);
+}
+
+///--------------------------------------
+// HTTP/2
+///--------------------------------------
+
+typedef struct {
+    size_t count;
+    char names[8][64];
+    char values[8][64];
+} SRTestHeaders;
+
+static void SRTestHeadersAppend(void *context, const uint8_t *name, size_t nameLength, const uint8_t *value, size_t valueLength)
+{
+    SRTestHeaders *headers = context;
+    if (headers->count == 8 || nameLength >= 64 || valueLength >= 64) {
+        return;
+    }
+    memcpy(headers->names[headers->count], name, nameLength);
+    headers->names[headers->count][nameLength] = '\0';
+    memcpy(headers->values[headers->count], value, valueLength);
+    headers->values[headers->count][valueLength] = '\0';
+    headers->count++;
+}
+
+static void testHPACK(void)
+{
+    uint8_t scratch[256];
+    SRTestHeaders headers;
+
+    // RFC 7541, C.4.1: first request with Huffman coding.
+    const uint8_t request[] = {
+        0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff,
+    };
+    memset(&headers, 0, sizeof(headers));
+    SRHPACKDecoderCallbacks callbacks = { .header = SRTestHeadersAppend, .context = &headers };
+    SRTestAssert(SRHPACKDecode(request, sizeof(request), scratch, sizeof(scratch), callbacks) == SRFrameResultOK);
+    SRTestAssert(headers.count == 4);
+    SRTestAssert(strcmp(headers.names[0], ":method") == 0 && strcmp(headers.values[0], "GET") == 0);
+    SRTestAssert(strcmp(headers.names[1], ":scheme") == 0 && strcmp(headers.values[1], "http") == 0);
+    SRTestAssert(strcmp(headers.names[2], ":path") == 0 && strcmp(headers.values[2], "/") == 0);
+    SRTestAssert(strcmp(headers.names[3], ":authority") == 0 && strcmp(headers.values[3], "www.example.com") == 0);
+
+    // Huffman output that doesn't fit into scratch, references to the dynamic table and growing it are errors.
+    SRTestAssert(SRHPACKDecode(request, sizeof(request), scratch, 4, callbacks) == SRFrameResultProtocolError);
+    const uint8_t dynamicIndex[] = { 0xBE };
+    SRTestAssert(SRHPACKDecode(dynamicIndex, sizeof(dynamicIndex), scratch, sizeof(scratch), callbacks) == SRFrameResultProtocolError);
+    const uint8_t tableSizeUpdate[] = { 0x3F, 0xE1, 0x1F };
+    SRTestAssert(SRHPACKDecode(tableSizeUpdate, sizeof(tableSizeUpdate), scratch, sizeof(scratch), callbacks) == SRFrameResultProtocolError);
+
+    // Padding longer than 7 bits is an error.
+    uint8_t decoded[8];
+    const uint8_t overlongPadding[] = { 0x1F, 0xFF };
+    SRTestAssert(SRHPACKHuffmanDecode(overlongPadding, sizeof(overlongPadding), decoded, sizeof(decoded)) == -1);
+
+    static SRTestBuffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    SRCoreIO io = { .write = SRTestBufferWrite, .context = &buffer };
+    SRTestAssert(SRHPACKEncodeHeader(&io, ":status", 7, "200", 3));
+    SRTestAssert(buffer.length == 1 && buffer.bytes[0] == 0x88);
+    SRTestAssert(SRHPACKEncodeHeader(&io, ":method", 7, "CONNECT", 7));
+    SRTestAssert(SRHPACKEncodeHeader(&io, ":protocol", 9, "websocket", 9));
+
+    static char longValue[300];
+    memset(longValue, 'x', sizeof(longValue) - 1);
+    SRTestAssert(SRHPACKEncodeHeader(&io, "sec-websocket-protocol", 22, longValue, strlen(longValue)));
+
+    // Strings that aren't Huffman-encoded are passed straight from the input, without using scratch.
+    uint8_t noScratch[1];
+    SRTestHeaders roundTrip;
+    memset(&roundTrip, 0, sizeof(roundTrip));
+    callbacks.context = &roundTrip;
+    SRTestAssert(SRHPACKDecode(buffer.bytes, buffer.length, noScratch, sizeof(noScratch), callbacks) == SRFrameResultOK);
+    // The long value doesn't fit into `SRTestHeaders` and is dropped by the callback.
+    SRTestAssert(roundTrip.count == 3);
+    SRTestAssert(strcmp(roundTrip.names[0], ":status") == 0 && strcmp(roundTrip.values[0], "200") == 0);
+    SRTestAssert(strcmp(roundTrip.names[1], ":method") == 0 && strcmp(roundTrip.values[1], "CONNECT") == 0);
+    SRTestAssert(strcmp(roundTrip.names[2], ":protocol") == 0 && strcmp(roundTrip.values[2], "websocket") == 0);
+}
+
+static void testHTTP2Frames(void)
+{
+    static SRTestBuffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    SRCoreIO io = { .write = SRTestBufferWrite, .context = &buffer };
+
+    const SRHTTP2Setting settings[] = {
+        { SRHTTP2SettingEnableConnectProtocol, 1 },
+        { SRHTTP2SettingInitialWindowSize, 1 << 20 },
+    };
+    SRTestAssert(SRHTTP2WriteSettings(&io, settings, 2, false));
+    SRTestAssert(SRHTTP2WriteWindowUpdate(&io, 3, 0x80001000));
+
+    SRHTTP2FrameHeader header;
+    SRTestAssert(SRHTTP2FrameHeaderParse(buffer.bytes, SRHTTP2FrameHeaderLength - 1, &header) == SRFrameResultNeedMoreData);
+    SRTestAssert(SRHTTP2FrameHeaderParse(buffer.bytes, buffer.length, &header) == SRFrameResultOK);
+    SRTestAssert(header.type == SRHTTP2FrameTypeSettings && header.flags == 0 && header.streamID == 0);
+    SRTestAssert(header.length == 2 * SRHTTP2SettingLength);
+
+    SRHTTP2Setting setting;
+    const uint8_t *payload = buffer.bytes + SRHTTP2FrameHeaderLength;
+    SRTestAssert(SRHTTP2SettingRead(payload, header.length, 1, &setting));
+    SRTestAssert(setting.identifier == SRHTTP2SettingInitialWindowSize && setting.value == (1 << 20));
+    SRTestAssert(!SRHTTP2SettingRead(payload, header.length, 2, &setting));
+
+    // The reserved bit of the increment is dropped.
+    const uint8_t *windowUpdate = payload + header.length;
+    SRTestAssert(SRHTTP2FrameHeaderParse(windowUpdate, SRHTTP2FrameHeaderLength, &header) == SRFrameResultOK);
+    SRTestAssert(header.type == SRHTTP2FrameTypeWindowUpdate && header.streamID == 3 && header.length == 4);
+    SRTestAssert(SRHTTP2ReadUInt31(windowUpdate + SRHTTP2FrameHeaderLength) == 0x1000);
+
+    // Padded HEADERS with priority.
+    const uint8_t padded[] = { 2, 0, 0, 0, 1, 16, 0x88, 0, 0 };
+    SRHTTP2FrameHeader headers = { .length = sizeof(padded), .type = SRHTTP2FrameTypeHeaders, .flags = SRHTTP2FlagPadded | SRHTTP2FlagPriority };
+    const uint8_t *stripped = NULL;
+    size_t strippedLength = 0;
+    SRTestAssert(SRHTTP2FramePayloadStrip(&headers, padded, &stripped, &strippedLength) == SRFrameResultOK);
+    SRTestAssert(strippedLength == 1 && stripped[0] == 0x88);
+    headers.length = 3;
+    SRTestAssert(SRHTTP2FramePayloadStrip(&headers, padded, &stripped, &strippedLength) == SRFrameResultProtocolError);
+}
+
+int main(void)
+{
+    testSHA1();
+    testBase64();
+    testHandshake();
+    testMasking();
+    testMaskingCopy();
+    testMaskingConcurrently();
+    testUTF8();
+    testUTF8Concurrently();
+    testFrameHeader();
+    testCloseCodes();
+    testFrameRoundTrip();
+    testFrameDecoderValidation();
+    testFrameHeaderValidation();
+    testCaptureRoundTrip();
+    testHPACK();
+    testHTTP2Frames();
+
+    if (SRTestFailureCount > 0) {
+        fprintf(stderr, "%d assertion(s) failed\n", SRTestFailureCount);
+        return EXIT_FAILURE;
+    }
+    printf("All tests passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,368 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+@import XCTest;
+
+#import <CommonCrypto/CommonDigest.h>
+
+#import <SocketRocket/SocketRocket.h>
+
+static const NSUInteger SRFloodMessageLength = 1024;
+static const NSUInteger SRFloodMessageCount = 4096;
+static const NSUInteger SRFloodMaximumUndeliveredMessageCount = 16;
+
+///--------------------------------------
+#pragma mark - Flood Server
+///--------------------------------------
+
+// Answers the opening handshake, then writes binary messages as fast as the transport accepts them.
+@interface SRFloodServer : NSObject <SRTransportDelegate>
+
+- (instancetype)initWithTransport:(SRLoopbackTransport *)transport messageCount:(NSUInteger)messageCount;
+
+@property (atomic, assign, readonly) NSUInteger bytesWritten;
+
+@end
+
+@interface SRFloodServer ()
+
+@property (atomic, assign, readwrite) NSUInteger bytesWritten;
+
+@end
+
+@implementation SRFloodServer
+{
+    SRLoopbackTransport *_transport;
+    NSMutableData *_input;
+    NSMutableData *_output;
+    NSUInteger _outputOffset;
+    NSData *_frame;
+    NSUInteger _remainingMessageCount;
+}
+
+- (instancetype)initWithTransport:(SRLoopbackTransport *)transport messageCount:(NSUInteger)messageCount
+{
+    self = [super init];
+    if (!self) return self;
+
+    NSMutableData *frame = [NSMutableData dataWithLength:4 + SRFloodMessageLength];
+    uint8_t *header = frame.mutableBytes;
+    header[0] = 0x82; // FIN, binary
+    header[1] = 126;
+    header[2] = (uint8_t)(SRFloodMessageLength >> 8);
+    header[3] = (uint8_t)(SRFloodMessageLength & 0xFF);
+    _frame = frame;
+
+    _input = [NSMutableData data];
+    _remainingMessageCount = messageCount;
+    _transport = transport;
+    _transport.delegate = self;
+    [_transport openTransport];
+
+    return self;
+}
+
++ (NSUInteger)frameLength
+{
+    return 4 + SRFloodMessageLength;
+}
+
+- (void)transport:(id<SRTransport>)transport handleEvent:(SRTransportEvent)event
+{
+    switch (event) {
+        case SRTransportEventHasBytesAvailable: {
+            uint8_t buffer[4096];
+            while (_transport.hasBytesAvailable) {
+                NSInteger length = [_transport read:buffer maxLength:sizeof(buffer)];
+                if (length <= 0) {
+                    break;
+                }
+                [_input appendBytes:buffer length:(NSUInteger)length];
+            }
+            if (!_output) {
+                [self _readHandshake];
+            }
+            [self _flush];
+            break;
+        }
+        case SRTransportEventHasSpaceAvailable:
+            [self _flush];
+            break;
+        case SRTransportEventEndEncountered:
+        case SRTransportEventErrorOccurred:
+            [_transport close];
+            break;
+        case SRTransportEventOpenCompleted:
+            break;
+    }
+}
+
+- (void)_readHandshake
+{
+    NSData *terminator = [@"\r\n\r\n" dataUsingEncoding:NSASCIIStringEncoding];
+    NSRange terminatorRange = [_input rangeOfData:terminator options:0 range:NSMakeRange(0, _input.length)];
+    if (terminatorRange.location == NSNotFound) {
+        return;
+    }
+
+    NSString *request = [[NSString alloc] initWithBytes:_input.bytes length:terminatorRange.location encoding:NSUTF8StringEncoding];
+    NSString *key = @"";
+    for (NSString *line in [request componentsSeparatedByString:@"\r\n"]) {
+        NSRange separator = [line rangeOfString:@":"];
+        if (separator.location != NSNotFound &&
+            [[line substringToIndex:separator.location] caseInsensitiveCompare:@"Sec-WebSocket-Key"] == NSOrderedSame) {
+            key = [[line substringFromIndex:NSMaxRange(separator)] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        }
+    }
+
+    NSData *acceptSource = [[key stringByAppendingString:@"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"] dataUsingEncoding:NSUTF8StringEncoding];
+    uint8_t digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(acceptSource.bytes, (CC_LONG)acceptSource.length, digest);
+    NSString *accept = [[NSData dataWithBytes:digest length:sizeof(digest)] base64EncodedStringWithOptions:0];
+    NSString *response = [NSString stringWithFormat:@"HTTP/1.1 101 Switching Protocols\r\n"
+                                                    "Upgrade: websocket\r\n"
+                                                    "Connection: Upgrade\r\n"
+                                                    "Sec-WebSocket-Accept: %@\r\n\r\n", accept];
+    _output = [[response dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+}
+
+- (void)_flush
+{
+    while (_output) {
+        if (_outputOffset == _output.length) {
+            if (_remainingMessageCount == 0) {
+                return;
+            }
+            _remainingMessageCount -= 1;
+            _output = [_frame mutableCopy];
+            _outputOffset = 0;
+        }
+
+        NSInteger length = [_transport write:(const uint8_t *)_output.bytes + _outputOffset maxLength:_output.length - _outputOffset];
+        if (length <= 0) {
+            return;
+        }
+        _outputOffset += (NSUInteger)length;
+        self.bytesWritten += (NSUInteger)length;
+    }
+}
+
+@end
+
+///--------------------------------------
+#pragma mark - Message Counter
+///--------------------------------------
+
+// Counts received messages, and optionally stalls the delegate queue on the first one until `resume` is called.
+@interface SRMessageCounter : NSObject <SRWebSocketDelegate>
+
+- (instancetype)initWithExpectedMessageCount:(NSUInteger)messageCount stallsOnFirstMessage:(BOOL)stalls testCase:(XCTestCase *)testCase;
+
+@property (nonatomic, strong, readonly) XCTestExpectation *openExpectation;
+@property (nonatomic, strong, readonly) XCTestExpectation *receiveExpectation;
+@property (atomic, assign, readonly) NSUInteger receivedMessageCount;
+@property (atomic, strong, readonly) NSError *error;
+
+- (void)resume;
+
+@end
+
+@interface SRMessageCounter ()
+
+@property (atomic, assign, readwrite) NSUInteger receivedMessageCount;
+@property (atomic, strong, readwrite) NSError *error;
+
+@end
+
+@implementation SRMessageCounter
+{
+    NSUInteger _expectedMessageCount;
+    dispatch_semaphore_t _resumed;
+}
+
+- (instancetype)initWithExpectedMessageCount:(NSUInteger)messageCount stallsOnFirstMessage:(BOOL)stalls testCase:(XCTestCase *)testCase
+{
+    self = [super init];
+    if (!self) return self;
+
+    _expectedMessageCount = messageCount;
+    _resumed = (stalls ? dispatch_semaphore_create(0) : nil);
+    _openExpectation = [testCase expectationWithDescription:@"open"];
+    _receiveExpectation = [testCase expectationWithDescription:@"receive"];
+
+    return self;
+}
+
+- (void)resume
+{
+    dispatch_semaphore_signal(_resumed);
+}
+
+- (void)webSocketDidOpen:(SRWebSocket *)webSocket
+{
+    [_openExpectation fulfill];
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didReceiveMessageWithData:(NSData *)data
+{
+    if (self.receivedMessageCount == 0 && _resumed) {
+        dispatch_semaphore_wait(_resumed, DISPATCH_TIME_FOREVER);
+    }
+    self.receivedMessageCount += 1;
+    if (self.receivedMessageCount == _expectedMessageCount) {
+        [_receiveExpectation fulfill];
+    }
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didFailWithError:(NSError *)error
+{
+    self.error = error;
+}
+
+@end
+
+///--------------------------------------
+#pragma mark - Tests
+///--------------------------------------
+
+@interface SRFlowControlTests : XCTestCase <SRWebSocketDelegate>
+@end
+
+@implementation SRFlowControlTests {
+    dispatch_semaphore_t _delegateResumed;
+    XCTestExpectation *_openExpectation;
+    XCTestExpectation *_receiveExpectation;
+    NSUInteger _receivedMessageCount;
+}
+
+- (void)webSocketDidOpen:(SRWebSocket *)webSocket
+{
+    [_openExpectation fulfill];
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didReceiveMessageWithData:(NSData *)data
+{
+    XCTAssertEqual(data.length, SRFloodMessageLength);
+
+    // The first message stalls the delegate queue, like a busy main thread.
+    if (_receivedMessageCount == 0) {
+        dispatch_semaphore_wait(_delegateResumed, DISPATCH_TIME_FOREVER);
+    }
+    _receivedMessageCount += 1;
+    if (_receivedMessageCount == SRFloodMessageCount) {
+        [_receiveExpectation fulfill];
+    }
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didFailWithError:(NSError *)error
+{
+    XCTFail(@"%@", error);
+}
+
+// Spins the run loop until the server wasn't able to write anything for a while.
+- (void)waitUntilServerIsBlocked:(SRFloodServer *)server
+{
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:10.0];
+    NSUInteger bytesWritten = server.bytesWritten;
+    NSUInteger idleIntervals = 0;
+    while (idleIntervals < 5 && [deadline timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+        NSUInteger currentBytesWritten = server.bytesWritten;
+        idleIntervals = (currentBytesWritten == bytesWritten ? idleIntervals + 1 : 0);
+        bytesWritten = currentBytesWritten;
+    }
+}
+
+- (void)testStalledDelegateBoundsInboundMemory
+{
+    SRLoopbackTransport *clientTransport = nil;
+    SRLoopbackTransport *serverTransport = nil;
+    [SRLoopbackTransport getClientTransport:&clientTransport serverTransport:&serverTransport];
+    SRFloodServer *server = [[SRFloodServer alloc] initWithTransport:(SRLoopbackTransport *_Nonnull)serverTransport
+                                                        messageCount:SRFloodMessageCount];
+
+    _delegateResumed = dispatch_semaphore_create(0);
+    _openExpectation = [self expectationWithDescription:@"open"];
+    _receiveExpectation = [self expectationWithDescription:@"receive"];
+
+    SRWebSocket *webSocket = [[SRWebSocket alloc] initWithURL:[NSURL URLWithString:@"ws://localhost/"]];
+    webSocket.delegate = self;
+    webSocket.delegateDispatchQueue = dispatch_queue_create("com.facebook.socketrocket.tests.delegate", DISPATCH_QUEUE_SERIAL);
+    webSocket.maximumUndeliveredMessageCount = SRFloodMaximumUndeliveredMessageCount;
+    [webSocket openWithTransport:(SRLoopbackTransport *_Nonnull)clientTransport];
+    [self waitForExpectations:@[ _openExpectation ] timeout:10.0];
+
+    [self waitUntilServerIsBlocked:server];
+
+    // No more messages are parsed than the delegate may have pending.
+    XCTAssertLessThanOrEqual(webSocket.readStatistics.messageCount, SRFloodMaximumUndeliveredMessageCount);
+    // The rest stays with the sender. Only parsed messages, bytes read before parsing paused,
+    // and the 64KB loopback buffer were written, instead of the whole 4MB flood.
+    NSUInteger frameLength = [SRFloodServer frameLength];
+    XCTAssertLessThan(server.bytesWritten, SRFloodMaximumUndeliveredMessageCount * frameLength + 256 * 1024);
+    XCTAssertLessThan(server.bytesWritten, SRFloodMessageCount * frameLength);
+
+    // Once the delegate catches up, reading resumes and every message arrives.
+    dispatch_semaphore_signal(_delegateResumed);
+    [self waitForExpectations:@[ _receiveExpectation ] timeout:30.0];
+    XCTAssertEqual(webSocket.readStatistics.messageCount, SRFloodMessageCount);
+
+    webSocket.delegate = nil;
+    [webSocket close];
+}
+
+- (SRWebSocket *)openWebSocketWithDelegate:(SRMessageCounter *)delegate server:(SRFloodServer *_Nullable *_Nonnull)server messageCount:(NSUInteger)messageCount
+{
+    SRLoopbackTransport *clientTransport = nil;
+    SRLoopbackTransport *serverTransport = nil;
+    [SRLoopbackTransport getClientTransport:&clientTransport serverTransport:&serverTransport];
+    *server = [[SRFloodServer alloc] initWithTransport:(SRLoopbackTransport *_Nonnull)serverTransport messageCount:messageCount];
+
+    SRWebSocket *webSocket = [[SRWebSocket alloc] initWithURL:[NSURL URLWithString:@"ws://localhost/"]];
+    webSocket.delegate = delegate;
+    webSocket.delegateDispatchQueue = dispatch_queue_create("com.facebook.socketrocket.tests.delegate", DISPATCH_QUEUE_SERIAL);
+    [webSocket openWithTransport:(SRLoopbackTransport *_Nonnull)clientTransport];
+    return webSocket;
+}
+
+- (void)testSocketResumesWhenAnotherSocketReleasesMemoryBudget
+{
+    static const NSUInteger messageCount = 256;
+    NSUInteger globalMemoryBudget = SRWebSocket.globalMemoryBudget;
+    SRWebSocket.globalMemoryBudget = 16 * SRFloodMessageLength;
+
+    // The first socket takes the whole budget with messages its stalled delegate didn't handle yet.
+    SRFloodServer *stalledServer = nil;
+    SRMessageCounter *stalledDelegate = [[SRMessageCounter alloc] initWithExpectedMessageCount:messageCount stallsOnFirstMessage:YES testCase:self];
+    SRWebSocket *stalledSocket = [self openWebSocketWithDelegate:stalledDelegate server:&stalledServer messageCount:messageCount];
+    [self waitForExpectations:@[ stalledDelegate.openExpectation ] timeout:10.0];
+    [self waitUntilServerIsBlocked:stalledServer];
+
+    // The second socket pauses as soon as anything is read, since the budget is exhausted.
+    SRFloodServer *server = nil;
+    SRMessageCounter *delegate = [[SRMessageCounter alloc] initWithExpectedMessageCount:messageCount stallsOnFirstMessage:NO testCase:self];
+    SRWebSocket *webSocket = [self openWebSocketWithDelegate:delegate server:&server messageCount:messageCount];
+    [self waitUntilServerIsBlocked:server];
+    XCTAssertLessThan(delegate.receivedMessageCount, messageCount);
+
+    // Once the first socket releases the budget, the second one is woken up, even though nothing it did freed memory.
+    [stalledDelegate resume];
+    [self waitForExpectations:@[ stalledDelegate.receiveExpectation, delegate.openExpectation, delegate.receiveExpectation ] timeout:30.0];
+    XCTAssertEqual(delegate.receivedMessageCount, messageCount);
+    XCTAssertNil(stalledDelegate.error);
+    XCTAssertNil(delegate.error);
+
+    stalledSocket.delegate = nil;
+    [stalledSocket close];
+    webSocket.delegate = nil;
+    [webSocket close];
+    SRWebSocket.globalMemoryBudget = globalMemoryBudget;
+}
+
+@end
@@ -0,0 +1,344 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+@import XCTest;
+
+#import <CommonCrypto/CommonDigest.h>
+#import <signal.h>
+#import <sys/resource.h>
+
+#import <SocketRocket/SocketRocket.h>
+
+#import "SRSpillFile.h"
+
+static const NSUInteger SRSpillFrameLength = 4096;
+
+///--------------------------------------
+#pragma mark - Frame Server
+///--------------------------------------
+
+// Answers the opening handshake, writes the given frames, and records the code of the close frame it receives.
+@interface SRFrameServer : NSObject <SRTransportDelegate>
+
+- (instancetype)initWithTransport:(SRLoopbackTransport *)transport frames:(NSData *)frames;
+
+@property (atomic, assign, readonly) NSInteger closeCode;
+
+@end
+
+@interface SRFrameServer ()
+
+@property (atomic, assign, readwrite) NSInteger closeCode;
+
+@end
+
+@implementation SRFrameServer
+{
+    SRLoopbackTransport *_transport;
+    NSMutableData *_input;
+    NSMutableData *_output;
+    NSUInteger _outputOffset;
+    NSData *_frames;
+}
+
+- (instancetype)initWithTransport:(SRLoopbackTransport *)transport frames:(NSData *)frames
+{
+    self = [super init];
+    if (!self) return self;
+
+    _input = [NSMutableData data];
+    _frames = frames;
+    _transport = transport;
+    _transport.delegate = self;
+    [_transport openTransport];
+
+    return self;
+}
+
+- (void)transport:(id<SRTransport>)transport handleEvent:(SRTransportEvent)event
+{
+    switch (event) {
+        case SRTransportEventHasBytesAvailable: {
+            uint8_t buffer[4096];
+            while (_transport.hasBytesAvailable) {
+                NSInteger length = [_transport read:buffer maxLength:sizeof(buffer)];
+                if (length <= 0) {
+                    break;
+                }
+                [_input appendBytes:buffer length:(NSUInteger)length];
+            }
+            if (!_output) {
+                [self _readHandshake];
+            } else {
+                [self _readCloseFrame];
+            }
+            [self _flush];
+            break;
+        }
+        case SRTransportEventHasSpaceAvailable:
+            [self _flush];
+            break;
+        case SRTransportEventEndEncountered:
+        case SRTransportEventErrorOccurred:
+            [_transport close];
+            break;
+        case SRTransportEventOpenCompleted:
+            break;
+    }
+}
+
+- (void)_readHandshake
+{
+    NSData *terminator = [@"\r\n\r\n" dataUsingEncoding:NSASCIIStringEncoding];
+    NSRange terminatorRange = [_input rangeOfData:terminator options:0 range:NSMakeRange(0, _input.length)];
+    if (terminatorRange.location == NSNotFound) {
+        return;
+    }
+
+    NSString *request = [[NSString alloc] initWithBytes:_input.bytes length:terminatorRange.location encoding:NSUTF8StringEncoding];
+    NSString *key = @"";
+    for (NSString *line in [request componentsSeparatedByString:@"\r\n"]) {
+        NSRange separator = [line rangeOfString:@":"];
+        if (separator.location != NSNotFound &&
+            [[line substringToIndex:separator.location] caseInsensitiveCompare:@"Sec-WebSocket-Key"] == NSOrderedSame) {
+            key = [[line substringFromIndex:NSMaxRange(separator)] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        }
+    }
+    [_input replaceBytesInRange:NSMakeRange(0, NSMaxRange(terminatorRange)) withBytes:NULL length:0];
+
+    NSData *acceptSource = [[key stringByAppendingString:@"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"] dataUsingEncoding:NSUTF8StringEncoding];
+    uint8_t digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(acceptSource.bytes, (CC_LONG)acceptSource.length, digest);
+    NSString *accept = [[NSData dataWithBytes:digest length:sizeof(digest)] base64EncodedStringWithOptions:0];
+    NSString *response = [NSString stringWithFormat:@"HTTP/1.1 101 Switching Protocols\r\n"
+                                                    "Upgrade: websocket\r\n"
+                                                    "Connection: Upgrade\r\n"
+                                                    "Sec-WebSocket-Accept: %@\r\n\r\n", accept];
+    _output = [[response dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+    [_output appendData:_frames];
+}
+
+// Client frames are masked, with a short payload for a close frame.
+- (void)_readCloseFrame
+{
+    const uint8_t *bytes = _input.bytes;
+    if (_input.length < 8 || (bytes[0] & 0x0F) != 0x8) {
+        return;
+    }
+    uint8_t high = bytes[6] ^ bytes[2];
+    uint8_t low = bytes[7] ^ bytes[3];
+    self.closeCode = (high << 8) | low;
+}
+
+- (void)_flush
+{
+    while (_output && _outputOffset < _output.length) {
+        NSInteger length = [_transport write:(const uint8_t *)_output.bytes + _outputOffset maxLength:_output.length - _outputOffset];
+        if (length <= 0) {
+            return;
+        }
+        _outputOffset += (NSUInteger)length;
+    }
+}
+
+@end
+
+///--------------------------------------
+#pragma mark - Tests
+///--------------------------------------
+
+@interface SRMessageSpillTests : XCTestCase <SRWebSocketDelegate>
+@end
+
+@implementation SRMessageSpillTests {
+    SRLoopbackTransport *_clientTransport;
+    SRFrameServer *_server;
+    SRWebSocket *_webSocket;
+    XCTestExpectation *_closeExpectation;
+    NSMutableArray<NSData *> *_messages;
+    struct rlimit _fileSizeLimit;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    _messages = [NSMutableArray array];
+    getrlimit(RLIMIT_FSIZE, &_fileSizeLimit);
+}
+
+- (void)tearDown
+{
+    setrlimit(RLIMIT_FSIZE, &_fileSizeLimit);
+    _webSocket.delegate = nil;
+    [_webSocket close];
+
+    [super tearDown];
+}
+
+// Binary message of `frameCount` frames, each filled with its index.
++ (NSData *)framesForMessageWithFrameCount:(NSUInteger)frameCount
+{
+    NSMutableData *frames = [NSMutableData data];
+    for (NSUInteger i = 0; i < frameCount; i++) {
+        uint8_t header[4] = {
+            (uint8_t)((i == 0 ? 0x2 : 0x0) | (i == frameCount - 1 ? 0x80 : 0x00)),
+            126,
+            (uint8_t)(SRSpillFrameLength >> 8),
+            (uint8_t)(SRSpillFrameLength & 0xFF),
+        };
+        [frames appendBytes:header length:sizeof(header)];
+
+        NSMutableData *payload = [NSMutableData dataWithLength:SRSpillFrameLength];
+        memset(payload.mutableBytes, (int)i, SRSpillFrameLength);
+        [frames appendData:payload];
+    }
+    return frames;
+}
+
+- (void)openWebSocketWithFrames:(NSData *)frames configuration:(void (^)(SRWebSocket *webSocket))configuration
+{
+    SRLoopbackTransport *clientTransport = nil;
+    SRLoopbackTransport *serverTransport = nil;
+    [SRLoopbackTransport getClientTransport:&clientTransport serverTransport:&serverTransport];
+    _clientTransport = clientTransport;
+    _server = [[SRFrameServer alloc] initWithTransport:(SRLoopbackTransport *_Nonnull)serverTransport frames:frames];
+
+    _closeExpectation = [self expectationWithDescription:@"close"];
+    _webSocket = [[SRWebSocket alloc] initWithURL:[NSURL URLWithString:@"ws://localhost/"]];
+    _webSocket.delegate = self;
+    _webSocket.delegateDispatchQueue = dispatch_queue_create("com.facebook.socketrocket.tests.delegate", DISPATCH_QUEUE_SERIAL);
+    configuration(_webSocket);
+    [_webSocket openWithTransport:_clientTransport];
+}
+
+// The server reads the close frame on its own queue, possibly after the socket reported that it closed.
+- (void)waitForCloseCode:(NSInteger)closeCode
+{
+    NSPredicate *predicate = [NSPredicate predicateWithFormat:@"closeCode != 0"];
+    [self waitForExpectations:@[ [self expectationForPredicate:predicate evaluatedWithObject:_server handler:nil] ] timeout:10.0];
+    XCTAssertEqual(_server.closeCode, closeCode);
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didReceiveMessageWithData:(NSData *)data
+{
+    @synchronized (_messages) {
+        [_messages addObject:data];
+    }
+    [webSocket close];
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didCloseWithCode:(NSInteger)code reason:(NSString *)reason wasClean:(BOOL)wasClean
+{
+    [_closeExpectation fulfill];
+}
+
+- (void)webSocket:(SRWebSocket *)webSocket didFailWithError:(NSError *)error
+{
+    [_closeExpectation fulfill];
+}
+
+///--------------------------------------
+#pragma mark - Spill File
+///--------------------------------------
+
+- (void)testSpillFileMapsAppendedBytes
+{
+    NSError *error = nil;
+    SRSpillFile *file = [[SRSpillFile alloc] initWithError:&error];
+    XCTAssertNotNil(file, @"%@", error);
+
+    XCTAssertTrue([file appendBytes:"Socket" length:6]);
+    XCTAssertTrue([file appendBytes:"Rocket" length:6]);
+    XCTAssertEqual(file.length, 12);
+    XCTAssertEqualObjects([file mapData], [NSData dataWithBytes:"SocketRocket" length:12]);
+
+    // The file is closed once mapped.
+    XCTAssertFalse([file appendBytes:"!" length:1]);
+    XCTAssertNil([file mapData]);
+}
+
+- (void)testEmptySpillFileMapsEmptyData
+{
+    SRSpillFile *file = [[SRSpillFile alloc] initWithError:nil];
+    XCTAssertEqualObjects([file mapData], [NSData data]);
+}
+
+- (void)testFailedAppendClosesSpillFile
+{
+    SRSpillFile *file = [[SRSpillFile alloc] initWithError:nil];
+    XCTAssertNotNil(file);
+
+    signal(SIGXFSZ, SIG_IGN);
+    struct rlimit limit = { .rlim_cur = SRSpillFrameLength, .rlim_max = _fileSizeLimit.rlim_max };
+    setrlimit(RLIMIT_FSIZE, &limit);
+    NSMutableData *bytes = [NSMutableData dataWithLength:2 * SRSpillFrameLength];
+    BOOL appended = [file appendBytes:bytes.bytes length:bytes.length];
+    setrlimit(RLIMIT_FSIZE, &_fileSizeLimit);
+
+    // Nothing can be appended after the gap, even once writes would succeed again.
+    XCTAssertFalse(appended);
+    XCTAssertFalse([file appendBytes:"!" length:1]);
+    XCTAssertNil([file mapData]);
+}
+
+///--------------------------------------
+#pragma mark - Receiving
+///--------------------------------------
+
+- (void)testLargeMessageIsSpilledAndMapped
+{
+    static const NSUInteger frameCount = 4;
+    [self openWebSocketWithFrames:[[self class] framesForMessageWithFrameCount:frameCount] configuration:^(SRWebSocket *webSocket) {
+        webSocket.messageSpillThreshold = SRSpillFrameLength;
+        // Spilled messages aren't limited by the receive buffer size.
+        webSocket.maximumReceiveBufferSize = 2 * SRSpillFrameLength;
+    }];
+    [self waitForExpectations:@[ _closeExpectation ] timeout:10.0];
+
+    XCTAssertEqual(_messages.count, 1);
+    NSData *message = _messages.firstObject;
+    XCTAssertEqual(message.length, frameCount * SRSpillFrameLength);
+    for (NSUInteger i = 0; i < frameCount; i++) {
+        const uint8_t *bytes = (const uint8_t *)message.bytes + i * SRSpillFrameLength;
+        XCTAssertEqual(bytes[0], i);
+        XCTAssertEqual(bytes[SRSpillFrameLength - 1], i);
+    }
+    [self waitForCloseCode:SRStatusCodeNormal];
+}
+
+- (void)testSpilledMessageAboveMaximumSizeClosesConnection
+{
+    [self openWebSocketWithFrames:[[self class] framesForMessageWithFrameCount:16] configuration:^(SRWebSocket *webSocket) {
+        webSocket.messageSpillThreshold = SRSpillFrameLength;
+        webSocket.maximumSpilledMessageSize = 4 * SRSpillFrameLength;
+    }];
+    [self waitForExpectations:@[ _closeExpectation ] timeout:10.0];
+
+    XCTAssertEqual(_messages.count, 0);
+    [self waitForCloseCode:SRStatusCodeMessageTooBig];
+}
+
+- (void)testFailedSpillWriteClosesConnectionWithoutDelivering
+{
+    // Only the first frame fits into the temporary file.
+    signal(SIGXFSZ, SIG_IGN);
+    struct rlimit limit = { .rlim_cur = SRSpillFrameLength, .rlim_max = _fileSizeLimit.rlim_max };
+    setrlimit(RLIMIT_FSIZE, &limit);
+
+    [self openWebSocketWithFrames:[[self class] framesForMessageWithFrameCount:4] configuration:^(SRWebSocket *webSocket) {
+        webSocket.messageSpillThreshold = SRSpillFrameLength / 2;
+    }];
+    [self waitForExpectations:@[ _closeExpectation ] timeout:10.0];
+
+    XCTAssertEqual(_messages.count, 0);
+    [self waitForCloseCode:SRStatusCodeInternalError];
+}
+
+@end
@@ -0,0 +1,227 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+@import XCTest;
+
+#import "SROutgoingMessageQueue.h"
+#import "SRSendHandle+Private.h"
+
+@interface SROutgoingMessageQueueTests : XCTestCase
+@end
+
+@implementation SROutgoingMessageQueueTests {
+    SROutgoingMessageQueue *_queue;
+}
+
+///--------------------------------------
+#pragma mark - Setup
+///--------------------------------------
+
+- (void)setUp
+{
+    [super setUp];
+
+    _queue = [[SROutgoingMessageQueue alloc] init];
+}
+
+- (SROutgoingMessage *)enqueueOpcode:(SROpCode)opcode length:(NSUInteger)length lane:(SROutgoingLane)lane
+{
+    SROutgoingMessage *message = [[SROutgoingMessage alloc] initWithOpcode:opcode data:[NSMutableData dataWithLength:length] lane:lane];
+    [_queue enqueueMessage:message];
+    return message;
+}
+
+- (SROutgoingMessage *)enqueueOpcode:(SROpCode)opcode
+                              length:(NSUInteger)length
+                                lane:(SROutgoingLane)lane
+                       conflationKey:(NSString *)conflationKey
+{
+    SROutgoingMessage *message = [[SROutgoingMessage alloc] initWithOpcode:opcode
+                                                                      data:[NSMutableData dataWithLength:length]
+                                                                      lane:lane
+                                                                sendHandle:nil
+                                                             conflationKey:conflationKey];
+    [_queue enqueueMessage:message];
+    return message;
+}
+
+// Frames the next message completely, the way the socket does when it fits into a single fragment.
+- (SROutgoingMessage *)frameNextMessage
+{
+    SROutgoingMessage *message = [_queue nextMessage];
+    if (message) {
+        [_queue message:message didFrameLength:message.data.length - message.framedLength];
+    }
+    return message;
+}
+
+///--------------------------------------
+#pragma mark - Lanes
+///--------------------------------------
+
+- (void)testLanesAreDrainedInPriorityOrder
+{
+    SROutgoingMessage *low = [self enqueueOpcode:SROpCodeBinaryFrame length:1 lane:SROutgoingLaneLow];
+    SROutgoingMessage *normal = [self enqueueOpcode:SROpCodeBinaryFrame length:2 lane:SROutgoingLaneDefault];
+    SROutgoingMessage *high = [self enqueueOpcode:SROpCodeBinaryFrame length:3 lane:SROutgoingLaneHigh];
+    SROutgoingMessage *secondHigh = [self enqueueOpcode:SROpCodeTextFrame length:4 lane:SROutgoingLaneHigh];
+    SROutgoingMessage *ping = [self enqueueOpcode:SROpCodePing length:0 lane:SROutgoingLaneControl];
+
+    XCTAssertEqual([_queue messageCountInLane:SROutgoingLaneHigh], 2);
+    XCTAssertEqual([_queue byteCountInLane:SROutgoingLaneHigh], 7);
+
+    XCTAssertEqual([self frameNextMessage], ping);
+    XCTAssertEqual([self frameNextMessage], high);
+    XCTAssertEqual([self frameNextMessage], secondHigh);
+    XCTAssertEqual([self frameNextMessage], normal);
+    XCTAssertEqual([self frameNextMessage], low);
+    XCTAssertNil([_queue nextMessage]);
+    XCTAssertTrue(_queue.empty);
+
+    for (NSUInteger lane = 0; lane < SROutgoingLaneCount; lane++) {
+        XCTAssertEqual([_queue messageCountInLane:lane], 0);
+        XCTAssertEqual([_queue byteCountInLane:lane], 0);
+    }
+}
+
+- (void)testCloseIsSentAfterQueuedData
+{
+    SROutgoingMessage *data = [self enqueueOpcode:SROpCodeBinaryFrame length:1 lane:SROutgoingLaneLow];
+    SROutgoingMessage *close = [self enqueueOpcode:SROpCodeConnectionClose length:2 lane:SROutgoingLaneControl];
+
+    XCTAssertEqual([self frameNextMessage], data);
+    XCTAssertEqual([self frameNextMessage], close);
+    XCTAssertTrue(_queue.empty);
+}
+
+///--------------------------------------
+#pragma mark - Fragmentation
+///--------------------------------------
+
+- (void)testDataMessagesAreNotInterleavedWithFragments
+{
+    SROutgoingMessage *message = [self enqueueOpcode:SROpCodeBinaryFrame length:10 lane:SROutgoingLaneDefault];
+
+    XCTAssertEqual([_queue nextMessage], message);
+    [_queue message:message didFrameLength:4];
+    XCTAssertEqual(message.framedLength, 4);
+    XCTAssertEqual([_queue byteCountInLane:SROutgoingLaneDefault], 6);
+    XCTAssertEqual([_queue messageCountInLane:SROutgoingLaneDefault], 1);
+
+    // A higher priority message and a close have to wait for the last fragment.
+    SROutgoingMessage *high = [self enqueueOpcode:SROpCodeBinaryFrame length:1 lane:SROutgoingLaneHigh];
+    SROutgoingMessage *close = [self enqueueOpcode:SROpCodeConnectionClose length:0 lane:SROutgoingLaneControl];
+    XCTAssertEqual([_queue nextMessage], message);
+
+    [_queue message:message didFrameLength:4];
+    XCTAssertEqual([_queue nextMessage], message);
+    [_queue message:message didFrameLength:2];
+
+    XCTAssertEqual([_queue messageCountInLane:SROutgoingLaneDefault], 0);
+    XCTAssertEqual([_queue byteCountInLane:SROutgoingLaneDefault], 0);
+    XCTAssertEqual([self frameNextMessage], high);
+    XCTAssertEqual([self frameNextMessage], close);
+    XCTAssertTrue(_queue.empty);
+}
+
+- (void)testPingIsSentBetweenFragments
+{
+    SROutgoingMessage *message = [self enqueueOpcode:SROpCodeTextFrame length:10 lane:SROutgoingLaneLow];
+
+    XCTAssertEqual([_queue nextMessage], message);
+    [_queue message:message didFrameLength:5];
+
+    SROutgoingMessage *ping = [self enqueueOpcode:SROpCodePing length:0 lane:SROutgoingLaneControl];
+    XCTAssertEqual([self frameNextMessage], ping);
+    XCTAssertEqual([_queue nextMessage], message);
+    XCTAssertEqual(message.framedLength, 5);
+}
+
+- (void)testStartedMessageCantBeRemoved
+{
+    SRSendHandle *handle = [[SRSendHandle alloc] initWithCompletion:nil cancelHandler:^(SRSendHandle *cancelledHandle) {}];
+    SROutgoingMessage *message = [[SROutgoingMessage alloc] initWithOpcode:SROpCodeBinaryFrame
+                                                                      data:[NSMutableData dataWithLength:10]
+                                                                      lane:SROutgoingLaneDefault
+                                                                sendHandle:handle];
+    [_queue enqueueMessage:message];
+    XCTAssertEqual([_queue nextMessage], message);
+
+    XCTAssertNil([_queue removeMessageWithSendHandle:handle]);
+    XCTAssertEqual([_queue messageCountInLane:SROutgoingLaneDefault], 1);
+}
+
+///--------------------------------------
+#pragma mark - Conflation
+///--------------------------------------
+
+- (void)testPendingMessageIsReplacedInPlace
+{
+    SROutgoingMessage *keyed = [self enqueueOpcode:SROpCodeBinaryFrame length:1 lane:SROutgoingLaneDefault conflationKey:@"price"];
+    SROutgoingMessage *other = [self enqueueOpcode:SROpCodeBinaryFrame length:2 lane:SROutgoingLaneDefault];
+    [self enqueueOpcode:SROpCodeTextFrame length:5 lane:SROutgoingLaneHigh conflationKey:@"price"];
+
+    // The newer payload takes the position and lane of the pending message.
+    XCTAssertEqual(_queue.conflatedMessageCount, 1);
+    XCTAssertEqual([_queue messageCountInLane:SROutgoingLaneDefault], 2);
+    XCTAssertEqual([_queue byteCountInLane:SROutgoingLaneDefault], 7);
+    XCTAssertEqual([_queue messageCountInLane:SROutgoingLaneHigh], 0);
+
+    XCTAssertEqual([self frameNextMessage], keyed);
+    XCTAssertEqual(keyed.opcode, SROpCodeTextFrame);
+    XCTAssertEqual(keyed.data.length, 5);
+    XCTAssertEqual([self frameNextMessage], other);
+    XCTAssertTrue(_queue.empty);
+}
+
+- (void)testMessageIsAppendedOnceKeyedMessageStartedTransmitting
+{
+    SROutgoingMessage *keyed = [self enqueueOpcode:SROpCodeBinaryFrame length:10 lane:SROutgoingLaneDefault conflationKey:@"price"];
+    XCTAssertEqual([_queue nextMessage], keyed);
+
+    // Picked for framing, even without any fragment produced yet, the payload can't change anymore.
+    SROutgoingMessage *newer = [self enqueueOpcode:SROpCodeBinaryFrame length:3 lane:SROutgoingLaneDefault conflationKey:@"price"];
+    XCTAssertEqual(_queue.conflatedMessageCount, 0);
+    XCTAssertEqual(keyed.data.length, 10);
+    XCTAssertEqual([_queue messageCountInLane:SROutgoingLaneDefault], 2);
+    XCTAssertEqual([_queue byteCountInLane:SROutgoingLaneDefault], 13);
+
+    // Until it is picked, the appended message is replaced like any other.
+    [self enqueueOpcode:SROpCodeBinaryFrame length:4 lane:SROutgoingLaneDefault conflationKey:@"price"];
+    XCTAssertEqual(_queue.conflatedMessageCount, 1);
+    XCTAssertEqual([_queue messageCountInLane:SROutgoingLaneDefault], 2);
+
+    XCTAssertEqual([self frameNextMessage], keyed);
+    XCTAssertEqual([self frameNextMessage], newer);
+    XCTAssertEqual(newer.data.length, 4);
+    XCTAssertTrue(_queue.empty);
+}
+
+- (void)testUnsentKeyedMessagesAreCountedAsDroppedOnClose
+{
+    SROutgoingMessage *sent = [self enqueueOpcode:SROpCodeBinaryFrame length:1 lane:SROutgoingLaneHigh conflationKey:@"sent"];
+    XCTAssertEqual([self frameNextMessage], sent);
+
+    SROutgoingMessage *started = [self enqueueOpcode:SROpCodeBinaryFrame length:10 lane:SROutgoingLaneDefault conflationKey:@"started"];
+    XCTAssertEqual([_queue nextMessage], started);
+    [_queue message:started didFrameLength:4];
+    [self enqueueOpcode:SROpCodeBinaryFrame length:1 lane:SROutgoingLaneLow conflationKey:@"pending"];
+    [self enqueueOpcode:SROpCodeBinaryFrame length:1 lane:SROutgoingLaneLow];
+
+    XCTAssertEqual([_queue removeAllMessages].count, 0);
+    XCTAssertEqual(_queue.droppedMessageCount, 2);
+    XCTAssertTrue(_queue.empty);
+
+    // Keys of removed messages are forgotten, so a new message is appended instead of replacing one.
+    [self enqueueOpcode:SROpCodeBinaryFrame length:1 lane:SROutgoingLaneLow conflationKey:@"pending"];
+    XCTAssertEqual(_queue.conflatedMessageCount, 0);
+    XCTAssertEqual([_queue messageCountInLane:SROutgoingLaneLow], 1);
+}
+
+@end
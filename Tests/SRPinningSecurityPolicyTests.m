@@ -0,0 +1,243 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+@import XCTest;
+
+#import "SRPinningSecurityPolicy.h"
+
+// Self-signed certificates, generated with:
+// `openssl req -x509 -newkey rsa:2048 -nodes -days 36500 -subj "/CN=rsa.socketrocket.example.com" -outform der`
+static NSString *const SRTestRSACertificate =
+    @"MIIDMTCCAhmgAwIBAgIUas1L3sS6bGg023os7F2ciI269T4wDQYJKoZIhvcNAQELBQAwJzElMCMGA1UEAwwccnNhLnNvY2tldHJv"
+    @"Y2tldC5leGFtcGxlLmNvbTAgFw0yNjEwMTkwMjEzNTZaGA8yMTI2MDkyNTAyMTM1NlowJzElMCMGA1UEAwwccnNhLnNvY2tldHJv"
+    @"Y2tldC5leGFtcGxlLmNvbTCCASIwDQYJKoZIhvcNAQEBBQADggEPADCCAQoCggEBAMgPiQSJMNZEC7RbQjTI/4t4OPPBy0J2M9cU"
+    @"qkUEah8l3Y4CYj7BXfNHIkmvZSuYE61/qCR7QT+eaUqmOxDhPIwMkwRqGGOlQODsGWokIZKeAmxPhZ+NhQ7j0O/k3P6U/n+o2zJL"
+    @"LLC8K9UlhQ/K9haLoLzpbmrgfsBf67z9z/QJzxeyJUXreycFcP2/nCptOpWCpSxm2SqmvADP+JiZMDizzcYc01+Zoo3YX5+WmQuL"
+    @"1aGt2LBjaS0/kwAhLwnuGI+hxKXFbCUa3Q5Y+wiIJhHDKcucfW5LJemQ1qUxngTDtC6kvJzqfl6ghqYNS0iOw9/sFWGmwbQ2lCWF"
+    @"y8daLlUCAwEAAaNTMFEwHQYDVR0OBBYEFC18nAp8W6GAFDL+YWKXHv/jJuFsMB8GA1UdIwQYMBaAFC18nAp8W6GAFDL+YWKXHv/j"
+    @"JuFsMA8GA1UdEwEB/wQFMAMBAf8wDQYJKoZIhvcNAQELBQADggEBAAYWfeEjy07KH9cDo9kLdxWjFxUJtr7r4kjx6LFd3ZdISzh3"
+    @"q2zaGyAoXiBmyb6N1P33pWVn1DN9Kdzf5iPKwC+twJRaoFNdKG3+qTM8Wle+V+gbFnAowyaguV82Nt/JXwRd6p/GygX6rzWaRjg6"
+    @"/xRPGQ91+YnQnEBNktabwJu4VX6s3k+iHnlh+EiO6ZRjpsbQKgW067OBVNm6/WTnxa/99ZK3H8GXodc18y93B3XOHITST2NYh0v4"
+    @"B2C72OqZhu3ozBchrvZnrdl6sQx+iYcVUyJklCzR30LdTFWNfNppcko2MoCW9232Y+V8W3CGjl60Ww5Hj/+fZ2ks8tqlrO4=";
+// `openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes -days 36500 -subj "/CN=ec.socketrocket.example.com" -outform der`
+static NSString *const SRTestECCertificate =
+    @"MIIBozCCAUmgAwIBAgIUcJESY+4bcvcdKkKjnXEMYNu6wo4wCgYIKoZIzj0EAwIwJjEkMCIGA1UEAwwbZWMuc29ja2V0cm9ja2V0"
+    @"LmV4YW1wbGUuY29tMCAXDTI2MTAxOTAyMTM1NloYDzIxMjYwOTI1MDIxMzU2WjAmMSQwIgYDVQQDDBtlYy5zb2NrZXRyb2NrZXQu"
+    @"ZXhhbXBsZS5jb20wWTATBgcqhkjOPQIBBggqhkjOPQMBBwNCAAQZsg0y48QIfbKtPZCxJo49ixYp0s512E8eTzmghU7RRxgWOUsb"
+    @"qc6RPfpMvucaK/WB2e/B+0OM+ugXLeZVAyUDo1MwUTAdBgNVHQ4EFgQUAVqjXN+z9YloMJY6b/3StYWPPtAwHwYDVR0jBBgwFoAU"
+    @"AVqjXN+z9YloMJY6b/3StYWPPtAwDwYDVR0TAQH/BAUwAwEB/zAKBggqhkjOPQQDAgNIADBFAiEA48uoWJNW2wzuSPoZ2FrWs+5J"
+    @"paGO4EXBzGO0plXDb68CIH+LEL9CI0NEw7oB6niEjdCyTXTwJntDvl8H2d41jMmQ";
+
+// `openssl x509 -pubkey -noout | openssl pkey -pubin -outform der | openssl dgst -sha256 -binary | base64`
+static NSString *const SRTestRSAPublicKeyHash = @"6khgYXHYaPGusB3sM3RU/NaRhMUI3kzWaNXHOIl/1lA=";
+static NSString *const SRTestECPublicKeyHash = @"hTZP7AdFgBMEjycwn+UJY/i1ss5jOOZWK27n6msM+xw=";
+
+// Chain for socketrocket.example.com, EC P-256: root -> intermediate -> leaf, generated with `openssl req`/`openssl x509 -req`.
+// The leaf is valid from 2026-10-19 to 2027-11-21, so trust is evaluated at a fixed date within that range.
+static NSString *const SRTestChainRootCertificate =
+    @"MIIBqTCCAU+gAwIBAgIUf8uqpOXiaN31i7LD1rOeS1p9j0cwCgYIKoZIzj0EAwIwITEfMB0GA1UEAwwWU29ja2V0Um9ja2V0IFRl"
+    @"c3QgUm9vdDAgFw0yNjEwMTkwMjMxMjVaGA8yMTI2MDkyNTAyMzEyNVowITEfMB0GA1UEAwwWU29ja2V0Um9ja2V0IFRlc3QgUm9v"
+    @"dDBZMBMGByqGSM49AgEGCCqGSM49AwEHA0IABM4aj1QsIO/6MOd4DMPr8V7KwXadR+1H0cH4V/jfrECshlHkim3FcjH8CQHIevqW"
+    @"S+zDqRkRfECMB+le+RXhrT+jYzBhMB0GA1UdDgQWBBRosACm5p9/gsCtyblmvAOXOaivyjAfBgNVHSMEGDAWgBRosACm5p9/gsCt"
+    @"yblmvAOXOaivyjAPBgNVHRMBAf8EBTADAQH/MA4GA1UdDwEB/wQEAwIBBjAKBggqhkjOPQQDAgNIADBFAiEAjdUijP9NyJ1rxt+M"
+    @"N7kny0ql0cS+jnlS+wEcHU9Y5yMCIAIBeWKGOnsEiI5yQoz2A6fuqxynK4G7fcfuMrdzVIMj";
+static NSString *const SRTestChainIntermediateCertificate =
+    @"MIIBsTCCAVegAwIBAgIUN/0i3yCV0GjT4nFA1LKyeGnFugUwCgYIKoZIzj0EAwIwITEfMB0GA1UEAwwWU29ja2V0Um9ja2V0IFRl"
+    @"c3QgUm9vdDAgFw0yNjEwMTkwMjMxMjVaGA8yMTI2MDkyNTAyMzEyNVowKTEnMCUGA1UEAwweU29ja2V0Um9ja2V0IFRlc3QgSW50"
+    @"ZXJtZWRpYXRlMFkwEwYHKoZIzj0CAQYIKoZIzj0DAQcDQgAEFFNzEF2+scPNTaEGUV1LtdXClEnbRR1ILRf0vSzZGo+vCl9klKZN"
+    @"STifPf+OmgV+tjGcvSJPN4MTj430hwAG2aNjMGEwDwYDVR0TAQH/BAUwAwEB/zAOBgNVHQ8BAf8EBAMCAQYwHQYDVR0OBBYEFNYs"
+    @"5MG2ruXKtKVb8HYHWRkViJQ7MB8GA1UdIwQYMBaAFGiwAKbmn3+CwK3JuWa8A5c5qK/KMAoGCCqGSM49BAMCA0gAMEUCIQDFIVNp"
+    @"/BnzDgg6E5/W/N5dbMhaVDNw0RUVeYmo5WaQCAIgWHy9hEKs35V1wd/okIXWX40FFit4/pH5vNYFyO5otsM=";
+static NSString *const SRTestChainLeafCertificate =
+    @"MIIB6zCCAZCgAwIBAgIUXKm+Z8BMDxMQGywLUlZ/2RAaaCgwCgYIKoZIzj0EAwIwKTEnMCUGA1UEAwweU29ja2V0Um9ja2V0IFRl"
+    @"c3QgSW50ZXJtZWRpYXRlMB4XDTI2MTAxOTAyMzEyNVoXDTI3MTEyMTAyMzEyNVowIzEhMB8GA1UEAwwYc29ja2V0cm9ja2V0LmV4"
+    @"YW1wbGUuY29tMFkwEwYHKoZIzj0CAQYIKoZIzj0DAQcDQgAEXdv7ABufruB9A57Oph+W+0hIArU2kblnPNHIou5SiD0btsw8eVOR"
+    @"RglDIIB3iq5CdiVGaqMzfxo53QR2dAjGVKOBmzCBmDAMBgNVHRMBAf8EAjAAMA4GA1UdDwEB/wQEAwIHgDATBgNVHSUEDDAKBggr"
+    @"BgEFBQcDATAjBgNVHREEHDAaghhzb2NrZXRyb2NrZXQuZXhhbXBsZS5jb20wHQYDVR0OBBYEFDG2UlU5+H4i5V1EuDZbKcJzAT7k"
+    @"MB8GA1UdIwQYMBaAFNYs5MG2ruXKtKVb8HYHWRkViJQ7MAoGCCqGSM49BAMCA0kAMEYCIQDGyOeGwOgWhBAfs9gb8ZcAbxZWu+g1"
+    @"AptkXnxCD/V9zwIhANTnYVJB4DIUz1yuta/Zwg4PLHu1OwxMYsBn9VzIUjAf";
+// Leaf for the same name, issued by a different CA that claims to be "SocketRocket Test Intermediate".
+static NSString *const SRTestChainAttackerLeafCertificate =
+    @"MIIB6zCCAZCgAwIBAgIUTk1lnIlMYvJhEKvs/+iWq7hTT58wCgYIKoZIzj0EAwIwKTEnMCUGA1UEAwweU29ja2V0Um9ja2V0IFRl"
+    @"c3QgSW50ZXJtZWRpYXRlMB4XDTI2MTAxOTAyMzEzMVoXDTI3MTEyMTAyMzEzMVowIzEhMB8GA1UEAwwYc29ja2V0cm9ja2V0LmV4"
+    @"YW1wbGUuY29tMFkwEwYHKoZIzj0CAQYIKoZIzj0DAQcDQgAEGqfMeOBMUAK6+jAR06uzG5hnINwX0VIUdQQ3wKUhZd2jfB2VnwFl"
+    @"AEaL2aVp51ZtdqcvgDKH3nFOmDOhwUfeD6OBmzCBmDAMBgNVHRMBAf8EAjAAMA4GA1UdDwEB/wQEAwIHgDATBgNVHSUEDDAKBggr"
+    @"BgEFBQcDATAjBgNVHREEHDAaghhzb2NrZXRyb2NrZXQuZXhhbXBsZS5jb20wHQYDVR0OBBYEFNbvmIfCC06MFO5X8ROZl2EQL9Ve"
+    @"MB8GA1UdIwQYMBaAFL5FM4IXUp+M3xfJC6f+NwUUTxlAMAoGCCqGSM49BAMCA0kAMEYCIQDQ7dhRT8+IvGZpGCKLo4AIdD6mVwME"
+    @"PDG9nf4J4H3IWwIhAKmHdo9aYtgLdppJg8y8UnSDzgtYBVXHTg/v+oXuSitz";
+static NSString *const SRTestChainIntermediatePublicKeyHash = @"zKFJChXwU6EmilTRhQjl/Atq69qmgsI5wer6G0qvyDI=";
+static NSTimeInterval const SRTestChainVerifyDate = 1793491200.0; // 2026-11-01
+
+@interface SRPinningSecurityPolicyTests : XCTestCase
+@end
+
+@implementation SRPinningSecurityPolicyTests
+
+///--------------------------------------
+#pragma mark - Helpers
+///--------------------------------------
+
+- (NSData *)dataFromBase64:(NSString *)string
+{
+    return [[NSData alloc] initWithBase64EncodedString:string options:0];
+}
+
+- (SecTrustRef)createTrustWithCertificateData:(NSData *)data
+{
+    SecCertificateRef certificate = SecCertificateCreateWithData(NULL, (__bridge CFDataRef)data);
+    XCTAssertTrue(certificate != NULL);
+
+    SecPolicyRef policy = SecPolicyCreateBasicX509();
+    SecTrustRef trust = NULL;
+    XCTAssertEqual(SecTrustCreateWithCertificates(certificate, policy, &trust), errSecSuccess);
+    CFRelease(policy);
+    CFRelease(certificate);
+    return trust;
+}
+
+// Trust for a chain presented by a server, anchored at the test root.
+- (SecTrustRef)createTrustWithCertificates:(NSArray<NSString *> *)certificates
+{
+    NSMutableArray *chain = [NSMutableArray array];
+    for (NSString *certificate in certificates) {
+        [chain addObject:CFBridgingRelease(SecCertificateCreateWithData(NULL, (__bridge CFDataRef)[self dataFromBase64:certificate]))];
+    }
+    id root = CFBridgingRelease(SecCertificateCreateWithData(NULL, (__bridge CFDataRef)[self dataFromBase64:SRTestChainRootCertificate]));
+
+    SecPolicyRef policy = SecPolicyCreateBasicX509();
+    SecTrustRef trust = NULL;
+    XCTAssertEqual(SecTrustCreateWithCertificates((__bridge CFArrayRef)chain, policy, &trust), errSecSuccess);
+    CFRelease(policy);
+    XCTAssertEqual(SecTrustSetAnchorCertificates(trust, (__bridge CFArrayRef)@[ root ]), errSecSuccess);
+    XCTAssertEqual(SecTrustSetVerifyDate(trust, (__bridge CFDateRef)[NSDate dateWithTimeIntervalSince1970:SRTestChainVerifyDate]), errSecSuccess);
+    return trust;
+}
+
+///--------------------------------------
+#pragma mark - Public Key Hash
+///--------------------------------------
+
+- (void)testPublicKeyHashOfRSACertificate
+{
+    NSData *data = [self dataFromBase64:SRTestRSACertificate];
+    XCTAssertEqualObjects(SRPublicKeyHashFromCertificateData(data), [self dataFromBase64:SRTestRSAPublicKeyHash]);
+
+    SecCertificateRef certificate = SecCertificateCreateWithData(NULL, (__bridge CFDataRef)data);
+    XCTAssertEqualObjects(SRPublicKeyHashFromCertificate(certificate), [self dataFromBase64:SRTestRSAPublicKeyHash]);
+    CFRelease(certificate);
+}
+
+- (void)testPublicKeyHashOfECCertificate
+{
+    NSData *data = [self dataFromBase64:SRTestECCertificate];
+    XCTAssertEqualObjects(SRPublicKeyHashFromCertificateData(data), [self dataFromBase64:SRTestECPublicKeyHash]);
+}
+
+- (void)testPublicKeyHashOfTruncatedCertificate
+{
+    NSData *data = [self dataFromBase64:SRTestECCertificate];
+    for (NSUInteger length = 0; length < data.length; length++) {
+        XCTAssertNil(SRPublicKeyHashFromCertificateData([data subdataWithRange:NSMakeRange(0, length)]), @"%lu", (unsigned long)length);
+    }
+}
+
+- (void)testPublicKeyHashOfMalformedCertificate
+{
+    // Not a SEQUENCE.
+    NSMutableData *data = [[self dataFromBase64:SRTestECCertificate] mutableCopy];
+    ((uint8_t *)data.mutableBytes)[0] = 0x31;
+    XCTAssertNil(SRPublicKeyHashFromCertificateData(data));
+
+    // Long form length without length bytes.
+    const uint8_t indefiniteLength[] = { 0x30, 0x80, 0x30, 0x00 };
+    XCTAssertNil(SRPublicKeyHashFromCertificateData([NSData dataWithBytes:indefiniteLength length:sizeof(indefiniteLength)]));
+
+    // Length that doesn't fit in 4 bytes.
+    const uint8_t hugeLength[] = { 0x30, 0x85, 0x01, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00 };
+    XCTAssertNil(SRPublicKeyHashFromCertificateData([NSData dataWithBytes:hugeLength length:sizeof(hugeLength)]));
+
+    // Element that runs past the end of data.
+    const uint8_t overlongElement[] = { 0x30, 0x06, 0x30, 0x04, 0x02, 0x7F, 0x00, 0x00 };
+    XCTAssertNil(SRPublicKeyHashFromCertificateData([NSData dataWithBytes:overlongElement length:sizeof(overlongElement)]));
+
+    // TBSCertificate that ends before `subjectPublicKeyInfo`.
+    const uint8_t missingElements[] = { 0x30, 0x08, 0x30, 0x06, 0x02, 0x01, 0x01, 0x02, 0x01, 0x02 };
+    XCTAssertNil(SRPublicKeyHashFromCertificateData([NSData dataWithBytes:missingElements length:sizeof(missingElements)]));
+
+    // `subjectPublicKeyInfo` that is not a SEQUENCE.
+    const uint8_t notSequence[] = {
+        0x30, 0x11, 0x30, 0x0F,
+        0x02, 0x01, 0x01, 0x30, 0x00, 0x30, 0x00, 0x30, 0x00, 0x30, 0x00,
+        0x04, 0x02, 0x00, 0x00,
+    };
+    XCTAssertNil(SRPublicKeyHashFromCertificateData([NSData dataWithBytes:notSequence length:sizeof(notSequence)]));
+}
+
+///--------------------------------------
+#pragma mark - Policy
+///--------------------------------------
+
+- (void)testPublicKeyPinningPolicy
+{
+    NSArray<NSData *> *hashes = @[ [self dataFromBase64:SRTestECPublicKeyHash], [self dataFromBase64:SRTestChainIntermediatePublicKeyHash] ];
+    SRSecurityPolicy *pinnedPolicy = [SRSecurityPolicy pinningPolicyWithPublicKeyHashes:hashes];
+    SRSecurityPolicy *otherPolicy = [SRSecurityPolicy pinningPolicyWithPublicKeyHashes:@[ [self dataFromBase64:SRTestECPublicKeyHash] ]];
+
+    SecTrustRef trust = [self createTrustWithCertificates:@[ SRTestChainLeafCertificate, SRTestChainIntermediateCertificate ]];
+    XCTAssertTrue([pinnedPolicy evaluateServerTrust:trust forDomain:@"socketrocket.example.com"]);
+    XCTAssertFalse([otherPolicy evaluateServerTrust:trust forDomain:@"socketrocket.example.com"]);
+    CFRelease(trust);
+}
+
+- (void)testPublicKeyPinningPolicyRejectsLeafNotSignedByPinnedCertificate
+{
+    SRSecurityPolicy *policy = [SRSecurityPolicy pinningPolicyWithPublicKeyHashes:@[ [self dataFromBase64:SRTestChainIntermediatePublicKeyHash] ]];
+
+    // The pinned intermediate and the root are presented, but the leaf doesn't chain to them.
+    NSArray<NSString *> *certificates = @[ SRTestChainAttackerLeafCertificate, SRTestChainIntermediateCertificate, SRTestChainRootCertificate ];
+    SecTrustRef trust = [self createTrustWithCertificates:certificates];
+    XCTAssertFalse([policy evaluateServerTrust:trust forDomain:@"socketrocket.example.com"]);
+    CFRelease(trust);
+
+    // Nothing is remembered from a failed evaluation.
+    trust = [self createTrustWithCertificates:certificates];
+    XCTAssertFalse([policy evaluateServerTrust:trust forDomain:@"socketrocket.example.com"]);
+    CFRelease(trust);
+}
+
+- (void)testPublicKeyPinningPolicyRequiresValidChain
+{
+    SRSecurityPolicy *policy = [SRSecurityPolicy pinningPolicyWithPublicKeyHashes:@[ [self dataFromBase64:SRTestChainIntermediatePublicKeyHash] ]];
+    NSArray<NSString *> *certificates = @[ SRTestChainLeafCertificate, SRTestChainIntermediateCertificate ];
+
+    SecTrustRef trust = [self createTrustWithCertificates:certificates];
+    XCTAssertFalse([policy evaluateServerTrust:trust forDomain:@"other.example.com"]);
+    CFRelease(trust);
+
+    // A leaf validated for one domain is not trusted for another one.
+    trust = [self createTrustWithCertificates:certificates];
+    XCTAssertTrue([policy evaluateServerTrust:trust forDomain:@"socketrocket.example.com"]);
+    CFRelease(trust);
+    trust = [self createTrustWithCertificates:certificates];
+    XCTAssertFalse([policy evaluateServerTrust:trust forDomain:@"other.example.com"]);
+    CFRelease(trust);
+
+    // Self-signed certificate with a pinned key isn't trusted without a chain to an anchor.
+    SRSecurityPolicy *selfSignedPolicy = [SRSecurityPolicy pinningPolicyWithPublicKeyHashes:@[ [self dataFromBase64:SRTestRSAPublicKeyHash] ]];
+    trust = [self createTrustWithCertificateData:[self dataFromBase64:SRTestRSACertificate]];
+    XCTAssertFalse([selfSignedPolicy evaluateServerTrust:trust forDomain:@"rsa.socketrocket.example.com"]);
+    CFRelease(trust);
+}
+
+- (void)testPublicKeyPinningPolicyRequiresHashes
+{
+    XCTAssertThrows([SRSecurityPolicy pinningPolicyWithPublicKeyHashes:@[]]);
+}
+
+@end
@@ -0,0 +1,118 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+@import XCTest;
+
+#import "SRProxyCache.h"
+
+@interface SRProxyCacheTests : XCTestCase
+@end
+
+@implementation SRProxyCacheTests {
+    NSURL *_PACURL;
+}
+
+///--------------------------------------
+#pragma mark - Setup
+///--------------------------------------
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSString *fileName = [NSString stringWithFormat:@"SRProxyCacheTests-%@.pac", [NSUUID UUID].UUIDString];
+    _PACURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:fileName]];
+    [[SRProxyCache sharedCache] invalidate];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtURL:_PACURL error:nil];
+    [[SRProxyCache sharedCache] invalidate];
+
+    [super tearDown];
+}
+
+- (void)writePACScriptReturning:(NSString *)result
+{
+    NSString *script = [NSString stringWithFormat:@"function FindProxyForURL(url, host) { return \"%@\"; }", result];
+    NSError *error = nil;
+    XCTAssertTrue([script writeToURL:_PACURL atomically:YES encoding:NSUTF8StringEncoding error:&error], @"%@", error);
+}
+
+- (NSDictionary *)resolveProxyForURL:(NSURL *)url
+{
+    __block NSString *fetchedScript = nil;
+    [[SRProxyCache sharedCache] fetchPACScriptFromURL:_PACURL completion:^(NSString *script) {
+        fetchedScript = script;
+    }];
+    XCTAssertNotNil(fetchedScript);
+
+    NSDictionary *systemSettings = [[SRProxyCache sharedCache] systemProxySettings];
+    return [[SRProxyCache sharedCache] proxySettingsForURL:url PACScript:fetchedScript proxySettings:systemSettings];
+}
+
+///--------------------------------------
+#pragma mark - Tests
+///--------------------------------------
+
+- (void)testFilePACScriptIsEvaluatedAndCached
+{
+    NSURL *url = [NSURL URLWithString:@"https://socketrocket.example.com"];
+
+    [self writePACScriptReturning:@"PROXY 127.0.0.1:3128"];
+    NSDictionary *settings = [self resolveProxyForURL:url];
+    XCTAssertEqualObjects(settings[(__bridge NSString *)kCFProxyTypeKey], (__bridge NSString *)kCFProxyTypeHTTP);
+    XCTAssertEqualObjects(settings[(__bridge NSString *)kCFProxyHostNameKey], @"127.0.0.1");
+    XCTAssertEqualObjects(settings[(__bridge NSString *)kCFProxyPortNumberKey], @3128);
+
+    // Script on disk changed, but cached script and result should still be used.
+    [self writePACScriptReturning:@"DIRECT"];
+    XCTAssertEqualObjects([self resolveProxyForURL:url], settings);
+
+    // After invalidation - new script is loaded and evaluated.
+    [[SRProxyCache sharedCache] invalidate];
+    NSDictionary *directSettings = [self resolveProxyForURL:url];
+    XCTAssertEqualObjects(directSettings[(__bridge NSString *)kCFProxyTypeKey], (__bridge NSString *)kCFProxyTypeNone);
+}
+
+- (void)testScriptsWithSamePrefixAndSuffixAreCachedSeparately
+{
+    NSURL *url = [NSURL URLWithString:@"https://socketrocket.example.com"];
+    NSDictionary *systemSettings = [[SRProxyCache sharedCache] systemProxySettings];
+
+    // Scripts only differ in the returned proxy, surrounded by long identical text.
+    NSString *padding = [@"" stringByPaddingToLength:4096 withString:@"/* padding */ " startingAtIndex:0];
+    NSString *format = @"function FindProxyForURL(url, host) { %@ return \"PROXY %@:3128\"; %@ }";
+    NSString *firstScript = [NSString stringWithFormat:format, padding, @"127.0.0.1", padding];
+    NSString *secondScript = [NSString stringWithFormat:format, padding, @"127.0.0.2", padding];
+
+    NSDictionary *firstSettings = [[SRProxyCache sharedCache] proxySettingsForURL:url PACScript:firstScript proxySettings:systemSettings];
+    NSDictionary *secondSettings = [[SRProxyCache sharedCache] proxySettingsForURL:url PACScript:secondScript proxySettings:systemSettings];
+    XCTAssertEqualObjects(firstSettings[(__bridge NSString *)kCFProxyHostNameKey], @"127.0.0.1");
+    XCTAssertEqualObjects(secondSettings[(__bridge NSString *)kCFProxyHostNameKey], @"127.0.0.2");
+}
+
+- (void)testCacheExpiresAfterTimeToLive
+{
+    NSURL *url = [NSURL URLWithString:@"http://socketrocket.example.com"];
+    NSTimeInterval timeToLive = [SRProxyCache sharedCache].timeToLive;
+    [SRProxyCache sharedCache].timeToLive = 0.1;
+
+    [self writePACScriptReturning:@"PROXY 127.0.0.1:3128"];
+    XCTAssertEqualObjects([self resolveProxyForURL:url][(__bridge NSString *)kCFProxyHostNameKey], @"127.0.0.1");
+
+    [self writePACScriptReturning:@"PROXY 127.0.0.2:3128"];
+    [NSThread sleepForTimeInterval:0.2];
+    XCTAssertEqualObjects([self resolveProxyForURL:url][(__bridge NSString *)kCFProxyHostNameKey], @"127.0.0.2");
+
+    [SRProxyCache sharedCache].timeToLive = timeToLive;
+}
+
+@end
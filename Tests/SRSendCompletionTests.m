@@ -0,0 +1,384 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+@import XCTest;
+
+#import <CommonCrypto/CommonDigest.h>
+
+#import <SocketRocket/SocketRocket.h>
+
+#import "SRFrame.h"
+#import "SRMasking.h"
+
+///--------------------------------------
+#pragma mark - Sink Server
+///--------------------------------------
+
+// Answers the opening handshake, then reads and discards everything, but only while `reading` is enabled.
+@interface SRSinkServer : NSObject <SRTransportDelegate>
+
+- (instancetype)initWithTransport:(SRLoopbackTransport *)transport;
+
+@property (atomic, assign) BOOL reading;
+@property (atomic, assign, readonly) NSUInteger bytesRead; // After the handshake.
+@property (atomic, copy, readonly) NSData *receivedData;
+
+- (void)readAvailableBytes;
+
+@end
+
+@interface SRSinkServer ()
+
+@property (atomic, assign, readwrite) NSUInteger bytesRead;
+
+@end
+
+@implementation SRSinkServer
+{
+    SRLoopbackTransport *_transport;
+    NSMutableData *_handshake;
+    BOOL _handshakeCompleted;
+    NSMutableData *_receivedData;
+}
+
+- (instancetype)initWithTransport:(SRLoopbackTransport *)transport
+{
+    self = [super init];
+    if (!self) return self;
+
+    _handshake = [NSMutableData data];
+    _receivedData = [NSMutableData data];
+    _transport = transport;
+    _transport.delegate = self;
+    [_transport openTransport];
+
+    return self;
+}
+
+- (void)transport:(id<SRTransport>)transport handleEvent:(SRTransportEvent)event
+{
+    switch (event) {
+        case SRTransportEventHasBytesAvailable:
+            if (!_handshakeCompleted) {
+                [self _readHandshake];
+            } else if (self.reading) {
+                [self readAvailableBytes];
+            }
+            break;
+        case SRTransportEventEndEncountered:
+        case SRTransportEventErrorOccurred:
+            [_transport close];
+            break;
+        case SRTransportEventOpenCompleted:
+        case SRTransportEventHasSpaceAvailable:
+            break;
+    }
+}
+
+- (void)readAvailableBytes
+{
+    uint8_t buffer[4096];
+    while (_transport.hasBytesAvailable) {
+        NSInteger length = [_transport read:buffer maxLength:sizeof(buffer)];
+        if (length <= 0) {
+            break;
+        }
+        @synchronized (self) {
+            [_receivedData appendBytes:buffer length:(NSUInteger)length];
+        }
+        self.bytesRead += (NSUInteger)length;
+    }
+}
+
+- (NSData *)receivedData
+{
+    @synchronized (self) {
+        return [_receivedData copy];
+    }
+}
+
+- (void)_readHandshake
+{
+    // Read byte by byte, so nothing after the request is consumed.
+    uint8_t byte = 0;
+    while (!_handshakeCompleted && [_transport read:&byte maxLength:1] == 1) {
+        [_handshake appendBytes:&byte length:1];
+        _handshakeCompleted = (_handshake.length >= 4 &&
+                               memcmp((const uint8_t *)_handshake.bytes + _handshake.length - 4, "\r\n\r\n", 4) == 0);
+    }
+    if (!_handshakeCompleted) {
+        return;
+    }
+
+    NSString *request = [[NSString alloc] initWithData:_handshake encoding:NSUTF8StringEncoding];
+    NSString *key = @"";
+    for (NSString *line in [request componentsSeparatedByString:@"\r\n"]) {
+        NSRange separator = [line rangeOfString:@":"];
+        if (separator.location != NSNotFound &&
+            [[line substringToIndex:separator.location] caseInsensitiveCompare:@"Sec-WebSocket-Key"] == NSOrderedSame) {
+            key = [[line substringFromIndex:NSMaxRange(separator)] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        }
+    }
+
+    NSData *acceptSource = [[key stringByAppendingString:@"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"] dataUsingEncoding:NSUTF8StringEncoding];
+    uint8_t digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(acceptSource.bytes, (CC_LONG)acceptSource.length, digest);
+    NSString *accept = [[NSData dataWithBytes:digest length:sizeof(digest)] base64EncodedStringWithOptions:0];
+    NSString *response = [NSString stringWithFormat:@"HTTP/1.1 101 Switching Protocols\r\n"
+                                                    "Upgrade: websocket\r\n"
+                                                    "Connection: Upgrade\r\n"
+                                                    "Sec-WebSocket-Accept: %@\r\n\r\n", accept];
+    NSData *responseData = [response dataUsingEncoding:NSUTF8StringEncoding];
+    [_transport write:responseData.bytes maxLength:responseData.length];
+
+    if (self.reading) {
+        [self readAvailableBytes];
+    }
+}
+
+@end
+
+///--------------------------------------
+#pragma mark - Tests
+///--------------------------------------
+
+@interface SRSendCompletionTests : XCTestCase <SRWebSocketDelegate>
+@end
+
+@implementation SRSendCompletionTests {
+    SRLoopbackTransport *_clientTransport;
+    SRSinkServer *_server;
+    SRWebSocket *_webSocket;
+    XCTestExpectation *_openExpectation;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    SRLoopbackTransport *clientTransport = nil;
+    SRLoopbackTransport *serverTransport = nil;
+    [SRLoopbackTransport getClientTransport:&clientTransport serverTransport:&serverTransport];
+    _clientTransport = clientTransport;
+    _server = [[SRSinkServer alloc] initWithTransport:(SRLoopbackTransport *_Nonnull)serverTransport];
+
+    _openExpectation = [self expectationWithDescription:@"open"];
+    _webSocket = [[SRWebSocket alloc] initWithURL:[NSURL URLWithString:@"ws://localhost/"]];
+    _webSocket.delegate = self;
+    _webSocket.delegateDispatchQueue = dispatch_queue_create("com.facebook.socketrocket.tests.delegate", DISPATCH_QUEUE_SERIAL);
+    [_webSocket openWithTransport:_clientTransport];
+    [self waitForExpectations:@[ _openExpectation ] timeout:10.0];
+}
+
+- (void)tearDown
+{
+    _webSocket.delegate = nil;
+    [_webSocket close];
+
+    [super tearDown];
+}
+
+- (void)webSocketDidOpen:(SRWebSocket *)webSocket
+{
+    [_openExpectation fulfill];
+}
+
+// Spins the run loop, so anything that would happen in the meantime does.
+- (void)waitForInterval:(NSTimeInterval)interval
+{
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:interval]];
+}
+
+///--------------------------------------
+#pragma mark - Tests
+///--------------------------------------
+
+- (void)testCompletionWaitsUntilLastByteIsWritten
+{
+    // The server doesn't read, so only as much as the link buffers is written.
+    _clientTransport.bufferSize = 16 * 1024;
+
+    __block NSError *firstError = [NSError errorWithDomain:@"pending" code:0 userInfo:nil];
+    __block NSError *secondError = firstError;
+    __block BOOL secondCompletedFirst = NO;
+    XCTestExpectation *firstCompletion = [self expectationWithDescription:@"first"];
+    XCTestExpectation *secondCompletion = [self expectationWithDescription:@"second"];
+
+    NSError *error = nil;
+    XCTAssertNotNil([_webSocket sendData:[NSMutableData dataWithLength:32 * 1024] priority:SRSendPriorityDefault completion:^(NSError *sendError) {
+        firstError = sendError;
+        [firstCompletion fulfill];
+    } error:&error]);
+    XCTAssertNotNil([_webSocket sendData:[NSMutableData dataWithLength:100] priority:SRSendPriorityDefault completion:^(NSError *sendError) {
+        secondCompletedFirst = (firstError != nil);
+        secondError = sendError;
+        [secondCompletion fulfill];
+    } error:&error]);
+
+    // Frames of both messages are produced, but the first one is only partially written.
+    [self waitForInterval:0.5];
+    XCTAssertNotNil(firstError);
+    XCTAssertNotNil(secondError);
+
+    _server.reading = YES;
+    [_server readAvailableBytes];
+    [self waitForExpectations:@[ firstCompletion, secondCompletion ] timeout:10.0];
+    XCTAssertNil(firstError);
+    XCTAssertNil(secondError);
+    XCTAssertFalse(secondCompletedFirst);
+}
+
+- (void)testCancelRacingWithFraming
+{
+    static const NSUInteger messageCount = 200;
+    static const NSUInteger messageLength = 100;
+    static const NSUInteger frameLength = 2 + 4 + messageLength; // Short header and mask key.
+    _server.reading = YES;
+
+    __block NSUInteger cancelledCount = 0;
+    NSMutableArray<NSNumber *> *cancelled = [NSMutableArray arrayWithCapacity:messageCount];
+    NSMutableArray<id> *errors = [NSMutableArray arrayWithCapacity:messageCount];
+    for (NSUInteger i = 0; i < messageCount; i++) {
+        [cancelled addObject:@NO];
+        [errors addObject:[NSNull null]];
+    }
+
+    XCTestExpectation *completions = [self expectationWithDescription:@"completions"];
+    completions.expectedFulfillmentCount = messageCount;
+    dispatch_group_t cancellations = dispatch_group_create();
+    for (NSUInteger i = 0; i < messageCount; i++) {
+        SRSendHandle *handle = [_webSocket sendData:[NSMutableData dataWithLength:messageLength] priority:SRSendPriorityDefault completion:^(NSError *sendError) {
+            @synchronized (errors) {
+                errors[i] = sendError ?: [NSNull null];
+            }
+            [completions fulfill];
+        } error:nil];
+        XCTAssertNotNil(handle);
+
+        // Cancel from another thread, while the socket may be framing the message.
+        dispatch_group_async(cancellations, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+            BOOL didCancel = [handle cancel];
+            @synchronized (cancelled) {
+                cancelled[i] = @(didCancel);
+                cancelledCount += (didCancel ? 1 : 0);
+            }
+        });
+    }
+    dispatch_group_wait(cancellations, DISPATCH_TIME_FOREVER);
+    [self waitForExpectations:@[ completions ] timeout:10.0];
+
+    // A cancelled message fails and is never written, any other message is written completely.
+    for (NSUInteger i = 0; i < messageCount; i++) {
+        NSError *error = ([errors[i] isKindOfClass:[NSError class]] ? errors[i] : nil);
+        if ([cancelled[i] boolValue]) {
+            XCTAssertEqual(error.code, 2137, @"%lu", (unsigned long)i);
+        } else {
+            XCTAssertNil(error, @"%lu", (unsigned long)i);
+        }
+    }
+
+    NSUInteger expectedBytes = (messageCount - cancelledCount) * frameLength;
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:10.0];
+    while (_server.bytesRead < expectedBytes && [deadline timeIntervalSinceNow] > 0) {
+        [self waitForInterval:0.05];
+    }
+    [self waitForInterval:0.2];
+    XCTAssertEqual(_server.bytesRead, expectedBytes);
+}
+
+- (void)testPendingSendsFailWhenConnectionBreaks
+{
+    _clientTransport.bufferSize = 16 * 1024;
+
+    static const NSUInteger messageCount = 4;
+    NSMutableArray<NSError *> *errors = [NSMutableArray array];
+    XCTestExpectation *completions = [self expectationWithDescription:@"completions"];
+    completions.expectedFulfillmentCount = messageCount;
+
+    // The first message is partially written, the others wait in the queue.
+    for (NSUInteger i = 0; i < messageCount; i++) {
+        XCTAssertNotNil([_webSocket sendData:[NSMutableData dataWithLength:32 * 1024] priority:SRSendPriorityDefault completion:^(NSError *sendError) {
+            @synchronized (errors) {
+                if (sendError) {
+                    [errors addObject:sendError];
+                }
+            }
+            [completions fulfill];
+        } error:nil]);
+    }
+    [self waitForInterval:0.5];
+
+    [_clientTransport failWithError:[NSError errorWithDomain:NSPOSIXErrorDomain code:ECONNRESET userInfo:nil]];
+    [self waitForExpectations:@[ completions ] timeout:10.0];
+
+    XCTAssertEqual(errors.count, messageCount);
+    for (NSError *error in errors) {
+        XCTAssertEqual(error.code, 2138);
+    }
+}
+
+- (void)testLargeMessageIsSentInFragmentsOfConcurrentProcessingThreshold
+{
+    _server.reading = YES;
+    _webSocket.outgoingFragmentSize = 64 * 1024;
+    _webSocket.concurrentProcessingThreshold = 1024 * 1024;
+
+    // Fragments of the threshold size, so each is masked on all cores, and a short last one.
+    NSMutableData *message = [NSMutableData dataWithLength:2 * 1024 * 1024 + 3];
+    uint8_t *messageBytes = message.mutableBytes;
+    for (NSUInteger i = 0; i < message.length; i++) {
+        messageBytes[i] = (uint8_t)(i * 31);
+    }
+
+    XCTestExpectation *completion = [self expectationWithDescription:@"completion"];
+    XCTAssertNotNil([_webSocket sendData:message priority:SRSendPriorityDefault completion:^(NSError *sendError) {
+        XCTAssertNil(sendError);
+        [completion fulfill];
+    } error:nil]);
+    [self waitForExpectations:@[ completion ] timeout:10.0];
+
+    NSUInteger frameCount = 3;
+    NSUInteger expectedLength = message.length + 2 * SRFrameHeaderLength(1024 * 1024, true) + SRFrameHeaderLength(3, true);
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:10.0];
+    while (_server.bytesRead < expectedLength && [deadline timeIntervalSinceNow] > 0) {
+        [self waitForInterval:0.05];
+    }
+    NSData *receivedData = _server.receivedData;
+    XCTAssertEqual(receivedData.length, expectedLength);
+
+    // Every fragment is unmasked on its own with the key in its header, as a server does.
+    NSMutableData *payload = [NSMutableData data];
+    NSMutableSet<NSData *> *maskKeys = [NSMutableSet set];
+    NSUInteger offset = 0;
+    NSUInteger receivedFrameCount = 0;
+    BOOL fin = NO;
+    while (!fin && offset < receivedData.length) {
+        SRFrameHeader header = {0};
+        const uint8_t *bytes = (const uint8_t *)receivedData.bytes + offset;
+        XCTAssertEqual(SRFrameHeaderParse(bytes, receivedData.length - offset, &header), SRFrameResultOK);
+        XCTAssertTrue(header.masked);
+        XCTAssertEqual(header.opcode, (receivedFrameCount == 0 ? SROpCodeBinaryFrame : SROpCodeContinuationFrame));
+        [maskKeys addObject:[NSData dataWithBytes:header.maskKey length:sizeof(header.maskKey)]];
+
+        NSMutableData *fragment = [NSMutableData dataWithBytes:bytes + header.headerLength length:(NSUInteger)header.payloadLength];
+        SRMaskBytes(fragment.mutableBytes, fragment.length, header.maskKey, 0);
+        [payload appendData:fragment];
+
+        offset += header.headerLength + (NSUInteger)header.payloadLength;
+        receivedFrameCount += 1;
+        fin = header.fin;
+    }
+    XCTAssertTrue(fin);
+    XCTAssertEqual(receivedFrameCount, frameCount);
+    // Random keys, so equal ones are practically impossible.
+    XCTAssertEqual(maskKeys.count, frameCount);
+    XCTAssertEqualObjects(payload, message);
+}
+
+@end
@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+@import XCTest;
+
+#import <SocketRocket/SRUTF8String.h>
+
+@interface SRUTF8StringTests : XCTestCase
+@end
+
+@implementation SRUTF8StringTests
+
+- (SRUTF8String *)stringWithString:(NSString *)string
+{
+    return [[SRUTF8String alloc] initWithUTF8Data:[string dataUsingEncoding:NSUTF8StringEncoding]];
+}
+
+- (void)testInvalidUTF8
+{
+    const uint8_t bytes[] = { 'a', 0xC3 };
+    XCTAssertNil([[SRUTF8String alloc] initWithUTF8Data:[NSData dataWithBytes:bytes length:sizeof(bytes)]]);
+}
+
+- (void)testLengthMatchesUTF16
+{
+    NSArray<NSString *> *strings = @[ @"", @"ascii", @"café", @"€100", @"\U0001F680 launch", @"日本語" ];
+    for (NSString *string in strings) {
+        SRUTF8String *utf8String = [self stringWithString:string];
+        XCTAssertEqual(utf8String.length, string.length, @"%@", string);
+        XCTAssertEqualObjects(utf8String, string);
+        XCTAssertEqualObjects(string, utf8String);
+        XCTAssertEqual(utf8String.hash, string.hash);
+    }
+}
+
+- (void)testUTF8AccessDoesNotCopy
+{
+    NSData *data = [@"\U0001F680 launch" dataUsingEncoding:NSUTF8StringEncoding];
+    SRUTF8String *string = [[SRUTF8String alloc] initWithUTF8Data:data];
+
+    XCTAssertEqual(string.UTF8Data.bytes, data.bytes);
+    XCTAssertEqual([string dataUsingEncoding:NSUTF8StringEncoding].bytes, data.bytes);
+    XCTAssertEqual([string lengthOfBytesUsingEncoding:NSUTF8StringEncoding], data.length);
+    XCTAssertEqual(strcmp(string.UTF8String, "\xF0\x9F\x9A\x80 launch"), 0);
+}
+
+- (void)testUTF16Access
+{
+    SRUTF8String *string = [self stringWithString:@"\U0001F680 launch"];
+
+    XCTAssertEqual([string characterAtIndex:0], 0xD83D);
+    XCTAssertEqual([string characterAtIndex:1], 0xDE80);
+    XCTAssertEqualObjects([string substringFromIndex:3], @"launch");
+    XCTAssertEqualObjects([string copy], string);
+}
+
+- (void)testLeadingByteOrderMarkIsKept
+{
+    const uint8_t bytes[] = { 0xEF, 0xBB, 0xBF, 'h', 'i' };
+    SRUTF8String *string = [[SRUTF8String alloc] initWithUTF8Data:[NSData dataWithBytes:bytes length:sizeof(bytes)]];
+
+    XCTAssertEqual(string.length, 3);
+    XCTAssertEqual([string characterAtIndex:0], 0xFEFF);
+    XCTAssertEqual([string characterAtIndex:2], 'i');
+
+    unichar characters[3] = { 0 };
+    [string getCharacters:characters range:NSMakeRange(0, 3)];
+    XCTAssertEqual(characters[0], 0xFEFF);
+    XCTAssertEqual(characters[1], 'h');
+    XCTAssertEqualObjects([string substringFromIndex:1], @"hi");
+    XCTAssertEqual(string.length, 3);
+}
+
+@end